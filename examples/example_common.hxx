@@ -151,7 +151,8 @@ void init_raft(ptr<state_machine> sm_instance) {
                                 std::to_string( stuff.server_id_ ) +
                                 ".log";
     ptr<logger_wrapper> log_wrap = cs_new<logger_wrapper>( log_file_name, 4 );
-    stuff.raft_logger_ = log_wrap;
+    // Write logs on a background thread, not on Raft's threads.
+    stuff.raft_logger_ = cs_new<async_logger>(log_wrap);
 
     // State machine.
     stuff.smgr_ = cs_new<inmem_state_mgr>( stuff.server_id_,
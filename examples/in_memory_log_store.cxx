@@ -19,32 +19,79 @@ limitations under the License.
 
 #include "nuraft.hxx"
 
+#include <algorithm>
 #include <cassert>
 
 namespace nuraft {
 
+// Initial number of slots in the ring, should be a power of 2.
+static const size_t INITIAL_RING_SIZE = 1024;
+
 inmem_log_store::inmem_log_store()
-    : start_idx_(1)
+    : ring_( cs_new<ring>(INITIAL_RING_SIZE) )
+    , start_idx_(1)
+    , next_idx_(1)
 {
     // Dummy entry for index 0.
     ptr<buffer> buf = buffer::alloc(sz_ulong);
-    logs_[0] = cs_new<log_entry>(0, buf);
+    dummy_ = cs_new<log_entry>(0, buf);
 }
 
 inmem_log_store::~inmem_log_store() {}
 
 ptr<log_entry> inmem_log_store::make_clone(const ptr<log_entry>& entry) {
-    ptr<log_entry> clone = cs_new<log_entry>
+    buffer& buf = entry->get_buf();
+    ptr<log_entry> clone = log_entry::make_compact
                            ( entry->get_term(),
-                             buffer::clone( entry->get_buf() ),
+                             buf.data_begin(),
+                             buf.size(),
                              entry->get_val_type() );
+    if (entry->has_crc32()) clone->set_crc32( entry->get_crc32() );
     return clone;
 }
 
+ptr<log_entry> inmem_log_store::get_entry(ulong index) const {
+    if (index < start_idx_ || index >= next_idx_) return nullptr;
+
+    ptr<ring> rr = std::atomic_load(&ring_);
+    ptr<log_entry> le = std::atomic_load(&rr->slot(index));
+
+    // The slot may have been reused by a newer log
+    // after compaction, while we were reading it.
+    if (index < start_idx_) return nullptr;
+    return le;
+}
+
+void inmem_log_store::put_entry(ulong index, const ptr<log_entry>& entry) {
+    ptr<ring> rr = ring_;
+    ulong start = start_idx_;
+    if (index - start >= rr->slots_.size()) {
+        // Full, double the ring. Readers holding the old one
+        // can keep reading it.
+        ptr<ring> new_ring = cs_new<ring>(rr->slots_.size() * 2);
+        for (ulong ii = start; ii < index; ++ii) {
+            new_ring->slot(ii) = std::atomic_load(&rr->slot(ii));
+        }
+        std::atomic_store(&ring_, new_ring);
+        rr = new_ring;
+    }
+    std::atomic_store(&rr->slot(index), entry);
+    next_idx_ = index + 1;
+}
+
+void inmem_log_store::truncate(ulong index) {
+    ulong next = next_idx_;
+    if (index >= next) return;
+
+    next_idx_ = index;
+    ptr<ring> rr = ring_;
+    for (ulong ii = index; ii < next; ++ii) {
+        std::atomic_store(&rr->slot(ii), ptr<log_entry>());
+    }
+}
+
 ulong inmem_log_store::next_slot() const {
-    std::lock_guard<std::mutex> l(logs_lock_);
-    // Exclude the dummy entry.
-    return start_idx_ + logs_.size() - 1;
+    return next_idx_;
 }
 
 ulong inmem_log_store::start_index() const {
@@ -52,22 +99,17 @@ ulong inmem_log_store::start_index() const {
 }
 
 ptr<log_entry> inmem_log_store::last_entry() const {
-    ulong next_idx = next_slot();
-    std::lock_guard<std::mutex> l(logs_lock_);
-    auto entry = logs_.find( next_idx - 1 );
-    if (entry == logs_.end()) {
-        entry = logs_.find(0);
-    }
-
-    return make_clone(entry->second);
+    ptr<log_entry> le = get_entry(next_idx_ - 1);
+    if (!le) le = dummy_;
+    return make_clone(le);
 }
 
 ulong inmem_log_store::append(ptr<log_entry>& entry) {
     ptr<log_entry> clone = make_clone(entry);
 
     std::lock_guard<std::mutex> l(logs_lock_);
-    size_t idx = start_idx_ + logs_.size() - 1;
-    logs_[idx] = clone;
+    ulong idx = next_idx_;
+    put_entry(idx, clone);
     return idx;
 }
 
@@ -76,34 +118,39 @@ void inmem_log_store::write_at(ulong index, ptr<log_entry>& entry) {
 
     // Discard all logs equal to or greater than `index.
     std::lock_guard<std::mutex> l(logs_lock_);
-    auto itr = logs_.lower_bound(index);
-    while (itr != logs_.end()) {
-        itr = logs_.erase(itr);
-    }
-    logs_[index] = clone;
+    truncate(index);
+    put_entry(index, clone);
+}
+
+void inmem_log_store::append_batch(ulong start_idx,
+                                   std::vector< ptr<log_entry> >& entries)
+{
+    std::vector< ptr<log_entry> > clones;
+    clones.reserve(entries.size());
+    for (ptr<log_entry>& le: entries) clones.push_back(make_clone(le));
+
+    std::lock_guard<std::mutex> l(logs_lock_);
+    ulong idx = next_idx_;
+    for (ptr<log_entry>& le: clones) put_entry(idx++, le);
+}
+
+void inmem_log_store::write_batch_at(ulong start_idx,
+                                     std::vector< ptr<log_entry> >& entries)
+{
+    std::vector< ptr<log_entry> > clones;
+    clones.reserve(entries.size());
+    for (ptr<log_entry>& le: entries) clones.push_back(make_clone(le));
+
+    std::lock_guard<std::mutex> l(logs_lock_);
+    truncate(start_idx);
+    ulong idx = start_idx;
+    for (ptr<log_entry>& le: clones) put_entry(idx++, le);
 }
 
 ptr< std::vector< ptr<log_entry> > >
     inmem_log_store::log_entries(ulong start, ulong end)
 {
-    ptr< std::vector< ptr<log_entry> > > ret =
-        cs_new< std::vector< ptr<log_entry> > >();
-
-    ret->resize(end - start);
-    ulong cc=0;
-    for (ulong ii = start ; ii < end ; ++ii) {
-        ptr<log_entry> src = nullptr;
-        {   std::lock_guard<std::mutex> l(logs_lock_);
-            auto entry = logs_.find(ii);
-            if (entry == logs_.end()) {
-                entry = logs_.find(0);
-                assert(0);
-            }
-            src = entry->second;
-        }
-        (*ret)[cc++] = make_clone(src);
-    }
-    return ret;
+    return log_entries_ext(start, end, 0);
 }
 
 ptr<std::vector<ptr<log_entry>>>
@@ -113,17 +160,15 @@ ptr<std::vector<ptr<log_entry>>>
 {
     ptr< std::vector< ptr<log_entry> > > ret =
         cs_new< std::vector< ptr<log_entry> > >();
+    if (end <= start) return ret;
 
+    ret->reserve(end - start);
     size_t accum_size = 0;
     for (ulong ii = start ; ii < end ; ++ii) {
-        ptr<log_entry> src = nullptr;
-        {   std::lock_guard<std::mutex> l(logs_lock_);
-            auto entry = logs_.find(ii);
-            if (entry == logs_.end()) {
-                entry = logs_.find(0);
-                assert(0);
-            }
-            src = entry->second;
+        ptr<log_entry> src = get_entry(ii);
+        if (!src) {
+            // Compacted or truncated in the meantime.
+            return nullptr;
         }
         ret->push_back(make_clone(src));
         accum_size += src->get_buf().size();
@@ -134,27 +179,19 @@ ptr<std::vector<ptr<log_entry>>>
 }
 
 ptr<log_entry> inmem_log_store::entry_at(ulong index) {
-    ptr<log_entry> src = nullptr;
-    {   std::lock_guard<std::mutex> l(logs_lock_);
-        auto entry = logs_.find(index);
-        if (entry == logs_.end()) {
-            entry = logs_.find(0);
-        }
-        src = entry->second;
-    }
+    ptr<log_entry> src = get_entry(index);
+    if (!src) src = dummy_;
     return make_clone(src);
 }
 
 ulong inmem_log_store::term_at(ulong index) {
-    ulong term = 0;
-    {   std::lock_guard<std::mutex> l(logs_lock_);
-        auto entry = logs_.find(index);
-        if (entry == logs_.end()) {
-            entry = logs_.find(0);
-        }
-        term = entry->second->get_term();
-    }
-    return term;
+    ptr<log_entry> src = get_entry(index);
+    return src ? src->get_term() : 0;
+}
+
+log_val_type inmem_log_store::val_type_at(ulong index) {
+    ptr<log_entry> src = get_entry(index);
+    return src ? src->get_val_type() : log_val_type::app_log;
 }
 
 ptr<buffer> inmem_log_store::pack(ulong index, int32 cnt) {
@@ -162,10 +199,7 @@ ptr<buffer> inmem_log_store::pack(ulong index, int32 cnt) {
 
     size_t size_total = 0;
     for (ulong ii=index; ii<index+cnt; ++ii) {
-        ptr<log_entry> le = nullptr;
-        {   std::lock_guard<std::mutex> l(logs_lock_);
-            le = logs_[ii];
-        }
+        ptr<log_entry> le = get_entry(ii);
         assert(le.get());
         ptr<buffer> buf = le->serialize();
         size_total += buf->size();
@@ -191,6 +225,16 @@ void inmem_log_store::apply_pack(ulong index, buffer& pack) {
     pack.pos(0);
     int32 num_logs = pack.get_int();
 
+    std::lock_guard<std::mutex> l(logs_lock_);
+    if (index < start_idx_ || index > next_idx_) {
+        // Not contiguous to the current logs, start over from `index`.
+        truncate(start_idx_);
+        start_idx_ = index;
+        next_idx_ = index;
+    } else {
+        truncate(index);
+    }
+
     for (int32 ii=0; ii<num_logs; ++ii) {
         ulong cur_idx = index + ii;
         int32 buf_size = pack.get_int();
@@ -199,34 +243,30 @@ void inmem_log_store::apply_pack(ulong index, buffer& pack) {
         pack.get(buf_local);
 
         ptr<log_entry> le = log_entry::deserialize(*buf_local);
-        {   std::lock_guard<std::mutex> l(logs_lock_);
-            logs_[cur_idx] = le;
-        }
-    }
-
-    {   std::lock_guard<std::mutex> l(logs_lock_);
-        auto entry = logs_.upper_bound(0);
-        if (entry != logs_.end()) {
-            start_idx_ = entry->first;
-        } else {
-            start_idx_ = 1;
-        }
+        put_entry(cur_idx, le);
     }
 }
 
 bool inmem_log_store::compact(ulong last_log_index) {
     std::lock_guard<std::mutex> l(logs_lock_);
-    for (ulong ii = start_idx_; ii <= last_log_index; ++ii) {
-        auto entry = logs_.find(ii);
-        if (entry != logs_.end()) {
-            logs_.erase(entry);
-        }
-    }
+    ulong start = start_idx_;
+    ulong next = next_idx_;
+    if (last_log_index < start) return true;
 
     // WARNING:
     //   Even though nothing has been erased,
     //   we should set `start_idx_` to new index.
+    //
+    // Move `start_idx_` first, so that readers do not
+    // see the slots being cleared.
     start_idx_ = last_log_index + 1;
+    if (next < start_idx_) next_idx_ = start_idx_.load();
+
+    ptr<ring> rr = ring_;
+    ulong end = std::min(next, last_log_index + 1);
+    for (ulong ii = start; ii < end; ++ii) {
+        std::atomic_store(&rr->slot(ii), ptr<log_entry>());
+    }
     return true;
 }
 
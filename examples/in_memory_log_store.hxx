@@ -20,11 +20,26 @@ limitations under the License.
 #include "log_store.hxx"
 
 #include <atomic>
-#include <map>
 #include <mutex>
+#include <vector>
 
 namespace nuraft {
 
+/**
+ * In-memory log store, based on a contiguous ring buffer addressed
+ * by log index.
+ *
+ * Writers (append, truncation, compaction) are serialized by a lock,
+ * while readers (`entry_at`, `term_at`, `log_entries`, ...) do not
+ * take the lock: the ring and its slots are accessed through atomic
+ * `shared_ptr` operations only, so that the replication threads of
+ * the leader do not wait for the appender holding the lock.
+ *
+ * Note that this is not lock-free: the standard library implements
+ * atomic `shared_ptr` operations with a small pool of internal spin
+ * locks, which are held only for the duration of a single load or
+ * store.
+ */
 class inmem_log_store : public log_store {
 public:
     inmem_log_store();
@@ -33,6 +48,7 @@ public:
 
     __nocopy__(inmem_log_store);
 
+public:
     ulong next_slot() const;
 
     ulong start_index() const;
@@ -43,6 +59,10 @@ public:
 
     void write_at(ulong index, ptr<log_entry>& entry);
 
+    void append_batch(ulong start_idx, std::vector< ptr<log_entry> >& entries);
+
+    void write_batch_at(ulong start_idx, std::vector< ptr<log_entry> >& entries);
+
     ptr<std::vector<ptr<log_entry>>> log_entries(ulong start, ulong end);
 
     ptr<std::vector<ptr<log_entry>>> log_entries_ext(
@@ -52,6 +72,8 @@ public:
 
     ulong term_at(ulong index);
 
+    log_val_type val_type_at(ulong index);
+
     ptr<buffer> pack(ulong index, int32 cnt);
 
     void apply_pack(ulong index, buffer& pack);
@@ -63,11 +85,50 @@ public:
     void close();
 
 private:
+    struct ring {
+        ring(size_t capacity) : slots_(capacity), mask_(capacity - 1) {}
+
+        ptr<log_entry>& slot(ulong index) { return slots_[index & mask_]; }
+
+        // Capacity is always a power of 2.
+        std::vector< ptr<log_entry> > slots_;
+        ulong mask_;
+    };
+
     static ptr<log_entry> make_clone(const ptr<log_entry>& entry);
 
-    std::map<ulong, ptr<log_entry>> logs_;
+    /**
+     * Get the log entry at the given index, without `logs_lock_`.
+     *
+     * @return `nullptr` if it does not exist.
+     */
+    ptr<log_entry> get_entry(ulong index) const;
+
+    /**
+     * Put the log entry at the given index, and make it the last one.
+     * Should be called under `logs_lock_`.
+     */
+    void put_entry(ulong index, const ptr<log_entry>& entry);
+
+    /**
+     * Discard all logs equal to or greater than `index`.
+     * Should be called under `logs_lock_`.
+     */
+    void truncate(ulong index);
+
+    // Entry returned for a non-existing log index.
+    ptr<log_entry> dummy_;
+
+    // Should be accessed using `std::atomic_load` and `std::atomic_store`,
+    // as well as its slots.
+    ptr<ring> ring_;
+
+    // Writer lock.
     mutable std::mutex logs_lock_;
+
     std::atomic<ulong> start_idx_;
+
+    std::atomic<ulong> next_idx_;
 };
 
 }
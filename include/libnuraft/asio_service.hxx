@@ -67,6 +67,33 @@ public:
     ptr<rpc_listener> create_rpc_listener(ushort listening_port,
                                           ptr<logger>& l);
 
+    /**
+     * Create a listener on the given endpoint. Other than TCP
+     * (`[tcp://]host:port`, where the host part is ignored),
+     * Unix domain socket (`unix://<path>`) is also supported on
+     * POSIX platforms, for the peers running on the same host.
+     * `create_client` accepts the same form of endpoints.
+     *
+     * @param endpoint Endpoint to listen.
+     * @param l Logger.
+     * @return Listener, `nullptr` if failed.
+     */
+    ptr<rpc_listener> create_rpc_listener(const std::string& endpoint,
+                                          ptr<logger>& l);
+
+    /**
+     * Create a client factory for the given Raft group, to run
+     * multiple Raft groups on the same nodes (Multi-Raft).
+     * Requests from the clients created by the factory are tagged
+     * with the group ID, and share a single connection per endpoint
+     * with the clients of the other groups.
+     * Listener should be started by `rpc_listener::listen_groups`.
+     *
+     * @param group_id Group ID, should be a non-negative number.
+     * @return Client factory, `nullptr` if the group ID is invalid.
+     */
+    ptr<rpc_client_factory> create_group_client_factory(int32 group_id);
+
     void stop();
 
     uint32_t get_active_workers();
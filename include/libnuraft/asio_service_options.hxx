@@ -63,10 +63,22 @@ struct asio_service_meta_cb_params {
  * Options used for initialization of Asio service.
  */
 struct asio_service_options {
+    enum compression_type {
+        // No compression.
+        none = 0x0,
+        // LZ4, if the library is found at build time.
+        lz4 = 0x1,
+        // Zstandard, if the library is found at build time.
+        zstd = 0x2,
+        // Zlib (deflate), if the library is found at build time.
+        zlib = 0x3,
+    };
+
     asio_service_options()
         : thread_pool_size_(0)
         , enable_ssl_(false)
         , skip_verification_(false)
+        , ssl_session_resumption_(false)
         , write_req_meta_(nullptr)
         , read_req_meta_(nullptr)
         , invoke_req_cb_on_empty_meta_(true)
@@ -74,6 +86,20 @@ struct asio_service_options {
         , read_resp_meta_(nullptr)
         , invoke_resp_cb_on_empty_meta_(true)
         , verify_sn_(nullptr)
+        , zero_copy_log_receive_(false)
+        , compact_log_entries_(false)
+        , crc32c_header_(false)
+        , log_entry_crc_(false)
+        , heartbeat_coalesce_window_ms_(0)
+        , timer_wheel_tick_ms_(0)
+        , io_context_per_worker_(false)
+        , pin_worker_threads_(false)
+        , connections_per_peer_(1)
+        , metrics_http_port_(0)
+        , metrics_http_address_("127.0.0.1")
+        , compression_type_(none)
+        , compression_level_(0)
+        , compression_threshold_bytes_(4096)
         {}
 
     // Number of ASIO worker threads.
@@ -86,6 +112,12 @@ struct asio_service_options {
     // If `true`, skip certificate verification.
     bool skip_verification_;
 
+    // If `true`, the TLS session (or ticket) received from each endpoint
+    // is cached, and resumed when reconnecting to the same endpoint,
+    // to avoid full handshakes. Note that the certificate verification,
+    // including `verify_sn_`, is not invoked again for resumed sessions.
+    bool ssl_session_resumption_;
+
     // Path to certification & key files.
     std::string server_cert_file_;
     std::string server_key_file_;
@@ -118,6 +150,90 @@ struct asio_service_options {
     // Callback function for verifying certificate subject name.
     // If not given, subject name will not be verified.
     std::function< bool(const std::string&) > verify_sn_;
+
+    // If `true`, log entries in the received request will refer to
+    // the receive buffer directly, instead of allocating and copying
+    // their own buffers. The receive buffer will be alive until all
+    // log entries in it are released.
+    bool zero_copy_log_receive_;
+
+    // If `true`, each log entry in the received request is created by
+    // `log_entry::make_compact`, so that it takes a single memory
+    // allocation instead of three. Ignored if `zero_copy_log_receive_`
+    // is set.
+    bool compact_log_entries_;
+
+    // If `true`, CRC of request headers will be calculated using CRC32C,
+    // which can use the hardware instruction. Responses will follow
+    // the CRC of their requests. All servers in the cluster should
+    // support CRC32C before enabling it.
+    bool crc32c_header_;
+
+    // If `true`, each log entry in requests will carry the CRC32C of
+    // its payload, which is verified by the receiver and then attached
+    // to the received `log_entry`. If the leader already attached it
+    // (`raft_params::log_entry_crc_`), it will not be calculated again.
+    // All servers in the cluster should support it before enabling it.
+    bool log_entry_crc_;
+
+    // If non-zero, heartbeats (empty append entries requests) of
+    // multiple Raft groups to the same node are buffered up to the given
+    // time, and then sent as a single message. Only for the clients created
+    // by `asio_service::create_group_client_factory`, and ignored if
+    // `write_req_meta_` or `read_resp_meta_` is given. It should be
+    // small enough compared to the heartbeat interval.
+    size_t heartbeat_coalesce_window_ms_;
+
+    // If non-zero, `delayed_task`s are scheduled on a timer wheel driven
+    // by a single timer ticking at the given interval, instead of having
+    // their own Asio timers. It makes schedule and cancel O(1) without
+    // allocation, at the cost of precision: tasks may expire up to
+    // one tick later than requested.
+    size_t timer_wheel_tick_ms_;
+
+    // If `true`, each worker thread (`thread_pool_size_`) runs its own
+    // io_service, instead of sharing a single one. Sessions, clients,
+    // and timers are spread over them, and each of them is handled by
+    // the same worker, which reduces cross-core handoffs and contention.
+    bool io_context_per_worker_;
+
+    // If `true`, each worker thread is pinned to a CPU core,
+    // in a round-robin manner. Only supported on Linux.
+    bool pin_worker_threads_;
+
+    // Number of connections to each peer. If greater than 1, the first
+    // connection is dedicated to small messages such as heartbeats and
+    // votes, so that they are not blocked behind large append entries
+    // or snapshot requests, which go through the rest of connections.
+    // Not applied to the clients created by
+    // `asio_service::create_group_client_factory`.
+    size_t connections_per_peer_;
+
+    // If non-zero, serve all stats in Prometheus text exposition format
+    // (`raft_server::get_all_stats_prometheus`) over HTTP on the given
+    // port, so that they can be scraped by `GET` to any path.
+    uint16_t metrics_http_port_;
+
+    // Local address that the metrics endpoint listens on. Loopback by
+    // default, set it to e.g. "0.0.0.0" to be scraped from other hosts.
+    std::string metrics_http_address_;
+
+    // If not `none`, the data section of requests (log entries including
+    // snapshot blocks, and meta) bigger than `compression_threshold_bytes_`
+    // is compressed using the given codec. It is negotiated per
+    // connection: requests are compressed only after the peer responds
+    // that it supports the same codec, so that it can be enabled without
+    // upgrading all servers at once. If the codec is not available in
+    // this build, compression is not used.
+    compression_type compression_type_;
+
+    // Compression level, 0 for the default of the codec.
+    // For LZ4, it is the acceleration factor (bigger is faster).
+    int compression_level_;
+
+    // Requests whose data section is smaller than this value
+    // are not compressed.
+    size_t compression_threshold_bytes_;
 };
 
 }
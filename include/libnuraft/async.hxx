@@ -34,6 +34,15 @@ limitations under the License.
 #include <string>
 #include <unordered_map>
 
+// Coroutine support requires C++20. With older standards,
+// `cmd_result` can only be used through `get()` or `when_ready()`.
+#if defined(__cpp_impl_coroutine)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define NURAFT_COROUTINE_SUPPORT (1)
+#endif
+#endif
+
 namespace nuraft {
 
 enum cmd_result_code {
@@ -47,6 +56,8 @@ enum cmd_result_code {
     SERVER_IS_JOINING = -7,
     SERVER_NOT_FOUND = -8,
     CANNOT_REMOVE_LEADER = -9,
+    SERVER_IS_BUSY = -10,
+    SERVER_IS_LAGGING = -11,
 
     FAILED = -32768,
 };
@@ -73,6 +84,8 @@ public:
         , accepted_(false)
         , handler_(nullptr)
         , handler2_(nullptr)
+        , resume_fn_(nullptr)
+        , resume_arg_(nullptr)
         {}
 
     explicit cmd_result(T& result)
@@ -83,6 +96,8 @@ public:
         , accepted_(false)
         , handler_(nullptr)
         , handler2_(nullptr)
+        , resume_fn_(nullptr)
+        , resume_arg_(nullptr)
         {}
 
     explicit cmd_result(T& result, bool _accepted)
@@ -93,6 +108,8 @@ public:
         , accepted_(_accepted)
         , handler_(nullptr)
         , handler2_(nullptr)
+        , resume_fn_(nullptr)
+        , resume_arg_(nullptr)
         {}
 
     explicit cmd_result(const handler_type& handler)
@@ -102,6 +119,8 @@ public:
         , accepted_(false)
         , handler_(handler)
         , handler2_(nullptr)
+        , resume_fn_(nullptr)
+        , resume_arg_(nullptr)
         {}
 
     ~cmd_result() {}
@@ -151,17 +170,28 @@ public:
      */
     void set_result(T& result, TE& err) {
         bool call_handler = false;
+        void (*resume_fn)(void*) = nullptr;
+        void* resume_arg = nullptr;
         {   std::lock_guard<std::mutex> guard(lock_);
             result_ = result;
             err_ = err;
             has_result_ = true;
             if (handler_ || handler2_) call_handler = true;
+            resume_fn = resume_fn_;
+            resume_arg = resume_arg_;
+            resume_fn_ = nullptr;
+            resume_arg_ = nullptr;
         }
         if (call_handler) {
             if (handler2_) handler2_(*this, err);
             else if (handler_) handler_(result, err);
         }
         cv_.notify_all();
+
+        // Resume the waiting coroutine (if any) directly in the
+        // current thread. It should be the last step, as the coroutine
+        // may release this instance once it is resumed.
+        if (resume_fn) resume_fn(resume_arg);
     }
 
     /**
@@ -233,6 +263,10 @@ public:
                  "Cannot find server."},
                 {cmd_result_code::CANNOT_REMOVE_LEADER,
                  "Cannot remove leader."},
+                {cmd_result_code::SERVER_IS_BUSY,
+                 "Too many uncommitted (or unapplied) requests."},
+                {cmd_result_code::SERVER_IS_LAGGING,
+                 "Server has not caught up with the leader yet."},
                 {cmd_result_code::FAILED,
                  "Failed."}
             } );
@@ -267,6 +301,59 @@ public:
         return empty_result_;
     }
 
+#ifdef NURAFT_COROUTINE_SUPPORT
+    /**
+     * Awaiter for `co_await`. It suspends the coroutine until
+     * the result is set, and then resumes it in the thread calling
+     * `set_result()` (i.e., the commit thread, if `async_handler`
+     * mode is used) without allocating any handler.
+     *
+     * The awaiting coroutine should hold a `ptr` to this instance
+     * until it is resumed.
+     */
+    class awaiter {
+    public:
+        explicit awaiter(cmd_result<T, TE>& owner) : owner_(owner) {}
+
+        bool await_ready() const noexcept {
+            std::lock_guard<std::mutex> guard(owner_.lock_);
+            return owner_.has_result_;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) noexcept {
+            std::lock_guard<std::mutex> guard(owner_.lock_);
+            // Result has been set in the meantime, do not suspend.
+            if (owner_.has_result_) return false;
+            owner_.resume_fn_ = &awaiter::resume;
+            owner_.resume_arg_ = handle.address();
+            return true;
+        }
+
+        T& await_resume() noexcept {
+            std::lock_guard<std::mutex> guard(owner_.lock_);
+            if (owner_.err_ == nullptr) return owner_.result_;
+            return owner_.empty_result_;
+        }
+
+    private:
+        static void resume(void* addr) {
+            std::coroutine_handle<>::from_address(addr).resume();
+        }
+
+        cmd_result<T, TE>& owner_;
+    };
+
+    /**
+     * Suspend the current coroutine until the result is set.
+     * The result value is returned, the same as `get()`.
+     *
+     * @return Awaiter.
+     */
+    awaiter operator co_await() noexcept {
+        return awaiter(*this);
+    }
+#endif
+
 private:
     T empty_result_;
     T result_;
@@ -276,6 +363,8 @@ private:
     bool accepted_;
     handler_type handler_;
     handler_type2 handler2_;
+    void (*resume_fn_)(void*);
+    void* resume_arg_;
     mutable std::mutex lock_;
     std::condition_variable cv_;
 };
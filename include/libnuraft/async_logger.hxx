@@ -0,0 +1,176 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include "basic_types.hxx"
+#include "logger.hxx"
+#include "ptr.hxx"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nuraft {
+
+/**
+ * Logger wrapper that moves the actual writing of logs off the caller's
+ * thread. Each `put_details` call only pushes the log into a bounded
+ * lock-free queue, and a background thread passes the queued logs to
+ * the given backend logger in order.
+ *
+ * Once the queue is full, new logs are dropped instead of blocking
+ * the caller, and the number of dropped logs is counted.
+ *
+ * Fatal logs (level <= 1) are not queued. They are written to the
+ * backend on the caller's thread, after all the queued logs.
+ *
+ * The log level is cached in this wrapper, so that `get_level` (called
+ * by the log macros before formatting) does not reach the backend.
+ */
+class async_logger : public logger {
+public:
+    struct options {
+        options()
+            : queue_size_(16384)
+            , flush_interval_ms_(100)
+            {}
+
+        /**
+         * Max number of logs in the queue. Will be rounded up to
+         * a power of 2.
+         */
+        size_t queue_size_;
+
+        /**
+         * Max interval that the background thread sleeps when the
+         * queue is empty.
+         */
+        size_t flush_interval_ms_;
+    };
+
+    async_logger(const ptr<logger>& backend,
+                 const options& opt = options());
+
+    ~async_logger();
+
+    __nocopy__(async_logger);
+
+public:
+    void set_level(int l);
+
+    int get_level() {
+        return level_.load(std::memory_order_relaxed);
+    }
+
+    void put_details(int level,
+                     const char* source_file,
+                     const char* func_name,
+                     size_t line_number,
+                     const std::string& log_line);
+
+    /**
+     * Wait until all logs queued so far are passed to the backend.
+     */
+    void flush();
+
+    /**
+     * Stop the background thread, after passing all queued logs to
+     * the backend. Logs put after this call are written directly
+     * on the caller's thread.
+     */
+    void stop();
+
+    /**
+     * Get the number of logs dropped due to the full queue.
+     */
+    uint64_t get_num_dropped() const {
+        return num_dropped_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Get the backend logger.
+     */
+    ptr<logger> get_backend() const { return backend_; }
+
+private:
+    struct entry {
+        entry()
+            : seq_(0), level_(0)
+            , source_file_(nullptr), func_name_(nullptr), line_number_(0)
+            {}
+        std::atomic<uint64_t> seq_;
+        int level_;
+        const char* source_file_;
+        const char* func_name_;
+        size_t line_number_;
+        std::string log_line_;
+    };
+
+    bool enqueue(int level,
+                 const char* source_file,
+                 const char* func_name,
+                 size_t line_number,
+                 const std::string& log_line);
+
+    size_t dequeue_all();
+
+    void flush_loop();
+
+    ptr<logger> backend_;
+
+    options opt_;
+
+    std::atomic<int> level_;
+
+    std::vector<entry> queue_;
+
+    uint64_t mask_;
+
+    // Next position to be taken by producers.
+    std::atomic<uint64_t> tail_;
+
+    // Next position to be read by the background thread.
+    std::atomic<uint64_t> head_;
+
+    std::atomic<uint64_t> num_dropped_;
+
+    // Number of `put_details` calls that are queueing logs,
+    // checked by `stop` to not leave any log in the queue.
+    std::atomic<uint64_t> num_producers_;
+
+    // `true` if the background thread is (about to be) sleeping,
+    // so that producers need to wake it up.
+    std::atomic<bool> sleeping_;
+
+    std::atomic<bool> stopping_;
+
+    std::mutex lock_;
+
+    std::condition_variable cv_;
+
+    // Notified whenever the background thread advances `head_`.
+    std::condition_variable flushed_cv_;
+
+    std::thread flusher_;
+};
+
+}
+
@@ -29,6 +29,8 @@ limitations under the License.
 
 namespace nuraft {
 
+class buffer_allocator;
+
 class buffer {
     buffer() = delete;
     __nocopy__(buffer);
@@ -42,6 +44,18 @@ public:
      */
     static ptr<buffer> alloc(const size_t size);
 
+    /**
+     * Set the memory allocator to be used by `alloc`
+     * (and `copy`, `clone`) from now on.
+     * Buffers allocated before this call are freed by the allocator
+     * that allocated them, hence allocators given to this function
+     * are kept alive until the process exits.
+     *
+     * @param allocator Allocator (e.g., `buffer_pool`).
+     *                  If `nullptr`, `new` and `delete` will be used.
+     */
+    static void set_allocator(const ptr<buffer_allocator>& allocator);
+
     /**
      * Copy the data in the given buffer starting from the current position.
      * It will allocate a new memory buffer.
@@ -64,6 +78,47 @@ public:
      */
     static ptr<buffer> clone(const buffer& buf);
 
+    /**
+     * Create a buffer referring to a part of the given buffer,
+     * without memory allocation or data copy. The returned buffer
+     * shares the ownership of `src`, so that `src` will be alive
+     * as long as the returned buffer is alive.
+     *
+     * WARNING: The meta section of the returned buffer is written
+     *          in place: `view_meta_size(len)` bytes right before
+     *          `offset` in `src` will be overwritten, so that they
+     *          should not be used anymore.
+     *
+     * @param src Source buffer.
+     * @param offset Offset of the data, from the beginning of `src`.
+     * @param len Length of the data.
+     * @return buffer instance, or `nullptr` if there is no room for
+     *         the meta section or the range is out of bound.
+     */
+    static ptr<buffer> view_in_place(const ptr<buffer>& src,
+                                     size_t offset,
+                                     size_t len);
+
+    /**
+     * Get the size of meta section that `view_in_place` requires.
+     *
+     * @param len Length of the data.
+     * @return Size of meta section.
+     */
+    static size_t view_meta_size(size_t len);
+
+    /**
+     * Make a buffer in the given memory, without memory allocation.
+     * The memory should be at least `view_meta_size(len) + len` bytes,
+     * and the caller is responsible for keeping it alive while the
+     * buffer is in use.
+     *
+     * @param mem Memory to make the buffer in.
+     * @param len Length of the data.
+     * @return Buffer, located at `mem`.
+     */
+    static buffer* make_in_place(void* mem, size_t len);
+
     /**
      * Get total size of entire buffer container, including meta section.
      *
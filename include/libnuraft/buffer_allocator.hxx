@@ -0,0 +1,86 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include "basic_types.hxx"
+#include "pp_util.hxx"
+
+#include <cstddef>
+
+namespace nuraft {
+
+/**
+ * Memory allocator of `buffer`, set by `buffer::set_allocator`.
+ */
+class buffer_allocator {
+    __interface_body__(buffer_allocator);
+
+public:
+    /**
+     * Allocate a memory block.
+     *
+     * @param len Size of the block, including the meta section of buffer.
+     * @return Pointer to the block.
+     */
+    virtual void* allocate(size_t len) = 0;
+
+    /**
+     * Free the memory block allocated by `allocate`.
+     * It can be called by a thread different from the one
+     * that allocated the block.
+     *
+     * @param ptr Pointer to the block.
+     * @param len Size of the block, the same as given to `allocate`.
+     */
+    virtual void deallocate(void* ptr, size_t len) = 0;
+};
+
+/**
+ * Allocator keeping freed blocks in thread-local, size-class (power of 2)
+ * free lists, so that they can be reused without calling `new` again.
+ * Blocks larger than `MAX_BLOCK_SIZE` are not pooled.
+ *
+ * Hit and miss counts are available as stat counters
+ * `buffer_pool_hits` and `buffer_pool_misses`.
+ */
+class buffer_pool : public buffer_allocator {
+public:
+    static const size_t MIN_BLOCK_SIZE = 64;
+    static const size_t MAX_BLOCK_SIZE = 64 * 1024;
+
+    /**
+     * @param max_cached_bytes_per_class Maximum amount of memory (in bytes)
+     *        that each thread keeps for each size class.
+     */
+    buffer_pool(size_t max_cached_bytes_per_class = 1024 * 1024);
+
+    void* allocate(size_t len) __override__;
+
+    void deallocate(void* ptr, size_t len) __override__;
+
+    /**
+     * Free all blocks cached by the current thread.
+     */
+    static void release_thread_cache();
+
+private:
+    size_t max_cached_bytes_;
+};
+
+}
+
@@ -48,6 +48,8 @@ enum raft_err {
     N21_log_flush_failed = -21,
     N22_unrecoverable_isolation = -22,
     N23_precommit_order_inversion = -23,
+    N24_log_append_failed = -24,
+    N25_corrupted_packed_log = -25,
 };
 
 extern const char * raft_err_msg[];
@@ -41,11 +41,36 @@ public:
         : term_(term)
         , value_type_(value_type)
         , buff_(buff)
+        , inline_buf_(nullptr)
+        , has_crc32_(false)
+        , crc32_(0)
         {}
 
     __nocopy__(log_entry);
 
 public:
+    /**
+     * Create a log entry holding a copy of the given data, in a compact
+     * layout: the reference counter, the log entry, and its buffer are
+     * placed in a single memory allocation, instead of three.
+     *
+     * The returned log entry works the same as the others. The buffer
+     * returned by `get_buf_ptr` shares the ownership of the log entry,
+     * so that the whole memory is kept alive until both of them are
+     * released.
+     *
+     * @param term Term of the log.
+     * @param data Data to copy.
+     * @param len Length of the data.
+     * @param value_type Type of the log.
+     * @return Log entry.
+     */
+    static ptr<log_entry> make_compact
+                          ( ulong term,
+                            const byte* data,
+                            size_t len,
+                            log_val_type value_type = log_val_type::app_log );
+
     ulong get_term() const {
         return term_;
     }
@@ -59,13 +84,14 @@ public:
     }
 
     bool is_buf_null() const {
-        return (buff_.get()) ? false : true;
+        return (inline_buf_ || buff_.get()) ? false : true;
     }
 
     buffer& get_buf() const {
         // We accept nil buffer, but in that case,
         // the get_buf() shouldn't be called, throw runtime exception
         // instead of having segment fault (AV on Windows)
+        if (inline_buf_) return *inline_buf_;
         if (!buff_) {
 #ifndef _NO_EXCEPTION
             throw std::runtime_error("get_buf cannot be called for a log_entry "
@@ -79,17 +105,47 @@ public:
     }
 
     ptr<buffer> get_buf_ptr() const {
+        if (inline_buf_) return ptr<buffer>(self_.lock(), inline_buf_);
         return buff_;
     }
 
+    /**
+     * Check if the CRC32C of the payload is attached.
+     * It is set by the leader if `raft_params::log_entry_crc_` is on,
+     * or by the receiver if the RPC message carries it, so that log store
+     * can persist it without calculating again.
+     *
+     * @return `true` if CRC32C is attached.
+     */
+    bool has_crc32() const {
+        return has_crc32_;
+    }
+
+    uint32_t get_crc32() const {
+        return crc32_;
+    }
+
+    /**
+     * Attach the CRC32C of the payload.
+     * It should be set before this log entry is shared
+     * with other threads.
+     *
+     * @param crc32 CRC32C value.
+     */
+    void set_crc32(uint32_t crc32) {
+        crc32_ = crc32;
+        has_crc32_ = true;
+    }
+
     ptr<buffer> serialize() {
-        buff_->pos(0);
+        buffer& data = get_buf();
+        data.pos(0);
         ptr<buffer> buf = buffer::alloc( sizeof(ulong) +
                                          sizeof(char) +
-                                         buff_->size() );
+                                         data.size() );
         buf->put(term_);
         buf->put( (static_cast<byte>(value_type_)) );
-        buf->put(*buff_);
+        buf->put(data);
         buf->pos(0);
         return buf;
     }
@@ -97,8 +153,10 @@ public:
     static ptr<log_entry> deserialize(buffer& buf) {
         ulong term = buf.get_ulong();
         log_val_type t = static_cast<log_val_type>(buf.get_byte());
-        ptr<buffer> data = buffer::copy(buf);
-        return cs_new<log_entry>(term, data, t);
+        size_t len = buf.size() - buf.pos();
+        ptr<log_entry> entry = make_compact(term, buf.data(), len, t);
+        buf.pos(buf.size());
+        return entry;
     }
 
     static ulong term_in_buffer(buffer& buf) {
@@ -111,6 +169,17 @@ private:
     ulong term_;
     log_val_type value_type_;
     ptr<buffer> buff_;
+
+    // Buffer in the same memory allocation, if created by
+    // `make_compact`. `buff_` is not used in that case.
+    buffer* inline_buf_;
+
+    // Pointer to itself, to share the ownership with `inline_buf_`.
+    // Set only if `inline_buf_` is set.
+    std::weak_ptr<log_entry> self_;
+
+    bool has_crc32_;
+    uint32_t crc32_;
 };
 
 }
@@ -61,7 +61,7 @@ public:
      * Append a log entry to store.
      *
      * @param entry Log entry
-     * @return Log index number.
+     * @return Log index number, or 0 if failed.
      */
     virtual ulong append(ptr<log_entry>& entry) = 0;
 
@@ -76,6 +76,54 @@ public:
      */
     virtual void write_at(ulong index, ptr<log_entry>& entry) = 0;
 
+    /**
+     * (Optional)
+     * Append the given log entries at once, so that the log store
+     * can write them by a single I/O and update its index once.
+     * Raft server does not call `append` or `write_at` concurrently
+     * with this function, thus `start_idx` is always `next_slot()`.
+     *
+     * If an entry cannot be written, the rest should not be written
+     * either. The caller finds the failure by `next_slot()`.
+     *
+     * The default implementation calls `append` for each entry.
+     *
+     * @param start_idx Log index number of the first entry.
+     * @param entries Log entries to append, in index order.
+     */
+    virtual void append_batch(ulong start_idx,
+                              std::vector< ptr<log_entry> >& entries)
+    {
+        for (ptr<log_entry>& le: entries) {
+            if (!append(le)) break;
+        }
+    }
+
+    /**
+     * (Optional)
+     * Overwrite log entries starting at the given `start_idx`.
+     * Same as `write_at`, all log entries after `start_idx` should be
+     * truncated first (if exist), and then the given entries are
+     * written in index order. Failure is reported in the same way as
+     * `append_batch`.
+     *
+     * The default implementation calls `write_at` for the first entry,
+     * and then `append` for the rest.
+     *
+     * @param start_idx Log index number to overwrite.
+     * @param entries New log entries to write, in index order.
+     */
+    virtual void write_batch_at(ulong start_idx,
+                                std::vector< ptr<log_entry> >& entries)
+    {
+        if (entries.empty()) return;
+        write_at(start_idx, entries[0]);
+        if (next_slot() != start_idx + 1) return;
+        for (size_t ii = 1; ii < entries.size(); ++ii) {
+            if (!append(entries[ii])) break;
+        }
+    }
+
     /**
      * Invoked after a batch of logs is written as a part of
      * a single append_entries request.
@@ -85,6 +133,20 @@ public:
      */
     virtual void end_of_append_batch(ulong start, ulong cnt) {}
 
+    /**
+     * (Optional)
+     * Get the last log index that is guaranteed to be durable.
+     *
+     * If `raft_params::parallel_log_appending_` is enabled,
+     * `end_of_append_batch` should not block for durability, but
+     * should persist the logs in background, and then call
+     * `raft_server::notify_log_append_completion`. In that case, the
+     * leader uses this index as its own position for the commit quorum.
+     *
+     * @return Last durable log index.
+     */
+    virtual ulong last_durable_index() { return next_slot() - 1; }
+
     /**
      * Get log entries with index [start, end).
      *
@@ -137,6 +199,26 @@ public:
      */
     virtual ulong term_at(ulong index) = 0;
 
+    /**
+     * (Optional)
+     * Get the type of the log entry at the specified index.
+     *
+     * It is called at startup for every log not committed yet, to see
+     * if there is a pending configuration change. The default
+     * implementation reads the whole entry, a log store that can tell
+     * the type from its index (without reading the payload) should
+     * override this, so that restart time does not depend on the size
+     * of the uncommitted logs.
+     *
+     * @param index Should be equal to or greater than 1.
+     * @return The type of the log entry, or `app_log`
+     *         if it does not exist.
+     */
+    virtual log_val_type val_type_at(ulong index) {
+        ptr<log_entry> le = entry_at(index);
+        return le ? le->get_val_type() : log_val_type::app_log;
+    }
+
     /**
      * Pack the given number of log items starting from the given index.
      *
@@ -29,6 +29,9 @@ enum log_val_type {
     cluster_server  = 3,
     log_pack        = 4,
     snp_sync_req    = 5,
+    // Multiple application payloads packed into one log entry,
+    // see `raft_server::append_packed_entries()`.
+    packed_app_log  = 6,
     custom          = 999,
 };
 
@@ -22,8 +22,10 @@ limitations under the License.
 
 #include "asio_service.hxx"
 #include "async.hxx"
+#include "async_logger.hxx"
 #include "basic_types.hxx"
 #include "buffer.hxx"
+#include "buffer_allocator.hxx"
 #include "buffer_serializer.hxx"
 #include "callback.hxx"
 #include "cluster_config.hxx"
@@ -35,17 +37,20 @@ limitations under the License.
 #include "log_store.hxx"
 #include "logger.hxx"
 #include "ptr.hxx"
+#include "raft_group_dispatcher.hxx"
 #include "raft_params.hxx"
 #include "raft_server.hxx"
 #include "rpc_cli_factory.hxx"
 #include "rpc_cli.hxx"
 #include "rpc_listener.hxx"
+#include "rw_lock.hxx"
 #include "snapshot.hxx"
 #include "srv_config.hxx"
 #include "srv_state.hxx"
 #include "state_machine.hxx"
 #include "state_mgr.hxx"
 #include "timer_task.hxx"
+#include "trace_events.hxx"
 
 #include "launcher.hxx"
 
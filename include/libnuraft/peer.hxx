@@ -33,6 +33,7 @@ limitations under the License.
 
 namespace nuraft {
 
+class batch_size_controller;
 class snapshot;
 class peer {
 public:
@@ -66,7 +67,8 @@ public:
         , next_log_idx_(0)
         , next_batch_size_hint_in_bytes_(0)
         , matched_idx_(0)
-        , busy_flag_(false)
+        , busy_cnt_(0)
+        , pipeline_ready_(false)
         , pending_commit_flag_(false)
         , hb_enabled_(false)
         , hb_task_( cs_new< timer_task<int32>,
@@ -82,6 +84,9 @@ public:
         , rpc_errs_(0)
         , last_sent_idx_(0)
         , cnt_not_applied_(0)
+        , append_req_seq_(0)
+        , acked_append_req_seq_(0)
+        , obsolete_append_req_seq_(0)
         , leave_requested_(false)
         , hb_cnt_since_leave_(0)
         , stepping_down_(false)
@@ -131,17 +136,42 @@ public:
         return current_hb_interval_;
     }
 
-    bool make_busy() {
-        bool f = false;
-        return busy_flag_.compare_exchange_strong(f, true);
+    bool make_busy(int32 max_inflight = 1) {
+        if (max_inflight < 1) max_inflight = 1;
+        int32 cur = busy_cnt_.load();
+        do {
+            if (cur >= max_inflight) return false;
+        } while ( !busy_cnt_.compare_exchange_weak(cur, cur + 1) );
+        return true;
     }
 
     bool is_busy() {
-        return busy_flag_;
+        return busy_cnt_ > 0;
     }
 
+    int32 get_num_inflight() const {
+        return busy_cnt_;
+    }
+
+    // Clear all in-flight requests.
     void set_free() {
-        busy_flag_.store(false);
+        busy_cnt_.store(0);
+    }
+
+    // One in-flight request is done.
+    void release_busy() {
+        int32 cur = busy_cnt_.load();
+        do {
+            if (cur <= 0) return;
+        } while ( !busy_cnt_.compare_exchange_weak(cur, cur - 1) );
+    }
+
+    bool is_pipeline_ready() const {
+        return pipeline_ready_;
+    }
+
+    void set_pipeline_ready(bool ready) {
+        pipeline_ready_ = ready;
     }
 
     bool is_hb_enabled() const {
@@ -173,6 +203,14 @@ public:
         next_batch_size_hint_in_bytes_ = batch_size;
     }
 
+    ptr<batch_size_controller> get_batch_size_controller() const {
+        return batch_ctl_;
+    }
+
+    void set_batch_size_controller(const ptr<batch_size_controller>& ctl) {
+        batch_ctl_ = ctl;
+    }
+
     ulong get_matched_idx() const {
         return matched_idx_;
     }
@@ -261,6 +299,15 @@ public:
                                           return cnt_not_applied_; }
     int32 get_cnt_not_applied() const   { return cnt_not_applied_; }
 
+    uint64_t get_append_req_seq() const { return append_req_seq_; }
+    uint64_t get_acked_append_req_seq() const
+    { return acked_append_req_seq_; }
+
+    // Responses to the append entries requests sent so far
+    // will be marked as obsolete.
+    void discard_inflight_appends()
+    { obsolete_append_req_seq_ = append_req_seq_.load(); }
+
     void step_down()                { stepping_down_ = true; }
     bool is_stepping_down() const   { return stepping_down_.load(); }
 
@@ -296,6 +343,8 @@ private:
     void handle_rpc_result(ptr<peer> myself,
                            ptr<rpc_client> my_rpc_client,
                            ptr<req_msg>& req,
+                           uint64_t req_seq,
+                           uint64_t sent_us,
                            ptr<rpc_result>& pending_result,
                            ptr<resp_msg>& resp,
                            ptr<rpc_exception>& err);
@@ -330,12 +379,22 @@ private:
     // Hint of the next log batch size in bytes.
     std::atomic<ulong> next_batch_size_hint_in_bytes_;
 
+    // Adaptive batch size limit of append entries requests,
+    // created on demand. Protected by `lock_`.
+    ptr<batch_size_controller> batch_ctl_;
+
     // The last log index whose term matches up with the leader.
     ulong matched_idx_;
 
-    // `true` if we sent message to this server and waiting for
-    // the response.
-    std::atomic<bool> busy_flag_;
+    // Number of requests that we sent to this server and are
+    // waiting for the responses. It can be greater than 1 only
+    // when append_entries pipelining is enabled.
+    std::atomic<int32> busy_cnt_;
+
+    // `true` if the last append_entries response from this server
+    // was accepted, so that its log is known to be matched with the
+    // leader's. Pipelining is allowed only in this state.
+    std::atomic<bool> pipeline_ready_;
 
     // `true` if we need to send follow-up request immediately
     // for commiting logs.
@@ -382,6 +441,17 @@ private:
     // Number of count where start log index is the same as previous.
     std::atomic<int32> cnt_not_applied_;
 
+    // Sequence number of the last append entries request sent.
+    std::atomic<uint64_t> append_req_seq_;
+
+    // The largest sequence number of append entries request
+    // that this peer has responded to.
+    std::atomic<uint64_t> acked_append_req_seq_;
+
+    // Responses to the append entries requests whose sequence number
+    // is equal to or smaller than this value are obsolete.
+    std::atomic<uint64_t> obsolete_append_req_seq_;
+
     // True if leave request has been sent to this peer.
     std::atomic<bool> leave_requested_;
 
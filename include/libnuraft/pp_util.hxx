@@ -38,6 +38,7 @@ limitations under the License.
 
 #define auto_lock(lock)     std::lock_guard<std::mutex> guard(lock)
 #define recur_lock(lock)    std::unique_lock<std::recursive_mutex> guard(lock)
+#define read_lock(lock)     read_lock_guard guard(lock)
 
 #define sz_int      sizeof(int32)
 #define sz_ulong    sizeof(ulong)
@@ -0,0 +1,98 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include "basic_types.hxx"
+#include "pp_util.hxx"
+#include "ptr.hxx"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace nuraft {
+
+class raft_server;
+
+/**
+ * Registry of Raft groups sharing the same listener (Multi-Raft).
+ * Each incoming request carries the ID of its group, and it is
+ * routed to the Raft server registered with that ID.
+ */
+class raft_group_dispatcher {
+public:
+    raft_group_dispatcher() {}
+
+    __nocopy__(raft_group_dispatcher);
+
+public:
+    /**
+     * Register a Raft server as the given group.
+     * Group ID should be a non-negative number.
+     *
+     * @param group_id Group ID.
+     * @param server Raft server instance.
+     * @return `true` on success,
+     *         `false` if the group ID is already in use.
+     */
+    bool register_group(int32 group_id, ptr<raft_server>& server) {
+        std::lock_guard<std::mutex> l(lock_);
+        return groups_.insert( std::make_pair(group_id, server) ).second;
+    }
+
+    /**
+     * Deregister the given group. Requests to the group after
+     * this call will be rejected.
+     *
+     * @param group_id Group ID.
+     * @return `true` if the group existed.
+     */
+    bool deregister_group(int32 group_id) {
+        std::lock_guard<std::mutex> l(lock_);
+        return groups_.erase(group_id) > 0;
+    }
+
+    /**
+     * Get the Raft server of the given group.
+     *
+     * @param group_id Group ID.
+     * @return Raft server instance,
+     *         `nullptr` if the group does not exist.
+     */
+    ptr<raft_server> get_server(int32 group_id) {
+        std::lock_guard<std::mutex> l(lock_);
+        auto entry = groups_.find(group_id);
+        if (entry == groups_.end()) return nullptr;
+        return entry->second;
+    }
+
+    /**
+     * Get the number of registered groups.
+     *
+     * @return Number of groups.
+     */
+    size_t get_num_groups() {
+        std::lock_guard<std::mutex> l(lock_);
+        return groups_.size();
+    }
+
+private:
+    std::mutex lock_;
+    std::unordered_map< int32, ptr<raft_server> > groups_;
+};
+
+}
@@ -49,9 +49,11 @@ struct raft_params {
         // use separate mutexes.
         dual_mutex = 0x1,
 
-        // (Not supported yet)
         // `append_entries()` will use RW-lock, which is separate to
         // the mutex used by background worker threads.
+        // Only appending logs is serialized, and the rest of
+        // the request handling (result tracking, callbacks) is done
+        // concurrently under the shared lock.
         dual_rw_lock = 0x2,
     };
 
@@ -62,9 +64,13 @@ struct raft_params {
         , rpc_failure_backoff_(50)
         , log_sync_batch_size_(1000)
         , log_sync_stop_gap_(99999)
+        , log_sync_snapshot_threshold_(0)
         , snapshot_distance_(0)
         , snapshot_block_size_(0)
+        , snapshot_prefetch_blocks_(0)
+        , snapshot_sync_streams_(1)
         , max_append_size_(100)
+        , append_pipeline_window_(1)
         , reserved_log_items_(100000)
         , client_req_timeout_(3000)
         , fresh_log_gap_(200)
@@ -72,9 +78,27 @@ struct raft_params {
         , custom_commit_quorum_size_(0)
         , custom_election_quorum_size_(0)
         , leadership_expiry_(0)
+        , lease_read_(false)
         , allow_temporary_zero_priority_leader_(true)
         , auto_forwarding_(false)
+        , auto_forwarding_batch_size_(0)
+        , auto_forwarding_max_connections_(1)
         , use_bg_thread_for_urgent_commit_(true)
+        , group_commit_max_bytes_(0)
+        , group_commit_max_delay_us_(0)
+        , max_commit_batch_size_(0)
+        , commit_prefetch_(false)
+        , commit_prefetch_batches_(2)
+        , commit_ret_ring_size_(0)
+        , log_entry_crc_(false)
+        , parallel_log_appending_(false)
+        , use_bg_thread_for_follower_flush_(false)
+        , max_uncommitted_entries_(0)
+        , max_uncommitted_bytes_(0)
+        , max_apply_lag_(0)
+        , adaptive_batch_target_latency_us_(0)
+        , use_bg_thread_for_log_compaction_(false)
+        , parallel_append_senders_(0)
         , locking_method_type_(dual_mutex)
         , return_method_(blocking)
         {}
@@ -134,6 +158,19 @@ struct raft_params {
         return *this;
     }
 
+    /**
+     * The maximum number of append_entries requests that can be
+     * sent to each follower without waiting for the responses.
+     * If 1 (default), pipelining is disabled.
+     *
+     * @param window
+     * @return self
+     */
+    raft_params& with_append_pipeline_window(int32 window) {
+        append_pipeline_window_ = window;
+        return *this;
+    }
+
     /**
      * For new member that just joined the cluster, we will use
      * log sync to ask it to catch up, and this parameter is to
@@ -163,6 +200,22 @@ struct raft_params {
         return *this;
     }
 
+    /**
+     * For new member that just joined the cluster, if the number of
+     * logs that can be covered by the latest snapshot is greater than
+     * this value, the snapshot is installed first and then only the
+     * logs after the snapshot are synced.
+     * If 0 (default), snapshot is used only when the logs that the new
+     * member needs have been already compacted.
+     *
+     * @param threshold
+     * @return self
+     */
+    raft_params& with_log_sync_snapshot_threshold(int32 threshold) {
+        log_sync_snapshot_threshold_ = threshold;
+        return *this;
+    }
+
     /**
      * Enable log compact and snapshot with the commit distance
      *
@@ -186,6 +239,30 @@ struct raft_params {
         return *this;
     }
 
+    /**
+     * Number of snapshot blocks (or objects) to be read ahead by a
+     * background thread while sending a snapshot to a peer.
+     *
+     * @param num_blocks Number of blocks, 0 to disable.
+     * @return self
+     */
+    raft_params& with_snapshot_prefetch_blocks(int32 num_blocks) {
+        snapshot_prefetch_blocks_ = num_blocks;
+        return *this;
+    }
+
+    /**
+     * Number of object streams of logical snapshot,
+     * sent to a follower in parallel.
+     *
+     * @param num_streams Number of streams.
+     * @return self
+     */
+    raft_params& with_snapshot_sync_streams(int32 num_streams) {
+        snapshot_sync_streams_ = num_streams;
+        return *this;
+    }
+
     /**
      * The number of reserved log items when doing log compaction.
      *
@@ -220,6 +297,211 @@ struct raft_params {
         return *this;
     }
 
+    /**
+     * Queue client requests forwarded to the leader, and send up to
+     * the given number of queued requests in one RPC.
+     *
+     * @param batch_size Max number of requests in an RPC. 0 to disable.
+     * @return self
+     */
+    raft_params& with_auto_forwarding_batch_size(int32 batch_size) {
+        auto_forwarding_batch_size_ = batch_size;
+        return *this;
+    }
+
+    /**
+     * Number of connections to the leader used for forwarding
+     * queued client requests.
+     *
+     * @param num_connections Number of connections.
+     * @return self
+     */
+    raft_params& with_auto_forwarding_max_connections(int32 num_connections) {
+        auto_forwarding_max_connections_ = num_connections;
+        return *this;
+    }
+
+    /**
+     * Enable group commit, so that concurrent client requests are
+     * coalesced into one log store batch and one replication round.
+     *
+     * @param max_bytes Soft limit of the total size of log entries
+     *                  in a group. 0 to disable group commit.
+     * @return self
+     */
+    raft_params& with_group_commit_max_bytes(int32 max_bytes) {
+        group_commit_max_bytes_ = max_bytes;
+        return *this;
+    }
+
+    /**
+     * Maximum time to wait for more client requests to join
+     * the current group, in microseconds.
+     *
+     * @param delay_us Delay in microseconds.
+     * @return self
+     */
+    raft_params& with_group_commit_max_delay_us(int32 delay_us) {
+        group_commit_max_delay_us_ = delay_us;
+        return *this;
+    }
+
+    /**
+     * Maximum number of logs to be applied to the state machine
+     * by a single `state_machine::commit_batch` call.
+     *
+     * @param batch_size Max number of logs. 0 or 1 to disable.
+     * @return self
+     */
+    raft_params& with_max_commit_batch_size(int32 batch_size) {
+        max_commit_batch_size_ = batch_size;
+        return *this;
+    }
+
+    /**
+     * Read the logs to commit in batches by a background thread,
+     * using `log_store::log_entries`, ahead of applying them.
+     *
+     * @param enable `true` to enable.
+     * @return self
+     */
+    raft_params& with_commit_prefetch(bool enable) {
+        commit_prefetch_ = enable;
+        return *this;
+    }
+
+    /**
+     * Number of commit batches to be read ahead,
+     * if `commit_prefetch_` is set.
+     *
+     * @param num_batches Number of batches.
+     * @return self
+     */
+    raft_params& with_commit_prefetch_batches(int32 num_batches) {
+        commit_prefetch_batches_ = num_batches;
+        return *this;
+    }
+
+    /**
+     * Number of pre-allocated slots for tracking the results of
+     * client requests in `async_handler` mode.
+     *
+     * @param num_slots Number of slots. 0 to disable.
+     * @return self
+     */
+    raft_params& with_commit_ret_ring_size(int32 num_slots) {
+        commit_ret_ring_size_ = num_slots;
+        return *this;
+    }
+
+    /**
+     * Calculate CRC32C of each new log entry on the leader.
+     *
+     * @param enable `true` to enable.
+     * @return self
+     */
+    raft_params& with_log_entry_crc(bool enable) {
+        log_entry_crc_ = enable;
+        return *this;
+    }
+
+    /**
+     * Replicate logs to followers while the leader's own log store is
+     * still persisting them.
+     *
+     * @param enable `true` to enable.
+     * @return self
+     */
+    raft_params& with_parallel_log_appending(bool enable) {
+        parallel_log_appending_ = enable;
+        return *this;
+    }
+
+    /**
+     * Make logs received by a follower durable in a background thread,
+     * and defer the response until then.
+     *
+     * @param enable `true` to enable.
+     * @return self
+     */
+    raft_params& with_bg_thread_for_follower_flush(bool enable) {
+        use_bg_thread_for_follower_flush_ = enable;
+        return *this;
+    }
+
+    /**
+     * Maximum number of logs appended but not committed yet.
+     * Client requests beyond it will be rejected with
+     * `cmd_result_code::SERVER_IS_BUSY`.
+     *
+     * @param max_entries Number of logs. 0 for no limit.
+     * @return self
+     */
+    raft_params& with_max_uncommitted_entries(int32 max_entries) {
+        max_uncommitted_entries_ = max_entries;
+        return *this;
+    }
+
+    /**
+     * Maximum total payload size of logs appended by clients
+     * but not committed yet.
+     *
+     * @param max_bytes Size in bytes. 0 for no limit.
+     * @return self
+     */
+    raft_params& with_max_uncommitted_bytes(int64_t max_bytes) {
+        max_uncommitted_bytes_ = max_bytes;
+        return *this;
+    }
+
+    /**
+     * Maximum number of logs committed but not applied to
+     * the state machine yet.
+     *
+     * @param max_lag Number of logs. 0 for no limit.
+     * @return self
+     */
+    raft_params& with_max_apply_lag(int32 max_lag) {
+        max_apply_lag_ = max_lag;
+        return *this;
+    }
+
+    /**
+     * Adjust the size of append entries requests to each peer,
+     * so that they are acknowledged within the given latency.
+     *
+     * @param latency_us Target latency in microseconds. 0 to disable.
+     * @return self
+     */
+    raft_params& with_adaptive_batch_target_latency_us(int32 latency_us) {
+        adaptive_batch_target_latency_us_ = latency_us;
+        return *this;
+    }
+
+    /**
+     * Compact the log store in a background thread after creating
+     * a snapshot, instead of doing it while holding the lock.
+     *
+     * @param enable `true` to enable.
+     * @return self
+     */
+    raft_params& with_bg_thread_for_log_compaction(bool enable) {
+        use_bg_thread_for_log_compaction_ = enable;
+        return *this;
+    }
+
+    /**
+     * Create and send append entries requests to peers in the given
+     * number of threads, mostly without holding the lock.
+     *
+     * @param num_threads Number of threads. 0 to disable.
+     * @return self
+     */
+    raft_params& with_parallel_append_senders(int32 num_threads) {
+        parallel_append_senders_ = num_threads;
+        return *this;
+    }
+
     /**
      * If this node is considered as stale and the gap between this node's committed
      * log index and the leader's committed log index is smaller than this threshold,
@@ -297,6 +579,17 @@ struct raft_params {
         return *this;
     }
 
+    /**
+     * Enable or disable lease-based linearizable read.
+     *
+     * @param enable `true` to enable.
+     * @return self
+     */
+    raft_params& with_lease_read(bool enable) {
+        lease_read_ = enable;
+        return *this;
+    }
+
     /**
      * Return heartbeat interval.
      * If given heartbeat interval is smaller than a specific value
@@ -333,16 +626,49 @@ public:
     // and starts to receive heartbeat from leader.
     int32 log_sync_stop_gap_;
 
+    // If non-zero, catch-up of joining a new node installs the
+    // latest snapshot first, when it covers more than this number
+    // of logs that the new node does not have.
+    int32 log_sync_snapshot_threshold_;
+
     // Log gap (the number of logs) to create a Raft snapshot.
     int32 snapshot_distance_;
 
     // (Deprecated).
     int32 snapshot_block_size_;
 
+    // If non-zero, a background thread reads up to this number of
+    // snapshot blocks (or logical objects) ahead while sending a
+    // snapshot to a peer, so that reading the snapshot is overlapped
+    // with network transfer, and is done outside the Raft lock.
+    // For raw binary snapshot, the same number of blocks can be
+    // in flight at the same time (the last block is sent only after
+    // all the others are acknowledged).
+    // If 0, each block is read synchronously when it is sent.
+    int32 snapshot_prefetch_blocks_;
+
+    // Number of object streams of logical snapshot, sent to a
+    // follower in parallel (refer to
+    // `state_machine::read_logical_snp_obj_stream`). One request
+    // of each stream can be in flight at the same time.
+    // If greater than 1, prefetching is not used, and all nodes
+    // in the cluster should support it. Not used for a new server
+    // joining the cluster.
+    // If 0 or 1, the snapshot is sent in a single stream.
+    int32 snapshot_sync_streams_;
+
     // Max number of logs that can be packed in a RPC
     // for append entry request.
     int32 max_append_size_;
 
+    // Max number of append_entries requests that can be in flight
+    // to each follower at the same time. If this value is greater
+    // than 1, the leader optimistically advances the follower's next
+    // log index whenever it sends a batch, and sends the next batch
+    // without waiting for the response of the previous one.
+    // If 0 or 1, pipelining is disabled.
+    int32 append_pipeline_window_;
+
     // Minimum number of logs that will be preserved
     // (i.e., protected from log compaction) since the
     // last Raft snapshot.
@@ -376,6 +702,13 @@ public:
     // (the same as the original Raft logic).
     int32 leadership_expiry_;
 
+    // If true, `raft_server::read_index()` will skip the leadership
+    // confirmation round if quorum of members have responded within
+    // the lease period, which is the minimum of election timeout
+    // lower bound and `leadership_expiry_`, minus heartbeat interval.
+    // It assumes that clock drift between members is bounded.
+    bool lease_read_;
+
     // If true, zero-priority member can initiate vote
     // when leader is not elected long time (that can happen
     // only the zero-priority member has the latest log).
@@ -389,12 +722,143 @@ public:
     // Otherwise, it will return error to client immediately.
     bool auto_forwarding_;
 
+    // If non-zero, client requests forwarded by `auto_forwarding_` are
+    // put into a queue per leader, instead of being sent right away.
+    // Each connection to the leader carries one RPC at a time, and
+    // requests queued while all connections are busy are coalesced
+    // into one RPC, up to this number of requests. The result of each
+    // request is delivered to its own `cmd_result`. The leader should
+    // understand `msg_type::client_request_batch`.
+    int32 auto_forwarding_batch_size_;
+
+    // Number of connections to the leader used by the forwarding
+    // queue above. It bounds the number of forwarding RPCs in flight.
+    int32 auto_forwarding_max_connections_;
+
     // If true, creating replication (append_entries) requests will be
     // done by a backgroudn thread, instead of doing it in user threads.
     // There can be some delay a little bit, but it improves reducing
     // the lock contention.
     bool use_bg_thread_for_urgent_commit_;
 
+    // If non-zero, client requests are submitted to a queue, and
+    // one of the user threads appends all queued requests at once,
+    // doing a single `log_store::end_of_append_batch` call and a
+    // single replication round. The thread stops gathering requests
+    // once their total size reaches this value (in bytes) or
+    // `group_commit_max_delay_us_` passes.
+    //
+    // This is a soft limit: the size is checked after taking all the
+    // requests queued at the moment, so a group can exceed it by the
+    // requests submitted at the same time.
+    int32 group_commit_max_bytes_;
+
+    // Maximum time to wait for gathering requests for group commit,
+    // in microseconds. If 0, only the requests queued so far are
+    // appended together.
+    int32 group_commit_max_delay_us_;
+
+    // Maximum number of logs to be applied to the state machine by
+    // a single `commit_batch` call. A batch is split by non-application
+    // logs such as config. If 0 or 1, logs are committed one by one
+    // using `commit_ext`.
+    int32 max_commit_batch_size_;
+
+    // If `true`, logs to be committed in a batch are read from
+    // the log store by one `log_entries` call, instead of calling
+    // `entry_at` for each log. The call is made by a background
+    // thread, which reads committed logs ahead while the current
+    // batch is being applied to the state machine.
+    // Effective only if `max_commit_batch_size_` is greater than 1.
+    bool commit_prefetch_;
+
+    // Number of commit batches that the background thread keeps
+    // read ahead (or being read), if `commit_prefetch_` is set.
+    int32 commit_prefetch_batches_;
+
+    // If non-zero, results of client requests in `async_handler` mode
+    // are tracked by a lock-free ring of pre-allocated slots, addressed
+    // by log index, instead of the map guarded by a mutex. It will be
+    // rounded up to a power of 2, and should be bigger than the number
+    // of uncommitted logs at a time; otherwise, the map will be used
+    // for the logs that do not fit. It cannot be changed at runtime.
+    int32 commit_ret_ring_size_;
+
+    // If `true`, the leader calculates the CRC32C of the payload of each
+    // log entry appended by clients, and attaches it to the log entry
+    // (`log_entry::get_crc32()`) before appending it to the log store.
+    // It will be sent to followers as it is, if the transport supports it.
+    bool log_entry_crc_;
+
+    // If `true`, the leader does not wait for `end_of_append_batch` of
+    // its log store to make logs durable, and sends them to followers
+    // right away. The log store should persist them in background,
+    // and call `raft_server::notify_log_append_completion` once done.
+    // The leader counts itself toward the commit quorum only up to
+    // `log_store::last_durable_index`, and a follower defers its
+    // append response until the accepted logs are durable.
+    bool parallel_log_appending_;
+
+    // If `true`, a follower does not call `end_of_append_batch` of its
+    // log store inline while handling append entries requests. Instead,
+    // a dedicated thread calls it for all logs appended since its last
+    // call (i.e., a group flush across requests), and the response is
+    // deferred by `resp_msg::set_defer_cb` until the logs become durable.
+    // The log store should allow `end_of_append_batch` to be called
+    // concurrently with `append` and `write_at`.
+    bool use_bg_thread_for_follower_flush_;
+
+    // Admission control of client requests on the leader. If any of
+    // the limits below is reached, new client requests are rejected
+    // right away with `cmd_result_code::SERVER_IS_BUSY`, instead of
+    // piling up until they time out. Requests admitted at once
+    // (e.g., a group commit) may exceed the limits by their own size.
+    // 0 means no limit.
+
+    // Maximum number of logs appended but not committed yet.
+    int32 max_uncommitted_entries_;
+
+    // Maximum total size of the payload of client logs
+    // appended but not committed yet, in bytes.
+    int64_t max_uncommitted_bytes_;
+
+    // Maximum number of logs committed but not applied to
+    // the state machine yet.
+    int32 max_apply_lag_;
+
+    // If non-zero, the leader limits the total payload size of each
+    // append entries request to a peer, based on the time between
+    // sending a request and receiving its response: the limit shrinks
+    // if it takes longer than this value (in microseconds), and grows
+    // while it is faster and the throughput improves. The number of
+    // logs is still bounded by `max_append_size_`, and the hint from
+    // the follower's state machine is respected if it is smaller.
+    // It also works with `append_pipeline_window_`, where the latency
+    // of each request includes the waiting time behind earlier ones.
+    int32 adaptive_batch_target_latency_us_;
+
+    // If `true`, `log_store::compact` after creating a snapshot is
+    // called by a dedicated thread without holding the lock, so that
+    // removing a large number of logs does not block vote requests,
+    // heartbeats, and client requests. Until it is done, the leader
+    // regards the logs being compacted as already gone, and sends the
+    // snapshot instead to a peer that needs them. The log store should
+    // allow `compact` to be called concurrently with other operations.
+    bool use_bg_thread_for_log_compaction_;
+
+    // If non-zero, append entries requests to peers are created and
+    // sent by this number of dedicated threads, instead of the thread
+    // triggering the replication (e.g., the background append thread
+    // or a response handler) while holding the lock. Each peer is
+    // always served by the same thread, and reading logs from the log
+    // store and serializing requests are done without the lock, so
+    // that replication to multiple peers proceeds in parallel. The
+    // log store should allow concurrent reads. `RequestAppendEntries`
+    // callback is still invoked while holding the lock, but on the
+    // sender thread. Threads are created on the first use, thus
+    // changing this value later takes effect only after restart.
+    int32 parallel_append_senders_;
+
     // Choose the type of lock that will be used by user threads.
     locking_method_type locking_method_type_;
 
@@ -27,13 +27,20 @@ limitations under the License.
 #include "log_store.hxx"
 #include "snapshot_sync_req.hxx"
 #include "rpc_cli.hxx"
+#include "rw_lock.hxx"
 #include "srv_config.hxx"
 #include "srv_role.hxx"
 #include "srv_state.hxx"
 #include "timer_task.hxx"
 
+#include <condition_variable>
+#include <deque>
+#include <list>
 #include <map>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 #include <unordered_map>
 
 class EventAwaiter;
@@ -45,15 +52,19 @@ using CbReturnCode = cb_func::ReturnCode;
 class cluster_config;
 class custom_notification_msg;
 class delayed_task_scheduler;
+class log_prefetcher;
 class logger;
 class peer;
+class repl_latency_tracker;
 class rpc_client;
 class req_msg;
 class resp_msg;
+class term_index;
 class rpc_exception;
 class state_machine;
 class state_mgr;
 struct context;
+struct snapshot_sync_ctx;
 struct raft_params;
 class raft_server {
 public:
@@ -135,6 +146,20 @@ public:
     ptr< cmd_result< ptr<buffer> > >
         remove_srv(const int srv_id);
 
+    /**
+     * Make the given learner a voting member of the current cluster.
+     * Only leader will accept this operation, and only if the learner
+     * is behind the leader by less than `raft_params::fresh_log_gap_`.
+     * The same as `add_srv`, this is also an asynchronous task:
+     * the learner becomes a voting member once the new configuration
+     * is committed.
+     *
+     * @param srv_id ID of learner to promote.
+     * @return `get_accepted()` will be true on success.
+     */
+    ptr< cmd_result< ptr<buffer> > >
+        promote_learner(const int srv_id);
+
     /**
      * Append and replicate the given logs.
      * Only leader will accept this operation.
@@ -150,6 +175,93 @@ public:
     ptr< cmd_result< ptr<buffer> > >
         append_entries(const std::vector< ptr<buffer> >& logs);
 
+    /**
+     * Append and replicate the given payloads, packed into a single
+     * log entry of type `log_val_type::packed_app_log`, so that small
+     * payloads do not pay the per-log overhead of the log store,
+     * the replication and the commit. The state machine receives them
+     * all at once by `state_machine::commit_packed`.
+     * Only leader will accept this operation.
+     *
+     * @param logs Set of payloads to replicate.
+     * @return `cmd_result` instance of each payload, in the same order.
+     *     Result value of each instance is the commit result of
+     *     the corresponding payload, as returned by the state machine
+     *     (`nullptr` and an empty buffer are distinguished).
+     *     Blocking and async modes work the same as `append_entries`.
+     */
+    std::vector< ptr< cmd_result< ptr<buffer> > > >
+        append_packed_entries(const std::vector< ptr<buffer> >& logs);
+
+    /**
+     * Notify that the log store has made more logs durable, if
+     * `raft_params::parallel_log_appending_` is enabled.
+     * On a follower, it also sends the append responses that
+     * have been waiting for those logs to be durable.
+     * It should not be called while holding a lock that is also
+     * acquired by the log store APIs.
+     *
+     * @param ok `false` if the log store failed to persist logs.
+     */
+    void notify_log_append_completion(bool ok);
+
+    /**
+     * Request a linearizable read (ReadIndex).
+     * Only leader will accept this operation.
+     *
+     * Leader records its current commit index, confirms its
+     * leadership by a round of append entries (heartbeat) which is
+     * shared by concurrent read requests, and then waits until the
+     * state machine applies the recorded index. Once the returned
+     * `cmd_result` has the result, the state machine of this server
+     * can be read locally with linearizability.
+     *
+     * If `raft_params::lease_read_` is set and the leader lease
+     * is valid, the confirmation round will be skipped.
+     *
+     * This function returns immediately, regardless of
+     * `raft_params::return_method_`.
+     *
+     * @return `cmd_result` whose value is the read index.
+     *         `get_accepted()` will be false if this server is not a leader.
+     */
+    ptr< cmd_result<uint64_t> > read_index();
+
+    /**
+     * Request a read with bounded staleness, which can be served by
+     * any member (including followers and learners) locally.
+     *
+     * Returned `cmd_result` will have the result once the state
+     * machine of this server satisfies both conditions below. After
+     * that, the state machine can be read locally.
+     *   1) It applied at least `min_log_idx`.
+     *   2) It applied the leader's commit index that this server
+     *      received no earlier than `max_staleness_ms` ago. If there
+     *      is no such one, it waits for the next append entries
+     *      request (or heartbeat) from the leader.
+     *
+     * The staleness is measured by the local clock of this server
+     * when the leader's commit index arrives, so that it does not
+     * include the network delay from the leader.
+     *
+     * On the leader, its own commit index is used only if the read
+     * lease is valid, or a quorum of members responded within
+     * `max_staleness_ms`. Otherwise, the leadership is confirmed
+     * first, in the same way as `read_index`.
+     *
+     * This function returns immediately, regardless of
+     * `raft_params::return_method_`.
+     *
+     * @param min_log_idx Minimum log index to be applied.
+     *                    0 to ignore the condition.
+     * @param max_staleness_ms Maximum staleness in milliseconds.
+     *                         Negative value to ignore the condition.
+     * @return `cmd_result` whose value is the log index that the
+     *         state machine has applied (at least).
+     */
+    ptr< cmd_result<uint64_t> > bounded_stale_read(ulong min_log_idx,
+                                                   int32 max_staleness_ms);
+
     /**
      * Update the priority of given server.
      * Only leader will accept this operation.
@@ -184,13 +296,19 @@ public:
      * this server becomes next leader again.
      *
      * Otherwise, this server will pause write first, wait until
-     * highest priority server (except for this server) finishes
-     * the catch-up of the latest log, and then resign.
+     * the successor finishes the catch-up of the latest log, and then
+     * resign. The successor will start a new election right away,
+     * without pre-vote and election timer, ignoring priorities.
      * In such case, next leader will be much more predictable.
      *
      * @param immediate_yield If `true`, yield immediately.
+     * @param successor_id ID of the server to be the next leader.
+     *                     If -1 or not a valid voting member, the
+     *                     highest priority server (except for this
+     *                     server) will be chosen.
      */
-    void yield_leadership(bool immediate_yield = false);
+    void yield_leadership(bool immediate_yield = false,
+                          int32 successor_id = -1);
 
     /**
      * Start the election timer on this server, if this server is a follower.
@@ -262,6 +380,23 @@ public:
     ulong get_committed_log_idx() const
     { return sm_commit_index_.load(); }
 
+    /**
+     * Get the number of client requests, or their commit results,
+     * waiting for the other side in the map (i.e., not in the
+     * commit result ring).
+     *
+     * @return Number of pending elements.
+     */
+    size_t get_num_pending_commit_rets();
+
+    /**
+     * Get the number of queues of client requests being forwarded
+     * to the leader, used if `auto_forwarding_batch_size_` is set.
+     *
+     * @return Number of queues.
+     */
+    size_t get_num_forward_queues();
+
     /**
      * Get the target log index number we are required to commit.
      *
@@ -435,6 +570,37 @@ public:
      */
     static void reset_all_stats();
 
+    /**
+     * Get all existing stats in Prometheus text exposition format,
+     * so that they can be scraped by a metrics endpoint.
+     *
+     * @param prefix Prefix of each metric name.
+     * @return Text of all stats.
+     */
+    static std::string get_all_stats_prometheus
+                       (const std::string& prefix = "nuraft_");
+
+    /**
+     * Pack the given payloads into a buffer, which is the format
+     * of a `log_val_type::packed_app_log` log entry.
+     * `nullptr` payload is unpacked as `nullptr`, not an empty buffer.
+     *
+     * @param payloads Payloads to pack.
+     * @return Packed buffer.
+     */
+    static ptr<buffer> pack_app_logs(const std::vector< ptr<buffer> >& payloads);
+
+    /**
+     * Unpack the payloads of a `log_val_type::packed_app_log` log entry.
+     *
+     * @param buf Packed buffer.
+     * @param[out] payloads_out Payloads, in the packed order.
+     * @return `true` on success, `false` if the buffer is corrupted
+     *         or its format version is unknown.
+     */
+    static bool unpack_app_logs(buffer& buf,
+                                std::vector< ptr<buffer> >& payloads_out);
+
     /**
      * Apply a log entry containing configuration change, while Raft
      * server is not running.
@@ -457,6 +623,27 @@ protected:
 
     struct commit_ret_elem;
 
+    struct commit_ret_slot;
+
+    struct group_commit_elem;
+
+    struct forward_elem;
+
+    struct forward_queue;
+
+    struct append_sender;
+
+    struct read_index_elem {
+        explicit read_index_elem(ulong read_idx)
+            : read_idx_(read_idx)
+            , result_( cs_new< cmd_result<uint64_t> >() )
+            {}
+        // Commit index when the read request arrived.
+        ulong read_idx_;
+        // Result to be set once state machine applies `read_idx_`.
+        ptr< cmd_result<uint64_t> > result_;
+    };
+
     struct pre_vote_status_t {
         pre_vote_status_t()
             : quorum_reject_count_(0)
@@ -485,6 +672,7 @@ protected:
     int32 get_num_voting_members();
     int32 get_quorum_for_election();
     int32 get_quorum_for_commit();
+    int32 get_quorum_for_read();
     int32 get_leadership_expiry();
     size_t get_not_responding_peers();
 
@@ -492,7 +680,19 @@ protected:
     ptr<resp_msg> handle_prevote_req(req_msg& req);
     ptr<resp_msg> handle_vote_req(req_msg& req);
     ptr<resp_msg> handle_cli_req_prelock(req_msg& req);
-    ptr<resp_msg> handle_cli_req(req_msg& req);
+    ptr<resp_msg> handle_cli_req(req_msg& req, uint64_t enqueue_us = 0);
+    bool check_flow_control();
+    void add_inflight_bytes(ulong last_idx, uint64_t bytes);
+    void release_inflight_bytes(ulong committed_idx);
+    void handle_cli_req_batch(std::vector<req_msg*>& reqs,
+                              std::vector< ptr<resp_msg> >& resps_out,
+                              const std::vector<uint64_t>& enqueue_us);
+    void append_cli_req_batch(std::vector<req_msg*>& reqs,
+                              std::vector< ptr<resp_msg> >& resps_out,
+                              const std::vector<uint64_t>& enqueue_us);
+    ptr<resp_msg> handle_cli_req_group(req_msg& req);
+    void run_group_commit();
+    ptr<resp_msg> handle_cli_req_fwd_batch(req_msg& req);
     ptr<resp_msg> handle_cli_req_callback(ptr<commit_ret_elem> elem,
                                           ptr<resp_msg> resp);
     ptr< cmd_result< ptr<buffer> > >
@@ -500,6 +700,25 @@ protected:
 
     void drop_all_pending_commit_elems();
 
+    bool use_commit_ret_ring() const;
+    void arrive_commit_ret(ulong idx,
+                           ptr< cmd_result< ptr<buffer> > > async_result,
+                           ptr<buffer> ret_value);
+    void arrive_commit_ret_map(ulong idx,
+                               ptr< cmd_result< ptr<buffer> > > async_result,
+                               ptr<buffer> ret_value);
+
+    bool check_read_lease();
+    bool check_quorum_responded(int32 within_ms);
+    ptr< cmd_result<uint64_t> > read_index_internal(ulong min_log_idx);
+    void start_read_index_round();
+    void check_read_index_round();
+    void wait_for_read_index_commit(std::list< ptr<read_index_elem> >& elems);
+    void notify_read_index_waiters();
+    void drop_all_read_index_reqs();
+    void on_leader_commit_index(ulong leader_commit_idx);
+    void drop_all_stale_read_reqs();
+
     ptr<resp_msg> handle_ext_msg(req_msg& req);
     ptr<resp_msg> handle_install_snapshot_req(req_msg& req);
     ptr<resp_msg> handle_rm_srv_req(req_msg& req);
@@ -542,12 +761,21 @@ protected:
                                           ulong last_log_idx,
                                           ulong term,
                                           ulong commit_idx);
+    bool read_prefetched_snp_block(snapshot_sync_ctx& sync_ctx,
+                                   ulong offset,
+                                   bool wait,
+                                   ptr<buffer>& data_out,
+                                   bool& is_last_out,
+                                   bool& not_ready_out);
+    void stop_snapshot_prefetchers();
+    bool has_more_snp_blocks_to_send(peer& p);
     void commit(ulong target_idx);
     void snapshot_and_compact(ulong committed_idx);
     bool update_term(ulong term);
     void reconfigure(const ptr<cluster_config>& new_config);
     void update_target_priority();
     void decay_target_priority();
+    void hand_over_leadership(ptr<peer>& p);
     void reconnect_client(peer& p);
     void become_leader();
     void become_follower();
@@ -557,6 +785,7 @@ protected:
     void reset_peer_info();
     void handle_election_timeout();
     void sync_log_to_new_srv(ulong start_idx);
+    bool need_snapshot_for_new_srv(ulong start_idx);
     void invite_srv_to_join_cluster();
     void rm_srv_from_cluster(int32 srv_id);
     int get_snapshot_sync_block_size() const;
@@ -568,17 +797,53 @@ protected:
 
     void commit_in_bg();
     void append_entries_in_bg();
-
+    bool enqueue_append_req(ptr<peer>& p);
+    void run_append_sender(ptr<append_sender> s);
+    void stop_append_senders();
+    void flush_logs_in_bg();
+    void request_follower_flush(ulong start, ulong cnt);
+    bool is_follower_log_durable(ulong log_idx);
+    void defer_append_ack(ptr<resp_msg>& resp, ulong log_idx);
+    void complete_append_acks();
+    void stop_flush_thread();
+    void compact_logs_in_bg();
+    void request_log_compaction(ulong upto);
+    void wait_for_log_compaction();
+    void stop_compaction_thread();
+
+    void commit_in_batch(bool need_to_handle_commit_elem);
+    ptr< std::vector< ptr<log_entry> > >
+        get_prefetched_logs(ulong first_idx, ulong last_idx);
     void commit_app_log(ptr<log_entry>& le, bool need_to_handle_commit_elem);
+    void commit_app_log_batch(std::vector< ptr<log_entry> >& les,
+                              ulong first_idx,
+                              bool need_to_handle_commit_elem);
+    void commit_packed_log(ptr<log_entry>& le, bool need_to_handle_commit_elem);
+    void notify_commit_ret_elems(ulong first_idx,
+                                 std::vector< ptr<buffer> >& ret_values);
+    ptr<buffer> pre_commit_packed_log(ulong log_idx, ptr<buffer>& buf);
+    void rollback_packed_log(ulong log_idx, ptr<buffer>& buf);
     void commit_conf(ptr<log_entry>& le);
 
     ptr< cmd_result< ptr<buffer> > > send_msg_to_leader(ptr<req_msg>& req);
+    ptr< cmd_result< ptr<buffer> > > enqueue_forward_req(int32 leader_id,
+                                                         ptr<req_msg>& req);
+    void flush_forward_queue(ptr<forward_queue> fq);
+    void handle_forward_resp(ptr<forward_queue> fq,
+                             ptr<rpc_client> rpc_cli,
+                             std::vector< ptr<forward_elem> >& elems,
+                             ptr<resp_msg>& resp,
+                             ptr<rpc_exception>& err);
+    void drop_all_forward_reqs();
+    void prune_forward_queues();
 
     void set_config(const ptr<cluster_config>& new_config);
     ptr<snapshot> get_last_snapshot() const;
     void set_last_snapshot(const ptr<snapshot>& new_snapshot);
 
     ulong store_log_entry(ptr<log_entry>& entry, ulong index = 0);
+    ulong store_log_entries(std::vector< ptr<log_entry> >& entries,
+                            ulong index = 0);
 
     ptr<resp_msg> handle_out_of_log_msg(req_msg& req,
                                         ptr<custom_notification_msg> msg,
@@ -602,6 +867,65 @@ protected:
     // Condition variable to invoke append thread.
     EventAwaiter* bg_append_ea_;
 
+    // Threads creating and sending append entries requests,
+    // if `parallel_append_senders_` is set. Created on the first use.
+    std::vector< ptr<append_sender> > append_senders_;
+
+    // Protects the creation of `append_senders_`.
+    std::mutex append_senders_lock_;
+
+    // `true` once `append_senders_` is created.
+    std::atomic<bool> append_senders_ready_;
+
+    // Background thread for flushing logs of follower, started on
+    // demand if `use_bg_thread_for_follower_flush_` is set.
+    std::thread bg_flush_thread_;
+
+    // Protects the follower flush status below.
+    std::mutex flush_lock_;
+
+    // Notified when new logs are appended, to wake up the flush thread.
+    std::condition_variable flush_cv_;
+
+    // Logs appended but not flushed yet: [flush_start_, flush_end_].
+    // `flush_start_` is 0 if there is nothing.
+    ulong flush_start_;
+    ulong flush_end_;
+
+    // `true` while `end_of_append_batch` is being called.
+    bool flush_running_;
+
+    // Logs up to this index are durable.
+    ulong durable_idx_;
+
+    // Increased when logs being flushed are overwritten.
+    uint64_t flush_epoch_;
+
+    // Deferred append responses of follower, and the log index
+    // that should be durable before sending each of them.
+    std::list< std::pair<ulong, resp_ready_cb> > pending_append_acks_;
+
+    // Background thread for log compaction, started on demand
+    // if `use_bg_thread_for_log_compaction_` is set.
+    std::thread bg_compact_thread_;
+
+    // Protects the compaction status below.
+    std::mutex compact_lock_;
+
+    // Notified when a compaction is requested or done.
+    std::condition_variable compact_cv_;
+
+    // Log index to compact up to, requested but not started yet.
+    // 0 if there is nothing.
+    ulong compact_target_;
+
+    // `true` while `log_store::compact` is being called.
+    bool compact_running_;
+
+    // Logs up to this index have been (or are being) compacted.
+    // Only increases.
+    std::atomic<ulong> compact_watermark_;
+
     // `true` if this server is ready to serve operation.
     std::atomic<bool> initialized_;
 
@@ -646,6 +970,11 @@ protected:
     // Actual commit index of state machine.
     std::atomic<ulong> sm_commit_index_;
 
+    // Index of the last log whose commit call to the state machine
+    // has returned. `sm_commit_index_` is advanced before the call,
+    // so read requests should wait for this index instead.
+    std::atomic<ulong> sm_applied_index_;
+
     // (Read-only)
     // Initial commit index when this server started.
     ulong initial_commit_index_;
@@ -749,6 +1078,11 @@ protected:
     // Log store instance.
     ptr<log_store> log_store_;
 
+    // (Read-only, but its contents will change)
+    // Cached terms of the logs in `log_store_`, updated along with
+    // every append and compaction done by this server.
+    ptr<term_index> term_index_;
+
     // (Read-only)
     // State machine instance.
     ptr<state_machine> state_machine_;
@@ -761,6 +1095,10 @@ protected:
     // so that cannot send message before election timeout.
     std::atomic<ulong> et_cnt_receiving_snapshot_;
 
+    // Streams whose last objects have been received,
+    // if the snapshot is sent in multiple streams.
+    std::set<int32> snp_streams_done_;
+
     // (Read-only)
     // Logger instance.
     ptr<logger> l_;
@@ -790,21 +1128,50 @@ protected:
     // protected by `lock_`.
     ptr<srv_config> conf_to_add_;
 
+    // Log index where the catch-up of `srv_to_join_` started,
+    // and the timer reset at that time, to measure the catch-up rate.
+    // Protected by `lock_`.
+    ulong srv_to_join_start_idx_;
+    timer_helper srv_to_join_timer_;
+
     // Lock of entire Raft operation.
     std::recursive_mutex lock_;
 
+    // Serializes appending logs to the log store, so that logs
+    // appended by `log_store::append_batch` get consecutive indexes
+    // even when client requests and config changes are appended
+    // under different locks.
+    std::mutex log_append_lock_;
+
     // Lock of handling client request and role change.
+    // In `dual_rw_lock` mode, it only serializes appending logs and
+    // their `pre_commit`, not `end_of_append_batch`.
     std::mutex cli_lock_;
 
+    // Lock of handling client request (shared) and
+    // role change (exclusive), used in `dual_rw_lock` mode.
+    rw_lock cli_rw_lock_;
+
     // Condition variable to invoke BG commit thread.
     std::condition_variable commit_cv_;
 
     // Lock for `commit_cv_`.
     std::mutex commit_cv_lock_;
 
+    // Background reader of the logs to be committed, used if
+    // `raft_params::commit_prefetch_` is set.
+    // Only accessed by the BG commit thread.
+    ptr<log_prefetcher> commit_prefetcher_;
+
     // Lock for auto forwarding.
     std::mutex rpc_clients_lock_;
 
+    // Map of {leader ID, queue of requests forwarded to the leader},
+    // used if `auto_forwarding_batch_size_` is set. The queue of a
+    // previous leader is removed once it is drained.
+    // Protected by `rpc_clients_lock_`.
+    std::unordered_map< int32, ptr<forward_queue> > forward_queues_;
+
     // Client requests waiting for replication.
     // Only used in blocking mode.
     std::map<ulong, ptr<commit_ret_elem>> commit_ret_elems_;
@@ -812,6 +1179,88 @@ protected:
     // Lock for `commit_ret_elems_`.
     std::mutex commit_ret_elems_lock_;
 
+    // Lock-free ring of client requests waiting for replication,
+    // addressed by log index. Only used in async handler mode,
+    // and `commit_ret_elems_` is used for the logs not fitting in.
+    std::vector< ptr<commit_ret_slot> > commit_ret_ring_;
+
+    // The last log index whose commit result has been passed to
+    // `arrive_commit_ret` by the commit thread. A request for a log
+    // up to this index, that finds nothing in the ring and the map,
+    // has its result dropped, as nobody was waiting for it.
+    std::atomic<ulong> commit_ret_notified_idx_;
+
+    // Head of lock-free submission queue (stack) for group commit.
+    // The latest submitted element is at the head.
+    std::atomic<group_commit_elem*> group_commit_head_;
+
+    // `true` if a thread is appending requests in the submission queue.
+    // Protected by `group_commit_lock_`.
+    bool group_commit_active_;
+
+    std::mutex group_commit_lock_;
+
+    // Notified when a request is submitted, to the appender
+    // gathering requests.
+    std::condition_variable group_commit_submit_cv_;
+
+    // Notified when requests are appended, or the appender
+    // hands off to the waiting threads.
+    std::condition_variable group_commit_done_cv_;
+
+    // Latency of commit phases of the logs appended by this server.
+    ptr<repl_latency_tracker> repl_lat_tracker_;
+
+    // Lock for `inflight_bytes_` and `inflight_total_bytes_`.
+    std::mutex inflight_lock_;
+
+    // Uncommitted client logs appended by this server (as leader),
+    // as pairs of {last log index, payload size} of each batch.
+    std::deque< std::pair<ulong, uint64_t> > inflight_bytes_;
+
+    // Sum of payload sizes in `inflight_bytes_`.
+    uint64_t inflight_total_bytes_;
+
+    // Read requests waiting for the next leadership confirmation
+    // round, protected by `lock_`.
+    std::list< ptr<read_index_elem> > read_index_queue_;
+
+    // Read requests in the current leadership confirmation round,
+    // protected by `lock_`. Empty if there is no round in progress.
+    std::list< ptr<read_index_elem> > read_index_round_;
+
+    // Map of {peer ID, sequence number of append entries request}
+    // for the current confirmation round. Once quorum of peers respond
+    // to the request with that number (or later), leadership is
+    // confirmed. Protected by `lock_`.
+    std::unordered_map<int32, uint64_t> read_index_round_targets_;
+
+    // Confirmed read requests waiting for state machine commit,
+    // protected by `read_index_waiters_lock_`.
+    std::list< ptr<read_index_elem> > read_index_waiters_;
+
+    // Bounded staleness reads waiting for state machine commit,
+    // protected by `read_index_waiters_lock_`.
+    std::list< ptr<read_index_elem> > stale_read_waiters_;
+
+    // Bounded staleness reads waiting for the next commit index
+    // from the leader, protected by `read_index_waiters_lock_`.
+    // `read_idx_` of each element holds its minimum log index.
+    std::list< ptr<read_index_elem> > stale_read_pending_;
+
+    // `true` if `last_leader_commit_idx_` is valid,
+    // protected by `read_index_waiters_lock_`.
+    bool leader_commit_received_;
+
+    // The latest commit index received from the leader, and the
+    // timer reset at that time. Protected by `read_index_waiters_lock_`.
+    ulong last_leader_commit_idx_;
+    timer_helper last_leader_commit_timer_;
+
+    // Lock for `read_index_waiters_` and the bounded
+    // staleness read status above.
+    std::mutex read_index_waiters_lock_;
+
     // Condition variable to invoke Raft server for
     // notifying the termination of BG commit thread.
     std::condition_variable ready_to_stop_cv_;
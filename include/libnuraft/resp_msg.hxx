@@ -33,6 +33,18 @@ using resp_cb =
 using resp_async_cb =
     std::function< ptr< cmd_result< ptr<buffer> > >() >;
 
+/**
+ * Invoked once a deferred response is ready to be sent.
+ * `ok` is `false` if the response cannot be completed
+ * (e.g., the server is shutting down), and should be discarded.
+ */
+using resp_ready_cb = std::function<void(bool ok)>;
+
+/**
+ * Registers the given `resp_ready_cb` of a deferred response.
+ */
+using resp_defer_cb = std::function<void(resp_ready_cb)>;
+
 class resp_msg : public msg_base {
 public:
     resp_msg(ulong term,
@@ -45,9 +57,11 @@ public:
         , next_idx_(next_idx)
         , next_batch_size_hint_in_bytes_(0)
         , accepted_(accepted)
+        , obsolete_(false)
         , ctx_(nullptr)
         , cb_func_(nullptr)
         , async_cb_func_(nullptr)
+        , defer_cb_func_(nullptr)
         , result_code_(cmd_result_code::OK)
         {}
 
@@ -75,6 +89,19 @@ public:
         accepted_ = true;
     }
 
+    /**
+     * Mark this response as the one to a request that was sent before
+     * the leader reset the replication state of the peer. It is local
+     * only, not sent over the network.
+     */
+    void set_obsolete() {
+        obsolete_ = true;
+    }
+
+    bool is_obsolete() const {
+        return obsolete_;
+    }
+
     void set_ctx(ptr<buffer> src) {
         ctx_ = src;
     }
@@ -109,6 +136,28 @@ public:
         return async_cb_func_();
     }
 
+    /**
+     * Make this response deferred: it should not be sent until
+     * the callback registered by `when_ready` is invoked.
+     */
+    void set_defer_cb(resp_defer_cb _func) {
+        defer_cb_func_ = _func;
+    }
+
+    bool is_deferred() const {
+        if (defer_cb_func_) return true;
+        return false;
+    }
+
+    /**
+     * Register the callback to be invoked once this deferred response
+     * is ready. It does not block, and the callback can be invoked
+     * either right away on the caller's thread, or later on another thread.
+     */
+    void when_ready(resp_ready_cb ready) {
+        defer_cb_func_(ready);
+    }
+
     void set_result_code(cmd_result_code rc) {
         result_code_ = rc;
     }
@@ -121,9 +170,11 @@ private:
     ulong next_idx_;
     ulong next_batch_size_hint_in_bytes_;
     bool accepted_;
+    bool obsolete_;
     ptr<buffer> ctx_;
     resp_cb cb_func_;
     resp_async_cb async_cb_func_;
+    resp_defer_cb defer_cb_func_;
     cmd_result_code result_code_;
 };
 
@@ -27,10 +27,23 @@ namespace nuraft {
 class raft_server;
 typedef raft_server msg_handler;
 
+class raft_group_dispatcher;
+
 class rpc_listener {
 __interface_body__(rpc_listener);
 public:
     virtual void listen(ptr<msg_handler>& handler) = 0;
+
+    /**
+     * Start listening on behalf of multiple Raft groups (Multi-Raft).
+     * Requests with a group ID are routed to the server registered
+     * to the given dispatcher, and the others to `default_handler`
+     * (can be `nullptr`).
+     * Not every implementation supports it.
+     */
+    virtual void listen_groups(ptr<raft_group_dispatcher>& dispatcher,
+                               ptr<msg_handler> default_handler = nullptr) {}
+
     virtual void stop() = 0;
     virtual void shutdown() {}
 };
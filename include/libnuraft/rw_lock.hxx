@@ -0,0 +1,84 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+
+namespace nuraft {
+
+/**
+ * Reader-writer lock, which can be used with `std::unique_lock`
+ * (exclusive) and `read_lock_guard` (shared).
+ *
+ * Waiting writers have priority over new readers, so that
+ * frequent readers cannot starve a writer.
+ */
+class rw_lock {
+public:
+    rw_lock() : num_readers_(0), num_waiting_writers_(0), writer_(false) {}
+
+    void lock() {
+        std::unique_lock<std::mutex> l(lock_);
+        num_waiting_writers_++;
+        cv_.wait(l, [this]() { return !writer_ && !num_readers_; });
+        num_waiting_writers_--;
+        writer_ = true;
+    }
+
+    void unlock() {
+        std::lock_guard<std::mutex> l(lock_);
+        writer_ = false;
+        cv_.notify_all();
+    }
+
+    void lock_shared() {
+        std::unique_lock<std::mutex> l(lock_);
+        cv_.wait(l, [this]() { return !writer_ && !num_waiting_writers_; });
+        num_readers_++;
+    }
+
+    void unlock_shared() {
+        std::lock_guard<std::mutex> l(lock_);
+        if (--num_readers_ == 0) cv_.notify_all();
+    }
+
+private:
+    std::mutex lock_;
+    std::condition_variable cv_;
+    size_t num_readers_;
+    size_t num_waiting_writers_;
+    bool writer_;
+};
+
+/**
+ * RAII wrapper for the shared ownership of `rw_lock`.
+ */
+class read_lock_guard {
+public:
+    read_lock_guard(rw_lock& lock) : lock_(lock) { lock_.lock_shared(); }
+    ~read_lock_guard() { lock_.unlock_shared(); }
+
+private:
+    read_lock_guard(const read_lock_guard&) = delete;
+    read_lock_guard& operator=(const read_lock_guard&) = delete;
+
+    rw_lock& lock_;
+};
+
+}
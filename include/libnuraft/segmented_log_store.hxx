@@ -0,0 +1,210 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include "log_store.hxx"
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace nuraft {
+
+/**
+ * Durable log store based on append-only segment files.
+ *
+ * Each segment file holds a contiguous range of log entries, and is
+ * pre-allocated to `segment_size_` and memory-mapped, so that reads
+ * (`entry_at`, `log_entries`, `pack`) are served from the page cache
+ * without any system call. Appends are written to the last segment,
+ * and are made durable by a single `fsync` per batch in
+ * `end_of_append_batch` (or `flush`).
+ *
+ * Terms of all entries are kept in memory, so `term_at` does not
+ * touch the files. Offsets of every `index_interval_`-th entry are
+ * kept in memory as a sparse index, and the rest are found by
+ * walking the record headers in the mapped segment.
+ *
+ * `compact` just deletes the segments entirely covered by the given
+ * index. `pack` copies the raw records, and `apply_pack` writes them
+ * as they are, without (de)serializing log entries. Hence the packed
+ * format is specific to this log store, all members of a cluster
+ * should use the same log store.
+ *
+ * Only POSIX platforms are supported.
+ */
+class segmented_log_store : public log_store {
+public:
+    struct options {
+        options()
+            : segment_size_(64 * 1024 * 1024)
+            , index_interval_(32)
+            , fsync_(true)
+            {}
+
+        /**
+         * Size of each segment file. A log entry bigger than this
+         * will have its own segment.
+         */
+        size_t segment_size_;
+
+        /**
+         * Keep the offset of every `index_interval_`-th log entry
+         * in memory.
+         */
+        size_t index_interval_;
+
+        /**
+         * If `false`, `end_of_append_batch` and `flush` do not call
+         * `fsync`. Only for testing.
+         */
+        bool fsync_;
+    };
+
+    /**
+     * Open (or create) the log store in the given directory.
+     * Log entries in existing segment files are recovered, and any
+     * partially written entry at the end is discarded.
+     *
+     * @param path Directory of the segment files.
+     * @param opt Options.
+     * @return Log store instance, or `nullptr` on failure.
+     */
+    static ptr<segmented_log_store> open(const std::string& path,
+                                         const options& opt = options());
+
+    segmented_log_store(const std::string& path, const options& opt);
+
+    ~segmented_log_store();
+
+    __nocopy__(segmented_log_store);
+
+public:
+    ulong next_slot() const;
+
+    ulong start_index() const;
+
+    ptr<log_entry> last_entry() const;
+
+    ulong append(ptr<log_entry>& entry);
+
+    void write_at(ulong index, ptr<log_entry>& entry);
+
+    void append_batch(ulong start_idx, std::vector< ptr<log_entry> >& entries);
+
+    void write_batch_at(ulong start_idx, std::vector< ptr<log_entry> >& entries);
+
+    void end_of_append_batch(ulong start, ulong cnt);
+
+    ptr<std::vector<ptr<log_entry>>> log_entries(ulong start, ulong end);
+
+    ptr<std::vector<ptr<log_entry>>> log_entries_ext(
+            ulong start, ulong end, ulong batch_size_hint_in_bytes = 0);
+
+    ptr<log_entry> entry_at(ulong index);
+
+    ulong term_at(ulong index);
+
+    log_val_type val_type_at(ulong index);
+
+    ptr<buffer> pack(ulong index, int32 cnt);
+
+    void apply_pack(ulong index, buffer& pack);
+
+    bool compact(ulong last_log_index);
+
+    bool flush();
+
+    /**
+     * Flush and close all segment files. Called by the destructor.
+     */
+    void close();
+
+    /**
+     * Get the number of segment files.
+     */
+    size_t get_num_segments() const;
+
+private:
+    struct segment;
+
+    bool load();
+
+    bool load_segment(const ptr<segment>& seg, bool is_last);
+
+    ptr<segment> open_segment(ulong start_idx, size_t min_size, bool create);
+
+    void remove_segment(const ptr<segment>& seg);
+
+    void truncate_segment(const ptr<segment>& seg, size_t offset, ulong count);
+
+    void truncate_from(ulong index);
+
+    bool append_record(ulong index,
+                       const byte* payload,
+                       size_t payload_len,
+                       ulong term);
+
+    bool append_raw(ulong index,
+                    const byte* rec,
+                    size_t rec_len,
+                    const byte* rec_rest,
+                    size_t rec_rest_len,
+                    ulong term);
+
+    segment* find_segment(ulong index) const;
+
+    const byte* find_record(ulong index, size_t& rec_len_out) const;
+
+    ptr<log_entry> read_entry(ulong index) const;
+
+    bool sync_dirty();
+
+    bool save_meta();
+
+    void load_meta(ulong& start_idx_out);
+
+    std::string path_;
+
+    options opt_;
+
+    // Segments, by the index of their first log entry.
+    std::map<ulong, ptr<segment>> segments_;
+
+    // Segments written since the last `fsync`.
+    std::vector<ptr<segment>> dirty_;
+
+    // `true` if segment files were created or removed
+    // since the last `fsync` of the directory.
+    bool dir_dirty_;
+
+    // Terms of log entries in [start_idx_, next_idx_).
+    std::deque<ulong> terms_;
+
+    std::atomic<ulong> start_idx_;
+
+    std::atomic<ulong> next_idx_;
+
+    mutable std::mutex lock_;
+};
+
+}
+
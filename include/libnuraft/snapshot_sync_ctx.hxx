@@ -21,11 +21,18 @@ limitations under the License.
 #ifndef _SNAPSHOT_SYNC_CTX_HXX_
 #define _SNAPSHOT_SYNC_CTX_HXX_
 
+#include "basic_types.hxx"
 #include "internal_timer.hxx"
+#include "pp_util.hxx"
+#include "ptr.hxx"
+
+#include <vector>
 
 namespace nuraft {
 
 class snapshot;
+class snapshot_prefetcher;
+class state_machine;
 struct snapshot_sync_ctx {
 public:
     snapshot_sync_ctx(const ptr<snapshot>& s,
@@ -33,18 +40,36 @@ public:
         : snapshot_(s)
         , offset_(offset)
         , user_snp_ctx_(nullptr)
+        , sent_offset_(offset)
+        , next_stream_(0)
     {
         // 10 seconds by default.
         timer_.set_duration_sec(10);
     }
 
+    ~snapshot_sync_ctx();
+
     __nocopy__(snapshot_sync_ctx);
 
 public:
     const ptr<snapshot>& get_snapshot() const { return snapshot_; }
     ulong get_offset() const { return offset_; }
     ulong get_obj_idx() const { return obj_idx_; }
-    void*& get_user_snp_ctx() { return user_snp_ctx_; }
+
+    /**
+     * Get the user context of logical snapshot. If the background
+     * reader is running, it is stopped first to take back the context,
+     * so that the caller can free it.
+     */
+    void*& get_user_snp_ctx() {
+        stop_prefetch();
+        return user_snp_ctx_;
+    }
+
+    /**
+     * Stop the background reader if it is running.
+     */
+    void stop_prefetch();
 
     void set_offset(ulong offset) {
         if (offset_ != offset) timer_.reset();
@@ -55,6 +80,40 @@ public:
 
     timer_helper& get_timer() { return timer_; }
 
+    /**
+     * Send the logical snapshot in multiple object streams.
+     * User contexts of the streams are freed by the given
+     * state machine when this context is destroyed.
+     *
+     * @param sm State machine.
+     * @param num_streams Number of streams.
+     */
+    void init_streams(const ptr<state_machine>& sm, int32 num_streams);
+
+    int32 get_num_streams() const {
+        return streams_.empty() ? 1 : (int32)streams_.size();
+    }
+
+    /**
+     * Pick a stream to send the next object.
+     * Until the first object of stream 0 is acknowledged, the other
+     * streams are not used.
+     *
+     * @return Stream ID, or -1 if all streams are in flight or done.
+     */
+    int32 next_stream();
+
+    /**
+     * Check if there is a stream that `next_stream()` can pick.
+     */
+    bool has_stream_to_send() const;
+
+    /**
+     * Clear in-flight flags of all streams,
+     * when there is no request in flight.
+     */
+    void reset_in_flight_streams();
+
 public:
     ptr<snapshot> snapshot_;
     // Can be used for either byte offset or object index.
@@ -64,6 +123,36 @@ public:
     };
     void* user_snp_ctx_;
     timer_helper timer_;
+    // Background reader, if prefetching is enabled.
+    ptr<snapshot_prefetcher> prefetcher_;
+    // Next byte offset to send. It can be ahead of `offset_`
+    // (acknowledged by the peer) if multiple blocks of raw binary
+    // snapshot are in flight.
+    ulong sent_offset_;
+
+    // State of an object stream.
+    struct stream {
+        stream()
+            : obj_idx_(0)
+            , user_snp_ctx_(nullptr)
+            , in_flight_(false)
+            , done_(false)
+            {}
+        // Next object index, acknowledged by the peer.
+        ulong obj_idx_;
+        void* user_snp_ctx_;
+        bool in_flight_;
+        bool done_;
+    };
+    // Empty if the snapshot is sent in a single stream.
+    std::vector<stream> streams_;
+    // To free user contexts of streams.
+    ptr<state_machine> sm_;
+    // Round-robin cursor of `next_stream()`.
+    size_t next_stream_;
+
+private:
+    int32 find_stream() const;
 };
 
 }
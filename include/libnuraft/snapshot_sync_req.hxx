@@ -36,7 +36,8 @@ public:
                       ulong offset,
                       const ptr<buffer>& buf,
                       bool done)
-        : snapshot_(s), offset_(offset), data_(buf), done_(done) {}
+        : snapshot_(s), offset_(offset), data_(buf), done_(done)
+        , stream_id_(0), num_streams_(1) {}
 
     __nocopy__(snapshot_sync_req);
 
@@ -56,12 +57,50 @@ public:
 
     bool is_done() const { return done_; }
 
+    /**
+     * Stream that this object belongs to, if the snapshot is
+     * sent in multiple streams. All nodes should support it
+     * before it is enabled.
+     */
+    int32 get_stream_id() const { return stream_id_; }
+    int32 get_num_streams() const { return num_streams_; }
+    void set_stream(int32 stream_id, int32 num_streams) {
+        stream_id_ = stream_id;
+        num_streams_ = num_streams;
+    }
+
     ptr<buffer> serialize();
+
+    /**
+     * Response context of an object in a stream.
+     *
+     * @param stream_id Stream ID.
+     * @param stream_done `true` if it was the last object of the stream.
+     * @param snp_done `true` if all streams are done and
+     *                 the snapshot has been installed.
+     * @return Context buffer.
+     */
+    static ptr<buffer> make_stream_ack(int32 stream_id,
+                                       bool stream_done,
+                                       bool snp_done);
+
+    /**
+     * Parse the response context made by `make_stream_ack`.
+     *
+     * @return `false` if it is not a stream response context.
+     */
+    static bool parse_stream_ack(buffer& ctx,
+                                 int32& stream_id_out,
+                                 bool& stream_done_out,
+                                 bool& snp_done_out);
+
 private:
     ptr<snapshot> snapshot_;
     ulong offset_;
     ptr<buffer> data_;
     bool done_;
+    int32 stream_id_;
+    int32 num_streams_;
 };
 
 }
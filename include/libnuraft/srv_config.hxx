@@ -75,6 +75,8 @@ public:
 
     bool is_learner() const { return learner_; }
 
+    void set_learner(bool learner) { learner_ = learner; }
+
     int32 get_priority() const { return priority_; }
 
     void set_priority(const int32 new_val) { priority_ = new_val; }
@@ -98,7 +100,8 @@ private:
     std::string aux_;
 
     // `true` if this node is learner.
-    // Learner will not initiate or participate in leader election.
+    // Learner will not initiate or participate in leader election,
+    // and is not counted in the quorum for commit.
     bool learner_;
 
     // Priority of this node.
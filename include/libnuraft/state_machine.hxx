@@ -27,6 +27,8 @@ limitations under the License.
 #include "pp_util.hxx"
 #include "ptr.hxx"
 
+#include <vector>
+
 namespace nuraft {
 
 class snapshot;
@@ -71,6 +73,49 @@ public:
     virtual ptr<buffer> commit_ext(const ext_op_params& params)
     {   return commit(params.log_idx, *params.data);    }
 
+    /**
+     * (Optional)
+     * Commit the given consecutive Raft logs at once.
+     * It is called only if `raft_params::max_commit_batch_size_`
+     * is bigger than 1, and `params` are in log index order.
+     *
+     * Same as `commit()`, memory buffers are owned by caller.
+     *
+     * @param params List of Raft logs to commit.
+     * @param[out] results_out Result value of each log, in the same order.
+     */
+    virtual void commit_batch(const std::vector<ext_op_params>& params,
+                              std::vector< ptr<buffer> >& results_out)
+    {
+        results_out.resize(params.size());
+        for (size_t ii = 0; ii < params.size(); ++ii) {
+            results_out[ii] = commit_ext(params[ii]);
+        }
+    }
+
+    /**
+     * (Optional)
+     * Commit the payloads packed in a single Raft log of type
+     * `log_val_type::packed_app_log`
+     * (see `raft_server::append_packed_entries`).
+     * All `params` have the same log index, and are in the packed order.
+     * `pre_commit_ext` and `rollback_ext` are called for each payload
+     * in the same way.
+     *
+     * Same as `commit()`, memory buffers are owned by caller.
+     *
+     * @param params List of payloads to commit.
+     * @param[out] results_out Result value of each payload, in the same order.
+     */
+    virtual void commit_packed(const std::vector<ext_op_params>& params,
+                               std::vector< ptr<buffer> >& results_out)
+    {
+        results_out.resize(params.size());
+        for (size_t ii = 0; ii < params.size(); ++ii) {
+            results_out[ii] = commit_ext(params[ii]);
+        }
+    }
+
     /**
      * Pre-commit the given Raft log.
      *
@@ -231,6 +276,82 @@ public:
                                      ptr<buffer>& data_out,
                                      bool& is_last_obj) { return 0; }
 
+    /**
+     * Read the given object of a snapshot stream.
+     * This API is for snapshot sender (i.e., leader), and will be
+     * invoked instead of `read_logical_snp_obj` if
+     * `raft_params::snapshot_sync_streams_` is greater than 1.
+     *
+     * Each stream has its own `user_snp_ctx` and object IDs, and
+     * starts from object ID 0. Streams are sent in parallel once
+     * the first object of stream 0 is saved by the receiver, so
+     * each of them should cover an independent part of the state
+     * machine. The snapshot is installed when all streams reach
+     * their last objects.
+     *
+     * By default, stream 0 reads the entire snapshot by calling
+     * `read_logical_snp_obj`, and the other streams are empty.
+     *
+     * @param s Snapshot instance to read.
+     * @param[in,out] user_snp_ctx User-defined instance of this stream.
+     * @param stream_id Stream ID, from 0 to `num_streams - 1`.
+     * @param num_streams Total number of streams.
+     * @param obj_id Object ID to read.
+     * @param[out] data Buffer where the read object will be stored.
+     * @param[out] is_last_obj Set `true` if this is the last object
+     *                         of this stream.
+     * @return 0 if failed.
+     */
+    virtual int read_logical_snp_obj_stream(snapshot& s,
+                                            void*& user_snp_ctx,
+                                            int32 stream_id,
+                                            int32 num_streams,
+                                            ulong obj_id,
+                                            ptr<buffer>& data_out,
+                                            bool& is_last_obj)
+    {
+        if (stream_id == 0) {
+            return read_logical_snp_obj(s, user_snp_ctx, obj_id,
+                                        data_out, is_last_obj);
+        }
+        data_out = buffer::alloc(0);
+        is_last_obj = true;
+        return 0;
+    }
+
+    /**
+     * Save the given object of a snapshot stream.
+     * This API is for snapshot receiver (i.e., follower), counterpart
+     * of `read_logical_snp_obj_stream`.
+     *
+     * Objects of different streams are independent of each other,
+     * so the state machine can apply them concurrently (e.g., by
+     * handing each stream to its own worker), as long as all of them
+     * are applied before `apply_snapshot` is invoked.
+     *
+     * @param s Snapshot instance to save.
+     * @param stream_id Stream ID, from 0 to `num_streams - 1`.
+     * @param num_streams Total number of streams.
+     * @param obj_id[in,out]
+     *     Object ID. As a result of this API call, the next object ID
+     *     of this stream should be set to this parameter.
+     * @param data Payload of given object.
+     * @param is_first_obj `true` if this is the first object of this stream.
+     * @param is_last_obj `true` if this is the last object of this stream.
+     */
+    virtual void save_logical_snp_obj_stream(snapshot& s,
+                                             int32 stream_id,
+                                             int32 num_streams,
+                                             ulong& obj_id,
+                                             buffer& data,
+                                             bool is_first_obj,
+                                             bool is_last_obj)
+    {
+        if (stream_id == 0) {
+            save_logical_snp_obj(s, obj_id, data, is_first_obj, is_last_obj);
+        }
+    }
+
     /**
      * Free user-defined instance that is allocated by
      * `read_logical_snp_obj`.
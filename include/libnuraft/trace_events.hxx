@@ -0,0 +1,159 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include "basic_types.hxx"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace nuraft {
+
+enum trace_event_id : uint16_t {
+    // Leader: append entries request (or heartbeat) is sent to a peer.
+    TE_APPEND_REQ_SEND      = 1,
+    // Leader: append entries response is received from a peer.
+    TE_APPEND_RESP_RECV     = 2,
+    // Follower: append entries request is received from the leader.
+    TE_APPEND_REQ_RECV      = 3,
+    // Leader: logs from clients are appended to the log store.
+    TE_LOG_APPEND           = 4,
+    // Logs are committed by quorum.
+    TE_COMMIT_QUORUM        = 5,
+    // Logs are committed to the state machine.
+    TE_COMMIT_SM            = 6,
+    // Candidate: election (vote request) starts.
+    TE_ELECTION_START       = 7,
+    // Candidate: vote is granted by a peer.
+    TE_VOTE_GRANTED         = 8,
+    TE_BECOME_LEADER        = 9,
+    TE_BECOME_FOLLOWER      = 10,
+};
+
+/**
+ * Fixed-size binary trace event.
+ */
+struct trace_event {
+    // Steady clock time in nanoseconds.
+    uint64_t ts_ns_;
+    // Log index (if any).
+    uint64_t log_idx_;
+    // Term (if any).
+    uint64_t term_;
+    // ID of the server that records the event.
+    int32 srv_id_;
+    // ID of the peer (if any).
+    int32 peer_id_;
+    // Sequential ID of the recording thread.
+    uint32_t thread_id_;
+    // `trace_event_id`.
+    uint16_t event_id_;
+    uint16_t reserved_;
+};
+
+/**
+ * Trace events recorded into a lock-free ring buffer of each thread,
+ * without formatting or any lock in the hot path. Once the ring is
+ * full, the oldest events are overwritten.
+ *
+ * Recording is disabled by default, and can be enabled at runtime.
+ * Call sites can be compiled out by defining `NO_RAFT_TRACE_EVENTS`.
+ */
+class trace_events {
+public:
+    // Number of events per thread. Once the ring wraps around,
+    // `dump` returns up to `RING_SIZE - 1` events of the thread, as
+    // the oldest slot may be being overwritten at the moment.
+    static const size_t RING_SIZE = 8192;
+
+    /**
+     * Enable or disable recording.
+     *
+     * @param enable `true` to enable.
+     */
+    static void enable(bool enable) {
+        enabled_.store(enable, std::memory_order_relaxed);
+    }
+
+    static bool is_enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Record an event in the ring of the current thread.
+     */
+    static void record(uint16_t event_id,
+                       int32 srv_id,
+                       uint64_t log_idx,
+                       int32 peer_id,
+                       uint64_t term);
+
+    /**
+     * Get the events in the rings of all threads, sorted by timestamp.
+     * The ring of a thread is freed when the thread exits, and only
+     * the latest `RING_SIZE` events of all exited threads are kept. To stream events, pass the timestamp
+     * of the last event from the previous call.
+     *
+     * @param[out] events_out Events.
+     * @param since_ns Only the events after this timestamp are returned.
+     */
+    static void dump(std::vector<trace_event>& events_out,
+                     uint64_t since_ns = 0);
+
+    /**
+     * Discard all recorded events.
+     */
+    static void clear();
+
+    /**
+     * Save the given events to a binary file.
+     *
+     * @return `true` on success.
+     */
+    static bool save(const std::string& path,
+                     const std::vector<trace_event>& events);
+
+    /**
+     * Load events from the binary file written by `save`.
+     *
+     * @return `true` on success.
+     */
+    static bool load(const std::string& path,
+                     std::vector<trace_event>& events_out);
+
+    /**
+     * Convert the given events into Chrome trace (JSON) format,
+     * that can be opened by `chrome://tracing` or Perfetto.
+     * Each server is shown as a process, and each thread as a thread.
+     *
+     * @return JSON string.
+     */
+    static std::string to_chrome_trace(const std::vector<trace_event>& events);
+
+    /**
+     * Get the name of the given event.
+     */
+    static const char* event_name(uint16_t event_id);
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+}
+
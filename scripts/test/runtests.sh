@@ -5,7 +5,15 @@ set -e
 ./tests/serialization_test --abort-on-failure
 ./tests/timer_test --abort-on-failure
 ./tests/strfmt_test --abort-on-failure
+./tests/crc32_test --abort-on-failure
 ./tests/stat_mgr_test --abort-on-failure
+./tests/trace_events_test --abort-on-failure
+./tests/term_index_test --abort-on-failure
+./tests/async_logger_test --abort-on-failure
+./tests/segmented_log_store_test --abort-on-failure
 ./tests/raft_server_test --abort-on-failure
 ./tests/failure_test --abort-on-failure
 ./tests/asio_service_test --abort-on-failure
+if [ -x ./tests/cmd_result_coroutine_test ]; then
+    ./tests/cmd_result_coroutine_test --abort-on-failure
+fi
@@ -28,23 +28,30 @@ limitations under the License.
 #include "asio_service.hxx"
 
 #include "buffer_serializer.hxx"
+#include "compressor.hxx"
 #include "crc32.hxx"
 #include "internal_timer.hxx"
+#include "raft_group_dispatcher.hxx"
 #include "rpc_listener.hxx"
 #include "raft_server.hxx"
+#include "stat_mgr.hxx"
 #include "strfmt.hxx"
+#include "timer_wheel.hxx"
 #include "tracer.hxx"
 
 #include "asio.hpp"
 
 #include <atomic>
+#include <cstring>
 #include <ctime>
 #include <exception>
 #include <fstream>
 #include <list>
+#include <mutex>
 #include <queue>
 #include <thread>
 #include <regex>
+#include <unordered_map>
 
 #ifdef USE_BOOST_ASIO
     using namespace boost;
@@ -53,6 +60,15 @@ limitations under the License.
     #define ERROR_CODE asio::error_code
 #endif
 
+#if defined(ASIO_HAS_LOCAL_SOCKETS) || defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    #define LOCAL_SOCKETS_SUPPORTED (1)
+    #include <unistd.h>
+#endif
+
+// Stream socket and endpoint of either TCP or Unix domain socket.
+using stream_socket = asio::generic::stream_protocol::socket;
+using stream_endpoint = asio::generic::stream_protocol::endpoint;
+
 //#define SSL_LIBRARY_NOT_FOUND (1)
 #ifdef SSL_LIBRARY_NOT_FOUND
     #include "mock_ssl.hxx"
@@ -60,7 +76,7 @@ limitations under the License.
     using ssl_context = mock_ssl_context;
 #else
     #include "asio/ssl.hpp"
-    using ssl_socket = asio::ssl::stream<asio::ip::tcp::socket&>;
+    using ssl_socket = asio::ssl::stream<stream_socket&>;
     using ssl_context = asio::ssl::context;
 #endif
 
@@ -107,6 +123,61 @@ limitations under the License.
 // If set, RPC message (response) includes additional hints.
 #define INCLUDE_HINT (0x2)
 
+// If set, CRC of the header is CRC32C, instead of CRC32.
+// Response uses the same CRC as its request.
+#define CRC32C_HEADER (0x4)
+
+// If set, each log entry (request) carries the CRC32C of its payload,
+// next to its size.
+#define INCLUDE_LOG_CRC (0x8)
+
+// If set, RPC message (request) carries the 4-byte ID of the Raft group
+// it belongs to, at the beginning of the data (before meta).
+#define INCLUDE_GROUP_ID (0x10)
+
+// If set, RPC message carries heartbeats of multiple Raft groups
+// (or their responses), instead of a single request:
+//   request data:
+//     int32        number of heartbeats (4),
+//     {
+//       int32      group ID            (4),
+//       ulong      term                (8),
+//       ulong      last_log_term       (8),
+//       ulong      last_log_idx        (8),
+//       ulong      commit_idx          (8),
+//     } * number of heartbeats
+//   response data:
+//     int32        number of responses (4),
+//     {
+//       msg_type   type                (1),
+//       int32      src                 (4),
+//       int32      dst                 (4),
+//       ulong      term                (8),
+//       ulong      next_idx            (8),
+//       bool       accepted            (1),
+//     } * number of responses
+#define HEARTBEAT_BATCH (0x20)
+
+// If set, the data section of RPC message (request) is compressed:
+//     byte         codec               (1),
+//     int32        original data size  (4),
+//     byte[]       compressed data,
+// and the original data consists of group ID, meta, and log entries
+// as usual.
+#define COMPRESSED_DATA (0x40)
+
+// Codec (`asio_service_options::compression_type`) used by the sender
+// of RPC message. In a request, it means that the client wants to
+// compress requests using the codec. In a response, it means that the
+// server supports the codec, so that the client can start compressing.
+#define COMPRESSION_CODEC_SHIFT (8)
+#define COMPRESSION_CODEC_MASK (0xf00)
+
+#define COMPRESSED_DATA_HEADER_SIZE (1 + 4)
+
+#define HB_BATCH_REQ_SIZE (4 + 8*4)
+#define HB_BATCH_RESP_SIZE (4*2 + 8*2 + 1*2)
+
 // =======================
 
 namespace nuraft {
@@ -115,6 +186,15 @@ static const size_t SSL_GRACE_PERIOD_MS = 500;
 static const size_t SEND_RETRY_MS       = 500;
 static const size_t SEND_RETRY_MAX      = 6;
 
+// Group ID for the requests not belonging to any group.
+static const int32 NO_GROUP_ID          = -1;
+
+// Header CRC, using CRC32C if the peer negotiated it.
+static uint32_t calc_header_crc(uint32_t flags, const void* data, size_t len) {
+    if (flags & CRC32C_HEADER) return crc32c(data, len, 0);
+    return crc32_8(data, len, 0);
+}
+
 asio_service::meta_cb_params req_to_params(ptr<req_msg>& req) {
     return asio_service::meta_cb_params
            ( (int)req->get_type(),
@@ -126,6 +206,67 @@ asio_service::meta_cb_params req_to_params(ptr<req_msg>& req) {
              req->get_commit_idx() );
 }
 
+// Prefix of Unix domain socket endpoints, followed by the path.
+static const char* UNIX_SOCKET_PREFIX = "unix://";
+
+static bool parse_endpoint(const std::string& endpoint,
+                           std::string& hostname,
+                           std::string& port)
+{
+    // NOTE:
+    //   Abandoned regular expression due to bug in GCC < 4.9.
+    //   And also support `endpoint` which doesn't start with `tcp://`.
+#if 0
+    // the endpoint is expecting to be protocol://host:port,
+    // and we only support tcp for this factory
+    // which is endpoint must be tcp://hostname:port
+    static std::regex reg("^tcp://(([a-zA-Z0-9\\-]+\\.)*([a-zA-Z0-9]+)):([0-9]+)$");
+    std::smatch mresults;
+    if (!std::regex_match(endpoint, mresults, reg) || mresults.size() != 5) {
+        return false;
+    }
+#endif
+    if (endpoint.compare(0, strlen(UNIX_SOCKET_PREFIX), UNIX_SOCKET_PREFIX) == 0) {
+        // Unix domain socket: the path as `hostname`, without port.
+        hostname = endpoint.substr(strlen(UNIX_SOCKET_PREFIX));
+        port.clear();
+        return !hostname.empty();
+    }
+
+    bool valid_address = false;
+    size_t pos = endpoint.rfind(":");
+    do {
+        if (pos == std::string::npos) break;
+        int port_num = std::stoi( endpoint.substr(pos + 1) );
+        if (!port_num) break;
+        port = std::to_string( port_num );
+
+        size_t pos2 = endpoint.rfind("://", pos - 1);
+        hostname = (pos2 == std::string::npos)
+                   ? endpoint.substr(0, pos)
+                   : endpoint.substr(pos2 + 3, pos - pos2 - 3);
+
+        if (hostname.empty()) break;
+        valid_address = true;
+
+    } while (false);
+
+    return valid_address;
+}
+
+// Printable address of the given endpoint.
+static std::string endpoint_to_str(const stream_endpoint& ep) {
+    int family = ep.protocol().family();
+    if (family == AF_INET || family == AF_INET6) {
+        asio::ip::tcp::endpoint tcp_ep;
+        memcpy(tcp_ep.data(), ep.data(), ep.size());
+        tcp_ep.resize(ep.size());
+        return tcp_ep.address().to_string() + ":" +
+               std::to_string(tcp_ep.port());
+    }
+    return "local";
+}
+
 // === ASIO Abstraction ===
 //     (to switch SSL <-> unsecure on-the-fly)
 class aa {
@@ -133,7 +274,7 @@ public:
     template<typename BB, typename FF>
     static void write(bool is_ssl,
                       ssl_socket& _ssl_socket,
-                      asio::ip::tcp::socket& tcp_socket,
+                      stream_socket& tcp_socket,
                       const BB& buffer,
                       FF func)
     {
@@ -144,7 +285,7 @@ public:
     template<typename BB, typename FF>
     static void read(bool is_ssl,
                      ssl_socket& _ssl_socket,
-                     asio::ip::tcp::socket& tcp_socket,
+                     stream_socket& tcp_socket,
                      const BB& buffer,
                      FF func)
     {
@@ -153,6 +294,8 @@ public:
     }
 };
 
+class asio_rpc_client;
+
 // asio service implementation
 class asio_service_impl {
 public:
@@ -163,6 +306,34 @@ public:
     const asio_service::options& get_options() const { return my_opt_; }
     asio::io_service& get_io_svc() { return io_svc_; }
 
+    // Get the io_service that the given session or client (identified
+    // by `hash`) should be pinned to. If `io_context_per_worker_` is not
+    // set, it is always the same as `get_io_svc()`.
+    asio::io_service& get_io_svc(size_t hash) {
+        if (io_shards_.size() <= 1) return io_svc_;
+        return *io_shards_[hash % io_shards_.size()];
+    }
+
+    // Get the client connected to the given endpoint shared by
+    // multiple Raft groups, or create a new one if not exists.
+    ptr<asio_rpc_client> get_shared_client(const std::string& host,
+                                           const std::string& port,
+                                           ptr<logger>& l);
+
+#ifndef SSL_LIBRARY_NOT_FOUND
+    // Set the cached TLS session to the given endpoint (if exists)
+    // to the SSL object, so as to resume it by the next handshake.
+    void load_ssl_session(const std::string& endpoint, SSL* ssl);
+
+    // Cache the TLS session to the given endpoint,
+    // replacing the existing one. Takes the ownership of `sess`,
+    // which should not be shared with any connection.
+    void store_ssl_session(const std::string& endpoint, SSL_SESSION* sess);
+
+    // Forget the cached TLS session to the given endpoint.
+    void drop_ssl_session(const std::string& endpoint);
+#endif
+
 private:
 #ifndef SSL_LIBRARY_NOT_FOUND
     std::string get_password(std::size_t size,
@@ -170,13 +341,33 @@ private:
 #endif
     void stop();
     void worker_entry();
+    void set_worker_affinity(uint32_t worker_id);
     void timer_handler(ERROR_CODE err);
+    void start_wheel_timer();
+    void wheel_timer_handler(ERROR_CODE err);
+    void start_metrics_endpoint();
+    void accept_metrics();
 
 private:
     asio::io_service io_svc_;
+    // Additional io_services, one per worker except for the first one,
+    // if `io_context_per_worker_` is set.
+    std::vector< ptr<asio::io_service> > extra_io_svcs_;
+    // Prevent workers of `extra_io_svcs_` from returning when idle.
+    std::vector< ptr<asio::io_service::work> > extra_io_works_;
+    // All io_services, including `io_svc_` as the first one.
+    std::vector<asio::io_service*> io_shards_;
     ssl_context ssl_server_ctx_;
     ssl_context ssl_client_ctx_;
     asio::steady_timer asio_timer_;
+    // Timer wheel for `delayed_task`s, `nullptr` if not enabled.
+    ptr<timer_wheel> timer_wheel_;
+    // Timer driving `timer_wheel_`.
+    asio::steady_timer wheel_timer_;
+    // Expected time of the next tick of `timer_wheel_`.
+    std::chrono::steady_clock::time_point next_wheel_tick_;
+    // Acceptor of the HTTP metrics endpoint, `nullptr` if not enabled.
+    ptr<asio::ip::tcp::acceptor> metrics_acceptor_;
     std::atomic_int continue_;
     std::mutex logger_list_lock_;
     std::atomic<uint8_t> stopping_status_;
@@ -186,6 +377,14 @@ private:
     std::atomic<uint32_t> worker_id_;
     std::list< ptr<std::thread> > worker_handles_;
     asio_service::options my_opt_;
+    std::mutex shared_clients_lock_;
+    std::unordered_map< std::string,
+                        std::weak_ptr<asio_rpc_client> > shared_clients_;
+#ifndef SSL_LIBRARY_NOT_FOUND
+    // Cached TLS sessions, key: `host:port`.
+    std::mutex ssl_sessions_lock_;
+    std::unordered_map<std::string, SSL_SESSION*> ssl_sessions_;
+#endif
     ptr<logger> l_;
     friend asio_service;
 };
@@ -202,11 +401,14 @@ public:
                  ssl_context& ssl_ctx,
                  bool _enable_ssl,
                  ptr<msg_handler>& handler,
+                 ptr<raft_group_dispatcher>& dispatcher,
                  ptr<logger>& logger,
                  session_closed_callback& callback )
         : session_id_(id)
         , impl_(_impl)
+        , io_svc_(io)
         , handler_(handler)
+        , dispatcher_(dispatcher)
         , socket_(io)
         , ssl_socket_(socket_, ssl_ctx)
         , ssl_enabled_(_enable_ssl)
@@ -215,6 +417,8 @@ public:
         , header_(buffer::alloc(RPC_REQ_HEADER_SIZE))
         , l_(logger)
         , callback_(callback)
+        , writing_resp_(false)
+        , read_paused_(false)
     {
         p_tr("asio rpc session created: %p", this);
     }
@@ -232,10 +436,10 @@ public:
         // this is safe since we only expose ctor to cs_new
         ptr<rpc_session> self = this->shared_from_this();
 
-        p_in( "session %zu got connection from %s:%u (as a server)",
-              session_id_,
-              socket_.remote_endpoint().address().to_string().c_str(),
-              socket_.remote_endpoint().port() );
+        ERROR_CODE ec;
+        peer_addr_ = endpoint_to_str( socket_.remote_endpoint(ec) );
+        p_in( "session %zu got connection from %s (as a server)",
+              session_id_, peer_addr_.c_str() );
 
         if (ssl_enabled_) {
 #ifdef SSL_LIBRARY_NOT_FOUND
@@ -256,22 +460,17 @@ public:
     void handle_handshake(ptr<rpc_session> self,
                           const ERROR_CODE& err) {
         if (!err) {
-            p_in( "session %zu handshake with %s:%u succeeded (as a server)",
-                  session_id_,
-                  socket_.remote_endpoint().address().to_string().c_str(),
-                  socket_.remote_endpoint().port() );
+            p_in( "session %zu handshake with %s succeeded (as a server)",
+                  session_id_, peer_addr_.c_str() );
             this->start(self);
 
         } else {
-            p_er( "session %zu handshake with %s:%u failed: error %d",
-                  session_id_,
-                  socket_.remote_endpoint().address().to_string().c_str(),
-                  socket_.remote_endpoint().port(),
-                  err.value() );
+            p_er( "session %zu handshake with %s failed: error %d",
+                  session_id_, peer_addr_.c_str(), err.value() );
 
             // Lazy stop.
             ptr<asio::steady_timer> timer =
-                cs_new<asio::steady_timer>(impl_->get_io_svc());
+                cs_new<asio::steady_timer>(io_svc_);
             timer->expires_after
                    ( std::chrono::duration_cast<std::chrono::nanoseconds>
                      ( std::chrono::milliseconds( SSL_GRACE_PERIOD_MS ) ) );
@@ -297,12 +496,9 @@ public:
                   (const ERROR_CODE& err, size_t) -> void
         {
             if (err) {
-                p_er( "session %zu failed to read rpc header from socket %s:%u "
+                p_er( "session %zu failed to read rpc header from socket %s "
                       "due to error %d",
-                      session_id_,
-                      socket_.remote_endpoint().address().to_string().c_str(),
-                      socket_.remote_endpoint().port(),
-                      err.value() );
+                      session_id_, peer_addr_.c_str(), err.value() );
                 this->stop();
                 return;
             }
@@ -310,17 +506,18 @@ public:
             // NOTE:
             //  due to async_read() above, header_ size will be always
             //  equal to or greater than RPC_REQ_HEADER_SIZE.
-            header_->pos(0);
-            byte* header_data = header_->data();
-            uint32_t crc_local = crc32_8( header_data,
-                                          RPC_REQ_HEADER_SIZE - CRC_FLAGS_LEN,
-                                          0 );
-
             header_->pos(RPC_REQ_HEADER_SIZE - CRC_FLAGS_LEN);
             uint64_t flags_and_crc = header_->get_ulong();
             uint32_t crc_hdr = flags_and_crc & (uint32_t)0xffffffff;
             flags_ = (flags_and_crc >> 32);
 
+            header_->pos(0);
+            byte* header_data = header_->data();
+            uint32_t crc_local = calc_header_crc
+                                 ( flags_,
+                                   header_data,
+                                   RPC_REQ_HEADER_SIZE - CRC_FLAGS_LEN );
+
             // Verify CRC.
             if (crc_local != crc_hdr) {
                 p_er("CRC mismatch: local calculation %x, from header %x",
@@ -374,6 +571,7 @@ public:
             callback_(this->shared_from_this());
         }
         handler_.reset();
+        dispatcher_.reset();
     }
 
     ssl_socket::lowest_layer_type& socket() {
@@ -399,6 +597,13 @@ private:
                        const ERROR_CODE& err,
                        size_t bytes_read) {
         if (!err) {
+            if (flags_ & COMPRESSED_DATA) {
+                log_ctx = decompress_log_data(log_ctx);
+                if (!log_ctx) {
+                    this->stop();
+                    return;
+                }
+            }
             this->read_complete(header_, log_ctx);
         } else {
             p_er( "session %zu failed to read rpc log data from socket due "
@@ -409,6 +614,41 @@ private:
         }
     }
 
+    ptr<buffer> decompress_log_data(ptr<buffer>& comp_buf) {
+        static stat_elem& decomp_lat = *stat_mgr::get_instance()->create_stat
+            (stat_elem::HISTOGRAM, "asio_decompress_time_us");
+
+        if (comp_buf->size() < COMPRESSED_DATA_HEADER_SIZE) {
+            p_er("session %zu got too small compressed data %zu",
+                 session_id_, comp_buf->size());
+            return nullptr;
+        }
+        buffer_serializer bs(comp_buf);
+        compressor::codec codec = (compressor::codec)bs.get_u8();
+        int32 raw_size = bs.get_i32();
+        // Up to 1GB, the same as the data size in the header.
+        if (raw_size < 0 || raw_size > 0x40000000) {
+            p_er("session %zu got bad original data size %d",
+                 session_id_, raw_size);
+            return nullptr;
+        }
+
+        uint64_t start_us = stat_now_us();
+        ptr<buffer> raw_buf = compressor::decompress
+                              ( codec,
+                                comp_buf->data_begin() + bs.pos(),
+                                comp_buf->size() - bs.pos(),
+                                raw_size );
+        if (!raw_buf) {
+            p_er("session %zu failed to decompress data of %zu bytes "
+                 "with codec %d, original size %d",
+                 session_id_, comp_buf->size(), (int)codec, raw_size);
+            return nullptr;
+        }
+        decomp_lat += stat_now_us() - start_us;
+        return raw_buf;
+    }
+
     void read_complete(ptr<buffer> hdr, ptr<buffer> log_ctx) {
         ptr<rpc_session> self = this->shared_from_this();
 
@@ -422,12 +662,29 @@ private:
         ulong last_idx = hdr->get_ulong();
         ulong commit_idx = hdr->get_ulong();
 
+        if (flags_ & HEARTBEAT_BATCH) {
+            this->process_hb_batch(src, dst, log_ctx);
+            return;
+        }
+
         std::string meta_str;
+        int32 group_id = NO_GROUP_ID;
         ptr<req_msg> req = cs_new<req_msg>
                            ( term, t, src, dst, last_term, last_idx, commit_idx );
         if (hdr->get_int() > 0 && log_ctx) {
             log_ctx->pos(0);
-            // If flag is set, read meta first.
+            // If flag is set, read group ID first.
+            if (flags_ & INCLUDE_GROUP_ID) {
+                if (log_ctx->size() < sz_int) {
+                    p_wn("wrong log ctx size %zu for group ID, "
+                         "stop this session", log_ctx->size());
+                    this->stop();
+                    return;
+                }
+                group_id = log_ctx->get_int();
+            }
+
+            // And then meta.
             if (flags_ & INCLUDE_META) {
                 size_t meta_len = 0;
                 const byte* meta_raw = log_ctx->get_bytes(meta_len);
@@ -436,8 +693,11 @@ private:
                 }
             }
 
+            bool has_log_crc = (flags_ & INCLUDE_LOG_CRC);
+            size_t entry_hdr_size = sz_ulong + sz_byte + sz_int +
+                                    (has_log_crc ? sz_int : 0);
             while (log_ctx->size() > log_ctx->pos()) {
-                if (log_ctx->size() - log_ctx->pos() < sz_ulong + sz_byte + sz_int) {
+                if (log_ctx->size() - log_ctx->pos() < entry_hdr_size) {
                     // Possibly corrupted packet. Stop here.
                     p_wn("wrong log ctx size %zu pos %zu, stop this session",
                          log_ctx->size(), log_ctx->pos());
@@ -447,6 +707,7 @@ private:
                 ulong term = log_ctx->get_ulong();
                 log_val_type val_type = (log_val_type)log_ctx->get_byte();
                 size_t val_size = log_ctx->get_int();
+                uint32_t crc_hdr = has_log_crc ? (uint32_t)log_ctx->get_int() : 0;
                 if (log_ctx->size() - log_ctx->pos() < val_size) {
                     // Out-of-bound size.
                     p_wn("wrong value size %zu log ctx %zu %zu, "
@@ -456,9 +717,35 @@ private:
                     return;
                 }
 
-                ptr<buffer> buf( buffer::alloc(val_size) );
-                log_ctx->get(buf);
-                ptr<log_entry> entry( cs_new<log_entry>(term, buf, val_type) );
+                if (has_log_crc) {
+                    uint32_t crc_local = crc32c( log_ctx->data(), val_size, 0 );
+                    if (crc_local != crc_hdr) {
+                        p_er( "log CRC mismatch: local calculation %x, "
+                              "from header %x, stop this session",
+                              crc_local, crc_hdr );
+                        this->stop();
+                        return;
+                    }
+                }
+
+                ptr<log_entry> entry;
+                if (impl_->get_options().zero_copy_log_receive_) {
+                    // Term, type, and size are already read, so that
+                    // their space can be used for the meta section.
+                    ptr<buffer> buf = buffer::view_in_place
+                                      ( log_ctx, log_ctx->pos(), val_size );
+                    log_ctx->pos(log_ctx->pos() + val_size);
+                    entry = cs_new<log_entry>(term, buf, val_type);
+                } else if (impl_->get_options().compact_log_entries_) {
+                    entry = log_entry::make_compact
+                            ( term, log_ctx->data(), val_size, val_type );
+                    log_ctx->pos(log_ctx->pos() + val_size);
+                } else {
+                    ptr<buffer> buf = buffer::alloc(val_size);
+                    log_ctx->get(buf);
+                    entry = cs_new<log_entry>(term, buf, val_type);
+                }
+                if (has_log_crc) entry->set_crc32(crc_hdr);
                 req->log_entries().push_back(entry);
             }
         }
@@ -475,23 +762,92 @@ private:
             }
         }
 
+        ptr<msg_handler> handler = handler_;
+        if (flags_ & INCLUDE_GROUP_ID) {
+            handler = dispatcher_ ? dispatcher_->get_server(group_id) : nullptr;
+            if (!handler) {
+                // Responses should be returned in order, and there is
+                // no way to skip this request.
+                p_er("session %zu got request for unknown group %d, "
+                     "stop this session", session_id_, group_id);
+                this->stop();
+                return;
+            }
+        } else if (!handler) {
+            p_er("session %zu got request without group ID, but "
+                 "no default handler exists, stop this session",
+                 session_id_);
+            this->stop();
+            return;
+        }
+
         // === RAFT server processes the request here. ===
-        ptr<resp_msg> resp = handler_->process_req(*req);
+        ptr<resp_msg> resp = handler->process_req(*req);
         if (!resp) {
             p_wn("no response is returned from raft message handler");
             this->stop();
             return;
         }
 
-        if (resp->has_cb()) {
-            // If callback function exists, get new response message.
-            resp = resp->call_cb(resp);
+        if (resp->has_cb() || resp->is_deferred()) {
+            // The response is not ready yet (e.g., a follower waits for
+            // its logs to be durable). It will be completed in background,
+            // and the next request can be read in the meantime.
+            ptr<pending_resp> pr = cs_new<pending_resp>();
+            if (resp->is_deferred()) pr->deferred_.push_back(resp);
+            uint32_t req_flags = flags_;
+            pr->make_buf_ = [this, req, resp, req_flags]() -> ptr<buffer> {
+                ptr<resp_msg> rr = resp;
+                ptr<req_msg> qq = req;
+                if (rr->has_cb()) rr = rr->call_cb(rr);
+                return make_resp_buf(qq, rr, req_flags);
+            };
+            this->defer_resp(pr);
+            return;
         }
 
+        ptr<buffer> resp_buf = make_resp_buf(req, resp, flags_);
+        this->write_resp(resp_buf);
+
+       } catch (std::exception& ex) {
+        p_er( "session %zu failed to process request message "
+              "due to error: %s",
+              this->session_id_,
+              ex.what() );
+        this->stop();
+       }
+    }
+
+    struct pending_resp {
+        pending_resp() : num_waits_(0), failed_(false), cb_started_(false) {}
+        // Deferred responses that should be ready before `make_buf_`.
+        std::vector< ptr<resp_msg> > deferred_;
+        // Serializes the response, invoking its callback if any.
+        std::function< ptr<buffer>() > make_buf_;
+        // Number of deferred responses not ready yet.
+        std::atomic<size_t> num_waits_;
+        // `true` if any deferred response could not be completed.
+        std::atomic<bool> failed_;
+        // Serialized response, ready to be sent.
+        ptr<buffer> buf_;
+        bool cb_started_;
+    };
+
+    ptr<buffer> make_resp_buf(ptr<req_msg>& req,
+                              ptr<resp_msg>& resp,
+                              uint32_t req_flags) {
         ptr<buffer> resp_ctx = resp->get_ctx();
         int32 resp_ctx_size = (resp_ctx) ? resp_ctx->size() : 0;
 
-        uint32_t flags = 0x0;
+        // Use the same CRC as the request.
+        uint32_t flags = req_flags & CRC32C_HEADER;
+        compressor::codec req_codec =
+            (compressor::codec)
+            ( (req_flags & COMPRESSION_CODEC_MASK) >> COMPRESSION_CODEC_SHIFT );
+        if (compressor::is_available(req_codec)) {
+            // Let the client know that it can compress requests.
+            flags |= (req_flags & COMPRESSION_CODEC_MASK);
+        }
         size_t resp_meta_size = 0;
         std::string resp_meta_str;
         if (impl_->get_options().write_resp_meta_) {
@@ -529,9 +885,9 @@ private:
         bs.put_i32(carried_data_size);
 
         // Calculate CRC32 on header only.
-        uint32_t crc_val = crc32_8( resp_buf->data_begin(),
-                                    RPC_RESP_HEADER_SIZE - CRC_FLAGS_LEN,
-                                    0 );
+        uint32_t crc_val = calc_header_crc( flags,
+                                            resp_buf->data_begin(),
+                                            RPC_RESP_HEADER_SIZE - CRC_FLAGS_LEN );
 
         uint64_t flags_crc = ((uint64_t)flags << 32) | crc_val;
         bs.put_u64(flags_crc);
@@ -552,46 +908,289 @@ private:
             resp_ctx->pos(0);
             bs.put_buffer(*resp_ctx);
         }
+        return resp_buf;
+    }
+
+    // Process heartbeats of multiple groups, and respond to them
+    // at once in the same order.
+    void process_hb_batch(int32 src, int32 dst, ptr<buffer> log_ctx) {
+        if (!log_ctx || log_ctx->size() < sz_int) {
+            p_wn("wrong heartbeat batch, stop this session");
+            this->stop();
+            return;
+        }
+        log_ctx->pos(0);
+        int32 num_hbs = log_ctx->get_int();
+        if ( num_hbs < 0 ||
+             log_ctx->size() != sz_int + (size_t)num_hbs * HB_BATCH_REQ_SIZE ) {
+            p_wn("wrong heartbeat batch size %zu, count %d, "
+                 "stop this session", log_ctx->size(), num_hbs);
+            this->stop();
+            return;
+        }
+
+        std::vector< ptr<resp_msg> > resps;
+        resps.reserve(num_hbs);
+        ptr<pending_resp> pr = cs_new<pending_resp>();
+        for (int32 ii = 0; ii < num_hbs; ++ii) {
+            int32 group_id = log_ctx->get_int();
+            ulong term = log_ctx->get_ulong();
+            ulong last_term = log_ctx->get_ulong();
+            ulong last_idx = log_ctx->get_ulong();
+            ulong commit_idx = log_ctx->get_ulong();
+
+            ptr<msg_handler> handler =
+                dispatcher_ ? dispatcher_->get_server(group_id) : nullptr;
+            if (!handler) {
+                p_er("session %zu got heartbeat for unknown group %d, "
+                     "stop this session", session_id_, group_id);
+                this->stop();
+                return;
+            }
+
+            ptr<req_msg> req = cs_new<req_msg>
+                               ( term, msg_type::append_entries_request,
+                                 src, dst, last_term, last_idx, commit_idx );
+            if ( impl_->get_options().read_req_meta_ &&
+                 impl_->get_options().invoke_req_cb_on_empty_meta_ ) {
+                if ( !impl_->get_options().read_req_meta_
+                      ( req_to_params(req), std::string() ) ) {
+                    this->stop();
+                    return;
+                }
+            }
+
+            ptr<resp_msg> resp = handler->process_req(*req);
+            if (!resp) {
+                p_wn("no response is returned from raft message handler");
+                this->stop();
+                return;
+            }
+            if (resp->has_cb()) {
+                resp = resp->call_cb(resp);
+            }
+            if (resp->is_deferred()) {
+                pr->deferred_.push_back(resp);
+            }
+            resps.push_back(resp);
+        }
+
+        uint32_t req_flags = flags_;
+        if (!pr->deferred_.empty()) {
+            // Respond to all heartbeats at once, after the deferred
+            // responses (of any group) are ready.
+            pr->make_buf_ = [this, src, dst, req_flags, resps]() -> ptr<buffer> {
+                return make_hb_batch_resp_buf(src, dst, req_flags, resps);
+            };
+            this->defer_resp(pr);
+            return;
+        }
+
+        ptr<buffer> resp_buf = make_hb_batch_resp_buf(src, dst, req_flags, resps);
+        this->write_resp(resp_buf);
+    }
+
+    ptr<buffer> make_hb_batch_resp_buf(int32 src,
+                                       int32 dst,
+                                       uint32_t req_flags,
+                                       const std::vector< ptr<resp_msg> >& resps)
+    {
+        int32 num_hbs = resps.size();
+        size_t carried_data_size = sz_int + (size_t)num_hbs * HB_BATCH_RESP_SIZE;
+        ptr<buffer> resp_buf =
+            buffer::alloc(RPC_RESP_HEADER_SIZE + carried_data_size);
+        buffer_serializer bs(resp_buf);
+        bs.pos(RPC_RESP_HEADER_SIZE);
+        bs.put_i32(num_hbs);
+
+        for (const ptr<resp_msg>& resp: resps) {
+            // Context and hint are not delivered for heartbeats.
+            bs.put_u8(resp->get_type());
+            bs.put_i32(resp->get_src());
+            bs.put_i32(resp->get_dst());
+            bs.put_u64(resp->get_term());
+            bs.put_u64(resp->get_next_idx());
+            bs.put_u8(resp->get_accepted());
+        }
+
+        uint32_t flags = (req_flags & CRC32C_HEADER) | HEARTBEAT_BATCH;
+        bs.pos(0);
+        const byte RESP_MARKER = 0x1;
+        bs.put_u8(RESP_MARKER);
+        bs.put_u8(msg_type::append_entries_response);
+        bs.put_i32(dst);
+        bs.put_i32(src);
+        bs.put_u64(0);
+        bs.put_u64(0);
+        bs.put_u8(1);
+        bs.put_i32(carried_data_size);
+
+        uint32_t crc_val = calc_header_crc( flags,
+                                            resp_buf->data_begin(),
+                                            RPC_RESP_HEADER_SIZE - CRC_FLAGS_LEN );
+        uint64_t flags_crc = ((uint64_t)flags << 32) | crc_val;
+        bs.put_u64(flags_crc);
+        return resp_buf;
+    }
+
+    void write_resp(ptr<buffer>& resp_buf) {
+        ptr<rpc_session> self = this->shared_from_this();
+        ptr<pending_resp> pr = cs_new<pending_resp>();
+        pr->buf_ = resp_buf;
+        {   std::lock_guard<std::mutex> l(resp_queue_lock_);
+            resp_queue_.push_back(pr);
+            // Read the next request once all responses are sent.
+            read_paused_ = true;
+        }
+        this->flush_resp_queue(self);
+    }
+
+    void defer_resp(ptr<pending_resp>& pr) {
+        ptr<rpc_session> self = this->shared_from_this();
+        bool read_ahead = false;
+        {   std::lock_guard<std::mutex> l(resp_queue_lock_);
+            // Read ahead only one request beyond a deferred response,
+            // to bound the number of requests being processed.
+            read_ahead = resp_queue_.empty();
+            if (!read_ahead) read_paused_ = true;
+            resp_queue_.push_back(pr);
+        }
+        if (read_ahead) this->start(self);
+        this->flush_resp_queue(self);
+    }
+
+    void wait_for_deferred_resp(ptr<rpc_session> self, ptr<pending_resp> pr) {
+        if (pr->deferred_.empty()) {
+            io_svc_.post( std::bind( &rpc_session::complete_deferred_resp,
+                                     this,
+                                     self,
+                                     pr ) );
+            return;
+        }
+
+        // Do not block here, the last ready one will post the completion.
+        pr->num_waits_ = pr->deferred_.size();
+        for (ptr<resp_msg>& resp: pr->deferred_) {
+            resp->when_ready( [this, self, pr](bool ok) {
+                if (!ok) pr->failed_ = true;
+                if (pr->num_waits_.fetch_sub(1) != 1) return;
+                io_svc_.post( std::bind( &rpc_session::complete_deferred_resp,
+                                         this,
+                                         self,
+                                         pr ) );
+            } );
+        }
+    }
+
+    void complete_deferred_resp(ptr<rpc_session> self, ptr<pending_resp> pr) {
+        if (pr->failed_) {
+            p_wn( "session %zu failed to complete deferred response, "
+                  "stop this session", this->session_id_ );
+            this->stop();
+            return;
+        }
+
+        ptr<buffer> resp_buf;
+       try {
+        resp_buf = pr->make_buf_();
+       } catch (std::exception& ex) {
+        p_er( "session %zu failed to complete deferred response "
+              "due to error: %s",
+              this->session_id_,
+              ex.what() );
+        this->stop();
+        return;
+       }
+
+        {   std::lock_guard<std::mutex> l(resp_queue_lock_);
+            pr->buf_ = resp_buf;
+        }
+        this->flush_resp_queue(self);
+    }
+
+    // Send responses in the order of requests. The first one in the
+    // queue is either being written, or being completed in background.
+    void flush_resp_queue(ptr<rpc_session> self) {
+        ptr<buffer> to_write;
+        ptr<pending_resp> to_complete;
+        bool resume_read = false;
+        {   std::lock_guard<std::mutex> l(resp_queue_lock_);
+            if (writing_resp_) return;
+            if (resp_queue_.empty()) {
+                resume_read = read_paused_;
+                read_paused_ = false;
+            } else {
+                ptr<pending_resp>& front = resp_queue_.front();
+                if (front->buf_) {
+                    writing_resp_ = true;
+                    to_write = front->buf_;
+                } else if (!front->cb_started_) {
+                    front->cb_started_ = true;
+                    to_complete = front;
+                }
+            }
+        }
+
+        if (resume_read) {
+            this->start(self);
+            return;
+        }
+        if (to_complete) {
+            this->wait_for_deferred_resp(self, to_complete);
+            return;
+        }
+        if (!to_write) return;
 
         aa::write( ssl_enabled_, ssl_socket_, socket_,
-                   asio::buffer(resp_buf->data_begin(), resp_buf->size()),
-                   [this, self, resp_buf]
+                   asio::buffer(to_write->data_begin(), to_write->size()),
+                   [this, self, to_write]
                    (ERROR_CODE err_code, size_t) -> void
         {
-            // To avoid releasing `resp_buf` before the write is done.
-            (void)resp_buf;
-            if (!err_code) {
-                this->start(self);
-            } else {
+            // To avoid releasing `to_write` before the write is done.
+            (void)to_write;
+            if (err_code) {
                 p_er( "session %zu failed to send response to peer due "
                       "to error %d",
                       session_id_,
                       err_code.value() );
                 this->stop();
+                return;
+            }
+            {   std::lock_guard<std::mutex> l(resp_queue_lock_);
+                resp_queue_.pop_front();
+                writing_resp_ = false;
             }
+            this->flush_resp_queue(self);
         } );
-
-       } catch (std::exception& ex) {
-        p_er( "session %zu failed to process request message "
-              "due to error: %s",
-              this->session_id_,
-              ex.what() );
-        this->stop();
-       }
     }
 
 private:
     uint64_t session_id_;
     asio_service_impl* impl_;
+    asio::io_service& io_svc_;
     ptr<msg_handler> handler_;
-    asio::ip::tcp::socket socket_;
+    ptr<raft_group_dispatcher> dispatcher_;
+    stream_socket socket_;
     ssl_socket ssl_socket_;
+    // Address of the peer, for logging.
+    std::string peer_addr_;
     bool ssl_enabled_;
     uint32_t flags_;
     ptr<buffer> log_data_;
     ptr<buffer> header_;
     ptr<logger> l_;
     session_closed_callback callback_;
+
+    // Responses to be sent, in the order of requests.
+    std::list< ptr<pending_resp> > resp_queue_;
+    std::mutex resp_queue_lock_;
+
+    // `true` if the first response in the queue is being written.
+    bool writing_resp_;
+
+    // `true` if reading the next request is paused until
+    // all responses in the queue are sent.
+    bool read_paused_;
 };
 
 // rpc listener implementation
@@ -603,14 +1202,15 @@ public:
     asio_rpc_listener( asio_service_impl* _impl,
                        asio::io_service& io,
                        ssl_context& ssl_ctx,
-                       ushort port,
+                       const stream_endpoint& ep,
                        bool _enable_ssl,
                        ptr<logger>& l )
         : impl_(_impl)
         , io_svc_(io)
         , ssl_ctx_(ssl_ctx)
         , handler_()
-        , acceptor_(io, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port))
+        , dispatcher_()
+        , acceptor_(io, ep)
         , session_id_cnt_(1)
         , stopped_(false)
         , ssl_enabled_(_enable_ssl)
@@ -634,6 +1234,14 @@ public:
         start();
     }
 
+    virtual void listen_groups(ptr<raft_group_dispatcher>& dispatcher,
+                               ptr<msg_handler> default_handler) override {
+        dispatcher_ = dispatcher;
+        handler_ = default_handler;
+        stopped_ = false;
+        start();
+    }
+
     virtual void shutdown() override {
         auto_lock(session_lock_);
         for (auto& entry: active_sessions_) {
@@ -643,6 +1251,7 @@ public:
         }
         active_sessions_.clear();
         handler_.reset();
+        dispatcher_.reset();
     }
 
 private:
@@ -657,11 +1266,14 @@ private:
                        self,
                        std::placeholders::_1 );
 
+        // Sessions are spread over io_services (if multiple),
+        // in a round-robin manner.
+        uint64_t session_id = session_id_cnt_.fetch_add(1);
         ptr<rpc_session> session =
             cs_new< rpc_session >
-            ( session_id_cnt_.fetch_add(1),
-              impl_, io_svc_, ssl_ctx_, ssl_enabled_,
-              handler_, l_, cb );
+            ( session_id,
+              impl_, impl_->get_io_svc(session_id), ssl_ctx_, ssl_enabled_,
+              handler_, dispatcher_, l_, cb );
 
         acceptor_.async_accept( session->socket(),
                                 std::bind( &asio_rpc_listener::handle_accept,
@@ -709,7 +1321,8 @@ private:
     asio::io_service& io_svc_;
     ssl_context& ssl_ctx_;
     ptr<msg_handler> handler_;
-    asio::ip::tcp::acceptor acceptor_;
+    ptr<raft_group_dispatcher> dispatcher_;
+    asio::basic_socket_acceptor<asio::generic::stream_protocol> acceptor_;
     std::vector<ptr<rpc_session>> active_sessions_;
     std::atomic<uint64_t> session_id_cnt_;
     std::mutex session_lock_;
@@ -731,6 +1344,7 @@ public:
                     bool ssl_enabled,
                     ptr<logger> l)
         : impl_(_impl)
+        , io_svc_(io_svc)
         , resolver_(io_svc)
         , socket_(io_svc)
         , ssl_socket_(socket_, ssl_ctx)
@@ -741,6 +1355,9 @@ public:
         , ssl_ready_(false)
         , num_send_fails_(0)
         , abandoned_(false)
+        , peer_compression_ok_(false)
+        , writing_(false)
+        , reading_(false)
         , l_(l)
     {
         if (ssl_enabled_) {
@@ -758,6 +1375,12 @@ public:
                                      this,
                                      std::placeholders::_1,
                                      std::placeholders::_2 ) );
+
+            if (_impl->get_options().ssl_session_resumption_) {
+                // To find this client in `on_new_ssl_session`.
+                SSL_set_ex_data( ssl_socket_.native_handle(),
+                                 ssl_client_ex_idx(), this );
+            }
 #endif
         }
         p_tr("asio client created: %p", this);
@@ -784,6 +1407,28 @@ public:
         }
         return preverified;
     }
+
+    // Index of SSL ex data pointing to the client.
+    static int ssl_client_ex_idx() {
+        static int idx = SSL_get_ex_new_index(0, nullptr, nullptr,
+                                              nullptr, nullptr);
+        return idx;
+    }
+
+    // Called by OpenSSL when a new session (or a TLS 1.3 ticket,
+    // which arrives after the handshake) is received from the server.
+    static int on_new_ssl_session(SSL* ssl, SSL_SESSION* sess) {
+        asio_rpc_client* cli = static_cast<asio_rpc_client*>
+                               ( SSL_get_ex_data(ssl, ssl_client_ex_idx()) );
+        if (!cli) return 0;
+
+        // Keep a copy, for the same reason as `load_ssl_session`.
+        SSL_SESSION* copied = SSL_SESSION_dup(sess);
+        if (!copied) return 0;
+        cli->impl_->store_ssl_session(cli->host_ + ":" + cli->port_, copied);
+        // The original one is still owned by OpenSSL.
+        return 0;
+    }
 #endif
 
     ssl_socket::lowest_layer_type& socket() {
@@ -794,6 +1439,7 @@ public:
                      ptr<asio::steady_timer> timer,
                      ptr<req_msg>& req,
                      rpc_handler& when_done,
+                     int32 group_id,
                      const ERROR_CODE& err )
     {
         if ( err || num_send_fails_ >= SEND_RETRY_MAX ) {
@@ -814,10 +1460,55 @@ public:
             when_done(rsp, except);
             return;
         }
-        send(req, when_done);
+        send_req(req, when_done, group_id);
     }
 
     virtual void send(ptr<req_msg>& req, rpc_handler& when_done) __override__ {
+        send_req(req, when_done, NO_GROUP_ID);
+    }
+
+    bool is_abandoned() const { return abandoned_; }
+
+    // Send request of the given group. Heartbeat may be buffered
+    // to be sent with those of the other groups.
+    void send_group_req(ptr<req_msg>& req,
+                        rpc_handler& when_done,
+                        int32 group_id)
+    {
+        const asio_service::options& opt = impl_->get_options();
+        bool coalesce = opt.heartbeat_coalesce_window_ms_ &&
+                        !opt.write_req_meta_ &&
+                        !opt.read_resp_meta_ &&
+                        req->get_type() == msg_type::append_entries_request &&
+                        req->log_entries().empty();
+        if (!coalesce) {
+            send_req(req, when_done, group_id);
+            return;
+        }
+
+        {   std::lock_guard<std::mutex> l(hb_lock_);
+            hb_batch_.push_back( hb_elem(req, when_done, group_id) );
+            // Otherwise, flush is already scheduled.
+            if (hb_batch_.size() > 1) return;
+        }
+
+        ptr<asio_rpc_client> self = this->shared_from_this();
+        ptr<asio::steady_timer> timer =
+            cs_new<asio::steady_timer>(io_svc_);
+        timer->expires_after
+               ( std::chrono::duration_cast<std::chrono::nanoseconds>
+                 ( std::chrono::milliseconds
+                   ( opt.heartbeat_coalesce_window_ms_ ) ) );
+        timer->async_wait( std::bind( &asio_rpc_client::flush_hb_batch,
+                                      this,
+                                      self,
+                                      timer,
+                                      std::placeholders::_1 ) );
+    }
+
+    // If `group_id` is given (non-negative), the request is tagged
+    // with it so that the listener can route it to the right group.
+    void send_req(ptr<req_msg>& req, rpc_handler& when_done, int32 group_id) {
         if (abandoned_) {
             p_er( "client %p to %s:%s is already stale (SSL %s)",
                   this, host_.c_str(), port_.c_str(),
@@ -850,7 +1541,7 @@ public:
                 num_send_fails_.fetch_add(1);
 
                 ptr<asio::steady_timer> timer =
-                    cs_new<asio::steady_timer>(impl_->get_io_svc());
+                    cs_new<asio::steady_timer>(io_svc_);
                 timer->expires_after
                        ( std::chrono::duration_cast<std::chrono::nanoseconds>
                          ( std::chrono::milliseconds( SEND_RETRY_MS ) ) );
@@ -860,6 +1551,7 @@ public:
                                               timer,
                                               req,
                                               when_done,
+                                              group_id,
                                               std::placeholders::_1 ) );
                 return;
             }
@@ -871,25 +1563,55 @@ public:
                 break;
             }
 
+            if (port_.empty()) {
+                // Unix domain socket, `host_` is the path.
+#ifdef LOCAL_SOCKETS_SUPPORTED
+                socket().async_connect
+                    ( asio::local::stream_protocol::endpoint(host_),
+                      [self, this, req, when_done, group_id]
+                      (std::error_code err) mutable -> void
+                {
+                    connected(req, when_done, group_id, err);
+                } );
+#else
+                ptr<resp_msg> rsp;
+                ptr<rpc_exception> except
+                   ( cs_new<rpc_exception>
+                           ( lstrfmt("Unix domain socket is not supported, "
+                                     "path %s").fmt( host_.c_str() ),
+                             req ) );
+                when_done(rsp, except);
+#endif
+                return;
+            }
+
             asio::ip::tcp::resolver::query q
                 ( host_, port_, asio::ip::tcp::resolver::query::all_matching );
 
             resolver_.async_resolve
             ( q,
-              [self, this, req, when_done]
+              [self, this, req, when_done, group_id]
               ( std::error_code err,
                 asio::ip::tcp::resolver::iterator itor ) -> void
             {
                 if (!err) {
+                    // Resolved endpoints should be converted to
+                    // the generic ones to connect `socket()`.
+                    ptr< std::vector<stream_endpoint> > eps =
+                        cs_new< std::vector<stream_endpoint> >();
+                    for ( ; itor != asio::ip::tcp::resolver::iterator();
+                          ++itor ) {
+                        eps->push_back( itor->endpoint() );
+                    }
                     asio::async_connect
-                        ( socket(),
-                          itor,
-                          std::bind( &asio_rpc_client::connected,
-                                     self,
-                                     req,
-                                     when_done,
-                                     std::placeholders::_1,
-                                     std::placeholders::_2 ) );
+                        ( socket(), eps->begin(), eps->end(),
+                          [self, this, req, when_done, group_id, eps]
+                          ( std::error_code err,
+                            std::vector<stream_endpoint>::iterator )
+                          mutable -> void
+                    {
+                        connected(req, when_done, group_id, err);
+                    } );
                 } else {
                     ptr<resp_msg> rsp;
                     ptr<rpc_exception> except
@@ -912,7 +1634,7 @@ public:
             num_send_fails_.fetch_add(1);
 
             ptr<asio::steady_timer> timer =
-                cs_new<asio::steady_timer>(impl_->get_io_svc());
+                cs_new<asio::steady_timer>(io_svc_);
             timer->expires_after
                    ( std::chrono::duration_cast<std::chrono::nanoseconds>
                      ( std::chrono::milliseconds( SEND_RETRY_MS ) ) );
@@ -922,6 +1644,7 @@ public:
                                           timer,
                                           req,
                                           when_done,
+                                          group_id,
                                           std::placeholders::_1 ) );
             return;
         }
@@ -931,25 +1654,55 @@ public:
         num_send_fails_ = 0;
 
         // serialize req, send and read response
-        std::vector<ptr<buffer>> log_entry_bufs;
+        //
+        // Log entry payloads are not copied into a single buffer here.
+        // Header and the per-entry small headers (term, type, size)
+        // are written into separate buffers, and the payloads are
+        // referenced in place, as a scatter/gather write. `req` holds
+        // the log entries until the write is done.
+        uint32_t flags = 0x0;
+        if (impl_->get_options().crc32c_header_) {
+            flags |= CRC32C_HEADER;
+        }
+
+        std::vector<ptr<log_entry>>& entries = req->log_entries();
+        if ( impl_->get_options().log_entry_crc_ && !entries.empty() ) {
+            flags |= INCLUDE_LOG_CRC;
+        }
+        const size_t LOG_ENTRY_HEADER_SIZE =
+            8 + 1 + 4 + ( (flags & INCLUDE_LOG_CRC) ? 4 : 0 );
         int32 log_data_size(0);
+        ptr<buffer> entry_hdr_buf;
+        if (!entries.empty()) {
+            entry_hdr_buf = buffer::alloc
+                            ( LOG_ENTRY_HEADER_SIZE * entries.size() );
+            entry_hdr_buf->pos(0);
+        }
 
-        for (auto& entry: req->log_entries()) {
+        for (auto& entry: entries) {
             ptr<log_entry>& le = entry;
-            ptr<buffer> entry_buf = buffer::alloc
-                                    ( 8 + 1 + 4 + le->get_buf().size() );
-            entry_buf->put( le->get_term() );
-            entry_buf->put( (byte)le->get_val_type() );
-            entry_buf->put( (int32)le->get_buf().size() );
-            le->get_buf().pos(0);
-            entry_buf->put( le->get_buf() );
-            entry_buf->pos( 0 );
+            buffer& payload = le->get_buf();
+            entry_hdr_buf->put( le->get_term() );
+            entry_hdr_buf->put( (byte)le->get_val_type() );
+            entry_hdr_buf->put( (int32)payload.size() );
+            if (flags & INCLUDE_LOG_CRC) {
+                // Use the one calculated by the leader, if exists.
+                uint32_t crc_val = le->has_crc32()
+                                   ? le->get_crc32()
+                                   : crc32c( payload.data_begin(),
+                                             payload.size(), 0 );
+                entry_hdr_buf->put( (int32)crc_val );
+            }
+            log_data_size += (int32)( LOG_ENTRY_HEADER_SIZE +
+                                      payload.size() );
+        }
 
-            log_entry_bufs.push_back(entry_buf);
-            log_data_size += (int32)entry_buf->size();
+        size_t group_id_size = 0;
+        if (group_id != NO_GROUP_ID) {
+            flags |= INCLUDE_GROUP_ID;
+            group_id_size = sizeof(int32);
         }
 
-        uint32_t flags = 0x0;
         size_t meta_size = 0;
         std::string meta_str;
         if (impl_->get_options().write_req_meta_) {
@@ -961,8 +1714,27 @@ public:
             }
         }
 
+        // Compress the data section, if the server supports the codec.
+        ptr<buffer> comp_buf;
+        compressor::codec codec =
+            (compressor::codec)impl_->get_options().compression_type_;
+        if (compressor::is_available(codec)) {
+            flags |= ((uint32_t)codec << COMPRESSION_CODEC_SHIFT);
+            size_t raw_size = group_id_size + meta_size + log_data_size;
+            if ( peer_compression_ok_ &&
+                 raw_size &&
+                 raw_size >= impl_->get_options().compression_threshold_bytes_ ) {
+                comp_buf = compress_data( codec, group_id, meta_str, flags,
+                                          entries, entry_hdr_buf,
+                                          LOG_ENTRY_HEADER_SIZE, raw_size );
+            }
+        }
+        if (comp_buf) flags |= COMPRESSED_DATA;
+
         ptr<buffer> req_buf =
-            buffer::alloc(RPC_REQ_HEADER_SIZE + meta_size + log_data_size);
+            buffer::alloc( RPC_REQ_HEADER_SIZE +
+                           ( comp_buf ? COMPRESSED_DATA_HEADER_SIZE
+                                      : group_id_size + meta_size ) );
 
         req_buf->pos(0);
         byte* req_buf_data = req_buf->data();
@@ -976,42 +1748,361 @@ public:
         req_buf->put(req->get_last_log_term());
         req_buf->put(req->get_last_log_idx());
         req_buf->put(req->get_commit_idx());
-        req_buf->put((int32)meta_size + log_data_size);
+        if (comp_buf) {
+            req_buf->put( (int32)( COMPRESSED_DATA_HEADER_SIZE +
+                                   comp_buf->size() ) );
+        } else {
+            req_buf->put((int32)(group_id_size + meta_size) + log_data_size);
+        }
 
         // Calculate CRC32 on header-only.
-        uint32_t crc_val = crc32_8( req_buf_data,
-                                    RPC_REQ_HEADER_SIZE - CRC_FLAGS_LEN,
-                                    0 );
+        uint32_t crc_val = calc_header_crc( flags,
+                                            req_buf_data,
+                                            RPC_REQ_HEADER_SIZE - CRC_FLAGS_LEN );
 
         uint64_t flags_and_crc = ((uint64_t)flags << 32) | crc_val;
         req_buf->put((ulong)flags_and_crc);
 
-        // Handling meta if the flag is set.
-        if (flags & INCLUDE_META) {
-            req_buf->put( (byte*)meta_str.data(), meta_str.size() );
+        if (comp_buf) {
+            // Group ID, meta, and log entries are in the compressed data.
+            req_buf->put((byte)codec);
+            req_buf->put((int32)(group_id_size + meta_size + log_data_size));
+            req_buf->pos(0);
+
+            std::vector<asio::const_buffer> bufs;
+            bufs.push_back( asio::buffer(req_buf->data(), req_buf->size()) );
+            bufs.push_back( asio::buffer(comp_buf->data(), comp_buf->size()) );
+            ptr<pending_req> pr = cs_new<pending_req>
+                                  (req, req_buf, comp_buf, bufs, when_done);
+            enqueue(pr);
+            return;
+        }
+
+        // Group ID goes first if the flag is set.
+        if (flags & INCLUDE_GROUP_ID) {
+            req_buf->put(group_id);
+        }
+
+        // Handling meta if the flag is set.
+        if (flags & INCLUDE_META) {
+            req_buf->put( (byte*)meta_str.data(), meta_str.size() );
+        }
+        req_buf->pos(0);
+
+        std::vector<asio::const_buffer> bufs;
+        bufs.reserve(1 + entries.size() * 2);
+        bufs.push_back( asio::buffer(req_buf->data(), req_buf->size()) );
+        for (size_t ii = 0; ii < entries.size(); ++ii) {
+            bufs.push_back
+                ( asio::buffer( entry_hdr_buf->data_begin() +
+                                    LOG_ENTRY_HEADER_SIZE * ii,
+                                LOG_ENTRY_HEADER_SIZE ) );
+            buffer& payload = entries[ii]->get_buf();
+            if (payload.size()) {
+                bufs.push_back
+                    ( asio::buffer(payload.data_begin(), payload.size()) );
+            }
+        }
+
+        // Multiple requests can be sent through this client at the
+        // same time (e.g., pipelined append_entries), hence queue it
+        // so that writes and reads on the socket are not interleaved.
+        ptr<pending_req> pr = cs_new<pending_req>
+                              (req, req_buf, entry_hdr_buf, bufs, when_done);
+        enqueue(pr);
+    }
+private:
+    // Compress group ID, meta, and log entries into a single buffer.
+    // Returns `nullptr` if it is not beneficial.
+    ptr<buffer> compress_data(compressor::codec codec,
+                              int32 group_id,
+                              const std::string& meta_str,
+                              uint32_t flags,
+                              std::vector<ptr<log_entry>>& entries,
+                              ptr<buffer>& entry_hdr_buf,
+                              size_t entry_hdr_size,
+                              size_t raw_size)
+    {
+        static stat_elem& raw_bytes = *stat_mgr::get_instance()->create_stat
+            (stat_elem::COUNTER, "asio_compress_raw_bytes");
+        static stat_elem& out_bytes = *stat_mgr::get_instance()->create_stat
+            (stat_elem::COUNTER, "asio_compress_out_bytes");
+        static stat_elem& num_skipped = *stat_mgr::get_instance()->create_stat
+            (stat_elem::COUNTER, "asio_compress_skipped");
+        static stat_elem& comp_lat = *stat_mgr::get_instance()->create_stat
+            (stat_elem::HISTOGRAM, "asio_compress_time_us");
+
+        uint64_t start_us = stat_now_us();
+        ptr<buffer> raw_buf = buffer::alloc(raw_size);
+        raw_buf->pos(0);
+        if (flags & INCLUDE_GROUP_ID) {
+            raw_buf->put(group_id);
+        }
+        if (flags & INCLUDE_META) {
+            raw_buf->put( (byte*)meta_str.data(), meta_str.size() );
+        }
+        for (size_t ii = 0; ii < entries.size(); ++ii) {
+            raw_buf->put_raw( entry_hdr_buf->data_begin() + entry_hdr_size * ii,
+                              entry_hdr_size );
+            buffer& payload = entries[ii]->get_buf();
+            raw_buf->put_raw( payload.data_begin(), payload.size() );
+        }
+
+        ptr<buffer> comp_buf = compressor::compress
+                               ( codec,
+                                 impl_->get_options().compression_level_,
+                                 raw_buf->data_begin(),
+                                 raw_size );
+        comp_lat += stat_now_us() - start_us;
+        if ( !comp_buf ||
+             comp_buf->size() + COMPRESSED_DATA_HEADER_SIZE >= raw_size ) {
+            // Send it as it is.
+            num_skipped++;
+            return nullptr;
+        }
+        raw_bytes += raw_size;
+        out_bytes += COMPRESSED_DATA_HEADER_SIZE + comp_buf->size();
+        return comp_buf;
+    }
+
+    // Heartbeat waiting for being sent with those of the other groups.
+    struct hb_elem {
+        hb_elem(ptr<req_msg>& req, rpc_handler& when_done, int32 group_id)
+            : req_(req)
+            , when_done_(when_done)
+            , group_id_(group_id)
+            {}
+        ptr<req_msg> req_;
+        rpc_handler when_done_;
+        int32 group_id_;
+    };
+
+    void flush_hb_batch(ptr<asio_rpc_client> self,
+                        ptr<asio::steady_timer> timer,
+                        const ERROR_CODE& err)
+    {
+        ptr< std::vector<hb_elem> > batch = cs_new< std::vector<hb_elem> >();
+        {   std::lock_guard<std::mutex> l(hb_lock_);
+            batch->swap(hb_batch_);
+        }
+        if (batch->empty()) return;
+
+        if ( batch->size() == 1 ||
+             abandoned_ ||
+             !socket().is_open() ||
+             ( ssl_enabled_ && !ssl_ready_ ) ) {
+            // Nothing to combine, or connection is not ready yet.
+            // Going through the regular path will handle it.
+            for (hb_elem& ee: *batch) {
+                send_req(ee.req_, ee.when_done_, ee.group_id_);
+            }
+            return;
+        }
+
+        static stat_elem& num_batches = *stat_mgr::get_instance()->create_stat
+            (stat_elem::COUNTER, "num_heartbeat_batches");
+        static stat_elem& num_coalesced = *stat_mgr::get_instance()->create_stat
+            (stat_elem::COUNTER, "num_coalesced_heartbeats");
+        num_batches++;
+        num_coalesced += batch->size();
+
+        uint32_t flags = HEARTBEAT_BATCH;
+        if (impl_->get_options().crc32c_header_) {
+            flags |= CRC32C_HEADER;
         }
 
-        for (auto& it: log_entry_bufs) {
-            req_buf->put(*(it));
+        ptr<req_msg>& first_req = batch->front().req_;
+        int32 data_size = sz_int + batch->size() * HB_BATCH_REQ_SIZE;
+        ptr<buffer> req_buf = buffer::alloc(RPC_REQ_HEADER_SIZE + data_size);
+        req_buf->pos(0);
+
+        byte marker = 0x0;
+        req_buf->put(marker);
+        req_buf->put((byte)msg_type::append_entries_request);
+        req_buf->put(first_req->get_src());
+        req_buf->put(first_req->get_dst());
+        req_buf->put((ulong)0);
+        req_buf->put((ulong)0);
+        req_buf->put((ulong)0);
+        req_buf->put((ulong)0);
+        req_buf->put(data_size);
+
+        uint32_t crc_val = calc_header_crc( flags,
+                                            req_buf->data_begin(),
+                                            RPC_REQ_HEADER_SIZE - CRC_FLAGS_LEN );
+        uint64_t flags_and_crc = ((uint64_t)flags << 32) | crc_val;
+        req_buf->put((ulong)flags_and_crc);
+
+        req_buf->put((int32)batch->size());
+        for (hb_elem& ee: *batch) {
+            req_buf->put(ee.group_id_);
+            req_buf->put(ee.req_->get_term());
+            req_buf->put(ee.req_->get_last_log_term());
+            req_buf->put(ee.req_->get_last_log_idx());
+            req_buf->put(ee.req_->get_commit_idx());
         }
         req_buf->pos(0);
 
-        // Note: without passing `req_buf` to callback function, it will be
-        //       unreachable before the write is done so that it is freed
-        //       and the memory corruption will occur.
+        // Representative request of the batch, for error messages.
+        ptr<req_msg> req = cs_new<req_msg>
+                           ( 0, msg_type::append_entries_request,
+                             first_req->get_src(), first_req->get_dst(),
+                             0, 0, 0 );
+        rpc_handler when_done = std::bind( &asio_rpc_client::hb_batch_done,
+                                           self,
+                                           batch,
+                                           std::placeholders::_1,
+                                           std::placeholders::_2 );
+        std::vector<asio::const_buffer> bufs;
+        bufs.push_back( asio::buffer(req_buf->data(), req_buf->size()) );
+        ptr<buffer> entry_hdr_buf;
+        ptr<pending_req> pr = cs_new<pending_req>
+                              (req, req_buf, entry_hdr_buf, bufs, when_done);
+        enqueue(pr);
+    }
+
+    // Fan out the combined response to each group.
+    void hb_batch_done(ptr< std::vector<hb_elem> >& batch,
+                       ptr<resp_msg>& rsp,
+                       ptr<rpc_exception>& err)
+    {
+        ptr<buffer> ctx = (rsp && !err) ? rsp->get_ctx() : nullptr;
+        bool valid = false;
+        if (ctx && ctx->size() >= sz_int) {
+            ctx->pos(0);
+            size_t num_resps = ctx->get_int();
+            valid = ( num_resps == batch->size() &&
+                      ctx->size() == sz_int + num_resps * HB_BATCH_RESP_SIZE );
+        }
+
+        for (hb_elem& ee: *batch) {
+            if (!valid) {
+                ptr<resp_msg> no_rsp;
+                ptr<rpc_exception> except
+                    ( cs_new<rpc_exception>
+                      ( err ? std::string(err->what())
+                            : sstrfmt( "wrong heartbeat batch response from "
+                                       "peer %d, %s:%s" )
+                                     .fmt( ee.req_->get_dst(), host_.c_str(),
+                                           port_.c_str() ),
+                        ee.req_ ) );
+                ee.when_done_(no_rsp, except);
+                continue;
+            }
+
+            msg_type type = (msg_type)ctx->get_byte();
+            int32 src = ctx->get_int();
+            int32 dst = ctx->get_int();
+            ulong term = ctx->get_ulong();
+            ulong next_idx = ctx->get_ulong();
+            bool accepted = (ctx->get_byte() == 1);
+            ptr<resp_msg> sub_rsp = cs_new<resp_msg>
+                                    ( term, type, src, dst, next_idx, accepted );
+            ptr<rpc_exception> no_err;
+            ee.when_done_(sub_rsp, no_err);
+        }
+    }
+
+    struct pending_req {
+        pending_req(ptr<req_msg>& req,
+                    ptr<buffer>& buf,
+                    ptr<buffer>& entry_hdr_buf,
+                    std::vector<asio::const_buffer>& bufs,
+                    rpc_handler& when_done)
+            : req_(req)
+            , buf_(buf)
+            , entry_hdr_buf_(entry_hdr_buf)
+            , when_done_(when_done)
+            { bufs_.swap(bufs); }
+        // Request, holding log entries whose payloads are in `bufs_`.
+        ptr<req_msg> req_;
+        // Header and meta.
+        ptr<buffer> buf_;
+        // Headers of log entries, or compressed data section.
+        ptr<buffer> entry_hdr_buf_;
+        // Buffer sequence to write,
+        // referring to the above buffers and log entry payloads.
+        std::vector<asio::const_buffer> bufs_;
+        rpc_handler when_done_;
+    };
+
+    // Next write can be issued before getting the response of the
+    // previous request. Only one read and one write can be in flight
+    // at a time. SSL stream doesn't allow concurrent read and write,
+    // so requests are processed one by one in that case.
+    bool pipelined() const { return !ssl_enabled_; }
+
+    // Queue the request, and start writing if no write is in flight.
+    void enqueue(ptr<pending_req>& pr) {
+        {
+            std::lock_guard<std::mutex> l(pending_lock_);
+            pending_writes_.push_back(pr);
+            if (writing_) return;
+            writing_ = true;
+        }
+        start_write(pr);
+    }
+
+    void start_write(ptr<pending_req>& pr) {
+        ptr<asio_rpc_client> self = this->shared_from_this();
+        // Note: without passing `pr` (containing request buffers) to
+        //       callback function, it will be unreachable before the
+        //       write is done so that it is freed and the memory
+        //       corruption will occur.
         aa::write( ssl_enabled_, ssl_socket_, socket_,
-                   asio::buffer(req_buf->data(), req_buf->size()),
+                   pr->bufs_,
                    std::bind( &asio_rpc_client::sent,
                               self,
-                              req,
-                              req_buf,
-                              when_done,
+                              pr,
                               std::placeholders::_1,
                               std::placeholders::_2 ) );
     }
-private:
+
+    void start_read(ptr<pending_req>& pr) {
+        ptr<asio_rpc_client> self = this->shared_from_this();
+        rpc_handler when_done = std::bind( &asio_rpc_client::response_done,
+                                           self,
+                                           pr,
+                                           std::placeholders::_1,
+                                           std::placeholders::_2 );
+        ptr<buffer> resp_buf(buffer::alloc(RPC_RESP_HEADER_SIZE));
+        aa::read( ssl_enabled_, ssl_socket_, socket_,
+                  asio::buffer(resp_buf->data(), resp_buf->size()),
+                  std::bind(&asio_rpc_client::response_read,
+                            self,
+                            pr->req_,
+                            when_done,
+                            resp_buf,
+                            std::placeholders::_1,
+                            std::placeholders::_2));
+    }
+
+    // Fail all requests waiting for write or response.
+    void abandon_pending_reqs() {
+        std::list< ptr<pending_req> > reqs;
+        {
+            std::lock_guard<std::mutex> l(pending_lock_);
+            reqs.splice(reqs.end(), pending_reads_);
+            reqs.splice(reqs.end(), pending_writes_);
+        }
+        for (ptr<pending_req>& pr: reqs) {
+            ptr<resp_msg> rsp;
+            ptr<rpc_exception> except
+                ( cs_new<rpc_exception>
+                  ( sstrfmt( "connection to peer %d, %s:%s is broken" )
+                           .fmt( pr->req_->get_dst(), host_.c_str(),
+                                 port_.c_str() ),
+                    pr->req_ ) );
+            pr->when_done_(rsp, except);
+        }
+    }
+
     void close_socket() {
-        // Do nothing,
+        // The peer on the next connection may not support the codec
+        // (e.g., restarted with an older version), negotiate it again.
+        peer_compression_ok_ = false;
+
+        // Do nothing else,
         // early closing socket before destroying this instance
         // may cause problem, especially when SSL is enabled.
 #if 0
@@ -1030,26 +2121,33 @@ private:
 
     void connected(ptr<req_msg>& req,
                    rpc_handler& when_done,
-                   std::error_code err,
-                   asio::ip::tcp::resolver::iterator itor)
+                   int32 group_id,
+                   std::error_code err)
     {
         if (!err) {
             p_in( "connected to %s:%s (as a client)",
                   host_.c_str(), port_.c_str() );
+            // Same as `close_socket`, wait for the first response.
+            peer_compression_ok_ = false;
             if (ssl_enabled_) {
 #ifdef SSL_LIBRARY_NOT_FOUND
                 assert(0); // Should not reach here.
 #else
+                if (impl_->get_options().ssl_session_resumption_) {
+                    impl_->load_ssl_session( host_ + ":" + port_,
+                                             ssl_socket_.native_handle() );
+                }
                 ssl_socket_.async_handshake
                     ( asio::ssl::stream_base::client,
                       std::bind( &asio_rpc_client::handle_handshake,
                                  this,
                                  req,
                                  when_done,
+                                 group_id,
                                  std::placeholders::_1 ) );
 #endif
             } else {
-                this->send(req, when_done);
+                this->send_req(req, when_done, group_id);
             }
 
         } else {
@@ -1067,20 +2165,38 @@ private:
 
     void handle_handshake(ptr<req_msg>& req,
                           rpc_handler& when_done,
+                          int32 group_id,
                           const ERROR_CODE& err)
     {
         ptr<asio_rpc_client> self = this->shared_from_this();
 
         if (!err) {
-            p_in( "handshake with %s:%s succeeded (as a client)",
-                  host_.c_str(), port_.c_str() );
+#ifndef SSL_LIBRARY_NOT_FOUND
+            static stat_elem& num_handshakes =
+                *stat_mgr::get_instance()->create_stat
+                 (stat_elem::COUNTER, "asio_ssl_handshakes");
+            static stat_elem& num_resumed =
+                *stat_mgr::get_instance()->create_stat
+                 (stat_elem::COUNTER, "asio_ssl_resumed_handshakes");
+            bool resumed = SSL_session_reused( ssl_socket_.native_handle() );
+            num_handshakes++;
+            if (resumed) num_resumed++;
+            p_in( "handshake with %s:%s succeeded (as a client), "
+                  "session resumed: %s",
+                  host_.c_str(), port_.c_str(), resumed ? "true" : "false" );
+#endif
             ssl_ready_ = true;
-            this->send(req, when_done);
+            this->send_req(req, when_done, group_id);
 
         } else {
             abandoned_ = true;
             p_er( "failed SSL handshake with peer %d, %s:%s, error %d",
                   req->get_dst(), host_.c_str(), port_.c_str(), err.value() );
+#ifndef SSL_LIBRARY_NOT_FOUND
+            // The cached session might be the cause, start over
+            // with a full handshake next time.
+            impl_->drop_ssl_session(host_ + ":" + port_);
+#endif
 
             // Immediately stop.
             ptr<resp_msg> resp;
@@ -1095,41 +2211,104 @@ private:
         }
     }
 
-    void sent( ptr<req_msg>& req,
-               ptr<buffer>& buf,
-               rpc_handler& when_done,
+    void sent( ptr<pending_req>& pr,
                std::error_code err,
                size_t bytes_transferred )
     {
-        // Now we can safely free the `req_buf`.
-        (void)buf;
         ptr<asio_rpc_client> self(this->shared_from_this());
-        if (!err) {
-            // read a response
-            ptr<buffer> resp_buf(buffer::alloc(RPC_RESP_HEADER_SIZE));
-            aa::read( ssl_enabled_, ssl_socket_, socket_,
-                      asio::buffer(resp_buf->data(), resp_buf->size()),
-                      std::bind(&asio_rpc_client::response_read,
-                                self,
-                                req,
-                                when_done,
-                                resp_buf,
-                                std::placeholders::_1,
-                                std::placeholders::_2));
+        ptr<pending_req> next_read;
+        ptr<pending_req> next_write;
+        {
+            std::lock_guard<std::mutex> l(pending_lock_);
+            if ( pending_writes_.empty() ||
+                 pending_writes_.front() != pr ) {
+                // Already abandoned.
+                return;
+            }
+            pending_writes_.pop_front();
+            if (!err) {
+                // Now we can safely free the request buffers.
+                pr->bufs_.clear();
+                pr->buf_.reset();
+                pr->entry_hdr_buf_.reset();
+                pending_reads_.push_back(pr);
+                if (!reading_) {
+                    reading_ = true;
+                    next_read = pr;
+                }
+                if (pipelined() && !pending_writes_.empty()) {
+                    next_write = pending_writes_.front();
+                } else if (pipelined()) {
+                    writing_ = false;
+                }
+                // Otherwise, next write will be issued once
+                // the response is read.
+            }
+        }
 
-        } else {
+        if (err) {
             abandoned_ = true;
             ptr<resp_msg> rsp;
             ptr<rpc_exception> except
                 ( cs_new<rpc_exception>
                   ( sstrfmt( "failed to send request to peer %d, %s:%s, "
                              "error %d" )
-                           .fmt( req->get_dst(), host_.c_str(),
+                           .fmt( pr->req_->get_dst(), host_.c_str(),
                                  port_.c_str(), err.value() ),
-                    req ) );
+                    pr->req_ ) );
             close_socket();
-            when_done(rsp, except);
+            pr->when_done_(rsp, except);
+            abandon_pending_reqs();
+            return;
+        }
+
+        // read a response
+        if (next_read) start_read(next_read);
+        if (next_write) start_write(next_write);
+    }
+
+    void response_done( ptr<pending_req>& pr,
+                        ptr<resp_msg>& rsp,
+                        ptr<rpc_exception>& err )
+    {
+        ptr<asio_rpc_client> self(this->shared_from_this());
+        ptr<pending_req> next_read;
+        ptr<pending_req> next_write;
+        {
+            std::lock_guard<std::mutex> l(pending_lock_);
+            if ( pending_reads_.empty() ||
+                 pending_reads_.front() != pr ) {
+                // Already abandoned.
+                return;
+            }
+            pending_reads_.pop_front();
+            if (!err) {
+                if (!pending_reads_.empty()) {
+                    next_read = pending_reads_.front();
+                } else {
+                    reading_ = false;
+                }
+                if (!pipelined()) {
+                    if (!pending_writes_.empty()) {
+                        next_write = pending_writes_.front();
+                    } else {
+                        writing_ = false;
+                    }
+                }
+            }
+        }
+
+        pr->when_done_(rsp, err);
+        if (err) {
+            // Stream is not reliable anymore, the following
+            // responses should not be used.
+            abandoned_ = true;
+            abandon_pending_reqs();
+            return;
         }
+
+        if (next_read) start_read(next_read);
+        if (next_write) start_write(next_write);
     }
 
     void response_read(ptr<req_msg>& req,
@@ -1155,13 +2334,13 @@ private:
         }
 
         buffer_serializer bs(resp_buf);
-        uint32_t crc_local = crc32_8( resp_buf->data_begin(),
-                                      RPC_RESP_HEADER_SIZE - CRC_FLAGS_LEN,
-                                      0 );
         bs.pos(RPC_RESP_HEADER_SIZE - CRC_FLAGS_LEN);
         uint64_t flags_and_crc = bs.get_u64();
         uint32_t crc_buf = flags_and_crc & (uint32_t)0xffffffff;
         uint32_t flags = (flags_and_crc >> 32);
+        uint32_t crc_local = calc_header_crc( flags,
+                                              resp_buf->data_begin(),
+                                              RPC_RESP_HEADER_SIZE - CRC_FLAGS_LEN );
 
         if (crc_local != crc_buf) {
             ptr<resp_msg> rsp;
@@ -1177,6 +2356,15 @@ private:
             return;
         }
 
+        // Server supports the codec if it echoes it back. Checked on
+        // every response, so that it follows the server's support.
+        compressor::codec codec =
+            (compressor::codec)impl_->get_options().compression_type_;
+        peer_compression_ok_ =
+            compressor::is_available(codec) &&
+            ( (flags & COMPRESSION_CODEC_MASK) >> COMPRESSION_CODEC_SHIFT ) ==
+                (uint32_t)codec;
+
         bs.pos(1);
         byte msg_type_val = bs.get_u8();
         int32 src = bs.get_i32();
@@ -1312,8 +2500,9 @@ private:
 
 private:
     asio_service_impl* impl_;
+    asio::io_service& io_svc_;
     asio::ip::tcp::resolver resolver_;
-    asio::ip::tcp::socket socket_;
+    stream_socket socket_;
     ssl_socket ssl_socket_;
     // `true` if attempting connection is in progress.
     // Other threads should not do anything.
@@ -1324,9 +2513,140 @@ private:
     std::atomic<bool> ssl_ready_;
     std::atomic<size_t> num_send_fails_;
     std::atomic<bool> abandoned_;
+    // `true` if the server supports the compression codec.
+    std::atomic<bool> peer_compression_ok_;
+    // Lock for the below queues and flags.
+    std::mutex pending_lock_;
+    // Requests waiting for being written to the socket.
+    // The first one is being written if `writing_` is set.
+    std::list< ptr<pending_req> > pending_writes_;
+    // Requests waiting for the response, in the order of writes.
+    // The first one is being read if `reading_` is set.
+    std::list< ptr<pending_req> > pending_reads_;
+    bool writing_;
+    bool reading_;
+    // Lock for `hb_batch_`.
+    std::mutex hb_lock_;
+    // Heartbeats of multiple groups to be sent at once.
+    std::vector<hb_elem> hb_batch_;
+    ptr<logger> l_;
+};
+
+// Client of a Raft group, sending requests through the connection
+// shared with the other groups.
+class asio_group_rpc_client : public rpc_client {
+public:
+    asio_group_rpc_client(ptr<asio_rpc_client>& conn, int32 group_id)
+        : conn_(conn)
+        , group_id_(group_id)
+        {}
+
+    virtual void send(ptr<req_msg>& req, rpc_handler& when_done) __override__ {
+        conn_->send_group_req(req, when_done, group_id_);
+    }
+
+private:
+    ptr<asio_rpc_client> conn_;
+    int32 group_id_;
+};
+
+class asio_group_client_factory : public rpc_client_factory {
+public:
+    asio_group_client_factory(asio_service_impl* _impl,
+                              int32 group_id,
+                              ptr<logger>& l)
+        : impl_(_impl)
+        , group_id_(group_id)
+        , l_(l)
+        {}
+
+    virtual ptr<rpc_client> create_client(const std::string& endpoint)
+                            __override__ {
+        std::string hostname;
+        std::string port;
+        if (!parse_endpoint(endpoint, hostname, port)) {
+            p_er("invalid endpoint: %s", endpoint.c_str());
+            return ptr<rpc_client>();
+        }
+
+        ptr<asio_rpc_client> conn =
+            impl_->get_shared_client(hostname, port, l_);
+        return cs_new<asio_group_rpc_client>(conn, group_id_);
+    }
+
+private:
+    asio_service_impl* impl_;
+    int32 group_id_;
     ptr<logger> l_;
 };
 
+// Client to a peer through multiple connections (lanes).
+// The first lane is dedicated to small, latency-sensitive messages
+// (heartbeats, votes, etc.), and the others to bulk traffic
+// (append entries with logs, snapshots).
+class asio_lane_rpc_client
+    : public rpc_client
+    , public std::enable_shared_from_this<asio_lane_rpc_client>
+{
+public:
+    asio_lane_rpc_client(std::vector< ptr<asio_rpc_client> >& lanes)
+        : lanes_(lanes)
+        , cur_bulk_lane_(0)
+        , num_bulk_inflight_(0)
+    {
+        assert(lanes_.size() >= 2);
+    }
+
+    virtual void send(ptr<req_msg>& req, rpc_handler& when_done) __override__ {
+        if (!is_bulk(req)) {
+            lanes_[0]->send(req, when_done);
+            return;
+        }
+
+        // Requests in flight should go through the same lane, as
+        // requests to a peer (e.g., pipelined append entries) should
+        // arrive in order. A lane is switched only when it is idle.
+        ptr<asio_rpc_client> lane;
+        {   std::lock_guard<std::mutex> l(lock_);
+            if (num_bulk_inflight_ == 0) {
+                cur_bulk_lane_ = (cur_bulk_lane_ % (lanes_.size() - 1)) + 1;
+            }
+            num_bulk_inflight_++;
+            lane = lanes_[cur_bulk_lane_];
+        }
+
+        ptr<asio_lane_rpc_client> self = this->shared_from_this();
+        rpc_handler handler = [self, when_done]
+                              ( ptr<resp_msg>& resp,
+                                ptr<rpc_exception>& err ) {
+            {   std::lock_guard<std::mutex> l(self->lock_);
+                self->num_bulk_inflight_--;
+            }
+            when_done(resp, err);
+        };
+        lane->send(req, handler);
+    }
+
+private:
+    static bool is_bulk(ptr<req_msg>& req) {
+        switch (req->get_type()) {
+        case msg_type::append_entries_request:
+            return !req->log_entries().empty();
+        case msg_type::install_snapshot_request:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    std::vector< ptr<asio_rpc_client> > lanes_;
+    std::mutex lock_;
+    // Index of the bulk lane currently used.
+    size_t cur_bulk_lane_;
+    // Number of bulk requests in flight.
+    size_t num_bulk_inflight_;
+};
+
 } // namespace nuraft
 
 using namespace nuraft;
@@ -1348,6 +2668,8 @@ asio_service_impl::asio_service_impl(const asio_service::options& _opt,
     , ssl_server_ctx_(ssl_context::sslv23)
     , ssl_client_ctx_(ssl_context::sslv23)
     , asio_timer_(io_svc_)
+    , timer_wheel_(nullptr)
+    , wheel_timer_(io_svc_)
     , continue_(1)
     , logger_list_lock_()
     , stopping_status_(0)
@@ -1378,6 +2700,16 @@ asio_service_impl::asio_service_impl(const asio_service::options& _opt,
 
         // For client
         ssl_client_ctx_.load_verify_file(_opt.root_cert_file_);
+
+        if (my_opt_.ssl_session_resumption_) {
+            // Sessions are kept by `ssl_sessions_` per endpoint,
+            // instead of the internal cache of OpenSSL.
+            SSL_CTX_set_session_cache_mode
+                ( ssl_client_ctx_.native_handle(),
+                  SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE );
+            SSL_CTX_sess_set_new_cb( ssl_client_ctx_.native_handle(),
+                                     &asio_rpc_client::on_new_ssl_session );
+        }
 #endif
     }
 
@@ -1391,6 +2723,12 @@ asio_service_impl::asio_service_impl(const asio_service::options& _opt,
                      this,
                      std::placeholders::_1 ) );
 
+    if (my_opt_.timer_wheel_tick_ms_) {
+        timer_wheel_ = cs_new<timer_wheel>(my_opt_.timer_wheel_tick_ms_);
+        next_wheel_tick_ = std::chrono::steady_clock::now();
+        start_wheel_timer();
+    }
+
     unsigned int cpu_cnt = _opt.thread_pool_size_;
     if (!cpu_cnt) {
         cpu_cnt = std::thread::hardware_concurrency();
@@ -1399,6 +2737,20 @@ asio_service_impl::asio_service_impl(const asio_service::options& _opt,
         cpu_cnt = 1;
     }
 
+    io_shards_.push_back(&io_svc_);
+    if (my_opt_.io_context_per_worker_) {
+        for (unsigned int i = 1; i < cpu_cnt; ++i) {
+            ptr<asio::io_service> svc = cs_new<asio::io_service>();
+            extra_io_works_.push_back( cs_new<asio::io_service::work>(*svc) );
+            extra_io_svcs_.push_back(svc);
+            io_shards_.push_back(svc.get());
+        }
+    }
+
+    if (my_opt_.metrics_http_port_) {
+        start_metrics_endpoint();
+    }
+
     for (unsigned int i = 0; i < cpu_cnt; ++i) {
         ptr<std::thread> t =
             cs_new<std::thread>( std::bind(&asio_service_impl::worker_entry, this) );
@@ -1406,11 +2758,144 @@ asio_service_impl::asio_service_impl(const asio_service::options& _opt,
     }
 }
 
+void asio_service_impl::start_metrics_endpoint() {
+    try {
+        metrics_acceptor_ = cs_new<asio::ip::tcp::acceptor>
+                            ( io_svc_,
+                              asio::ip::tcp::endpoint
+                              ( asio::ip::make_address
+                                ( my_opt_.metrics_http_address_ ),
+                                my_opt_.metrics_http_port_ ) );
+    } catch (std::exception& ee) {
+        p_er( "failed to open metrics endpoint on %s:%u: %s",
+              my_opt_.metrics_http_address_.c_str(),
+              (unsigned)my_opt_.metrics_http_port_, ee.what() );
+        metrics_acceptor_.reset();
+        return;
+    }
+    p_in( "metrics endpoint started on %s:%u",
+          my_opt_.metrics_http_address_.c_str(),
+          (unsigned)my_opt_.metrics_http_port_ );
+    accept_metrics();
+}
+
+void asio_service_impl::accept_metrics() {
+    if (!continue_ || !metrics_acceptor_->is_open()) return;
+
+    // Reply to any request with all stats, and close the connection.
+    ptr<asio::ip::tcp::socket> sock = cs_new<asio::ip::tcp::socket>(io_svc_);
+    metrics_acceptor_->async_accept
+        ( *sock,
+          [this, sock](const ERROR_CODE& err) -> void {
+        if (err) {
+            if (err == asio::error::operation_aborted) return;
+            p_wn("failed to accept metrics request: %d", err.value());
+            accept_metrics();
+            return;
+        }
+
+        ptr<asio::streambuf> req_buf = cs_new<asio::streambuf>();
+        asio::async_read_until
+            ( *sock, *req_buf, "\r\n\r\n",
+              [sock, req_buf](const ERROR_CODE& err, size_t) -> void {
+            if (err) return;
+
+            std::istream is(req_buf.get());
+            std::string method;
+            is >> method;
+
+            std::string body;
+            std::string status = "200 OK";
+            if (method == "GET") {
+                body = raft_server::get_all_stats_prometheus();
+            } else {
+                status = "405 Method Not Allowed";
+            }
+            ptr<std::string> resp = cs_new<std::string>
+                ( "HTTP/1.1 " + status + "\r\n"
+                  "Content-Type: text/plain; version=0.0.4\r\n"
+                  "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                  "Connection: close\r\n\r\n" + body );
+            asio::async_write
+                ( *sock, asio::buffer(*resp),
+                  [sock, resp](const ERROR_CODE&, size_t) -> void {
+                ERROR_CODE ec;
+                sock->shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+                sock->close(ec);
+            } );
+        } );
+
+        accept_metrics();
+    } );
+}
+
+ptr<asio_rpc_client> asio_service_impl::get_shared_client
+                     ( const std::string& host,
+                       const std::string& port,
+                       ptr<logger>& l )
+{
+    std::string key = host + ":" + port;
+    std::lock_guard<std::mutex> guard(shared_clients_lock_);
+    std::weak_ptr<asio_rpc_client>& entry = shared_clients_[key];
+    ptr<asio_rpc_client> conn = entry.lock();
+    if (conn && !conn->is_abandoned()) return conn;
+
+    // Not exist or the connection is broken, create a new one.
+    // Broken client will be released once all groups replace it.
+    std::string host_str = host;
+    std::string port_str = port;
+    conn = cs_new< asio_rpc_client >
+                 ( this,
+                   get_io_svc( std::hash<std::string>()(key) ),
+                   ssl_client_ctx_,
+                   host_str,
+                   port_str,
+                   my_opt_.enable_ssl_,
+                   l );
+    entry = conn;
+    return conn;
+}
+
 asio_service_impl::~asio_service_impl() {
     stop();
+#ifndef SSL_LIBRARY_NOT_FOUND
+    for (auto& entry: ssl_sessions_) SSL_SESSION_free(entry.second);
+    ssl_sessions_.clear();
+#endif
 }
 
 #ifndef SSL_LIBRARY_NOT_FOUND
+void asio_service_impl::load_ssl_session(const std::string& endpoint,
+                                         SSL* ssl)
+{
+    std::lock_guard<std::mutex> l(ssl_sessions_lock_);
+    auto entry = ssl_sessions_.find(endpoint);
+    if (entry == ssl_sessions_.end()) return;
+    // Give a copy, as OpenSSL marks the session of a connection
+    // as non-resumable if the connection is closed without shutdown.
+    SSL_SESSION* sess = SSL_SESSION_dup(entry->second);
+    if (!sess) return;
+    SSL_set_session(ssl, sess);
+    SSL_SESSION_free(sess);
+}
+
+void asio_service_impl::store_ssl_session(const std::string& endpoint,
+                                          SSL_SESSION* sess)
+{
+    std::lock_guard<std::mutex> l(ssl_sessions_lock_);
+    SSL_SESSION*& entry = ssl_sessions_[endpoint];
+    if (entry) SSL_SESSION_free(entry);
+    entry = sess;
+}
+
+void asio_service_impl::drop_ssl_session(const std::string& endpoint) {
+    std::lock_guard<std::mutex> l(ssl_sessions_lock_);
+    auto entry = ssl_sessions_.find(endpoint);
+    if (entry == ssl_sessions_.end()) return;
+    SSL_SESSION_free(entry->second);
+    ssl_sessions_.erase(entry);
+}
+
 std::string asio_service_impl::get_password
             ( std::size_t size,
               asio::ssl::context_base::password_purpose purpose )
@@ -1421,12 +2906,19 @@ std::string asio_service_impl::get_password
 #endif
 
 void asio_service_impl::worker_entry() {
-    std::string thread_name = "nuraft_w_" + std::to_string(worker_id_.fetch_add(1));
+    uint32_t worker_id = worker_id_.fetch_add(1);
+    std::string thread_name = "nuraft_w_" + std::to_string(worker_id);
 #ifdef __linux__
     pthread_setname_np(pthread_self(), thread_name.c_str());
 #elif __APPLE__
     pthread_setname_np(thread_name.c_str());
 #endif
+    if (my_opt_.pin_worker_threads_) {
+        set_worker_affinity(worker_id);
+    }
+
+    // Each worker runs its own io_service if there are multiple.
+    asio::io_service& io = *io_shards_[worker_id % io_shards_.size()];
 
     static std::atomic<size_t> exception_count(0);
     static timer_helper timer(60 * 1000000); // 1 min.
@@ -1435,7 +2927,7 @@ void asio_service_impl::worker_entry() {
     do {
         try {
             num_active_workers_.fetch_add(1);
-            io_svc_.run();
+            io.run();
             num_active_workers_.fetch_sub(1);
 
         } catch (std::exception& ee) {
@@ -1470,6 +2962,24 @@ void asio_service_impl::worker_entry() {
          num_active_workers_.load());
 }
 
+void asio_service_impl::set_worker_affinity(uint32_t worker_id) {
+#ifdef __linux__
+    unsigned int num_cpus = std::thread::hardware_concurrency();
+    if (!num_cpus) return;
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(worker_id % num_cpus, &cpu_set);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (rc) {
+        p_wn("failed to pin asio worker %u to cpu %u, error %d",
+             worker_id, worker_id % num_cpus, rc);
+    }
+#else
+    (void)worker_id;
+#endif
+}
+
 void asio_service_impl::timer_handler(ERROR_CODE err) {
     if (continue_.load() == 1) {
         asio_timer_.expires_after
@@ -1491,11 +3001,48 @@ void asio_service_impl::timer_handler(ERROR_CODE err) {
     }
 }
 
+void asio_service_impl::start_wheel_timer() {
+    // Based on the expected time, not the current time,
+    // so that the delay of handlers is not accumulated.
+    next_wheel_tick_ += std::chrono::milliseconds(my_opt_.timer_wheel_tick_ms_);
+    wheel_timer_.expires_at(next_wheel_tick_);
+    wheel_timer_.async_wait
+        ( std::bind( &asio_service_impl::wheel_timer_handler,
+                     this,
+                     std::placeholders::_1 ) );
+}
+
+void asio_service_impl::wheel_timer_handler(ERROR_CODE err) {
+    if (err || continue_.load() != 1) return;
+
+    std::vector< ptr<delayed_task> > expired;
+    auto now = std::chrono::steady_clock::now();
+    // Catch up on the ticks missed (if any).
+    do {
+        timer_wheel_->advance(expired);
+        if (next_wheel_tick_ + std::chrono::milliseconds
+                               (my_opt_.timer_wheel_tick_ms_) > now) break;
+        next_wheel_tick_ += std::chrono::milliseconds
+                            (my_opt_.timer_wheel_tick_ms_);
+    } while (true);
+    start_wheel_timer();
+
+    // Execute tasks by multiple workers, as the original timers do.
+    for (size_t ii = 0; ii < expired.size(); ++ii) {
+        get_io_svc(ii).post( std::bind( &delayed_task::execute, expired[ii] ) );
+    }
+}
+
 void asio_service_impl::stop() {
     int running = 1;
     if (continue_.compare_exchange_strong(running, 0)) {
         std::unique_lock<std::mutex> lock(stopping_lock_);
         asio_timer_.cancel();
+        wheel_timer_.cancel();
+        if (metrics_acceptor_) {
+            ERROR_CODE ec;
+            metrics_acceptor_->close(ec);
+        }
 
         uint8_t exp = 0;
         if (stopping_status_.compare_exchange_strong(exp, 1)) {
@@ -1508,9 +3055,11 @@ void asio_service_impl::stop() {
     // Stop all workers.
     stopping_status_ = 1;
 
-    io_svc_.stop();
-    while (!io_svc_.stopped()) {
-        std::this_thread::yield();
+    for (asio::io_service* io: io_shards_) {
+        io->stop();
+        while (!io->stopped()) {
+            std::this_thread::yield();
+        }
     }
 
     for (ptr<std::thread>& t: worker_handles_) {
@@ -1530,8 +3079,15 @@ asio_service::~asio_service() {
 }
 
 void asio_service::schedule(ptr<delayed_task>& task, int32 milliseconds) {
+    if (impl_->timer_wheel_) {
+        impl_->timer_wheel_->schedule(task, milliseconds);
+        return;
+    }
+
     if (task->get_impl_context() == nilptr) {
-        task->set_impl_context( new asio::steady_timer(impl_->io_svc_),
+        // Spread timers over io_services (if multiple).
+        size_t hash = reinterpret_cast<uintptr_t>(task.get()) >> 4;
+        task->set_impl_context( new asio::steady_timer(impl_->get_io_svc(hash)),
                                 &_free_timer_ );
     }
     // ensure it's not in cancelled state
@@ -1548,6 +3104,11 @@ void asio_service::schedule(ptr<delayed_task>& task, int32 milliseconds) {
 }
 
 void asio_service::cancel_impl(ptr<delayed_task>& task) {
+    if (impl_->timer_wheel_) {
+        impl_->timer_wheel_->cancel(task);
+        return;
+    }
+
     if (task->get_impl_context() != nilptr) {
         static_cast<asio::steady_timer*>( task->get_impl_context() )->cancel();
     }
@@ -1562,52 +3123,47 @@ uint32_t asio_service::get_active_workers() {
 }
 
 ptr<rpc_client> asio_service::create_client(const std::string& endpoint) {
-    // NOTE:
-    //   Abandoned regular expression due to bug in GCC < 4.9.
-    //   And also support `endpoint` which doesn't start with `tcp://`.
-#if 0
-    // the endpoint is expecting to be protocol://host:port,
-    // and we only support tcp for this factory
-    // which is endpoint must be tcp://hostname:port
-    static std::regex reg("^tcp://(([a-zA-Z0-9\\-]+\\.)*([a-zA-Z0-9]+)):([0-9]+)$");
-    std::smatch mresults;
-    if (!std::regex_match(endpoint, mresults, reg) || mresults.size() != 5) {
-        return ptr<rpc_client>();
-    }
-#endif
-    bool valid_address = false;
     std::string hostname;
     std::string port;
-    size_t pos = endpoint.rfind(":");
-    do {
-        if (pos == std::string::npos) break;
-        int port_num = std::stoi( endpoint.substr(pos + 1) );
-        if (!port_num) break;
-        port = std::to_string( port_num );
-
-        size_t pos2 = endpoint.rfind("://", pos - 1);
-        hostname = (pos2 == std::string::npos)
-                   ? endpoint.substr(0, pos)
-                   : endpoint.substr(pos2 + 3, pos - pos2 - 3);
-
-        if (hostname.empty()) break;
-        valid_address = true;
-
-    } while (false);
-
-    if (!valid_address) {
+    if (!parse_endpoint(endpoint, hostname, port)) {
         p_er("invalid endpoint: %s", endpoint.c_str());
         return ptr<rpc_client>();
     }
 
-    return cs_new< asio_rpc_client >
-                 ( impl_,
-                   impl_->io_svc_,
-                   impl_->ssl_client_ctx_,
-                   hostname,
-                   port,
-                   impl_->my_opt_.enable_ssl_,
-                   l_ );
+    // Clients to the same endpoint are pinned to the same io_service.
+    size_t hash = std::hash<std::string>()(hostname + ":" + port);
+    size_t num_lanes = impl_->my_opt_.connections_per_peer_;
+    if (num_lanes <= 1) {
+        return cs_new< asio_rpc_client >
+                     ( impl_,
+                       impl_->get_io_svc(hash),
+                       impl_->ssl_client_ctx_,
+                       hostname,
+                       port,
+                       impl_->my_opt_.enable_ssl_,
+                       l_ );
+    }
+
+    std::vector< ptr<asio_rpc_client> > lanes;
+    for (size_t ii = 0; ii < num_lanes; ++ii) {
+        lanes.push_back( cs_new< asio_rpc_client >
+                               ( impl_,
+                                 impl_->get_io_svc(hash + ii),
+                                 impl_->ssl_client_ctx_,
+                                 hostname,
+                                 port,
+                                 impl_->my_opt_.enable_ssl_,
+                                 l_ ) );
+    }
+    return cs_new< asio_lane_rpc_client >(lanes);
+}
+
+ptr<rpc_client_factory> asio_service::create_group_client_factory(int32 group_id) {
+    if (group_id < 0) {
+        p_er("invalid group ID: %d", group_id);
+        return nullptr;
+    }
+    return cs_new<asio_group_client_factory>(impl_, group_id, l_);
 }
 
 ptr<rpc_listener> asio_service::create_rpc_listener( ushort listening_port,
@@ -1618,7 +3174,8 @@ ptr<rpc_listener> asio_service::create_rpc_listener( ushort listening_port,
                      ( impl_,
                        impl_->io_svc_,
                        impl_->ssl_server_ctx_,
-                       listening_port,
+                       asio::ip::tcp::endpoint( asio::ip::tcp::v4(),
+                                                listening_port ),
                        impl_->my_opt_.enable_ssl_,
                        l );
     } catch (std::exception& ee) {
@@ -1628,3 +3185,37 @@ ptr<rpc_listener> asio_service::create_rpc_listener( ushort listening_port,
     }
 }
 
+ptr<rpc_listener> asio_service::create_rpc_listener( const std::string& endpoint,
+                                                     ptr<logger>& l )
+{
+    std::string hostname;
+    std::string port;
+    if (!parse_endpoint(endpoint, hostname, port)) {
+        p_er("invalid endpoint: %s", endpoint.c_str());
+        return nullptr;
+    }
+    if (!port.empty()) {
+        return create_rpc_listener( (ushort)std::stoi(port), l );
+    }
+
+#ifdef LOCAL_SOCKETS_SUPPORTED
+    try {
+        // Remove the socket file left by the previous process, if any.
+        ::unlink(hostname.c_str());
+        return cs_new< asio_rpc_listener >
+                     ( impl_,
+                       impl_->io_svc_,
+                       impl_->ssl_server_ctx_,
+                       asio::local::stream_protocol::endpoint(hostname),
+                       impl_->my_opt_.enable_ssl_,
+                       l );
+    } catch (std::exception& ee) {
+        p_er("got exception: %s", ee.what());
+        return nullptr;
+    }
+#else
+    p_er("Unix domain socket is not supported: %s", endpoint.c_str());
+    return nullptr;
+#endif
+}
+
@@ -0,0 +1,209 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "async_logger.hxx"
+
+#include <chrono>
+
+namespace nuraft {
+
+async_logger::async_logger(const ptr<logger>& backend, const options& opt)
+    : backend_(backend)
+    , opt_(opt)
+    , level_(backend ? backend->get_level() : 0)
+    , mask_(0)
+    , tail_(0)
+    , head_(0)
+    , num_dropped_(0)
+    , num_producers_(0)
+    , sleeping_(false)
+    , stopping_(false)
+{
+    size_t size = 1;
+    while (size < opt_.queue_size_) size <<= 1;
+    mask_ = size - 1;
+
+    std::vector<entry> q(size);
+    queue_.swap(q);
+    for (size_t ii = 0; ii < size; ++ii) queue_[ii].seq_ = ii;
+
+    flusher_ = std::thread(&async_logger::flush_loop, this);
+}
+
+async_logger::~async_logger() {
+    stop();
+}
+
+void async_logger::set_level(int l) {
+    level_ = l;
+    if (backend_) backend_->set_level(l);
+}
+
+void async_logger::put_details(int level,
+                               const char* source_file,
+                               const char* func_name,
+                               size_t line_number,
+                               const std::string& log_line)
+{
+    if (!backend_ || level > get_level()) return;
+
+    if (level <= 1) {
+        // Fatal log should not be lost even if the process dies right
+        // after this call. Write it on the caller's thread, after all
+        // the previous logs.
+        flush();
+        backend_->put_details( level, source_file, func_name,
+                               line_number, log_line );
+        return;
+    }
+
+    // Registered as a producer first, so that `stop` can wait for
+    // the logs being queued at the moment.
+    num_producers_.fetch_add(1);
+    if (!stopping_) {
+        bool queued =
+            enqueue(level, source_file, func_name, line_number, log_line);
+        num_producers_.fetch_sub(1);
+
+        if (queued) {
+            if (sleeping_) {
+                std::lock_guard<std::mutex> l(lock_);
+                cv_.notify_one();
+            }
+            return;
+        }
+
+        num_dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    } else {
+        num_producers_.fetch_sub(1);
+    }
+    backend_->put_details(level, source_file, func_name, line_number, log_line);
+}
+
+bool async_logger::enqueue(int level,
+                           const char* source_file,
+                           const char* func_name,
+                           size_t line_number,
+                           const std::string& log_line)
+{
+    // Bounded MPSC queue: each slot has a sequence number, which tells
+    // whether the slot is free for position `pos` (`seq == pos`), or
+    // filled for the reader (`seq == pos + 1`).
+    uint64_t pos = tail_.load(std::memory_order_relaxed);
+    entry* e = nullptr;
+    while (true) {
+        e = &queue_[pos & mask_];
+        uint64_t seq = e->seq_.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)seq - (int64_t)pos;
+        if (diff == 0) {
+            if ( tail_.compare_exchange_weak( pos, pos + 1,
+                                              std::memory_order_relaxed ) ) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Full.
+            return false;
+        } else {
+            pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+
+    e->level_ = level;
+    e->source_file_ = source_file;
+    e->func_name_ = func_name;
+    e->line_number_ = line_number;
+    e->log_line_ = log_line;
+    // Should be sequentially consistent with the check of `sleeping_`.
+    e->seq_.store(pos + 1);
+    return true;
+}
+
+size_t async_logger::dequeue_all() {
+    size_t num = 0;
+    uint64_t pos = head_.load(std::memory_order_relaxed);
+    while (true) {
+        entry& e = queue_[pos & mask_];
+        if (e.seq_.load(std::memory_order_acquire) != pos + 1) break;
+
+        backend_->put_details( e.level_, e.source_file_, e.func_name_,
+                               e.line_number_, e.log_line_ );
+        e.log_line_.clear();
+        e.seq_.store(pos + mask_ + 1, std::memory_order_release);
+        head_.store(++pos, std::memory_order_release);
+        num++;
+    }
+    return num;
+}
+
+void async_logger::flush_loop() {
+    std::string thread_name = "nuraft_logger";
+#ifdef __linux__
+    pthread_setname_np(pthread_self(), thread_name.c_str());
+#elif __APPLE__
+    pthread_setname_np(thread_name.c_str());
+#endif
+
+    while (true) {
+        if (backend_ && dequeue_all()) {
+            std::lock_guard<std::mutex> l(lock_);
+            flushed_cv_.notify_all();
+            continue;
+        }
+        if (stopping_) break;
+
+        std::unique_lock<std::mutex> l(lock_);
+        sleeping_ = true;
+        uint64_t pos = head_.load(std::memory_order_relaxed);
+        if ( queue_[pos & mask_].seq_.load() != pos + 1 &&
+             !stopping_ ) {
+            cv_.wait_for(l, std::chrono::milliseconds(opt_.flush_interval_ms_));
+        }
+        sleeping_ = false;
+    }
+}
+
+void async_logger::flush() {
+    // Once stopped, the remaining logs are drained by `stop`.
+    if (!backend_ || stopping_) return;
+
+    uint64_t target = tail_.load();
+    std::unique_lock<std::mutex> l(lock_);
+    while ( head_.load(std::memory_order_acquire) < target &&
+            !stopping_ ) {
+        cv_.notify_one();
+        flushed_cv_.wait_for(l, std::chrono::milliseconds(10));
+    }
+}
+
+void async_logger::stop() {
+    {   std::lock_guard<std::mutex> l(lock_);
+        if (!flusher_.joinable()) return;
+        stopping_ = true;
+        cv_.notify_one();
+    }
+    flusher_.join();
+
+    // Producers that saw `stopping_ == false` may be queueing logs
+    // even after the background thread exits. Wait for them, and then
+    // drain the rest.
+    while (num_producers_.load()) std::this_thread::yield();
+    if (backend_) dequeue_all();
+}
+
+}
+
@@ -0,0 +1,111 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "batch_size_controller.hxx"
+
+#include <algorithm>
+#include <chrono>
+
+namespace nuraft {
+
+// Lower bound of the limit, to avoid degenerating into
+// sending one tiny log at a time.
+static const size_t MIN_BATCH_BYTES = 4096;
+
+static uint64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>
+           ( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+batch_size_controller::batch_size_controller(uint64_t target_latency_us)
+    : target_us_(target_latency_us)
+    , max_bytes_(0)
+    , avg_tput_(0)
+    {}
+
+size_t batch_size_controller::get_max_bytes() {
+    std::lock_guard<std::mutex> l(lock_);
+    return max_bytes_;
+}
+
+void batch_size_controller::set_target_latency_us(uint64_t target_latency_us) {
+    std::lock_guard<std::mutex> l(lock_);
+    target_us_ = target_latency_us;
+}
+
+void batch_size_controller::on_sent(ulong last_idx,
+                                    size_t num_bytes,
+                                    bool is_full)
+{
+    std::lock_guard<std::mutex> l(lock_);
+    if (!inflight_.empty() && inflight_.back().last_idx_ >= last_idx) {
+        // Re-sending the same (or older) logs, earlier ones are void.
+        inflight_.clear();
+    }
+    inflight ii;
+    ii.last_idx_ = last_idx;
+    ii.num_bytes_ = num_bytes;
+    ii.is_full_ = is_full;
+    ii.sent_us_ = now_us();
+    inflight_.push_back(ii);
+}
+
+void batch_size_controller::on_acked(ulong matched_idx) {
+    std::lock_guard<std::mutex> l(lock_);
+    uint64_t now = now_us();
+    while (!inflight_.empty() && inflight_.front().last_idx_ <= matched_idx) {
+        inflight ii = inflight_.front();
+        inflight_.pop_front();
+        if (ii.last_idx_ == matched_idx) {
+            adjust(ii, now - ii.sent_us_);
+        }
+    }
+}
+
+void batch_size_controller::reset() {
+    std::lock_guard<std::mutex> l(lock_);
+    inflight_.clear();
+}
+
+void batch_size_controller::adjust(const inflight& ii, uint64_t latency_us) {
+    if (!target_us_ || !ii.num_bytes_) return;
+    latency_us = std::max(latency_us, (uint64_t)1);
+
+    if (latency_us > target_us_) {
+        // Too slow, shrink in proportion to the excess.
+        size_t base = max_bytes_ ? std::min(max_bytes_, ii.num_bytes_)
+                                 : ii.num_bytes_;
+        max_bytes_ = std::max( MIN_BATCH_BYTES,
+                               (size_t)( (double)base * target_us_ /
+                                         latency_us ) );
+        return;
+    }
+
+    if (!ii.is_full_) return;
+
+    double tput = (double)ii.num_bytes_ * 1000000 / latency_us;
+    bool tput_dropped = (avg_tput_ > 0 && tput < avg_tput_ * 0.9);
+    avg_tput_ = (avg_tput_ > 0) ? avg_tput_ * 0.8 + tput * 0.2 : tput;
+
+    if (max_bytes_ && !tput_dropped) {
+        // Fast enough, a bigger batch may give more throughput.
+        max_bytes_ += max_bytes_ / 4;
+    }
+}
+
+}
+
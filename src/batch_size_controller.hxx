@@ -0,0 +1,108 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include "basic_types.hxx"
+#include "pp_util.hxx"
+
+#include <deque>
+#include <mutex>
+
+namespace nuraft {
+
+/**
+ * Adaptive size limit of append entries requests to a peer.
+ *
+ * The limit is the total payload size of a batch, tuned by the
+ * observed latency between sending a batch and receiving its
+ * acknowledgement:
+ *   - If the latency exceeds the target, the limit is scaled down
+ *     in proportion to the excess (multiplicative decrease).
+ *   - If a full-size batch is acknowledged within the target, and
+ *     the throughput has not dropped, the limit grows by 1/4.
+ *
+ * Until the first batch exceeding the target is observed, there is
+ * no limit (other than the max number of logs given by the caller).
+ *
+ * Multiple batches can be in flight (pipelining), and they are
+ * matched with the acknowledgements by their last log index.
+ */
+class batch_size_controller {
+public:
+    batch_size_controller(uint64_t target_latency_us);
+
+    __nocopy__(batch_size_controller);
+
+public:
+    /**
+     * Current limit of the payload size of a batch.
+     *
+     * @return Size in bytes. 0 if no limit.
+     */
+    size_t get_max_bytes();
+
+    /**
+     * Update the target latency.
+     */
+    void set_target_latency_us(uint64_t target_latency_us);
+
+    /**
+     * Called when a batch is sent.
+     *
+     * @param last_idx Last log index of the batch.
+     * @param num_bytes Total payload size of the batch.
+     * @param is_full `true` if the batch was cut by a limit,
+     *                rather than by running out of logs.
+     */
+    void on_sent(ulong last_idx, size_t num_bytes, bool is_full);
+
+    /**
+     * Called when the peer has accepted logs up to `matched_idx`.
+     */
+    void on_acked(ulong matched_idx);
+
+    /**
+     * Forget in-flight batches (e.g., rejected or network error).
+     */
+    void reset();
+
+private:
+    struct inflight {
+        ulong last_idx_;
+        size_t num_bytes_;
+        bool is_full_;
+        uint64_t sent_us_;
+    };
+
+    void adjust(const inflight& ii, uint64_t latency_us);
+
+    std::mutex lock_;
+
+    std::deque<inflight> inflight_;
+
+    uint64_t target_us_;
+
+    // Current limit in bytes, 0 if no limit.
+    size_t max_bytes_;
+
+    // Moving average of throughput of full batches, in bytes per second.
+    double avg_tput_;
+};
+
+}
+
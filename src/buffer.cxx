@@ -19,61 +19,88 @@ limitations under the License.
 **************************************************************************/
 
 #include "buffer.hxx"
+#include "buffer_allocator.hxx"
 #include "stat_mgr.hxx"
 
+#include <atomic>
 #include <cstring>
 #include <iostream>
+#include <mutex>
+#include <vector>
 
-#define __is_big_block(p)       ( 0x80000000 & *( (uint*)(p) ) )
+// Meta section of a view made by `view_in_place` may not be aligned,
+// thus it is accessed through `memcpy`.
+#define __get_meta(p, type, idx)                                        \
+    ( nuraft::load_meta<type>( (const char*)(p) + sizeof(type) * (idx) ) )
+
+#define __put_meta(p, type, idx, val)                                   \
+    nuraft::store_meta<type>( (char*)(p) + sizeof(type) * (idx),       \
+                              (type)(val) )
+
+#define __is_big_block(p)       ( 0x80000000 & __get_meta(p, uint, 0) )
 
 #define __init_block(ptr, len, type)                                \
-                                ( (type*)(ptr) )[0] = (type)len;    \
-                                ( (type*)(ptr) )[1] = 0
+                                __put_meta(ptr, type, 0, len);      \
+                                __put_meta(ptr, type, 1, 0)
 
 #define __init_s_block(p, l)    __init_block(p, l, ushort)
 
-#define __init_b_block(p, l)    __init_block(p, l, uint);   \
-                                *( (uint*)(p) ) |= 0x80000000
+#define __init_b_block(p, l)    __init_block(p, (uint)(l) | 0x80000000, uint)
 
-#define __pos_of_s_block(p)     ( (ushort*)(p) )[1]
+#define __pos_of_s_block(p)     __get_meta(p, ushort, 1)
 
-#define __pos_of_b_block(p)     ( (uint*)(p) )[1]
+#define __pos_of_b_block(p)     __get_meta(p, uint, 1)
 
-#define __size_of_block(p)      ( __is_big_block(p) )               \
-                                ? ( *( (uint*)(p) ) ^ 0x80000000 )  \
-                                : *( (ushort*)(p) )
+#define __size_of_block(p)      ( ( __is_big_block(p) )                     \
+                                  ? ( __get_meta(p, uint, 0) ^ 0x80000000 ) \
+                                  : __get_meta(p, ushort, 0) )
 
-#define __pos_of_block(p)       ( __is_big_block(p) )   \
-                                ? __pos_of_b_block(p)   \
-                                : __pos_of_s_block(p)
+#define __pos_of_block(p)       ( ( __is_big_block(p) )     \
+                                  ? __pos_of_b_block(p)     \
+                                  : __pos_of_s_block(p) )
 
-#define __mv_fw_block(ptr, delta)                   \
-    if ( __is_big_block(ptr) ) {                    \
-        ( (uint*)(ptr) )[1] += (delta);             \
-    } else {                                        \
-        ( (ushort*)(ptr) )[1] += (ushort)(delta);   \
+#define __mv_fw_block(ptr, delta)                                       \
+    if ( __is_big_block(ptr) ) {                                        \
+        __put_meta(ptr, uint, 1, __pos_of_b_block(ptr) + (delta));      \
+    } else {                                                            \
+        __put_meta(ptr, ushort, 1, __pos_of_s_block(ptr) + (delta));    \
     }
 
 #define __set_block_pos(ptr, pos)               \
     if( __is_big_block(ptr) ){                  \
-        ( (uint*)(ptr) )[1] = (pos);            \
+        __put_meta(ptr, uint, 1, pos);          \
     } else {                                    \
-        ( (ushort*)(ptr) )[1] = (ushort)(pos);  \
+        __put_meta(ptr, ushort, 1, pos);        \
     }
 
 #define __data_of_block(p)                                                  \
     ( __is_big_block(p) )                                                   \
-    ? (byte*)( ( (byte*)( ((uint*)(p))   + 2 ) ) + __pos_of_b_block(p) )    \
-    : (byte*)( ( (byte*)( ((ushort*)(p)) + 2 ) ) + __pos_of_s_block(p) )
+    ? ( (byte*)(p) + sizeof(uint) * 2 + __pos_of_b_block(p) )               \
+    : ( (byte*)(p) + sizeof(ushort) * 2 + __pos_of_s_block(p) )
 
 #define __entire_data_of_block(p)               \
     ( __is_big_block(p) )                       \
-    ? (byte*)( (byte*)( ((uint*)(p))   + 2 ) )  \
-    : (byte*)( (byte*)( ((ushort*)(p)) + 2 ) )
+    ? ( (byte*)(p) + sizeof(uint) * 2 )         \
+    : ( (byte*)(p) + sizeof(ushort) * 2 )
 
 namespace nuraft {
 
-static void free_buffer(buffer* buf) {
+template<typename T>
+static inline T load_meta(const char* src) {
+    T val;
+    ::memcpy(&val, src, sizeof(T));
+    return val;
+}
+
+template<typename T>
+static inline void store_meta(char* dst, T val) {
+    ::memcpy(dst, &val, sizeof(T));
+}
+
+// Allocator set by `set_allocator`, `nullptr` if default.
+static std::atomic<buffer_allocator*> cur_allocator(nullptr);
+
+static void dec_active_stats(buffer* buf) {
     static stat_elem& num_active = *stat_mgr::get_instance()->create_stat
         (stat_elem::COUNTER, "num_active_buffers");
     static stat_elem& amount_active = *stat_mgr::get_instance()->create_stat
@@ -81,10 +108,48 @@ static void free_buffer(buffer* buf) {
 
     num_active--;
     amount_active -= buf->container_size();
+}
 
+static void free_buffer(buffer* buf) {
+    dec_active_stats(buf);
     delete[] reinterpret_cast<char*>(buf);
 }
 
+struct allocator_deleter {
+    allocator_deleter(buffer_allocator* a) : allocator_(a) {}
+
+    void operator()(buffer* buf) const {
+        size_t len = buf->container_size();
+        dec_active_stats(buf);
+        allocator_->deallocate(buf, len);
+    }
+
+    buffer_allocator* allocator_;
+};
+
+static ptr<buffer> alloc_container(size_t len) {
+    buffer_allocator* allocator = cur_allocator.load(std::memory_order_acquire);
+    if (!allocator) {
+        return ptr<buffer>( reinterpret_cast<buffer*>(new char[len]),
+                            &free_buffer );
+    }
+    return ptr<buffer>
+           ( reinterpret_cast<buffer*>(allocator->allocate(len)),
+             allocator_deleter(allocator) );
+}
+
+void buffer::set_allocator(const ptr<buffer_allocator>& allocator) {
+    // Allocators are never released, as there may be
+    // alive buffers allocated by them (even at exit).
+    static std::mutex lock;
+    static std::vector< ptr<buffer_allocator> >* allocators =
+        new std::vector< ptr<buffer_allocator> >();
+
+    std::lock_guard<std::mutex> l(lock);
+    if (allocator) allocators->push_back(allocator);
+    cur_allocator.store(allocator.get(), std::memory_order_release);
+}
+
 ptr<buffer> buffer::alloc(const size_t size) {
     static stat_elem& num_allocs = *stat_mgr::get_instance()->create_stat
         (stat_elem::COUNTER, "num_buffer_allocs");
@@ -104,8 +169,7 @@ ptr<buffer> buffer::alloc(const size_t size) {
 
     if (size >= 0x8000) {
         size_t len = size + sizeof(uint) * 2;
-        ptr<buffer> buf( reinterpret_cast<buffer*>(new char[len]),
-                         &free_buffer );
+        ptr<buffer> buf = alloc_container(len);
         amount_allocs += len;
         amount_active += len;
 
@@ -115,8 +179,7 @@ ptr<buffer> buffer::alloc(const size_t size) {
     }
 
     size_t len = size + sizeof(ushort) * 2;
-    ptr<buffer> buf( reinterpret_cast<buffer*>(new char[len]),
-                     &free_buffer );
+    ptr<buffer> buf = alloc_container(len);
     amount_allocs += len;
     amount_active += len;
 
@@ -144,6 +207,39 @@ ptr<buffer> buffer::clone(const buffer& buf) {
     return other;
 }
 
+ptr<buffer> buffer::view_in_place(const ptr<buffer>& src,
+                                  size_t offset,
+                                  size_t len)
+{
+    size_t meta_size = view_meta_size(len);
+    if ( !src ||
+         offset < meta_size ||
+         offset + len > src->size() ) {
+        return nullptr;
+    }
+
+    // Make the meta section right before the data,
+    // and share the ownership of the source buffer.
+    buffer* view = make_in_place( src->data_begin() + offset - meta_size, len );
+    return nuraft::ptr<buffer>(src, view);
+}
+
+buffer* buffer::make_in_place(void* mem, size_t len) {
+    any_ptr ptr = reinterpret_cast<any_ptr>(mem);
+    if (len >= 0x8000) {
+        __init_b_block(ptr, len);
+    } else {
+        __init_s_block(ptr, len);
+    }
+    return reinterpret_cast<buffer*>(ptr);
+}
+
+size_t buffer::view_meta_size(size_t len) {
+    return ( len >= 0x8000 )
+           ? sizeof(uint) * 2
+           : sizeof(ushort) * 2;
+}
+
 size_t buffer::container_size() const {
     return (size_t)( __size_of_block(this) +
                      ( ( __is_big_block(this) )
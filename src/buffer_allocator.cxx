@@ -0,0 +1,118 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "buffer_allocator.hxx"
+
+#include "stat_mgr.hxx"
+
+#include <vector>
+
+namespace nuraft {
+
+// 64 bytes ~ 64 KB.
+static const size_t MIN_CLASS_BITS = 6;
+static const size_t NUM_CLASSES = 11;
+
+// Set when the cache of this thread has been destroyed,
+// as buffers can be freed later during the thread exit.
+static thread_local bool tl_cache_destroyed = false;
+
+struct thread_cache {
+    ~thread_cache() {
+        release();
+        tl_cache_destroyed = true;
+    }
+
+    void release() {
+        for (std::vector<char*>& list: lists_) {
+            for (char* block: list) delete[] block;
+            list.clear();
+        }
+    }
+
+    std::vector<char*> lists_[NUM_CLASSES];
+};
+
+static thread_cache* get_thread_cache() {
+    if (tl_cache_destroyed) return nullptr;
+    static thread_local thread_cache cache;
+    return &cache;
+}
+
+// Return `NUM_CLASSES` if it is not pooled.
+static size_t class_of(size_t len) {
+    if (len > buffer_pool::MAX_BLOCK_SIZE) return NUM_CLASSES;
+    size_t cls = 0;
+    size_t block_size = buffer_pool::MIN_BLOCK_SIZE;
+    while (block_size < len) {
+        block_size <<= 1;
+        cls++;
+    }
+    return cls;
+}
+
+buffer_pool::buffer_pool(size_t max_cached_bytes_per_class)
+    : max_cached_bytes_(max_cached_bytes_per_class)
+    {}
+
+void* buffer_pool::allocate(size_t len) {
+    static stat_elem& num_hits = *stat_mgr::get_instance()->create_stat
+        (stat_elem::COUNTER, "buffer_pool_hits");
+    static stat_elem& num_misses = *stat_mgr::get_instance()->create_stat
+        (stat_elem::COUNTER, "buffer_pool_misses");
+
+    size_t cls = class_of(len);
+    if (cls >= NUM_CLASSES) {
+        num_misses++;
+        return new char[len];
+    }
+
+    thread_cache* cache = get_thread_cache();
+    if (cache && !cache->lists_[cls].empty()) {
+        char* block = cache->lists_[cls].back();
+        cache->lists_[cls].pop_back();
+        num_hits++;
+        return block;
+    }
+    num_misses++;
+    return new char[MIN_BLOCK_SIZE << cls];
+}
+
+void buffer_pool::deallocate(void* ptr, size_t len) {
+    char* block = static_cast<char*>(ptr);
+    size_t cls = class_of(len);
+    if (cls >= NUM_CLASSES) {
+        delete[] block;
+        return;
+    }
+
+    thread_cache* cache = get_thread_cache();
+    size_t max_blocks = max_cached_bytes_ / (MIN_BLOCK_SIZE << cls);
+    if (!cache || cache->lists_[cls].size() >= max_blocks) {
+        delete[] block;
+        return;
+    }
+    cache->lists_[cls].push_back(block);
+}
+
+void buffer_pool::release_thread_cache() {
+    thread_cache* cache = get_thread_cache();
+    if (cache) cache->release();
+}
+
+}
+
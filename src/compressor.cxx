@@ -0,0 +1,149 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "compressor.hxx"
+
+#ifdef USE_LZ4
+    #include <lz4.h>
+#endif
+#ifdef USE_ZSTD
+    #include <zstd.h>
+#endif
+#ifdef USE_ZLIB
+    #include <zlib.h>
+#endif
+
+#include <cstring>
+#include <limits>
+
+namespace nuraft {
+
+#if defined(USE_LZ4) || defined(USE_ZSTD) || defined(USE_ZLIB)
+// Copy the first `len` bytes of the given buffer into a new one.
+static ptr<buffer> shrink(const ptr<buffer>& src, size_t len) {
+    ptr<buffer> ret = buffer::alloc(len);
+    ::memcpy(ret->data_begin(), src->data_begin(), len);
+    return ret;
+}
+#endif
+
+bool compressor::is_available(codec cc) {
+    switch (cc) {
+#ifdef USE_LZ4
+    case lz4:   return true;
+#endif
+#ifdef USE_ZSTD
+    case zstd:  return true;
+#endif
+#ifdef USE_ZLIB
+    case zlib:  return true;
+#endif
+    default:    return false;
+    }
+}
+
+ptr<buffer> compressor::compress(codec cc,
+                                 int level,
+                                 const void* data,
+                                 size_t len)
+{
+    if (len > (size_t)std::numeric_limits<int32>::max()) return nullptr;
+
+    switch (cc) {
+#ifdef USE_LZ4
+    case lz4: {
+        int bound = LZ4_compressBound((int)len);
+        ptr<buffer> out = buffer::alloc(bound);
+        // For LZ4, level is the acceleration factor.
+        int sz = LZ4_compress_fast( (const char*)data, (char*)out->data_begin(),
+                                    (int)len, bound, level > 0 ? level : 1 );
+        if (sz <= 0) return nullptr;
+        return shrink(out, sz);
+    }
+#endif
+#ifdef USE_ZSTD
+    case zstd: {
+        size_t bound = ZSTD_compressBound(len);
+        ptr<buffer> out = buffer::alloc(bound);
+        size_t sz = ZSTD_compress( out->data_begin(), bound, data, len,
+                                   level > 0 ? level : ZSTD_CLEVEL_DEFAULT );
+        if (ZSTD_isError(sz)) return nullptr;
+        return shrink(out, sz);
+    }
+#endif
+#ifdef USE_ZLIB
+    case zlib: {
+        uLongf bound = compressBound(len);
+        ptr<buffer> out = buffer::alloc(bound);
+        int rc = compress2( (Bytef*)out->data_begin(), &bound,
+                            (const Bytef*)data, len,
+                            level > 0 ? level : Z_DEFAULT_COMPRESSION );
+        if (rc != Z_OK) return nullptr;
+        return shrink(out, bound);
+    }
+#endif
+    default:
+        (void)level;
+        (void)data;
+        return nullptr;
+    }
+}
+
+ptr<buffer> compressor::decompress(codec cc,
+                                   const void* data,
+                                   size_t len,
+                                   size_t raw_len)
+{
+    if (len > (size_t)std::numeric_limits<int32>::max()) return nullptr;
+
+    switch (cc) {
+#ifdef USE_LZ4
+    case lz4: {
+        ptr<buffer> out = buffer::alloc(raw_len);
+        int sz = LZ4_decompress_safe( (const char*)data, (char*)out->data_begin(),
+                                      (int)len, (int)raw_len );
+        if (sz < 0 || (size_t)sz != raw_len) return nullptr;
+        return out;
+    }
+#endif
+#ifdef USE_ZSTD
+    case zstd: {
+        ptr<buffer> out = buffer::alloc(raw_len);
+        size_t sz = ZSTD_decompress(out->data_begin(), raw_len, data, len);
+        if (ZSTD_isError(sz) || sz != raw_len) return nullptr;
+        return out;
+    }
+#endif
+#ifdef USE_ZLIB
+    case zlib: {
+        ptr<buffer> out = buffer::alloc(raw_len);
+        uLongf sz = raw_len;
+        int rc = uncompress( (Bytef*)out->data_begin(), &sz,
+                             (const Bytef*)data, len );
+        if (rc != Z_OK || sz != raw_len) return nullptr;
+        return out;
+    }
+#endif
+    default:
+        (void)data;
+        (void)raw_len;
+        return nullptr;
+    }
+}
+
+}
+
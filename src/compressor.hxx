@@ -0,0 +1,80 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include "buffer.hxx"
+#include "ptr.hxx"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace nuraft {
+
+/**
+ * Wrapper of compression libraries, enabled at build time
+ * (`USE_LZ4`, `USE_ZSTD`, and `USE_ZLIB`).
+ * Values of codecs are the same as
+ * `asio_service_options::compression_type`.
+ */
+class compressor {
+public:
+    enum codec {
+        none = 0x0,
+        lz4 = 0x1,
+        zstd = 0x2,
+        zlib = 0x3,
+    };
+
+    /**
+     * Check if the given codec is available in this build.
+     */
+    static bool is_available(codec cc);
+
+    /**
+     * Compress the given data.
+     *
+     * @param cc Codec.
+     * @param level Compression level, 0 for the default of the codec.
+     * @param data Data to compress.
+     * @param len Length of the data.
+     * @return Compressed data. `nullptr` if failed, or the codec
+     *         is not available.
+     */
+    static ptr<buffer> compress(codec cc,
+                                int level,
+                                const void* data,
+                                size_t len);
+
+    /**
+     * Decompress the given data.
+     *
+     * @param cc Codec.
+     * @param data Compressed data.
+     * @param len Length of the compressed data.
+     * @param raw_len Length of the original data.
+     * @return Original data. `nullptr` if failed, or the codec
+     *         is not available.
+     */
+    static ptr<buffer> decompress(codec cc,
+                                  const void* data,
+                                  size_t len,
+                                  size_t raw_len);
+};
+
+}
+
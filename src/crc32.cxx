@@ -385,3 +385,142 @@ uint32_t crc32_8_last8(const void* data, size_t len, uint32_t prev_value) {
 
 // LCOV_EXCL_STOP
 
+// === CRC32C (Castagnoli) ===
+
+#define CRC32C_POLY (0x82F63B78)
+
+// Slicing-by-8 table, generated at start-up.
+struct crc32c_table {
+    crc32c_table() {
+        for (uint32_t ii = 0; ii <= 0xFF; ++ii) {
+            uint32_t crc = ii;
+            for (int jj = 0; jj < 8; ++jj) {
+                crc = (crc >> 1) ^ ((crc & 1) * CRC32C_POLY);
+            }
+            lookup[0][ii] = crc;
+        }
+        for (uint32_t ii = 0; ii <= 0xFF; ++ii) {
+            for (int slice = 1; slice < 8; ++slice) {
+                uint32_t prev = lookup[slice - 1][ii];
+                lookup[slice][ii] = (prev >> 8) ^ lookup[0][prev & 0xFF];
+            }
+        }
+    }
+    uint32_t lookup[8][256];
+};
+static const crc32c_table& get_crc32c_table() {
+    static const crc32c_table table;
+    return table;
+}
+
+uint32_t crc32c_sw(const void* data, size_t len, uint32_t prev_value) {
+    const uint8_t* cur = (const uint8_t*)data;
+    uint32_t crc = ~prev_value;
+    const uint32_t (*lookup)[256] = get_crc32c_table().lookup;
+
+    while (len >= 8) {
+        uint32_t one, two;
+        memcpy(&one, cur, sizeof(one));
+        memcpy(&two, cur + 4, sizeof(two));
+        one ^= crc;
+        crc =
+            lookup[7][(one    ) & 0xFF] ^
+            lookup[6][(one>> 8) & 0xFF] ^
+            lookup[5][(one>>16) & 0xFF] ^
+            lookup[4][(one>>24) & 0xFF] ^
+            lookup[3][(two    ) & 0xFF] ^
+            lookup[2][(two>> 8) & 0xFF] ^
+            lookup[1][(two>>16) & 0xFF] ^
+            lookup[0][(two>>24) & 0xFF];
+        cur += 8;
+        len -= 8;
+    }
+
+    while (len--) {
+        crc = (crc >> 8) ^ lookup[0][(crc & 0xFF) ^ *cur++];
+    }
+
+    return ~crc;
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CRC32C_HW_X86
+#include <nmmintrin.h>
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(const void* data, size_t len, uint32_t prev_value) {
+    const uint8_t* cur = (const uint8_t*)data;
+    uint64_t crc = (uint32_t)~prev_value;
+
+    while (len >= 8) {
+        uint64_t val;
+        memcpy(&val, cur, sizeof(val));
+        crc = _mm_crc32_u64(crc, val);
+        cur += 8;
+        len -= 8;
+    }
+    uint32_t crc32 = (uint32_t)crc;
+    while (len--) {
+        crc32 = _mm_crc32_u8(crc32, *cur++);
+    }
+    return ~crc32;
+}
+
+static int crc32c_hw_check() {
+    return __builtin_cpu_supports("sse4.2") ? 1 : 0;
+}
+
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+#define CRC32C_HW_ARM
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+
+__attribute__((target("+crc")))
+static uint32_t crc32c_hw(const void* data, size_t len, uint32_t prev_value) {
+    const uint8_t* cur = (const uint8_t*)data;
+    uint32_t crc = ~prev_value;
+
+    while (len >= 8) {
+        uint64_t val;
+        memcpy(&val, cur, sizeof(val));
+        crc = __crc32cd(crc, val);
+        cur += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = __crc32cb(crc, *cur++);
+    }
+    return ~crc;
+}
+
+static int crc32c_hw_check() {
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) ? 1 : 0;
+}
+
+#else
+static uint32_t crc32c_hw(const void* data, size_t len, uint32_t prev_value) {
+    return crc32c_sw(data, len, prev_value);
+}
+
+static int crc32c_hw_check() {
+    return 0;
+}
+
+#endif
+
+int crc32c_hw_available() {
+    // Checked once, at the first call.
+    static const int supported = crc32c_hw_check();
+    return supported;
+}
+
+uint32_t crc32c(const void* data, size_t len, uint32_t prev_value) {
+    if (crc32c_hw_available()) {
+        return crc32c_hw(data, len, prev_value);
+    }
+    return crc32c_sw(data, len, prev_value);
+}
+
@@ -34,6 +34,16 @@ uint32_t crc32_1(const void* data, size_t len, uint32_t prev_value);
 uint32_t crc32_8(const void* data, size_t len, uint32_t prev_value);
 uint32_t crc32_8_last8(const void* data, size_t len, uint32_t prev_value);
 
+// CRC32C (Castagnoli), using the hardware instruction
+// (SSE4.2 or ARMv8 CRC) if available.
+uint32_t crc32c(const void* data, size_t len, uint32_t prev_value);
+
+// CRC32C using software (slicing-by-8) only.
+uint32_t crc32c_sw(const void* data, size_t len, uint32_t prev_value);
+
+// Return 1 if `crc32c` uses the hardware instruction.
+int crc32c_hw_available();
+
 #ifdef __cplusplus
 }
 #endif
@@ -44,7 +44,9 @@ const char * raft_err_msg[] = {
     "N20: Background committing thread encounter err.",
     "N21: Log store flush failed.",
     "N22: This node does not get messages from leader, while the others do.",
-    "N23: Commit is invoked before pre-commit, order inversion happened."
+    "N23: Commit is invoked before pre-commit, order inversion happened.",
+    "N24: Log store failed to append logs.",
+    "N25: Packed application log is corrupted."
 };
 
 } // namespace nuraft;
@@ -20,6 +20,7 @@ limitations under the License.
 
 #include "raft_server.hxx"
 
+#include "batch_size_controller.hxx"
 #include "cluster_config.hxx"
 #include "error_code.hxx"
 #include "event_awaiter.h"
@@ -27,15 +28,28 @@ limitations under the License.
 #include "peer.hxx"
 #include "snapshot.hxx"
 #include "state_machine.hxx"
+#include "stat_mgr.hxx"
 #include "state_mgr.hxx"
 #include "tracer.hxx"
 
 #include <algorithm>
 #include <cassert>
 #include <sstream>
+#include <unordered_set>
 
 namespace nuraft {
 
+struct raft_server::append_sender {
+    append_sender() : stop_(false) {}
+    std::thread thread_;
+    std::mutex lock_;
+    std::condition_variable cv_;
+    // Peers to send requests to, without duplicates.
+    std::list< ptr<peer> > queue_;
+    std::unordered_set<int32> queued_ids_;
+    bool stop_;
+};
+
 void raft_server::append_entries_in_bg() {
     std::string thread_name = "nuraft_append";
 #ifdef __linux__
@@ -56,6 +70,89 @@ void raft_server::append_entries_in_bg() {
     p_in("bg append_entries thread terminated");
 }
 
+bool raft_server::enqueue_append_req(ptr<peer>& p) {
+    if (!append_senders_ready_) {
+        int32 num_senders = ctx_->get_params()->parallel_append_senders_;
+        if (num_senders <= 0 || stopping_) return false;
+
+        std::lock_guard<std::mutex> l(append_senders_lock_);
+        if (!append_senders_ready_) {
+            for (int32 ii = 0; ii < num_senders; ++ii) {
+                ptr<append_sender> s = cs_new<append_sender>();
+                s->thread_ = std::thread( &raft_server::run_append_sender,
+                                          this, s );
+                append_senders_.push_back(s);
+            }
+            append_senders_ready_ = true;
+            p_in("%d append sender threads initiated", num_senders);
+        }
+    }
+
+    // Each peer is always served by the same sender.
+    ptr<append_sender>& s =
+        append_senders_[ p->get_id() % append_senders_.size() ];
+    if (s->thread_.get_id() == std::this_thread::get_id()) {
+        // Called by the sender itself, do it inline.
+        return false;
+    }
+
+    {   std::lock_guard<std::mutex> l(s->lock_);
+        if (s->stop_) return false;
+        if (s->queued_ids_.insert(p->get_id()).second) {
+            s->queue_.push_back(p);
+        }
+    }
+    s->cv_.notify_one();
+    return true;
+}
+
+void raft_server::run_append_sender(ptr<append_sender> s) {
+    std::string thread_name = "nuraft_sender";
+#ifdef __linux__
+    pthread_setname_np(pthread_self(), thread_name.c_str());
+#elif __APPLE__
+    pthread_setname_np(thread_name.c_str());
+#endif
+
+    std::unique_lock<std::mutex> l(s->lock_);
+    while (!s->stop_) {
+        if (s->queue_.empty()) {
+            s->cv_.wait(l);
+            continue;
+        }
+        ptr<peer> p = s->queue_.front();
+        s->queue_.pop_front();
+        s->queued_ids_.erase(p->get_id());
+        l.unlock();
+
+        // Without `lock_`, except for the checks before sending and
+        // taking the snapshot of the current state in
+        // `create_append_entries_req`.
+        if (!request_append_entries(p)) {
+            // Busy, will be sent once the response arrives.
+            p->set_pending_commit();
+        }
+        l.lock();
+    }
+}
+
+void raft_server::stop_append_senders() {
+    std::vector< ptr<append_sender> > senders;
+    {   std::lock_guard<std::mutex> l(append_senders_lock_);
+        if (!append_senders_ready_) return;
+        senders = append_senders_;
+    }
+    for (ptr<append_sender>& s: senders) {
+        {   std::lock_guard<std::mutex> l(s->lock_);
+            s->stop_ = true;
+            s->queue_.clear();
+            s->queued_ids_.clear();
+        }
+        s->cv_.notify_all();
+        if (s->thread_.joinable()) s->thread_.join();
+    }
+}
+
 void raft_server::request_append_entries() {
     // Special case:
     //   1) one-node cluster, OR
@@ -66,7 +163,12 @@ void raft_server::request_append_entries() {
     // We should call it here.
     if ( peers_.size() == 0 ||
          get_quorum_for_commit() == 0 ) {
-        commit(precommit_index_.load());
+        if (ctx_->get_params()->parallel_log_appending_) {
+            // Logs may not be durable yet.
+            commit(get_expected_committed_log_idx());
+        } else {
+            commit(precommit_index_.load());
+        }
         return;
     }
 
@@ -76,6 +178,15 @@ void raft_server::request_append_entries() {
 }
 
 bool raft_server::request_append_entries(ptr<peer> p) {
+    // If parallel senders are enabled, let the sender of
+    // this peer do the rest.
+    if (enqueue_append_req(p)) return true;
+
+    // Other callers already hold `lock_`, but a sender thread does not.
+    // Take it for the checks below, including the callback and
+    // re-connection, so that they see the same state in both cases.
+    std::unique_lock<std::recursive_mutex> pre_send_guard(lock_);
+
     // Checking the validity of role first.
     if (role_ != srv_role::leader) {
         // WARNING: We should allow `write_paused_` state for
@@ -108,11 +219,48 @@ bool raft_server::request_append_entries(ptr<peer> p) {
         p->clear_reconnection();
     }
 
-    if (p->make_busy()) {
-        p_tr("send request to %d\n", (int)p->get_id());
+    // If pipelining is enabled, more requests can be sent while
+    // previous ones are in flight, but only when the follower's log
+    // is known to be matched and there are new logs to send.
+    int32 window = 1;
+    if ( params->append_pipeline_window_ > 1 &&
+         p->is_pipeline_ready() &&
+         !p->get_snapshot_sync_ctx() ) {
+        window = params->append_pipeline_window_;
+        if ( p->is_busy() &&
+             p->get_next_log_idx() >= log_store_->next_slot() ) {
+            // Nothing new to send, wait for the responses.
+            window = 1;
+        }
+    }
+    bool snp_pipelining = false;
+    ptr<snapshot_sync_ctx> snp_ctx = p->get_snapshot_sync_ctx();
+    if ( params->snapshot_prefetch_blocks_ > 1 &&
+         snp_ctx &&
+         snp_ctx->get_snapshot()->get_type() == snapshot::raw_binary ) {
+        // Multiple blocks of raw binary snapshot can be in flight.
+        window = params->snapshot_prefetch_blocks_;
+        snp_pipelining = true;
+
+    } else if ( snp_ctx &&
+                snp_ctx->get_num_streams() > 1 &&
+                snp_ctx->get_offset() > 0 ) {
+        // One object of each stream can be in flight, once the
+        // first object (offset 0) has been acknowledged.
+        window = snp_ctx->get_num_streams();
+        snp_pipelining = true;
+    }
+
+    if (p->make_busy(window)) {
+        p_tr("send request to %d (in-flight %d)\n",
+             (int)p->get_id(), p->get_num_inflight());
+        // On a sender thread, logs are read and the request is built
+        // without `lock_`. `create_append_entries_req` takes it again
+        // for the snapshot of the current state, and checks the role.
+        pre_send_guard.unlock();
         ptr<req_msg> msg = create_append_entries_req(*p);
         if (!msg) {
-            p->set_free();
+            p->release_busy();
             return true;
         }
 
@@ -142,9 +290,22 @@ bool raft_server::request_append_entries(ptr<peer> p) {
             p->reset_manual_free();
         }
 
+        p_ev( TE_APPEND_REQ_SEND,
+              msg->get_last_log_idx() + msg->log_entries().size(),
+              p->get_id(), msg->get_term() );
         p->send_req(p, msg, resp_handler_);
         p->reset_ls_timer();
         p_tr("sent\n");
+
+        if ( window > 1 &&
+             p->get_num_inflight() < window &&
+             ( snp_pipelining
+               ? has_more_snp_blocks_to_send(*p)
+               : p->get_next_log_idx() < log_store_->next_slot() ) ) {
+            // Pipelining: fill up the window if there are more logs,
+            // or more snapshot blocks.
+            request_append_entries(p);
+        }
         return true;
     }
 
@@ -176,7 +337,15 @@ ptr<req_msg> raft_server::create_append_entries_req(peer& p) {
 
     {
         recur_lock(lock_);
+        if (role_ != srv_role::leader) {
+            // Parallel sender may reach here after losing leadership.
+            // Should not send the request with the new term.
+            return ptr<req_msg>();
+        }
         starting_idx = log_store_->start_index();
+        // Logs being compacted in background are regarded as gone.
+        ulong compacted_idx = compact_watermark_;
+        if (compacted_idx >= starting_idx) starting_idx = compacted_idx + 1;
         cur_nxt_idx = precommit_index_ + 1;
         commit_idx = quick_commit_index_;
         term = state_->get_term();
@@ -237,18 +406,51 @@ ptr<req_msg> raft_server::create_append_entries_req(peer& p) {
         p.reset_cnt_not_applied();
     }
 
+    ulong bs_hint = p.get_next_batch_size_hint_in_bytes();
+    ptr<batch_size_controller> batch_ctl;
+    size_t batch_max_bytes = 0;
+    int32 target_lat_us = ctx_->get_params()->adaptive_batch_target_latency_us_;
+    if (target_lat_us > 0) {
+        {   std::lock_guard<std::mutex> guard(p.get_lock());
+            batch_ctl = p.get_batch_size_controller();
+            if (!batch_ctl) {
+                batch_ctl = cs_new<batch_size_controller>(target_lat_us);
+                p.set_batch_size_controller(batch_ctl);
+            }
+        }
+        batch_ctl->set_target_latency_us(target_lat_us);
+        batch_max_bytes = batch_ctl->get_max_bytes();
+        if (batch_max_bytes && (!bs_hint || batch_max_bytes < bs_hint)) {
+            bs_hint = batch_max_bytes;
+        }
+    }
+
     ptr<std::vector<ptr<log_entry>>> log_entries;
     if ((last_log_idx + 1) >= cur_nxt_idx) {
         log_entries = ptr<std::vector<ptr<log_entry>>>();
     } else if (entries_valid) {
         log_entries = log_store_->log_entries_ext(last_log_idx + 1, end_idx,
-                                                  p.get_next_batch_size_hint_in_bytes());
+                                                  bs_hint);
         if (log_entries == nullptr) {
             p_wn("failed to retrieve log entries: %zu - %zu", last_log_idx + 1, end_idx);
             entries_valid = false;
         }
     }
 
+    size_t num_bytes = 0;
+    if (log_entries) {
+        // Log store may not respect the hint, cut it here.
+        size_t num_entries = 0;
+        for (ptr<log_entry>& le: *log_entries) {
+            num_bytes += le->get_buf().size();
+            num_entries++;
+            if (batch_max_bytes && num_bytes >= batch_max_bytes) break;
+        }
+        if (num_entries < log_entries->size()) {
+            log_entries->resize(num_entries);
+        }
+    }
+
     if (!entries_valid) {
         // Required log entries are missing. First, we try to use snapshot to recover.
         // To avoid inconsistency due to smart pointer, should have local varaible
@@ -266,6 +468,7 @@ ptr<req_msg> raft_server::create_append_entries_req(peer& p) {
                   p.get_id(),
                   last_log_idx, starting_idx, cur_nxt_idx,
                   snp_local->get_last_log_idx() );
+            p.set_pipeline_ready(false);
             return create_sync_snapshot_req(p, last_log_idx, term, commit_idx);
         }
 
@@ -332,11 +535,31 @@ ptr<req_msg> raft_server::create_append_entries_req(peer& p) {
     }
     p.set_last_sent_idx(last_log_idx + 1);
 
+    if (batch_ctl && !v.empty()) {
+        batch_ctl->on_sent( adjusted_end_idx - 1,
+                            num_bytes,
+                            adjusted_end_idx < cur_nxt_idx );
+    }
+
+    if ( ctx_->get_params()->append_pipeline_window_ > 1 &&
+         !v.empty() ) {
+        // Pipelining: assume that this batch will be accepted,
+        // so that the next request can start from the end of it.
+        // If not, response handler will move it back.
+        std::lock_guard<std::mutex> guard(p.get_lock());
+        if (p.get_next_log_idx() < adjusted_end_idx) {
+            p.set_next_log_idx(adjusted_end_idx);
+        }
+    }
+
     return req;
 }
 
 ptr<resp_msg> raft_server::handle_append_entries(req_msg& req)
 {
+    p_ev( TE_APPEND_REQ_RECV,
+          req.get_last_log_idx() + req.log_entries().size(),
+          req.get_src(), req.get_term() );
     bool supp_exp_warning = false;
     if (catching_up_) {
         // WARNING:
@@ -470,7 +693,7 @@ ptr<resp_msg> raft_server::handle_append_entries(req_msg& req)
         while ( log_idx < log_store_->next_slot() &&
                 cnt < req.log_entries().size() )
         {
-            if ( log_store_->term_at(log_idx) ==
+            if ( term_for_log(log_idx) ==
                      req.log_entries().at(cnt)->get_term() ) {
                 log_idx++;
                 cnt++;
@@ -515,6 +738,9 @@ ptr<resp_msg> raft_server::handle_append_entries(req_msg& req)
                       log_idx - 1 );
                 sm_commit_index_ = log_idx - 1;
             }
+            if ( sm_applied_index_ >= log_idx ) {
+                sm_applied_index_ = log_idx - 1;
+            }
 
             for ( uint64_t ii = 0; ii < my_last_log_idx - log_idx + 1; ++ii ) {
                 uint64_t idx = my_last_log_idx - ii;
@@ -526,6 +752,13 @@ ptr<resp_msg> raft_server::handle_append_entries(req_msg& req)
                         ( state_machine::ext_op_params( idx, buf ) );
                     p_in( "rollback log %zu", idx );
 
+                } else if ( old_entry->get_val_type() ==
+                                log_val_type::packed_app_log ) {
+                    ptr<buffer> buf = old_entry->get_buf_ptr();
+                    buf->pos(0);
+                    rollback_packed_log(idx, buf);
+                    p_in( "rollback packed log %zu", idx );
+
                 } else if (old_entry->get_val_type() == log_val_type::conf) {
                     p_in( "revert from a prev config change to config at %llu",
                           get_config()->get_log_idx() );
@@ -534,63 +767,67 @@ ptr<resp_msg> raft_server::handle_append_entries(req_msg& req)
             }
         }
 
-        // Dealing with overwrites (logs with different term).
-        while ( log_idx < log_store_->next_slot() &&
-                cnt < req.log_entries().size() )
-        {
-            ptr<log_entry> entry = req.log_entries().at(cnt);
-            p_in("overwrite at %zu\n", log_idx);
-            store_log_entry(entry, log_idx);
-
-            if (entry->get_val_type() == log_val_type::app_log) {
-                ptr<buffer> buf = entry->get_buf_ptr();
-                buf->pos(0);
-                state_machine_->pre_commit_ext
-                    ( state_machine::ext_op_params( log_idx, buf ) );
-
-            } else if(entry->get_val_type() == log_val_type::conf) {
-                p_in("receive a config change from leader at %llu", log_idx);
-                config_changing_ = true;
+        // Store the rest of logs at once. If they overlap with
+        // existing logs (with different term), overwrite them.
+        if (cnt < req.log_entries().size()) {
+            std::vector< ptr<log_entry> > entries
+                ( req.log_entries().begin() + cnt, req.log_entries().end() );
+            ulong first_idx = 0;
+            if (log_idx < log_store_->next_slot()) {
+                p_in("overwrite at %zu\n", log_idx);
+                first_idx = store_log_entries(entries, log_idx);
+            } else {
+                p_tr("append at %zu\n", log_store_->next_slot());
+                first_idx = store_log_entries(entries);
             }
 
-            log_idx += 1;
-            cnt += 1;
+            for (size_t ii = 0; ii < entries.size(); ++ii) {
+                ptr<log_entry>& entry = entries[ii];
+                ulong idx_for_entry = first_idx + ii;
+                if (entry->get_val_type() == log_val_type::conf) {
+                    p_in( "receive a config change from leader at %llu",
+                          idx_for_entry );
+                    config_changing_ = true;
+
+                } else if (entry->get_val_type() == log_val_type::app_log) {
+                    ptr<buffer> buf = entry->get_buf_ptr();
+                    buf->pos(0);
+                    state_machine_->pre_commit_ext
+                        ( state_machine::ext_op_params( idx_for_entry, buf ) );
+
+                } else if ( entry->get_val_type() ==
+                                log_val_type::packed_app_log ) {
+                    ptr<buffer> buf = entry->get_buf_ptr();
+                    buf->pos(0);
+                    pre_commit_packed_log(idx_for_entry, buf);
+                }
 
-            if (stopping_) return resp;
+                if (stopping_) return resp;
+            }
         }
-        p_db("[after OVWR] log_idx: %ld, count: %ld\n", log_idx, cnt);
+        p_db("[after STORE] log_idx: %ld, count: %ld\n",
+             log_idx, req.log_entries().size());
 
         if (rollback_in_progress) {
             p_in("last log index after rollback and overwrite: %zu",
                  log_store_->next_slot() - 1);
         }
 
-        // Append new log entries
-        while (cnt < req.log_entries().size()) {
-            p_tr("append at %zu\n", log_store_->next_slot());
-            ptr<log_entry> entry = req.log_entries().at( cnt++ );
-            ulong idx_for_entry = store_log_entry(entry);
-            if (entry->get_val_type() == log_val_type::conf) {
-                p_in( "receive a config change from leader at %llu",
-                      idx_for_entry );
-                config_changing_ = true;
-
-            } else if(entry->get_val_type() == log_val_type::app_log) {
-                ptr<buffer> buf = entry->get_buf_ptr();
-                buf->pos(0);
-                state_machine_->pre_commit_ext
-                    ( state_machine::ext_op_params( idx_for_entry, buf ) );
-            }
-
-            if (stopping_) return resp;
-        }
-
         // End of batch.
-        log_store_->end_of_append_batch( req.get_last_log_idx() + 1,
-                                         req.log_entries().size() );
+        if (ctx_->get_params()->use_bg_thread_for_follower_flush_) {
+            request_follower_flush( req.get_last_log_idx() + 1,
+                                    req.log_entries().size() );
+        } else {
+            log_store_->end_of_append_batch( req.get_last_log_idx() + 1,
+                                             req.log_entries().size() );
+        }
     }
 
-    leader_ = req.get_src();
+    if (leader_ != req.get_src()) {
+        leader_ = req.get_src();
+        // Connections to the previous leader are not needed anymore.
+        prune_forward_queues();
+    }
 
     // WARNING:
     //   If this node was leader but now follower, and right after
@@ -615,6 +852,7 @@ ptr<resp_msg> raft_server::handle_append_entries(req_msg& req)
     //      progress after that. Logs already reached consensus (1, 2, and 3)
     //      will remain unchanged.
     leader_commit_index_.store(req.get_commit_idx());
+    on_leader_commit_index(req.get_commit_idx());
 
     // WARNING:
     //   If `commit_idx > next_slot()`, it may cause problem
@@ -627,6 +865,16 @@ ptr<resp_msg> raft_server::handle_append_entries(req_msg& req)
 
     resp->accept(req.get_last_log_idx() + req.log_entries().size() + 1);
 
+    if ( ctx_->get_params()->parallel_log_appending_ ||
+         ctx_->get_params()->use_bg_thread_for_follower_flush_ ) {
+        // Leader will regard the logs up to the accepted index as durable
+        // on this node, so send the response after the log store makes
+        // them durable (`notify_log_append_completion`), or after
+        // the background flush.
+        ulong target_idx = req.get_last_log_idx() + req.log_entries().size();
+        defer_append_ack(resp, target_idx);
+    }
+
     int32 time_ms = tt.get_us() / 1000;
     if (time_ms >= ctx_->get_params()->heart_beat_interval_) {
         // Append entries took longer than HB interval. Warning.
@@ -669,19 +917,46 @@ void raft_server::handle_append_entries_resp(resp_msg& resp) {
     ptr<peer> p = it->second;
     p_tr("handle append entries resp (from %d), resp.get_next_idx(): %d\n",
          (int)p->get_id(), (int)resp.get_next_idx());
+    p_ev( TE_APPEND_RESP_RECV, resp.get_next_idx(),
+          p->get_id(), resp.get_term() );
 
     ulong bs_hint = resp.get_next_batch_size_hint_in_bytes();
     p_tr("peer %d batch size hint: %zu bytes", p->get_id(), bs_hint);
     p->set_next_batch_size_hint_in_bytes(bs_hint);
 
+    bool pipelining = ( ctx_->get_params()->append_pipeline_window_ > 1 );
+
+    ptr<batch_size_controller> batch_ctl;
+    {   std::lock_guard<std::mutex> guard(p->get_lock());
+        batch_ctl = p->get_batch_size_controller();
+    }
+    if (batch_ctl) {
+        if (resp.get_accepted()) {
+            batch_ctl->on_acked(resp.get_next_idx() - 1);
+        } else {
+            batch_ctl->reset();
+        }
+    }
+
     if (resp.get_accepted()) {
         uint64_t prev_matched_idx = 0;
         uint64_t new_matched_idx = 0;
         {
             std::lock_guard<std::mutex>(p->get_lock());
-            p->set_next_log_idx(resp.get_next_idx());
             prev_matched_idx = p->get_matched_idx();
             new_matched_idx = resp.get_next_idx() - 1;
+            if (!pipelining) {
+                p->set_next_log_idx(resp.get_next_idx());
+            } else {
+                // Responses of pipelined requests may arrive after
+                // the next log index has been advanced, or after a
+                // newer response. Both indexes should not go backward.
+                if (p->get_next_log_idx() < resp.get_next_idx()) {
+                    p->set_next_log_idx(resp.get_next_idx());
+                }
+                new_matched_idx = std::max(prev_matched_idx, new_matched_idx);
+                p->set_pipeline_ready(true);
+            }
             p_tr("peer %d, prev idx: %ld, next idx: %ld",
                  p->get_id(), prev_matched_idx, new_matched_idx);
             p->set_matched_idx(new_matched_idx);
@@ -696,12 +971,40 @@ void raft_server::handle_append_entries_resp(resp_msg& resp) {
         ulong committed_index = get_expected_committed_log_idx();
         commit( committed_index );
         need_to_catchup = p->clear_pending_commit() ||
-                          resp.get_next_idx() < log_store_->next_slot();
+                          p->get_next_log_idx() < log_store_->next_slot();
+
+    } else if (pipelining && resp.is_obsolete()) {
+        // Sent before the last rejection, based on the next log index
+        // that has been reset since then.
+        p_db( "ignore obsolete declined append: peer %d, resp next %zu",
+              p->get_id(), resp.get_next_idx() );
 
     } else {
         ulong prev_next_log = p->get_next_log_idx();
         std::lock_guard<std::mutex> guard(p->get_lock());
-        if (resp.get_next_idx() > 0 && p->get_next_log_idx() > resp.get_next_idx()) {
+        // Stop pipelining until the follower's log is matched again.
+        p->set_pipeline_ready(false);
+        if (pipelining) {
+            // Next log index may have been advanced optimistically by
+            // pipelined requests. Restart from the last index confirmed
+            // by the peer, and ignore the responses to the requests
+            // in flight, as all of them were sent from that position.
+            ulong new_next_log = prev_next_log;
+            if (p->get_matched_idx()) {
+                new_next_log = std::min(new_next_log, p->get_matched_idx() + 1);
+            }
+            if (resp.get_next_idx() > 0) {
+                new_next_log = std::min(new_next_log, resp.get_next_idx());
+            }
+            if (new_next_log == prev_next_log && new_next_log > 1) {
+                // No hint, move one log backward.
+                new_next_log--;
+            }
+            p->set_next_log_idx(new_next_log);
+            p->discard_inflight_appends();
+
+        } else if ( resp.get_next_idx() > 0 &&
+                    p->get_next_log_idx() > resp.get_next_idx() ) {
             // fast move for the peer to catch up
             p->set_next_log_idx(resp.get_next_idx());
         } else {
@@ -716,6 +1019,12 @@ void raft_server::handle_append_entries_resp(resp_msg& resp) {
               resp.get_next_idx(), p->get_next_log_idx() );
     }
 
+    // Any response (even rejection) in the current term
+    // confirms the leadership for pending read requests.
+    if (role_ == srv_role::leader) {
+        check_read_index_round();
+    }
+
     // NOTE:
     //   If all other followers are not responding, we may not make
     //   below condition true. In that case, we check the timeout of
@@ -731,40 +1040,7 @@ void raft_server::handle_append_entries_resp(resp_msg& resp) {
              next_leader_candidate_.load(),
              p_matched_idx,
              reelection_timer_.get_us());
-        leader_ = -1;
-
-        // To avoid this node becomes next leader again, set timeout
-        // value bigger than any others, just once at this time.
-        rand_timeout_ = [this]() -> int32 {
-            return this->ctx_->get_params()->election_timeout_upper_bound_ +
-                   this->ctx_->get_params()->election_timeout_lower_bound_;
-        };
-        become_follower();
-        update_rand_timeout();
-
-        // Clear live flag to avoid pre-vote rejection.
-        hb_alive_ = false;
-
-        // Send leadership takeover request to this follower.
-        ptr<req_msg> req = cs_new<req_msg>
-                           ( state_->get_term(),
-                             msg_type::custom_notification_request,
-                             id_, p->get_id(),
-                             term_for_log(log_store_->next_slot() - 1),
-                             log_store_->next_slot() - 1,
-                             quick_commit_index_.load() );
-
-        // Create a notification.
-        ptr<custom_notification_msg> custom_noti =
-            cs_new<custom_notification_msg>
-            ( custom_notification_msg::leadership_takeover );
-
-        // Wrap it using log_entry.
-        ptr<log_entry> custom_noti_le =
-            cs_new<log_entry>(0, custom_noti->serialize(), log_val_type::custom);
-
-        req->log_entries().push_back(custom_noti_le);
-        p->send_req(p, req, resp_handler_);
+        hand_over_leadership(p);
         return;
     }
 
@@ -783,8 +1059,13 @@ ulong raft_server::get_expected_committed_log_idx() {
     std::vector<ulong> matched_indexes;
     matched_indexes.reserve(16);
 
-    // Leader itself.
-    matched_indexes.push_back( precommit_index_ );
+    // Leader itself. With parallel log appending, it counts only
+    // the logs durable in its own log store.
+    ulong leader_idx = precommit_index_;
+    if (ctx_->get_params()->parallel_log_appending_) {
+        leader_idx = std::min(leader_idx, log_store_->last_durable_index());
+    }
+    matched_indexes.push_back( leader_idx );
     for (auto& entry: peers_) {
         ptr<peer>& p = entry.second;
 
@@ -814,5 +1095,169 @@ ulong raft_server::get_expected_committed_log_idx() {
     return matched_indexes[ quorum_idx ];
 }
 
-} // namespace nuraft;
+void raft_server::notify_log_append_completion(bool ok) {
+    if (!ok) {
+        // LCOV_EXCL_START
+        p_ft("log store failed to persist logs");
+        ctx_->state_mgr_->system_exit(N21_log_flush_failed);
+        return;
+        // LCOV_EXCL_STOP
+    }
+
+    // Send the responses of follower waiting for durable logs.
+    complete_append_acks();
+
+    recur_lock(lock_);
+    if (role_ != srv_role::leader) return;
+
+    // The leader's own durable index has moved forward,
+    // it may complete the commit quorum.
+    ulong committed_index = get_expected_committed_log_idx();
+    p_tr("log append completion, durable %lu, expected commit %lu",
+         log_store_->last_durable_index(), committed_index);
+    commit(committed_index);
+}
+
+void raft_server::request_follower_flush(ulong start, ulong cnt) {
+    std::lock_guard<std::mutex> l(flush_lock_);
+    if (start <= durable_idx_) {
+        // Logs were overwritten, they are not durable anymore.
+        // Also the result of the ongoing flush (if any) should not
+        // move `durable_idx_` beyond it.
+        durable_idx_ = start - 1;
+        flush_epoch_++;
+    }
+
+    if (!flush_start_ || start < flush_start_) flush_start_ = start;
+    flush_end_ = start + cnt - 1;
+    if (flush_end_ < flush_start_) {
+        // Nothing to flush (e.g., `cnt == 0`).
+        flush_start_ = flush_end_ = 0;
+        return;
+    }
 
+    if (!bg_flush_thread_.joinable()) {
+        bg_flush_thread_ = std::thread(&raft_server::flush_logs_in_bg, this);
+    }
+    flush_cv_.notify_all();
+}
+
+bool raft_server::is_follower_log_durable(ulong log_idx) {
+    // Should be called while holding `flush_lock_`.
+    if ( ctx_->get_params()->use_bg_thread_for_follower_flush_ &&
+         durable_idx_ < log_idx &&
+         (flush_start_ || flush_running_) ) {
+        return false;
+    }
+    if (ctx_->get_params()->parallel_log_appending_) {
+        return log_store_->last_durable_index() >= log_idx;
+    }
+    return true;
+}
+
+void raft_server::defer_append_ack(ptr<resp_msg>& resp, ulong log_idx) {
+    {   std::lock_guard<std::mutex> l(flush_lock_);
+        if (is_follower_log_durable(log_idx)) return;
+    }
+
+    resp->set_defer_cb( [this, log_idx](resp_ready_cb ready) {
+        bool ok = false;
+        {   std::lock_guard<std::mutex> l(flush_lock_);
+            if (!stopping_) {
+                if (!is_follower_log_durable(log_idx)) {
+                    pending_append_acks_.push_back
+                        ( std::make_pair(log_idx, ready) );
+                    return;
+                }
+                ok = true;
+            }
+        }
+        ready(ok);
+    } );
+}
+
+void raft_server::complete_append_acks() {
+    std::list<resp_ready_cb> oks;
+    std::list<resp_ready_cb> fails;
+    {   std::lock_guard<std::mutex> l(flush_lock_);
+        auto entry = pending_append_acks_.begin();
+        while (entry != pending_append_acks_.end()) {
+            if (stopping_) {
+                // Logs may not be durable, response should not be sent.
+                fails.push_back(entry->second);
+            } else if (is_follower_log_durable(entry->first)) {
+                oks.push_back(entry->second);
+            } else {
+                entry++;
+                continue;
+            }
+            entry = pending_append_acks_.erase(entry);
+        }
+    }
+
+    // Outside the lock, as the callbacks may do network I/O.
+    for (resp_ready_cb& ready: oks) ready(true);
+    for (resp_ready_cb& ready: fails) ready(false);
+}
+
+void raft_server::stop_flush_thread() {
+    {   std::lock_guard<std::mutex> l(flush_lock_);
+        flush_cv_.notify_all();
+    }
+    if (bg_flush_thread_.joinable()) {
+        bg_flush_thread_.join();
+    }
+    complete_append_acks();
+}
+
+void raft_server::flush_logs_in_bg() {
+    std::string thread_name = "nuraft_flush";
+#ifdef __linux__
+    pthread_setname_np(pthread_self(), thread_name.c_str());
+#elif __APPLE__
+    pthread_setname_np(thread_name.c_str());
+#endif
+
+    static stat_elem& rounds = *stat_mgr::get_instance()->create_stat
+        (stat_elem::COUNTER, "follower_bg_flush_rounds");
+    static stat_elem& flush_latency = *stat_mgr::get_instance()->create_stat
+        (stat_elem::HISTOGRAM, "follower_bg_flush_us");
+
+    p_in("bg flush thread initiated");
+    std::unique_lock<std::mutex> l(flush_lock_);
+    while (!stopping_) {
+        if (!flush_start_) {
+            flush_cv_.wait(l);
+            continue;
+        }
+
+        // Flush all logs appended so far at once.
+        ulong start = flush_start_;
+        ulong end = flush_end_;
+        uint64_t epoch = flush_epoch_;
+        flush_start_ = flush_end_ = 0;
+        flush_running_ = true;
+        l.unlock();
+
+        timer_helper tt;
+        log_store_->end_of_append_batch(start, end - start + 1);
+        flush_latency += tt.get_us();
+        rounds++;
+        p_tr("flushed logs %lu - %lu", start, end);
+
+        l.lock();
+        flush_running_ = false;
+        if (epoch == flush_epoch_ && end > durable_idx_) {
+            durable_idx_ = end;
+        }
+        l.unlock();
+
+        // Send the responses waiting for the logs flushed above.
+        complete_append_acks();
+        l.lock();
+    }
+    flush_cv_.notify_all();
+    p_in("bg flush thread terminated");
+}
+
+} // namespace nuraft;
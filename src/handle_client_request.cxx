@@ -20,32 +20,46 @@ limitations under the License.
 
 #include "handle_client_request.hxx"
 
+#include "buffer_serializer.hxx"
 #include "cluster_config.hxx"
 #include "context.hxx"
+#include "crc32.hxx"
 #include "error_code.hxx"
 #include "state_machine.hxx"
 #include "state_mgr.hxx"
 #include "tracer.hxx"
 
+#include <algorithm>
 #include <cassert>
 #include <sstream>
+#include <thread>
 
 namespace nuraft {
 
 ptr<resp_msg> raft_server::handle_cli_req_prelock(req_msg& req) {
+    uint64_t enqueue_us = stat_now_us();
     ptr<resp_msg> resp = nullptr;
     ptr<raft_params> params = ctx_->get_params();
+    if (params->group_commit_max_bytes_ > 0) {
+        // Urgent commit will be done by the appender.
+        return handle_cli_req_group(req);
+    }
+
     switch (params->locking_method_type_) {
         case raft_params::single_mutex: {
             recur_lock(lock_);
-            resp = handle_cli_req(req);
+            resp = handle_cli_req(req, enqueue_us);
+            break;
+        }
+        case raft_params::dual_rw_lock: {
+            read_lock(cli_rw_lock_);
+            resp = handle_cli_req(req, enqueue_us);
             break;
         }
         case raft_params::dual_mutex:
         default: {
-            // TODO: Use RW lock here.
             auto_lock(cli_lock_);
-            resp = handle_cli_req(req);
+            resp = handle_cli_req(req, enqueue_us);
             break;
         }
     }
@@ -62,99 +76,514 @@ ptr<resp_msg> raft_server::handle_cli_req_prelock(req_msg& req) {
     return resp;
 }
 
-ptr<resp_msg> raft_server::handle_cli_req(req_msg& req) {
-    ptr<resp_msg> resp = nullptr;
+ptr<resp_msg> raft_server::handle_cli_req_group(req_msg& req) {
+    // Submit the request to the queue.
+    group_commit_elem elem(req);
+    elem.next_ = group_commit_head_.load();
+    while ( !group_commit_head_.compare_exchange_weak(elem.next_, &elem) );
+
+    std::unique_lock<std::mutex> l(group_commit_lock_);
+    // Wake up the appender if it is gathering requests.
+    group_commit_submit_cv_.notify_one();
+
+    while (elem.state_ == group_commit_elem::PENDING) {
+        if (!group_commit_active_) {
+            // No other thread is appending, this thread becomes the
+            // appender. It runs a single round, which always includes
+            // its own request, and then hands off to a waiting thread,
+            // so as not to append others' requests forever under load.
+            group_commit_active_ = true;
+            l.unlock();
+            run_group_commit();
+            l.lock();
+            group_commit_active_ = false;
+            if (group_commit_head_.load()) {
+                group_commit_done_cv_.notify_all();
+            }
+            continue;
+        }
+
+        // Other thread is appending, wait for it.
+        group_commit_done_cv_.wait(l);
+    }
+    return elem.resp_;
+}
+
+void raft_server::run_group_commit() {
+    ptr<raft_params> params = ctx_->get_params();
+    size_t max_bytes = params->group_commit_max_bytes_;
+    uint64_t max_delay_us = std::max(0, params->group_commit_max_delay_us_);
+
+    // Gather requests, in submission order.
+    std::vector<group_commit_elem*> elems;
+    size_t total_bytes = 0;
+    timer_helper timer;
+    {   std::unique_lock<std::mutex> l(group_commit_lock_);
+        while (true) {
+            group_commit_elem* head = group_commit_head_.exchange(nullptr);
+            size_t num_prev = elems.size();
+            for (group_commit_elem* ee = head; ee; ee = ee->next_) {
+                elems.push_back(ee);
+                for (ptr<log_entry>& le: ee->req_.log_entries()) {
+                    total_bytes += le->get_buf().size();
+                }
+            }
+            std::reverse(elems.begin() + num_prev, elems.end());
+
+            uint64_t elapsed_us = timer.get_us();
+            if ( total_bytes >= max_bytes ||
+                 elapsed_us >= max_delay_us ) break;
+
+            // Wait for more requests.
+            group_commit_submit_cv_.wait_for
+                ( l, std::chrono::microseconds(max_delay_us - elapsed_us),
+                  [this]() { return group_commit_head_.load() != nullptr; } );
+        }
+    }
+    if (elems.empty()) return;
+
+    std::vector<req_msg*> reqs;
+    std::vector<uint64_t> enqueue_us;
+    reqs.reserve(elems.size());
+    enqueue_us.reserve(elems.size());
+    for (group_commit_elem* ee: elems) {
+        reqs.push_back(&ee->req_);
+        enqueue_us.push_back(ee->enqueue_us_);
+    }
+
+    std::vector< ptr<resp_msg> > resps;
+    append_cli_req_batch(reqs, resps, enqueue_us);
+    p_tr("group commit: %zu requests, %zu bytes, %zu us",
+         elems.size(), total_bytes, timer.get_us());
+
+    {   std::lock_guard<std::mutex> l(group_commit_lock_);
+        for (size_t ii = 0; ii < elems.size(); ++ii) {
+            group_commit_elem* ee = elems[ii];
+            ee->resp_ = resps[ii];
+            // WARNING: `ee` may be freed by the waiting thread
+            //          once the lock is released.
+            ee->state_ = group_commit_elem::DONE;
+        }
+    }
+    group_commit_done_cv_.notify_all();
+}
+
+void raft_server::append_cli_req_batch(std::vector<req_msg*>& reqs,
+                                       std::vector< ptr<resp_msg> >& resps_out,
+                                       const std::vector<uint64_t>& enqueue_us)
+{
+    ptr<raft_params> params = ctx_->get_params();
+    switch (params->locking_method_type_) {
+        case raft_params::single_mutex: {
+            recur_lock(lock_);
+            handle_cli_req_batch(reqs, resps_out, enqueue_us);
+            break;
+        }
+        case raft_params::dual_rw_lock: {
+            read_lock(cli_rw_lock_);
+            handle_cli_req_batch(reqs, resps_out, enqueue_us);
+            break;
+        }
+        case raft_params::dual_mutex:
+        default: {
+            auto_lock(cli_lock_);
+            handle_cli_req_batch(reqs, resps_out, enqueue_us);
+            break;
+        }
+    }
+
+    // Urgent commit, once for all requests.
+    if (params->use_bg_thread_for_urgent_commit_) {
+        bg_append_ea_->invoke();
+    } else {
+        recur_lock(lock_);
+        request_append_entries();
+    }
+}
+
+ptr<resp_msg> raft_server::handle_cli_req_fwd_batch(req_msg& req) {
+    //   << Format of the first log entry (header) >>
+    // version                      1 byte
+    // number of requests (N)       4 bytes
+    // number of logs of request    4 bytes * N
+    //
+    // All logs of the requests follow the header, in order.
+    ptr<resp_msg> resp = cs_new<resp_msg>( state_->get_term(),
+                                           msg_type::client_request_batch_response,
+                                           id_,
+                                           req.get_src() );
+
+    std::vector< ptr<log_entry> >& entries = req.log_entries();
+    std::vector< ptr<req_msg> > sub_reqs;
+   try {
+    if (entries.empty() || entries[0]->is_buf_null()) {
+        throw std::runtime_error("no header");
+    }
+    buffer_serializer bs(entries[0]->get_buf());
+    uint8_t version = bs.get_u8();
+    (void)version;
+    uint32_t num_reqs = bs.get_u32();
+    size_t cursor = 1;
+    for (uint32_t ii = 0; ii < num_reqs; ++ii) {
+        uint32_t num_logs = bs.get_u32();
+        if (cursor + num_logs > entries.size()) {
+            throw std::runtime_error("not enough logs");
+        }
+        ptr<req_msg> sub_req = cs_new<req_msg>
+                               ( (ulong)0, msg_type::client_request, 0, 0,
+                                 (ulong)0, (ulong)0, (ulong)0 );
+        sub_req->log_entries().assign( entries.begin() + cursor,
+                                       entries.begin() + cursor + num_logs );
+        cursor += num_logs;
+        sub_reqs.push_back(sub_req);
+    }
+   } catch (std::exception& ex) {
+    p_er("invalid forwarded client request batch from %d: %s",
+         req.get_src(), ex.what());
+    return resp;
+   }
+
+    std::vector<req_msg*> reqs;
+    reqs.reserve(sub_reqs.size());
+    for (ptr<req_msg>& sub_req: sub_reqs) reqs.push_back(sub_req.get());
+    std::vector<uint64_t> enqueue_us(sub_reqs.size(), stat_now_us());
+
+    std::vector< ptr<resp_msg> > resps;
+    append_cli_req_batch(reqs, resps, enqueue_us);
+    p_tr("forwarded batch from %d: %zu requests, %zu logs",
+         req.get_src(), sub_reqs.size(), entries.size() - 1);
+
+    // Result of each request, in the same order.
+    //   << Format >>
+    // version                      1 byte
+    // number of requests (N)       4 bytes
+    // { accepted                   1 byte
+    //   result code                4 bytes
+    //   ctx length (X)             4 bytes
+    //   ctx                        X bytes } * N
+    auto make_ctx = [](std::vector< ptr<resp_msg> >& rr) -> ptr<buffer> {
+        size_t len = sizeof(uint8_t) + sizeof(uint32_t);
+        for (ptr<resp_msg>& sub: rr) {
+            len += sizeof(uint8_t) + sizeof(int32) + sizeof(uint32_t);
+            if (sub && sub->get_ctx()) len += sub->get_ctx()->size();
+        }
+        ptr<buffer> ret = buffer::alloc(len);
+        buffer_serializer bs(ret);
+        const uint8_t CURRENT_VERSION = 0x0;
+        bs.put_u8(CURRENT_VERSION);
+        bs.put_u32(rr.size());
+        for (ptr<resp_msg>& sub: rr) {
+            if (!sub) {
+                bs.put_u8(0);
+                bs.put_i32((int32)cmd_result_code::FAILED);
+                bs.put_u32(0);
+                continue;
+            }
+            ptr<buffer> sub_ctx = sub->get_ctx();
+            bs.put_u8(sub->get_accepted() ? 1 : 0);
+            bs.put_i32((int32)sub->get_result_code());
+            if (sub_ctx) {
+                sub_ctx->pos(0);
+                bs.put_bytes(sub_ctx->data_begin(), sub_ctx->size());
+            } else {
+                bs.put_u32(0);
+            }
+        }
+        return ret;
+    };
+
+    resp->accept(log_store_->next_slot());
+    bool blocking = false;
+    for (ptr<resp_msg>& sub: resps) {
+        if (sub && sub->has_cb()) blocking = true;
+    }
+    if (!blocking) {
+        resp->set_ctx( make_ctx(resps) );
+        return resp;
+    }
+
+    // Blocking mode: wait for the results of all requests in order,
+    // the same as a single client request.
+    resp->set_cb( [resps, make_ctx](ptr<resp_msg> batch_resp) mutable
+                  -> ptr<resp_msg> {
+        for (ptr<resp_msg>& sub: resps) {
+            if (sub && sub->has_cb()) sub = sub->call_cb(sub);
+        }
+        batch_resp->set_ctx( make_ctx(resps) );
+        return batch_resp;
+    } );
+    return resp;
+}
+
+ptr<resp_msg> raft_server::handle_cli_req(req_msg& req, uint64_t enqueue_us) {
+    std::vector<req_msg*> reqs(1, &req);
+    std::vector<uint64_t> enqueue_us_list;
+    if (enqueue_us) enqueue_us_list.push_back(enqueue_us);
+    std::vector< ptr<resp_msg> > resps;
+    handle_cli_req_batch(reqs, resps, enqueue_us_list);
+    return resps[0];
+}
+
+bool raft_server::check_flow_control() {
+    static stat_elem& rejected = *stat_mgr::get_instance()->create_stat
+        (stat_elem::COUNTER, "flow_control_rejected_requests");
+    static stat_elem& inflight_entries = *stat_mgr::get_instance()->create_stat
+        (stat_elem::GAUGE, "flow_control_uncommitted_entries");
+    static stat_elem& inflight_bytes = *stat_mgr::get_instance()->create_stat
+        (stat_elem::GAUGE, "flow_control_uncommitted_bytes");
+    static stat_elem& apply_lag = *stat_mgr::get_instance()->create_stat
+        (stat_elem::GAUGE, "flow_control_apply_lag");
+
+    ptr<raft_params> params = ctx_->get_params();
+    if ( params->max_uncommitted_entries_ <= 0 &&
+         params->max_uncommitted_bytes_ <= 0 &&
+         params->max_apply_lag_ <= 0 ) {
+        return true;
+    }
+
+    ulong last_idx = log_store_->next_slot() - 1;
+    ulong c_idx = quick_commit_index_;
+    ulong sm_idx = sm_commit_index_;
+    ulong num_uncommitted = (last_idx > c_idx) ? last_idx - c_idx : 0;
+    ulong num_unapplied = (c_idx > sm_idx) ? c_idx - sm_idx : 0;
+    uint64_t num_bytes = 0;
+    {   std::lock_guard<std::mutex> l(inflight_lock_);
+        num_bytes = inflight_total_bytes_;
+    }
+    inflight_entries = num_uncommitted;
+    inflight_bytes = num_bytes;
+    apply_lag = num_unapplied;
+
+    const char* reason = nullptr;
+    if ( params->max_uncommitted_entries_ > 0 &&
+         num_uncommitted >= (ulong)params->max_uncommitted_entries_ ) {
+        reason = "uncommitted entries";
+    } else if ( params->max_uncommitted_bytes_ > 0 &&
+                num_bytes >= (uint64_t)params->max_uncommitted_bytes_ ) {
+        reason = "uncommitted bytes";
+    } else if ( params->max_apply_lag_ > 0 &&
+                num_unapplied >= (ulong)params->max_apply_lag_ ) {
+        reason = "apply lag";
+    }
+    if (!reason) return true;
+
+    rejected++;
+    static timer_helper msg_timer(1000000);
+    if (msg_timer.timeout_and_reset()) {
+        p_wn( "reject client request due to %s: "
+              "uncommitted %lu logs (%lu bytes), unapplied %lu logs",
+              reason, num_uncommitted, num_bytes, num_unapplied );
+    }
+    return false;
+}
+
+void raft_server::add_inflight_bytes(ulong last_idx, uint64_t bytes) {
+    if (!bytes) return;
+    std::lock_guard<std::mutex> l(inflight_lock_);
+    inflight_bytes_.push_back( std::make_pair(last_idx, bytes) );
+    inflight_total_bytes_ += bytes;
+}
+
+void raft_server::release_inflight_bytes(ulong committed_idx) {
+    std::lock_guard<std::mutex> l(inflight_lock_);
+    while ( !inflight_bytes_.empty() &&
+            inflight_bytes_.front().first <= committed_idx ) {
+        inflight_total_bytes_ -= inflight_bytes_.front().second;
+        inflight_bytes_.pop_front();
+    }
+}
+
+void raft_server::handle_cli_req_batch(std::vector<req_msg*>& reqs,
+                                       std::vector< ptr<resp_msg> >& resps_out,
+                                       const std::vector<uint64_t>& enqueue_us)
+{
+    static stat_elem& client_wait_lat = *stat_mgr::get_instance()->create_stat
+        (stat_elem::HISTOGRAM, "repl_lat_client_wait_us");
+    static stat_elem& store_log_lat = *stat_mgr::get_instance()->create_stat
+        (stat_elem::HISTOGRAM, "repl_lat_store_log_us");
+    static stat_elem& end_of_batch_lat = *stat_mgr::get_instance()->create_stat
+        (stat_elem::HISTOGRAM, "repl_lat_end_of_append_batch_us");
+
+    uint64_t start_us = stat_now_us();
+    for (uint64_t ts: enqueue_us) {
+        client_wait_lat += start_us - ts;
+    }
+
     ulong last_idx = 0;
-    ptr<buffer> ret_value = nullptr;
     ulong resp_idx = 1;
     ulong cur_term = state_->get_term();
+    size_t num_reqs = reqs.size();
+
+    std::vector< ptr<resp_msg> > resps(num_reqs);
+    for (size_t ii = 0; ii < num_reqs; ++ii) {
+        resps[ii] = cs_new<resp_msg>( cur_term,
+                                      msg_type::append_entries_response,
+                                      id_,
+                                      leader_ );
+    }
+    resps_out = resps;
+
+    // Done before taking the lock below, as it only touches
+    // the logs of the given requests.
+    bool log_entry_crc = ctx_->get_params()->log_entry_crc_;
+    std::vector< ptr<log_entry> > all_entries;
+    for (size_t ii = 0; ii < num_reqs; ++ii) {
+        std::vector< ptr<log_entry> >& entries = reqs[ii]->log_entries();
+        for (size_t jj = 0; jj < entries.size(); ++jj) {
+            // force the log's term to current term
+            entries.at(jj)->set_term(cur_term);
+            if (log_entry_crc && !entries.at(jj)->is_buf_null()) {
+                buffer& payload = entries.at(jj)->get_buf();
+                entries.at(jj)->set_crc32
+                    ( crc32c( payload.data_begin(), payload.size(), 0 ) );
+            }
+        }
+        all_entries.insert(all_entries.end(), entries.begin(), entries.end());
+    }
+
+    // In `dual_rw_lock` mode, only the caller holds the shared lock,
+    // so that appending logs and `pre_commit` should be serialized here.
+    // `end_of_append_batch` is called after releasing it, so that other
+    // requests can be appended while it is flushing the log store.
+    std::unique_lock<std::mutex> append_guard(cli_lock_, std::defer_lock);
+    if (ctx_->get_params()->locking_method_type_ == raft_params::dual_rw_lock) {
+        append_guard.lock();
+    }
 
-    resp = cs_new<resp_msg>( cur_term,
-                             msg_type::append_entries_response,
-                             id_,
-                             leader_ );
     if (role_ != srv_role::leader || write_paused_) {
-        resp->set_result_code( cmd_result_code::NOT_LEADER );
-        return resp;
+        for (ptr<resp_msg>& resp: resps) {
+            resp->set_result_code( cmd_result_code::NOT_LEADER );
+        }
+        return;
     }
 
-    std::vector< ptr<log_entry> >& entries = req.log_entries();
-    size_t num_entries = entries.size();
+    if (!check_flow_control()) {
+        for (ptr<resp_msg>& resp: resps) {
+            resp->set_result_code( cmd_result_code::SERVER_IS_BUSY );
+        }
+        return;
+    }
 
-    for (size_t i = 0; i < num_entries; ++i) {
-        // force the log's term to current term
-        entries.at(i)->set_term(cur_term);
+    // Last log index and the result of pre-commit of each request.
+    std::vector<ulong> last_idxs(num_reqs, 0);
+    std::vector< ptr<buffer> > ret_values(num_reqs);
+    size_t num_entries = 0;
+    uint64_t num_bytes = 0;
+
+    // Append logs of all requests to the log store at once.
+    ulong first_idx = store_log_entries(all_entries);
+    if (!all_entries.empty()) {
+        p_db("append at log_idx %zu - %zu\n",
+             first_idx, first_idx + all_entries.size() - 1);
+    }
 
-        ulong next_slot = store_log_entry(entries.at(i));
-        p_db("append at log_idx %d\n", (int)next_slot);
-        last_idx = next_slot;
+    for (size_t ii = 0; ii < num_reqs; ++ii) {
+        std::vector< ptr<log_entry> >& entries = reqs[ii]->log_entries();
+        for (size_t jj = 0; jj < entries.size(); ++jj) {
+            last_idx = first_idx + num_entries + jj;
 
-        ptr<buffer> buf = entries.at(i)->get_buf_ptr();
-        buf->pos(0);
-        ret_value = state_machine_->pre_commit_ext
-                    ( state_machine::ext_op_params( last_idx, buf ) );
+            ptr<buffer> buf = entries.at(jj)->get_buf_ptr();
+            buf->pos(0);
+            num_bytes += buf->size();
+            if (entries.at(jj)->get_val_type() == log_val_type::packed_app_log) {
+                ret_values[ii] = pre_commit_packed_log(last_idx, buf);
+            } else {
+                ret_values[ii] = state_machine_->pre_commit_ext
+                                 ( state_machine::ext_op_params( last_idx, buf ) );
+            }
+        }
+        num_entries += entries.size();
+        last_idxs[ii] = last_idx;
     }
+    uint64_t stored_us = stat_now_us();
+    store_log_lat += stored_us - start_us;
     if (num_entries) {
-        log_store_->end_of_append_batch(last_idx - num_entries, num_entries);
+        repl_lat_tracker_->on_appended(last_idx);
+        add_inflight_bytes(last_idx, num_bytes);
+        p_ev(TE_LOG_APPEND, last_idx, -1, cur_term);
     }
     precommit_index_ = last_idx;
     resp_idx = log_store_->next_slot();
+    if (append_guard.owns_lock()) append_guard.unlock();
+
+    if (num_entries) {
+        log_store_->end_of_append_batch(last_idx - num_entries, num_entries);
+        end_of_batch_lat += stat_now_us() - stored_us;
+    }
 
     // Finished appending logs and pre_commit of itself.
     cb_func::Param param(id_, leader_);
     param.ctx = &last_idx;
     CbReturnCode rc = ctx_->cb_func_.call(cb_func::AppendLogs, &param);
-    if (rc == CbReturnCode::ReturnNull) return nullptr;
-
-    if (!get_config()->is_async_replication()) {
-        // Sync replication:
-        //   Set callback function for `last_idx`.
-        ptr<commit_ret_elem> elem = cs_new<commit_ret_elem>();
-        elem->idx_ = last_idx;
-        elem->result_code_ = cmd_result_code::TIMEOUT;
-
-        {   auto_lock(commit_ret_elems_lock_);
-            auto entry = commit_ret_elems_.find(last_idx);
-            if (entry != commit_ret_elems_.end()) {
-                // Commit thread was faster than this.
-                elem = entry->second;
-            } else {
-                commit_ret_elems_.insert( std::make_pair(last_idx, elem) );
-            }
+    if (rc == CbReturnCode::ReturnNull) {
+        for (ptr<resp_msg>& resp: resps_out) resp.reset();
+        return;
+    }
 
-            switch (ctx_->get_params()->return_method_) {
-            case raft_params::blocking:
-            default:
-                // Blocking call: set callback function waiting for the result.
-                resp->set_cb( std::bind( &raft_server::handle_cli_req_callback,
-                                         this,
-                                         elem,
-                                         std::placeholders::_1 ) );
-                break;
-
-            case raft_params::async_handler:
-                // Async handler: create & set async result object.
-                if (!elem->async_result_) {
-                    elem->async_result_ = cs_new< cmd_result< ptr<buffer> > >();
+    for (size_t ii = 0; ii < num_reqs; ++ii) {
+        ptr<resp_msg>& resp = resps[ii];
+        ulong cur_last_idx = last_idxs[ii];
+
+        if ( !get_config()->is_async_replication() &&
+             use_commit_ret_ring() ) {
+            // Sync replication, lock-free ring.
+            ptr< cmd_result< ptr<buffer> > > async_result =
+                cs_new< cmd_result< ptr<buffer> > >();
+            resp->set_async_cb
+                  ( std::bind( &raft_server::handle_cli_req_callback_async,
+                               this,
+                               async_result ) );
+            arrive_commit_ret(cur_last_idx, async_result, nullptr);
+
+        } else if (!get_config()->is_async_replication()) {
+            // Sync replication:
+            //   Set callback function for `cur_last_idx`.
+            ptr<commit_ret_elem> elem = cs_new<commit_ret_elem>();
+            elem->idx_ = cur_last_idx;
+            elem->result_code_ = cmd_result_code::TIMEOUT;
+
+            {   auto_lock(commit_ret_elems_lock_);
+                auto entry = commit_ret_elems_.find(cur_last_idx);
+                if (entry != commit_ret_elems_.end()) {
+                    // Commit thread was faster than this.
+                    elem = entry->second;
+                } else {
+                    commit_ret_elems_.insert( std::make_pair(cur_last_idx, elem) );
+                }
+
+                switch (ctx_->get_params()->return_method_) {
+                case raft_params::blocking:
+                default:
+                    // Blocking call: set callback function waiting for the result.
+                    resp->set_cb( std::bind( &raft_server::handle_cli_req_callback,
+                                             this,
+                                             elem,
+                                             std::placeholders::_1 ) );
+                    break;
+
+                case raft_params::async_handler:
+                    // Async handler: create & set async result object.
+                    if (!elem->async_result_) {
+                        elem->async_result_ = cs_new< cmd_result< ptr<buffer> > >();
+                    }
+                    resp->set_async_cb
+                          ( std::bind( &raft_server::handle_cli_req_callback_async,
+                                       this,
+                                       elem->async_result_ ) );
+                    break;
                 }
-                resp->set_async_cb
-                      ( std::bind( &raft_server::handle_cli_req_callback_async,
-                                   this,
-                                   elem->async_result_ ) );
-                break;
             }
+
+        } else {
+            // Async replication:
+            //   Immediately return with the result of pre-commit.
+            p_dv( "asynchronously replicated %ld, return value %p\n",
+                  cur_last_idx, ret_values[ii].get() );
+            resp->set_ctx(ret_values[ii]);
         }
 
-    } else {
-        // Async replication:
-        //   Immediately return with the result of pre-commit.
-        p_dv( "asynchronously replicated %ld, return value %p\n",
-              last_idx, ret_value.get() );
-        resp->set_ctx(ret_value);
+        resp->accept(resp_idx);
     }
-
-    resp->accept(resp_idx);
-    return resp;
 }
 
 ptr<resp_msg> raft_server::handle_cli_req_callback(ptr<commit_ret_elem> elem,
@@ -203,6 +632,157 @@ ptr< cmd_result< ptr<buffer> > >
     return async_res;
 }
 
+bool raft_server::use_commit_ret_ring() const {
+    return ( !commit_ret_ring_.empty() &&
+             ctx_->get_params()->return_method_ == raft_params::async_handler );
+}
+
+void raft_server::arrive_commit_ret(ulong idx,
+                                    ptr< cmd_result< ptr<buffer> > > async_result,
+                                    ptr<buffer> ret_value)
+{
+    // Called by either client thread (registration, with `async_result`)
+    // or commit thread (completion, with `ret_value`). The one arriving
+    // later delivers the result.
+    typedef commit_ret_slot cs;
+    bool is_commit = !async_result;
+    cs::state_flag my_flag = is_commit ? cs::COMMITTED : cs::REGISTERED;
+    cs::state_flag other_flag = is_commit ? cs::REGISTERED : cs::COMMITTED;
+    commit_ret_slot& slot = *commit_ret_ring_[idx & (commit_ret_ring_.size() - 1)];
+    if (is_commit) {
+        // Before publishing the result. See `arrive_commit_ret_map`.
+        commit_ret_notified_idx_ = idx;
+    }
+
+    uint64_t cur = slot.state_.load(std::memory_order_acquire);
+    while (true) {
+        ulong cur_idx = cs::get_idx(cur);
+        cs::state_flag cur_flag = cs::get_flag(cur);
+
+        if (cur_flag == cs::BUSY) {
+            // Other thread is modifying the slot, it will be very short.
+            std::this_thread::yield();
+            cur = slot.state_.load(std::memory_order_acquire);
+            continue;
+        }
+
+        if (cur_idx > idx) {
+            // The slot is already taken by a newer log, the other side
+            // of this log is (or will be) in the map.
+            arrive_commit_ret_map(idx, async_result, ret_value);
+            return;
+        }
+
+        if (cur_idx == idx) {
+            if (cur_flag == other_flag) {
+                if ( !slot.state_.compare_exchange_weak
+                          ( cur, cs::make_state(idx, cs::BUSY) ) ) continue;
+                if (is_commit) {
+                    async_result = slot.async_result_;
+                } else {
+                    ret_value = slot.ret_value_;
+                }
+                slot.async_result_.reset();
+                slot.ret_value_.reset();
+                slot.state_.store( cs::make_state(idx, cs::FREE),
+                                   std::memory_order_release );
+
+                // Calling handler should be done outside the slot.
+                ptr<std::exception> err = nullptr;
+                async_result->set_result_code(cmd_result_code::OK);
+                async_result->set_result(ret_value, err);
+
+            } else if (!is_commit) {
+                // Already cancelled.
+                ptr<buffer> result = nullptr;
+                ptr<std::exception> err =
+                    cs_new<std::runtime_error>("Request cancelled.");
+                async_result->set_result_code(cmd_result_code::CANCELLED);
+                async_result->set_result(result, err);
+            }
+            return;
+        }
+
+        // Older log or empty slot: take it.
+        if ( !slot.state_.compare_exchange_weak
+                  ( cur, cs::make_state(idx, cs::BUSY) ) ) continue;
+
+        ptr< cmd_result< ptr<buffer> > > old_result = nullptr;
+        if (cur_flag == cs::REGISTERED) {
+            // Older request is still waiting for its result,
+            // move it to the map.
+            old_result = slot.async_result_;
+        }
+        // Otherwise, the older log is committed but nobody has
+        // registered for it (e.g., not the last log of a request, or
+        // appended by others). Drop it, so as not to pile it up in
+        // the map. A late request will find `commit_ret_notified_idx_`.
+        slot.async_result_ = async_result;
+        slot.ret_value_ = ret_value;
+        slot.state_.store( cs::make_state(idx, my_flag),
+                           std::memory_order_release );
+
+        if (old_result) {
+            p_db("commit ret ring overflow, move %zu to map", cur_idx);
+            arrive_commit_ret_map(cur_idx, old_result, nullptr);
+        }
+        return;
+    }
+}
+
+void raft_server::arrive_commit_ret_map(ulong idx,
+                                        ptr< cmd_result< ptr<buffer> > > async_result,
+                                        ptr<buffer> ret_value)
+{
+    ptr<commit_ret_elem> elem = nullptr;
+    {   auto_lock(commit_ret_elems_lock_);
+        auto entry = commit_ret_elems_.find(idx);
+        if (entry == commit_ret_elems_.end()) {
+            if (!async_result) {
+                // Only the requests waiting for their results are kept
+                // in the map. Nobody has registered for this log yet,
+                // and a late request will be completed below.
+                return;
+            }
+            if (idx <= commit_ret_notified_idx_) {
+                // Committed but the result has been dropped, as the
+                // request registered too late.
+                p_wn("commit result of log %zu has been dropped", idx);
+            } else {
+                // The other side has not arrived yet.
+                ptr<commit_ret_elem> new_elem = cs_new<commit_ret_elem>();
+                new_elem->idx_ = idx;
+                new_elem->async_result_ = async_result;
+                new_elem->result_code_ = cmd_result_code::TIMEOUT;
+                commit_ret_elems_.insert( std::make_pair(idx, new_elem) );
+                return;
+            }
+        } else {
+            elem = entry->second;
+            commit_ret_elems_.erase(entry);
+        }
+    }
+
+    if (!elem) {
+        // Dropped result, with the request above.
+    } else if (async_result) {
+        ret_value = elem->ret_value_;
+    } else {
+        async_result = elem->async_result_;
+    }
+    if (!async_result) return;
+
+    // Calling handler should be done outside the mutex.
+    ptr<std::exception> err = nullptr;
+    async_result->set_result_code(cmd_result_code::OK);
+    async_result->set_result(ret_value, err);
+}
+
+size_t raft_server::get_num_pending_commit_rets() {
+    auto_lock(commit_ret_elems_lock_);
+    return commit_ret_elems_.size();
+}
+
 void raft_server::drop_all_pending_commit_elems() {
     // Blocking mode:
     //   Invoke all awaiting requests to return `CANCELLED`.
@@ -224,9 +804,39 @@ void raft_server::drop_all_pending_commit_elems() {
     //   Set `CANCELLED` and set result & error.
     std::list< ptr<commit_ret_elem> > elems;
 
+    typedef commit_ret_slot cs;
+    for (ptr<commit_ret_slot>& entry: commit_ret_ring_) {
+        commit_ret_slot& slot = *entry;
+        uint64_t cur = slot.state_.load(std::memory_order_acquire);
+        while ( cs::get_flag(cur) != cs::FREE ) {
+            if ( cs::get_flag(cur) == cs::BUSY ) {
+                std::this_thread::yield();
+                cur = slot.state_.load(std::memory_order_acquire);
+                continue;
+            }
+            ulong idx = cs::get_idx(cur);
+            if ( !slot.state_.compare_exchange_weak
+                      ( cur, cs::make_state(idx, cs::BUSY) ) ) continue;
+
+            if (slot.async_result_) {
+                ptr<commit_ret_elem> elem = cs_new<commit_ret_elem>();
+                elem->idx_ = idx;
+                elem->async_result_ = slot.async_result_;
+                elems.push_back(elem);
+            }
+            slot.async_result_.reset();
+            slot.ret_value_.reset();
+            slot.state_.store( cs::make_state(idx, cs::FREE),
+                               std::memory_order_release );
+            break;
+        }
+    }
+
     {   auto_lock(commit_ret_elems_lock_);
         for (auto& entry: commit_ret_elems_) {
             ptr<commit_ret_elem>& ee = entry.second;
+            // Committed, but not requested by client (or cancelled).
+            if (!ee->async_result_) continue;
             elems.push_back(ee);
         }
         commit_ret_elems_.clear();
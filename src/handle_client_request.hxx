@@ -26,6 +26,9 @@ limitations under the License.
 #include "internal_timer.hxx"
 #include "ptr.hxx"
 #include "raft_server.hxx"
+#include "stat_mgr.hxx"
+
+#include <list>
 
 namespace nuraft {
 
@@ -46,5 +49,103 @@ struct raft_server::commit_ret_elem {
     ptr< cmd_result< ptr<buffer> > > async_result_;
 };
 
+struct raft_server::commit_ret_slot {
+    enum state_flag {
+        // Not used, or the result has been delivered.
+        FREE = 0x0,
+        // Client thread has set `async_result_`.
+        REGISTERED = 0x1,
+        // Commit thread has set `ret_value_`.
+        COMMITTED = 0x2,
+        // Being modified by a thread.
+        BUSY = 0x3,
+    };
+
+    static uint64_t make_state(ulong idx, state_flag flag) {
+        return ((uint64_t)idx << 2) | flag;
+    }
+
+    static ulong get_idx(uint64_t state) { return state >> 2; }
+
+    static state_flag get_flag(uint64_t state) {
+        return (state_flag)(state & 0x3);
+    }
+
+    commit_ret_slot() : state_(make_state(0, FREE)) {}
+
+    // Log index (upper bits) and flag (lower 2 bits).
+    // Log index of a slot only increases.
+    std::atomic<uint64_t> state_;
+
+    // Async result of the client request, set by the client thread.
+    ptr< cmd_result< ptr<buffer> > > async_result_;
+
+    // Result of the state machine, set by the commit thread.
+    ptr<buffer> ret_value_;
+};
+
+struct raft_server::group_commit_elem {
+    group_commit_elem(req_msg& req)
+        : req_(req)
+        , enqueue_us_(stat_now_us())
+        , resp_(nullptr)
+        , state_(PENDING)
+        , next_(nullptr)
+        {}
+
+    // Client request to append.
+    req_msg& req_;
+
+    // Time when the request is submitted, for the latency stat.
+    uint64_t enqueue_us_;
+
+    // Response of `handle_cli_req`, set by the appender.
+    ptr<resp_msg> resp_;
+
+    enum state_type {
+        // Waiting for the appender.
+        PENDING = 0,
+        // `resp_` is set, the appender will not touch this element anymore.
+        DONE = 1,
+    };
+    // Protected by `group_commit_lock_`.
+    int state_;
+
+    // Next (earlier submitted) element in the submission queue.
+    group_commit_elem* next_;
+};
+
+struct raft_server::forward_elem {
+    forward_elem(ptr<req_msg>& req)
+        : req_(req)
+        , result_( cs_new< cmd_result< ptr<buffer> > >() )
+        {}
+
+    // Client request to forward.
+    ptr<req_msg> req_;
+
+    // Result to be set once the leader responds.
+    ptr< cmd_result< ptr<buffer> > > result_;
+};
+
+struct raft_server::forward_queue {
+    forward_queue(int32 leader_id)
+        : leader_id_(leader_id)
+        , num_clients_(0)
+        {}
+
+    // ID of the leader that the requests in this queue are sent to.
+    int32 leader_id_;
+
+    // Requests waiting for an idle connection, in submission order.
+    std::list< ptr<forward_elem> > pending_;
+
+    // Connections not carrying any request.
+    std::list< ptr<rpc_client> > idle_clients_;
+
+    // Number of connections created, including busy ones.
+    size_t num_clients_;
+};
+
 } // namespace nuraft;
 
@@ -23,12 +23,16 @@ limitations under the License.
 #include "cluster_config.hxx"
 #include "error_code.hxx"
 #include "handle_client_request.hxx"
+#include "log_prefetcher.hxx"
 #include "peer.hxx"
 #include "snapshot.hxx"
+#include "stat_mgr.hxx"
 #include "state_machine.hxx"
 #include "state_mgr.hxx"
+#include "term_index.hxx"
 #include "tracer.hxx"
 
+#include <algorithm>
 #include <cassert>
 #include <list>
 #include <sstream>
@@ -39,6 +43,9 @@ void raft_server::commit(ulong target_idx) {
     if (target_idx > quick_commit_index_) {
         quick_commit_index_ = target_idx;
         p_db( "trigger commit upto %lu", quick_commit_index_.load() );
+        repl_lat_tracker_->on_quorum_commit(target_idx);
+        release_inflight_bytes(target_idx);
+        p_ev(TE_COMMIT_QUORUM, target_idx, -1, state_->get_term());
 
         // if this is a leader notify peers to commit as well
         // for peers that are free, send the request, otherwise,
@@ -103,6 +110,7 @@ void raft_server::commit_in_bg() {
             if (stopping_) {
                 lock.unlock();
                 lock.release();
+                commit_prefetcher_.reset();
                 { std::unique_lock<std::mutex> lock2(ready_to_stop_cv_lock_);
                   ready_to_stop_cv_.notify_all(); }
                 commit_bg_stopped_ = true;
@@ -122,14 +130,22 @@ void raft_server::commit_in_bg() {
                  log_start_idx,
                  log_start_idx - 1);
             sm_commit_index_ = log_start_idx - 1;
+            sm_applied_index_ = log_start_idx - 1;
         }
 
         ptr<cluster_config> cur_config = get_config();
         bool need_to_handle_commit_elem = ( is_leader() &&
                                             !cur_config->is_async_replication() );
 
+        int32 max_batch = ctx_->get_params()->max_commit_batch_size_;
+
         while ( sm_commit_index_ < quick_commit_index_ &&
                 sm_commit_index_ < log_store_->next_slot() - 1 ) {
+            if (max_batch > 1) {
+                commit_in_batch(need_to_handle_commit_elem);
+                continue;
+            }
+
             sm_commit_index_ += 1;
             ptr<log_entry> le = log_store_->entry_at(sm_commit_index_);
             p_tr( "commit upto %llu, curruent idx %llu\n",
@@ -149,14 +165,22 @@ void raft_server::commit_in_bg() {
             if (le->get_val_type() == log_val_type::app_log) {
                 commit_app_log(le, need_to_handle_commit_elem);
 
+            } else if (le->get_val_type() == log_val_type::packed_app_log) {
+                commit_packed_log(le, need_to_handle_commit_elem);
+
             } else if (le->get_val_type() == log_val_type::conf) {
                 commit_conf(le);
             }
+            sm_applied_index_ = sm_commit_index_.load();
 
             snapshot_and_compact(sm_commit_index_);
         }
         p_db( "DONE: commit upto %ld, curruent idx %ld\n",
               quick_commit_index_.load(), sm_commit_index_.load() );
+        repl_lat_tracker_->on_sm_commit(sm_commit_index_);
+        p_ev(TE_COMMIT_SM, sm_commit_index_, -1, state_->get_term());
+        notify_read_index_waiters();
+
         if (role_ == srv_role::follower) {
             ulong leader_idx = leader_commit_index_.load();
             ulong local_idx = sm_commit_index_.load();
@@ -190,6 +214,108 @@ void raft_server::commit_in_bg() {
     commit_bg_stopped_ = true;
 }
 
+void raft_server::commit_in_batch(bool need_to_handle_commit_elem) {
+    ptr<raft_params> params = ctx_->get_params();
+    ulong first_idx = sm_commit_index_ + 1;
+    ulong last_idx = std::min( quick_commit_index_.load(),
+                               log_store_->next_slot() - 1 );
+    last_idx = std::min( last_idx,
+                         first_idx + params->max_commit_batch_size_ - 1 );
+
+    std::vector< ptr<log_entry> > les;
+    if (params->commit_prefetch_) {
+        ptr< std::vector< ptr<log_entry> > > fetched =
+            get_prefetched_logs(first_idx, last_idx);
+        if (fetched) {
+            les.swap(*fetched);
+            // Batch read ahead can be shorter than the current one.
+            last_idx = first_idx + les.size() - 1;
+        }
+    } else if (commit_prefetcher_) {
+        commit_prefetcher_.reset();
+    }
+    if (les.empty()) {
+        les.clear();
+        les.reserve(last_idx - first_idx + 1);
+        for (ulong ii = first_idx; ii <= last_idx; ++ii) {
+            les.push_back( log_store_->entry_at(ii) );
+        }
+    }
+    p_tr( "commit batch %llu - %llu, quick_commit_index_ %llu\n",
+          first_idx, last_idx, quick_commit_index_.load() );
+
+    // Consecutive application logs are committed together,
+    // split by other types of logs.
+    std::vector< ptr<log_entry> > app_les;
+    ulong app_first_idx = first_idx;
+    for (ulong ii = first_idx; ii <= last_idx; ++ii) {
+        ptr<log_entry>& le = les[ii - first_idx];
+        if (le->get_term() == 0) {
+            // LCOV_EXCL_START
+            p_ft( "empty log at idx %llu, must be log corruption", ii );
+            ctx_->state_mgr_->system_exit(raft_err::N19_bad_log_idx_for_term);
+            ::exit(-1);
+            // LCOV_EXCL_STOP
+        }
+
+        if (le->get_val_type() == log_val_type::app_log) {
+            if (app_les.empty()) app_first_idx = ii;
+            app_les.push_back(le);
+            continue;
+        }
+
+        if (!app_les.empty()) {
+            commit_app_log_batch(app_les, app_first_idx,
+                                 need_to_handle_commit_elem);
+            app_les.clear();
+        }
+        sm_commit_index_ = ii;
+        if (le->get_val_type() == log_val_type::packed_app_log) {
+            commit_packed_log(le, need_to_handle_commit_elem);
+        } else if (le->get_val_type() == log_val_type::conf) {
+            commit_conf(le);
+        }
+        sm_applied_index_ = ii;
+    }
+    if (!app_les.empty()) {
+        commit_app_log_batch(app_les, app_first_idx,
+                             need_to_handle_commit_elem);
+    }
+
+    snapshot_and_compact(sm_commit_index_);
+}
+
+ptr< std::vector< ptr<log_entry> > >
+    raft_server::get_prefetched_logs(ulong first_idx, ulong last_idx)
+{
+    ptr<raft_params> params = ctx_->get_params();
+    size_t batch_size = params->max_commit_batch_size_;
+    size_t max_batches = std::max(params->commit_prefetch_batches_, 1);
+
+    // Restart the prefetcher once if it is not reading
+    // from `first_idx`, e.g., after installing a snapshot.
+    for (size_t ii = 0; ii < 2; ++ii) {
+        if (!commit_prefetcher_) {
+            commit_prefetcher_ = cs_new<log_prefetcher>
+                                 ( log_store_, first_idx,
+                                   batch_size, max_batches );
+        }
+        // All committed logs can be read ahead.
+        commit_prefetcher_->set_limit( std::min( quick_commit_index_.load(),
+                                                 log_store_->next_slot() - 1 ) );
+
+        ptr< std::vector< ptr<log_entry> > > ret =
+            commit_prefetcher_->get(first_idx);
+        if (ret && !ret->empty() && ret->size() <= last_idx - first_idx + 1) {
+            return ret;
+        }
+        commit_prefetcher_.reset();
+    }
+    p_wn("failed to get prefetched logs from %llu, read them directly",
+         first_idx);
+    return nullptr;
+}
+
 void raft_server::commit_app_log(ptr<log_entry>& le,
                                  bool need_to_handle_commit_elem)
 {
@@ -209,53 +335,185 @@ void raft_server::commit_app_log(ptr<log_entry>& le,
                 ( state_machine::ext_op_params( sm_idx, buf ) );
     if (ret_value) ret_value->pos(0);
 
-    std::list< ptr<commit_ret_elem> > async_elems;
     if (need_to_handle_commit_elem) {
-        std::unique_lock<std::mutex> cre_lock(commit_ret_elems_lock_);
-        bool match_found = false;
-        auto entry = commit_ret_elems_.begin();
+        std::vector< ptr<buffer> > ret_values(1, ret_value);
+        notify_commit_ret_elems(sm_idx, ret_values);
+    }
+}
+
+void raft_server::commit_packed_log(ptr<log_entry>& le,
+                                    bool need_to_handle_commit_elem)
+{
+    ulong sm_idx = sm_commit_index_.load();
+    ulong pc_idx = precommit_index_.load();
+    if (pc_idx < sm_idx) {
+        // Pre-commit should have been invoked, must be a bug.
+        p_ft( "pre-commit index %zu is smaller than commit index %zu",
+              pc_idx, sm_idx );
+        ctx_->state_mgr_->system_exit(raft_err::N23_precommit_order_inversion);
+        ::exit(-1);
+    }
+
+    std::vector< ptr<buffer> > bufs;
+    if (!unpack_app_logs(le->get_buf(), bufs)) {
+        // LCOV_EXCL_START
+        p_ft( "corrupted packed log at idx %llu", sm_idx );
+        ctx_->state_mgr_->system_exit(raft_err::N25_corrupted_packed_log);
+        ::exit(-1);
+        // LCOV_EXCL_STOP
+    }
+
+    // `ext_op_params` refers to the buffer pointers.
+    std::vector<state_machine::ext_op_params> params;
+    params.reserve(bufs.size());
+    for (ptr<buffer>& buf: bufs) {
+        params.push_back( state_machine::ext_op_params( sm_idx, buf ) );
+    }
+
+    std::vector< ptr<buffer> > results;
+    state_machine_->commit_packed(params, results);
+    results.resize(bufs.size());
+
+    if (need_to_handle_commit_elem) {
+        // Result of each payload is delivered as a packed buffer,
+        // and `append_packed_entries` unpacks it.
+        std::vector< ptr<buffer> > ret_values(1, pack_app_logs(results));
+        notify_commit_ret_elems(sm_idx, ret_values);
+    }
+}
+
+ptr<buffer> raft_server::pre_commit_packed_log(ulong log_idx, ptr<buffer>& buf) {
+    std::vector< ptr<buffer> > bufs;
+    if (!unpack_app_logs(*buf, bufs)) {
+        p_er("corrupted packed log at idx %llu, skip pre-commit", log_idx);
+        return nullptr;
+    }
+
+    std::vector< ptr<buffer> > results(bufs.size());
+    for (size_t ii = 0; ii < bufs.size(); ++ii) {
+        results[ii] = state_machine_->pre_commit_ext
+                      ( state_machine::ext_op_params( log_idx, bufs[ii] ) );
+    }
+    return pack_app_logs(results);
+}
+
+void raft_server::rollback_packed_log(ulong log_idx, ptr<buffer>& buf) {
+    std::vector< ptr<buffer> > bufs;
+    if (!unpack_app_logs(*buf, bufs)) {
+        p_er("corrupted packed log at idx %llu, skip rollback", log_idx);
+        return;
+    }
+
+    // In the reverse order of pre-commit.
+    for (size_t ii = bufs.size(); ii > 0; --ii) {
+        state_machine_->rollback_ext
+            ( state_machine::ext_op_params( log_idx, bufs[ii - 1] ) );
+    }
+}
+
+void raft_server::commit_app_log_batch(std::vector< ptr<log_entry> >& les,
+                                       ulong first_idx,
+                                       bool need_to_handle_commit_elem)
+{
+    ulong last_idx = first_idx + les.size() - 1;
+    ulong pc_idx = precommit_index_.load();
+    if (pc_idx < last_idx) {
+        // Pre-commit should have been invoked, must be a bug.
+        p_ft( "pre-commit index %zu is smaller than commit index %zu",
+              pc_idx, last_idx );
+        ctx_->state_mgr_->system_exit(raft_err::N23_precommit_order_inversion);
+        ::exit(-1);
+    }
+
+    // `ext_op_params` refers to the buffer pointers.
+    std::vector< ptr<buffer> > bufs(les.size());
+    std::vector<state_machine::ext_op_params> params;
+    params.reserve(les.size());
+    for (size_t ii = 0; ii < les.size(); ++ii) {
+        bufs[ii] = les[ii]->get_buf_ptr();
+        bufs[ii]->pos(0);
+        params.push_back( state_machine::ext_op_params( first_idx + ii,
+                                                        bufs[ii] ) );
+    }
+
+    sm_commit_index_ = last_idx;
+    std::vector< ptr<buffer> > ret_values;
+    state_machine_->commit_batch(params, ret_values);
+    sm_applied_index_ = last_idx;
+    ret_values.resize(les.size());
+    for (ptr<buffer>& ret_value: ret_values) {
+        if (ret_value) ret_value->pos(0);
+    }
+
+    if (need_to_handle_commit_elem) {
+        notify_commit_ret_elems(first_idx, ret_values);
+    }
+}
+
+void raft_server::notify_commit_ret_elems(ulong first_idx,
+                                          std::vector< ptr<buffer> >& ret_values)
+{
+    static stat_elem& callback_lat = *stat_mgr::get_instance()->create_stat
+        (stat_elem::HISTOGRAM, "repl_lat_callback_us");
+
+    if (ret_values.empty()) return;
+    ulong last_idx = first_idx + ret_values.size() - 1;
+
+    if (use_commit_ret_ring()) {
+        for (size_t ii = 0; ii < ret_values.size(); ++ii) {
+            // Handler is invoked inside if the client is waiting.
+            uint64_t start_us = stat_now_us();
+            arrive_commit_ret(first_idx + ii, nullptr, ret_values[ii]);
+            callback_lat += stat_now_us() - start_us;
+        }
+        return;
+    }
+
+    std::list< ptr<commit_ret_elem> > async_elems;
+    {   std::unique_lock<std::mutex> cre_lock(commit_ret_elems_lock_);
+        std::vector<bool> match_found(ret_values.size(), false);
+        auto entry = commit_ret_elems_.lower_bound(first_idx);
         while (entry != commit_ret_elems_.end()) {
             ptr<commit_ret_elem> elem = entry->second;
-            if (elem->idx_ > sm_idx) {
-                break;
-            } else if (elem->idx_ == sm_idx) {
-                elem->result_code_ = cmd_result_code::OK;
-                elem->ret_value_ = ret_value;
-                match_found = true;
-                p_dv("notify cb %ld %p", sm_idx, &elem->awaiter_);
-
-                switch (ctx_->get_params()->return_method_) {
-                case raft_params::blocking:
-                default:
-                    // Blocking mode: invoke waiting function.
-                    elem->awaiter_.invoke();
-                    entry++;
-                    break;
-
-                case raft_params::async_handler:
-                    // Async handler: put into list.
-                    async_elems.push_back(elem);
-                    entry = commit_ret_elems_.erase(entry);
-                    break;
-                }
+            if (elem->idx_ > last_idx) break;
 
-            } else {
+            size_t pos = elem->idx_ - first_idx;
+            elem->result_code_ = cmd_result_code::OK;
+            elem->ret_value_ = ret_values[pos];
+            match_found[pos] = true;
+            p_dv("notify cb %ld %p", elem->idx_, &elem->awaiter_);
+
+            switch (ctx_->get_params()->return_method_) {
+            case raft_params::blocking:
+            default:
+                // Blocking mode: invoke waiting function.
+                elem->awaiter_.invoke();
                 entry++;
+                break;
+
+            case raft_params::async_handler:
+                // Async handler: put into list.
+                async_elems.push_back(elem);
+                entry = commit_ret_elems_.erase(entry);
+                break;
             }
         }
 
-        if (!match_found) {
+        for (size_t ii = 0; ii < ret_values.size(); ++ii) {
+            if (match_found[ii]) continue;
+
             // If not found, commit thread is invoked earlier than user thread.
             // Create one here.
+            ulong idx = first_idx + ii;
             ptr<commit_ret_elem> elem = cs_new<commit_ret_elem>();
-            elem->idx_ = sm_idx;
+            elem->idx_ = idx;
             elem->result_code_ = cmd_result_code::OK;
-            elem->ret_value_ = ret_value;
+            elem->ret_value_ = ret_values[ii];
             switch (ctx_->get_params()->return_method_) {
             case raft_params::blocking:
             default:
                 elem->awaiter_.invoke(); // Callback will not sleep.
-                commit_ret_elems_.insert( std::make_pair(sm_idx, elem) );
+                commit_ret_elems_.insert( std::make_pair(idx, elem) );
                 break;
             case raft_params::async_handler:
                 // Async handler: put into list.
@@ -271,8 +529,10 @@ void raft_server::commit_app_log(ptr<log_entry>& le,
         ptr<commit_ret_elem>& elem = entry;
         if (elem->async_result_) {
             ptr<std::exception> err = nullptr;
+            uint64_t start_us = stat_now_us();
             elem->async_result_->set_result_code(cmd_result_code::OK);
             elem->async_result_->set_result( elem->ret_value_, err );
+            callback_lat += stat_now_us() - start_us;
             elem->ret_value_.reset();
             elem->async_result_.reset();
         }
@@ -457,7 +717,11 @@ void raft_server::on_snapshot_completed
             ulong compact_upto = new_snp->get_last_log_idx() -
                                      (ulong)params->reserved_log_items_;
             p_db("log_store_ compact upto %ld", compact_upto);
-            log_store_->compact(compact_upto);
+            if (params->use_bg_thread_for_log_compaction_) {
+                request_log_compaction(compact_upto);
+            } else if (log_store_->compact(compact_upto)) {
+                term_index_->compact(compact_upto);
+            }
         }
     }
  } while (false);
@@ -465,6 +729,76 @@ void raft_server::on_snapshot_completed
     snp_in_progress_.store(false);
 }
 
+void raft_server::request_log_compaction(ulong upto) {
+    std::lock_guard<std::mutex> l(compact_lock_);
+    if (upto <= compact_watermark_) return;
+
+    // From now on, logs up to `upto` are regarded as gone.
+    compact_watermark_ = upto;
+    compact_target_ = upto;
+    if (!bg_compact_thread_.joinable()) {
+        bg_compact_thread_ = std::thread(&raft_server::compact_logs_in_bg, this);
+    }
+    compact_cv_.notify_all();
+}
+
+void raft_server::wait_for_log_compaction() {
+    std::unique_lock<std::mutex> l(compact_lock_);
+    while ( (compact_target_ || compact_running_) &&
+            !stopping_ ) {
+        compact_cv_.wait(l);
+    }
+}
+
+void raft_server::stop_compaction_thread() {
+    {   std::lock_guard<std::mutex> l(compact_lock_);
+        compact_cv_.notify_all();
+    }
+    if (bg_compact_thread_.joinable()) {
+        bg_compact_thread_.join();
+    }
+}
+
+void raft_server::compact_logs_in_bg() {
+    std::string thread_name = "nuraft_compact";
+#ifdef __linux__
+    pthread_setname_np(pthread_self(), thread_name.c_str());
+#elif __APPLE__
+    pthread_setname_np(thread_name.c_str());
+#endif
+
+    static stat_elem& compact_latency = *stat_mgr::get_instance()->create_stat
+        (stat_elem::HISTOGRAM, "log_compaction_us");
+
+    p_in("bg compaction thread initiated");
+    std::unique_lock<std::mutex> l(compact_lock_);
+    while (!stopping_) {
+        if (!compact_target_) {
+            compact_cv_.wait(l);
+            continue;
+        }
+
+        // Requests made in the meantime are merged into the latest one.
+        ulong upto = compact_target_;
+        compact_target_ = 0;
+        compact_running_ = true;
+        l.unlock();
+
+        timer_helper tt;
+        bool ok = log_store_->compact(upto);
+        if (ok) term_index_->compact(upto);
+        compact_latency += tt.get_us();
+        p_db("compacted logs up to %lu in bg: %s, took %zu us",
+             upto, ok ? "OK" : "FAILED", tt.get_us());
+
+        l.lock();
+        compact_running_ = false;
+        compact_cv_.notify_all();
+    }
+    compact_cv_.notify_all();
+    p_in("bg compaction thread terminated");
+}
+
 void raft_server::reconfigure(const ptr<cluster_config>& new_config) {
     ptr<cluster_config> cur_config = get_config();
     p_in( "new config log idx %zu, prev log idx %zu, "
@@ -497,6 +831,11 @@ void raft_server::reconfigure(const ptr<cluster_config>& new_config) {
         }
         if (id_ == (*it)->get_id()) {
             my_priority_ = (*it)->get_priority();
+            if (im_learner_ && !(*it)->is_learner()) {
+                p_in("this server has been promoted to a voting member");
+                restart_election_timer();
+            }
+            im_learner_ = (*it)->is_learner();
             if (role_ == srv_role::follower &&
                 catching_up_) {
                 // If this node is newly added, start election timer
@@ -221,6 +221,43 @@ ptr<resp_msg> raft_server::handle_leadership_takeover
     return resp;
 }
 
+void raft_server::hand_over_leadership(ptr<peer>& p) {
+    leader_ = -1;
+
+    // To avoid this node becomes next leader again, set timeout
+    // value bigger than any others, just once at this time.
+    rand_timeout_ = [this]() -> int32 {
+        return this->ctx_->get_params()->election_timeout_upper_bound_ +
+               this->ctx_->get_params()->election_timeout_lower_bound_;
+    };
+    become_follower();
+    update_rand_timeout();
+
+    // Clear live flag to avoid pre-vote rejection.
+    hb_alive_ = false;
+
+    // Send leadership takeover request to the successor.
+    ptr<req_msg> req = cs_new<req_msg>
+                       ( state_->get_term(),
+                         msg_type::custom_notification_request,
+                         id_, p->get_id(),
+                         term_for_log(log_store_->next_slot() - 1),
+                         log_store_->next_slot() - 1,
+                         quick_commit_index_.load() );
+
+    // Create a notification.
+    ptr<custom_notification_msg> custom_noti =
+        cs_new<custom_notification_msg>
+        ( custom_notification_msg::leadership_takeover );
+
+    // Wrap it using log_entry.
+    ptr<log_entry> custom_noti_le =
+        cs_new<log_entry>(0, custom_noti->serialize(), log_val_type::custom);
+
+    req->log_entries().push_back(custom_noti_le);
+    p->send_req(p, req, resp_handler_);
+}
+
 void raft_server::handle_custom_notification_resp(resp_msg& resp) {
     if (!resp.get_accepted()) return;
 
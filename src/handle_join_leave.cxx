@@ -23,8 +23,11 @@ limitations under the License.
 #include "cluster_config.hxx"
 #include "event_awaiter.h"
 #include "peer.hxx"
+#include "snapshot.hxx"
 #include "state_machine.hxx"
+#include "stat_mgr.hxx"
 #include "state_mgr.hxx"
+#include "term_index.hxx"
 #include "tracer.hxx"
 
 #include <cassert>
@@ -32,6 +35,79 @@ limitations under the License.
 
 namespace nuraft {
 
+ptr< cmd_result< ptr<buffer> > > raft_server::promote_learner(const int srv_id)
+{
+    ptr<buffer> result;
+    ptr< cmd_result< ptr<buffer> > > ret =
+        cs_new< cmd_result< ptr<buffer> > >(result);
+
+    recur_lock(lock_);
+    if (role_ != srv_role::leader || write_paused_) {
+        p_wn("this is not a leader, cannot promote learner %d", srv_id);
+        ret->set_result_code(cmd_result_code::NOT_LEADER);
+        return ret;
+    }
+
+    auto entry = peers_.find(srv_id);
+    if (entry == peers_.end()) {
+        p_wn("cannot find learner %d to promote", srv_id);
+        ret->set_result_code(cmd_result_code::SERVER_NOT_FOUND);
+        return ret;
+    }
+    ptr<peer> pp = entry->second;
+    if (!pp->is_learner()) {
+        p_wn("server %d is already a voting member", srv_id);
+        ret->set_result_code(cmd_result_code::BAD_REQUEST);
+        return ret;
+    }
+
+    if (config_changing_) {
+        p_wn("previous config has not committed yet");
+        ret->set_result_code(cmd_result_code::CONFIG_CHANGING);
+        return ret;
+    }
+
+    ulong last_log_idx = log_store_->next_slot() - 1;
+    ulong matched_idx = pp->get_matched_idx();
+    ulong gap = ctx_->get_params()->fresh_log_gap_;
+    if (matched_idx + gap < last_log_idx) {
+        p_wn( "learner %d is lagging behind, matched idx %lu, "
+              "my last idx %lu, cannot promote it",
+              srv_id, matched_idx, last_log_idx );
+        ret->set_result_code(cmd_result_code::SERVER_IS_LAGGING);
+        return ret;
+    }
+
+    // Clone current cluster config.
+    ptr<cluster_config> cur_config = get_config();
+    if (uncommitted_config_) cur_config = uncommitted_config_;
+    ptr<buffer> enc_conf = cur_config->serialize();
+    ptr<cluster_config> new_conf = cluster_config::deserialize(*enc_conf);
+    for (auto& s_entry: new_conf->get_servers()) {
+        if (s_entry->get_id() == srv_id) {
+            s_entry->set_learner(false);
+        }
+    }
+    p_in( "promote learner %d to voting member, matched idx %lu, "
+          "my last idx %lu",
+          srv_id, matched_idx, last_log_idx );
+
+    new_conf->set_log_idx(log_store_->next_slot());
+    ptr<buffer> new_conf_buf(new_conf->serialize());
+    ptr<log_entry> le( cs_new<log_entry>
+                       ( state_->get_term(),
+                         new_conf_buf,
+                         log_val_type::conf ) );
+
+    config_changing_ = true;
+    uncommitted_config_ = new_conf;
+    store_log_entry(le);
+    request_append_entries();
+
+    ret->accept();
+    return ret;
+}
+
 ptr<resp_msg> raft_server::handle_add_srv_req(req_msg& req) {
     std::vector< ptr<log_entry> >& entries = req.log_entries();
     ptr<resp_msg> resp = cs_new<resp_msg>
@@ -169,6 +245,7 @@ ptr<resp_msg> raft_server::handle_join_cluster_req(req_msg& req) {
     if (reset_commit_idx) {
         // MONSTOR-7503: We should not reset it to 0.
         sm_commit_index_.store( initial_commit_index_ );
+        sm_applied_index_.store( initial_commit_index_ );
         quick_commit_index_.store( initial_commit_index_ );
     }
 
@@ -186,6 +263,9 @@ void raft_server::handle_join_cluster_resp(resp_msg& resp) {
         if (resp.get_accepted()) {
             p_in("new server (%d) confirms it will join, "
                  "start syncing logs to it", srv_to_join_->get_id());
+            srv_to_join_->set_next_log_idx(resp.get_next_idx());
+            srv_to_join_start_idx_ = resp.get_next_idx();
+            srv_to_join_timer_.reset();
             sync_log_to_new_srv(resp.get_next_idx());
         } else {
             p_wn("new server (%d) cannot accept the invitation, give up",
@@ -197,18 +277,40 @@ void raft_server::handle_join_cluster_resp(resp_msg& resp) {
 }
 
 void raft_server::sync_log_to_new_srv(ulong start_idx) {
+    static stat_elem& synced_logs = *stat_mgr::get_instance()->create_stat
+        (stat_elem::COUNTER, "new_member_sync_logs");
+    static stat_elem& sync_gap = *stat_mgr::get_instance()->create_stat
+        (stat_elem::GAUGE, "new_member_sync_gap");
+    static stat_elem& sync_rate = *stat_mgr::get_instance()->create_stat
+        (stat_elem::GAUGE, "new_member_sync_logs_per_sec");
+
     p_db("[SYNC LOG] peer %d start idx %llu, my log start idx %llu\n",
          srv_to_join_->get_id(), start_idx, log_store_->start_index());
     // only sync committed logs
     int32 gap = (int64_t)quick_commit_index_ - (int64_t)start_idx;
     ptr<raft_params> params = ctx_->get_params();
+
+    if (start_idx > srv_to_join_start_idx_) {
+        ulong synced = start_idx - srv_to_join_start_idx_;
+        uint64_t elapsed_us = srv_to_join_timer_.get_us();
+        if (elapsed_us) sync_rate.set(synced * 1000000 / elapsed_us);
+    }
+    sync_gap.set(std::max(gap, 0));
+
     if (gap < params->log_sync_stop_gap_) {
+        if (srv_to_join_->is_busy()) {
+            // Wait for the responses of in-flight requests,
+            // the last one will put the server into cluster.
+            return;
+        }
+
         p_in( "[SYNC LOG] LogSync is done for server %d "
               "with log gap %d (%zu - %zu, limit %d), "
               "now put the server into cluster",
               srv_to_join_->get_id(),
               gap, quick_commit_index_.load(), start_idx,
               params->log_sync_stop_gap_ );
+        sync_gap.set(0);
 
         ptr<cluster_config> cur_conf = get_config();
 
@@ -244,34 +346,85 @@ void raft_server::sync_log_to_new_srv(ulong start_idx) {
         return;
     }
 
-    ptr<req_msg> req;
-
     // Modified by Jung-Sang Ahn, 12/22, 2017.
     // When snapshot transmission is still in progress, start_idx can be 0.
     // We should tolerate this.
-    if (/* start_idx > 0 && */ start_idx < log_store_->start_index()) {
-        req = create_sync_snapshot_req( *srv_to_join_,
-                                        start_idx,
-                                        state_->get_term(),
-                                        quick_commit_index_);
-    } else {
-        int32 size_to_sync = std::min(gap, params->log_sync_batch_size_);
-        ptr<buffer> log_pack = log_store_->pack(start_idx, size_to_sync);
-        p_db( "size to sync: %d, log_pack size %zu\n",
-              size_to_sync, log_pack->size() );
-        req = cs_new<req_msg>( state_->get_term(),
-                               msg_type::sync_log_request,
-                               id_,
-                               srv_to_join_->get_id(),
-                               0L,
-                               start_idx - 1,
-                               quick_commit_index_.load() );
+    if (need_snapshot_for_new_srv(start_idx)) {
+        if (srv_to_join_->is_busy()) {
+            // Log sync requests are still in flight.
+            return;
+        }
+        ptr<req_msg> req = create_sync_snapshot_req( *srv_to_join_,
+                                                     start_idx,
+                                                     state_->get_term(),
+                                                     quick_commit_index_ );
+        if (req) srv_to_join_->send_req(srv_to_join_, req, ex_resp_handler_);
+        return;
+    }
+
+    // Same as append_entries, multiple log sync requests can be in
+    // flight once the new server acked the previous one.
+    int32 window = 1;
+    if ( params->append_pipeline_window_ > 1 &&
+         srv_to_join_->is_pipeline_ready() ) {
+        window = params->append_pipeline_window_;
+    }
+
+    ulong cur_idx = start_idx;
+    if (srv_to_join_->is_busy()) {
+        cur_idx = std::max(cur_idx, srv_to_join_->get_last_sent_idx() + 1);
+    }
+    while ( (int64_t)cur_idx < (int64_t)quick_commit_index_ &&
+            srv_to_join_->make_busy(window) ) {
+        int32 size_to_sync = (int32)std::min<ulong>
+                             ( quick_commit_index_ - cur_idx,
+                               params->log_sync_batch_size_ );
+        ptr<buffer> log_pack = log_store_->pack(cur_idx, size_to_sync);
+        p_db( "size to sync: %d, log_pack size %zu, in-flight %d\n",
+              size_to_sync, log_pack->size(),
+              srv_to_join_->get_num_inflight() );
+        ptr<req_msg> req = cs_new<req_msg>( state_->get_term(),
+                                            msg_type::sync_log_request,
+                                            id_,
+                                            srv_to_join_->get_id(),
+                                            0L,
+                                            cur_idx - 1,
+                                            quick_commit_index_.load() );
         req->log_entries().push_back
             ( cs_new<log_entry>
               ( state_->get_term(), log_pack, log_val_type::log_pack) );
+
+        cur_idx += size_to_sync;
+        srv_to_join_->set_last_sent_idx(cur_idx - 1);
+        synced_logs += size_to_sync;
+        srv_to_join_->send_req(srv_to_join_, req, ex_resp_handler_);
     }
+}
 
-    srv_to_join_->send_req(srv_to_join_, req, ex_resp_handler_);
+bool raft_server::need_snapshot_for_new_srv(ulong start_idx) {
+    if (start_idx < log_store_->start_index()) return true;
+
+    // Snapshot transmission is in progress.
+    if (srv_to_join_->get_snapshot_sync_ctx()) return true;
+
+    ptr<raft_params> params = ctx_->get_params();
+    if (params->log_sync_snapshot_threshold_ <= 0) return false;
+
+    // Install the latest snapshot first, if it replaces
+    // enough number of logs to sync.
+    ptr<snapshot> snp = get_last_snapshot();
+    if ( !snp ||
+         snp->get_last_log_idx() < start_idx ||
+         snp->get_last_log_idx() - start_idx + 1 <=
+             (ulong)params->log_sync_snapshot_threshold_ ) {
+        return false;
+    }
+    p_in( "[SYNC LOG] snapshot %zu covers %zu logs to sync to server %d, "
+          "install it first",
+          snp->get_last_log_idx(),
+          snp->get_last_log_idx() - start_idx + 1,
+          srv_to_join_->get_id() );
+    return true;
 }
 
 ptr<resp_msg> raft_server::handle_log_sync_req(req_msg& req) {
@@ -298,7 +451,18 @@ ptr<resp_msg> raft_server::handle_log_sync_req(req_msg& req) {
         return resp;
     }
 
-    log_store_->apply_pack(req.get_last_log_idx() + 1, entries[0]->get_buf());
+    if (req.get_last_log_idx() + 1 > log_store_->next_slot()) {
+        // Previous request has been lost, leader will re-send it.
+        p_wn("log sync request starting at %llu is beyond "
+             "my next log idx %llu, reject it",
+             req.get_last_log_idx() + 1, resp->get_next_idx());
+        return resp;
+    }
+
+    {   std::lock_guard<std::mutex> l(log_append_lock_);
+        log_store_->apply_pack(req.get_last_log_idx() + 1, entries[0]->get_buf());
+        term_index_->rebuild(*log_store_);
+    }
     p_db("last log %ld\n", log_store_->next_slot() - 1);
     precommit_index_ = log_store_->next_slot() - 1;
     commit(log_store_->next_slot() - 1);
@@ -313,6 +477,9 @@ void raft_server::handle_log_sync_resp(resp_msg& resp) {
         srv_to_join_->resume_hb_speed();
         srv_to_join_->set_next_log_idx(resp.get_next_idx());
         srv_to_join_->set_matched_idx(resp.get_next_idx() - 1);
+        // Rejection means some requests in between have been lost,
+        // stop pipelining until all in-flight requests are done.
+        srv_to_join_->set_pipeline_ready(resp.get_accepted());
         sync_log_to_new_srv(resp.get_next_idx());
     } else {
         p_wn("got log sync resp while srv_to_join is null");
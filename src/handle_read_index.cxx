@@ -0,0 +1,331 @@
+/************************************************************************
+Modifications Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Original Copyright:
+See URL: https://github.com/datatechnology/cornerstone
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "raft_server.hxx"
+
+#include "peer.hxx"
+#include "tracer.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <list>
+#include <sstream>
+
+namespace nuraft {
+
+ptr< cmd_result<uint64_t> > raft_server::read_index() {
+    return read_index_internal(0);
+}
+
+ptr< cmd_result<uint64_t> > raft_server::read_index_internal(ulong min_log_idx) {
+    std::list< ptr<read_index_elem> > confirmed;
+    ptr<read_index_elem> elem;
+
+    {   recur_lock(lock_);
+        if ( role_ != srv_role::leader || write_paused_ || stopping_ ) {
+            uint64_t zero = 0;
+            ptr< cmd_result<uint64_t> > ret =
+                cs_new< cmd_result<uint64_t> >(zero, false);
+            ret->set_result_code(cmd_result_code::NOT_LEADER);
+            return ret;
+        }
+
+        // If the leader has not committed any log of its term yet
+        // (i.e., the config log appended by `become_leader`), its
+        // commit index may be behind the actual one. Use the last
+        // log index instead, which is safe.
+        ulong read_idx = quick_commit_index_;
+        bool committed_in_term = ( term_for_log(read_idx) == state_->get_term() );
+        if (!committed_in_term) {
+            read_idx = std::max(read_idx, log_store_->next_slot() - 1);
+        }
+        read_idx = std::max(read_idx, min_log_idx);
+
+        elem = cs_new<read_index_elem>(read_idx);
+        elem->result_->accept();
+
+        if (committed_in_term && check_read_lease()) {
+            p_tr("read index %zu, lease is valid", read_idx);
+            confirmed.push_back(elem);
+        } else {
+            p_tr("read index %zu, wait for leadership confirmation", read_idx);
+            read_index_queue_.push_back(elem);
+            if (read_index_round_.empty()) {
+                // Otherwise, it will be started once the current
+                // round is done, with all requests queued.
+                start_read_index_round();
+            }
+        }
+    }
+
+    if (!confirmed.empty()) {
+        wait_for_read_index_commit(confirmed);
+    }
+    return elem->result_;
+}
+
+bool raft_server::check_read_lease() {
+    ptr<raft_params> params = ctx_->get_params();
+    if (!params->lease_read_) return false;
+
+    // Followers will not start a new election at least for
+    // the election timeout after the last response. Heartbeat
+    // interval is used as a margin for the network latency.
+    int32 lease_ms = params->election_timeout_lower_bound_;
+    int32 expiry = get_leadership_expiry();
+    if (expiry > 0) lease_ms = std::min(lease_ms, expiry);
+    lease_ms -= params->heart_beat_interval_;
+    if (lease_ms <= 0) return false;
+
+    return check_quorum_responded(lease_ms);
+}
+
+bool raft_server::check_quorum_responded(int32 within_ms) {
+    int32 num_alive = 0;
+    for (auto& entry: peers_) {
+        ptr<peer> p = entry.second;
+        if (p->is_learner()) continue;
+
+        int32 resp_elapsed_ms = (int32)(p->get_resp_timer_us() / 1000);
+        if (resp_elapsed_ms < within_ms) num_alive++;
+    }
+    return num_alive >= get_quorum_for_read();
+}
+
+void raft_server::start_read_index_round() {
+    read_index_round_.splice(read_index_round_.end(), read_index_queue_);
+    read_index_round_targets_.clear();
+
+    // Responses to the next append entries requests (or later)
+    // confirm the leadership.
+    for (auto& entry: peers_) {
+        ptr<peer> p = entry.second;
+        if (p->is_learner()) continue;
+        read_index_round_targets_[p->get_id()] = p->get_append_req_seq() + 1;
+    }
+    p_tr("start read index round, %zu requests", read_index_round_.size());
+
+    for (auto& entry: peers_) {
+        ptr<peer> p = entry.second;
+        if (p->is_learner()) continue;
+        if (!request_append_entries(p)) {
+            // Busy, will be sent once the response of
+            // the current request arrives.
+            p->set_pending_commit();
+        }
+    }
+
+    // In case of quorum size 1.
+    check_read_index_round();
+}
+
+void raft_server::check_read_index_round() {
+    if (read_index_round_.empty()) return;
+
+    int32 num_acked = 0;
+    for (auto& entry: read_index_round_targets_) {
+        auto pe = peers_.find(entry.first);
+        if (pe == peers_.end()) continue;
+        if (pe->second->get_acked_append_req_seq() >= entry.second) {
+            num_acked++;
+        }
+    }
+    if (num_acked < get_quorum_for_read()) return;
+
+    p_tr("leadership confirmed, %zu read requests",
+         read_index_round_.size());
+    std::list< ptr<read_index_elem> > confirmed;
+    confirmed.swap(read_index_round_);
+    read_index_round_targets_.clear();
+    wait_for_read_index_commit(confirmed);
+
+    if (!read_index_queue_.empty()) {
+        start_read_index_round();
+    }
+}
+
+void raft_server::wait_for_read_index_commit
+                  ( std::list< ptr<read_index_elem> >& elems )
+{
+    {   auto_lock(read_index_waiters_lock_);
+        read_index_waiters_.splice(read_index_waiters_.end(), elems);
+    }
+    // State machine may have already applied them.
+    notify_read_index_waiters();
+}
+
+void raft_server::notify_read_index_waiters() {
+    std::list< ptr<read_index_elem> > done;
+    {   auto_lock(read_index_waiters_lock_);
+        if (read_index_waiters_.empty() && stale_read_waiters_.empty()) return;
+
+        // Should compare with the applied index, as `sm_commit_index_`
+        // is advanced before the state machine applies the log.
+        ulong sm_idx = sm_applied_index_.load();
+        for (auto* waiters: {&read_index_waiters_, &stale_read_waiters_}) {
+            auto entry = waiters->begin();
+            while (entry != waiters->end()) {
+                if ((*entry)->read_idx_ <= sm_idx) {
+                    done.push_back(*entry);
+                    entry = waiters->erase(entry);
+                } else {
+                    entry++;
+                }
+            }
+        }
+    }
+
+    // Calling handler should be done outside the mutex.
+    for (auto& entry: done) {
+        ptr<read_index_elem>& ee = entry;
+        uint64_t read_idx = ee->read_idx_;
+        ptr<std::exception> err = nullptr;
+        ee->result_->set_result_code(cmd_result_code::OK);
+        ee->result_->set_result(read_idx, err);
+    }
+}
+
+void raft_server::drop_all_read_index_reqs() {
+    std::list< ptr<read_index_elem> > elems;
+    {   recur_lock(lock_);
+        elems.splice(elems.end(), read_index_queue_);
+        elems.splice(elems.end(), read_index_round_);
+        read_index_round_targets_.clear();
+    }
+    {   auto_lock(read_index_waiters_lock_);
+        elems.splice(elems.end(), read_index_waiters_);
+    }
+
+    for (auto& entry: elems) {
+        ptr<read_index_elem>& ee = entry;
+        p_wn("cancelled read request %zu", ee->read_idx_);
+
+        uint64_t read_idx = ee->read_idx_;
+        ptr<std::exception> err =
+            cs_new<std::runtime_error>("Request cancelled.");
+        ee->result_->set_result_code(cmd_result_code::CANCELLED);
+        ee->result_->set_result(read_idx, err);
+    }
+}
+
+ptr< cmd_result<uint64_t> > raft_server::bounded_stale_read
+                            ( ulong min_log_idx, int32 max_staleness_ms )
+{
+    if (stopping_) {
+        uint64_t zero = 0;
+        ptr< cmd_result<uint64_t> > ret =
+            cs_new< cmd_result<uint64_t> >(zero, false);
+        ret->set_result_code(cmd_result_code::CANCELLED);
+        return ret;
+    }
+
+    bool leader_confirmed = false;
+    bool leader_unconfirmed = false;
+    if (max_staleness_ms >= 0) {
+        recur_lock(lock_);
+        if (role_ == srv_role::leader) {
+            // A deposed leader may not know that it is deposed yet.
+            // Its commit index can be used only if a quorum confirmed
+            // the leadership recently enough.
+            leader_confirmed = check_read_lease() ||
+                               check_quorum_responded(max_staleness_ms);
+            leader_unconfirmed = !leader_confirmed;
+        }
+    }
+    if (leader_unconfirmed) {
+        p_tr("bounded staleness read (min %zu, %d ms), "
+             "confirm leadership first",
+             min_log_idx, max_staleness_ms);
+        return read_index_internal(min_log_idx);
+    }
+
+    ptr<read_index_elem> elem = cs_new<read_index_elem>(min_log_idx);
+    elem->result_->accept();
+
+    {   auto_lock(read_index_waiters_lock_);
+        if (max_staleness_ms < 0) {
+            // Only the minimum index matters.
+            stale_read_waiters_.push_back(elem);
+
+        } else if (leader_confirmed) {
+            // Leader's own commit index is the latest one.
+            elem->read_idx_ = std::max(elem->read_idx_,
+                                       quick_commit_index_.load());
+            stale_read_waiters_.push_back(elem);
+
+        } else if ( leader_commit_received_ &&
+                    last_leader_commit_timer_.get_ms() <=
+                        (uint64_t)max_staleness_ms ) {
+            elem->read_idx_ = std::max(elem->read_idx_,
+                                       last_leader_commit_idx_);
+            stale_read_waiters_.push_back(elem);
+
+        } else {
+            p_tr("bounded staleness read (min %zu, %d ms), "
+                 "wait for leader's commit index",
+                 min_log_idx, max_staleness_ms);
+            stale_read_pending_.push_back(elem);
+            return elem->result_;
+        }
+        p_tr("bounded staleness read (min %zu, %d ms), read index %zu",
+             min_log_idx, max_staleness_ms, elem->read_idx_);
+    }
+
+    // State machine may have already applied it.
+    notify_read_index_waiters();
+    return elem->result_;
+}
+
+void raft_server::on_leader_commit_index(ulong leader_commit_idx) {
+    {   auto_lock(read_index_waiters_lock_);
+        leader_commit_received_ = true;
+        last_leader_commit_idx_ = leader_commit_idx;
+        last_leader_commit_timer_.reset();
+
+        if (stale_read_pending_.empty()) return;
+        for (auto& entry: stale_read_pending_) {
+            entry->read_idx_ = std::max(entry->read_idx_, leader_commit_idx);
+        }
+        stale_read_waiters_.splice( stale_read_waiters_.end(),
+                                    stale_read_pending_ );
+    }
+    notify_read_index_waiters();
+}
+
+void raft_server::drop_all_stale_read_reqs() {
+    std::list< ptr<read_index_elem> > elems;
+    {   auto_lock(read_index_waiters_lock_);
+        elems.splice(elems.end(), stale_read_pending_);
+        elems.splice(elems.end(), stale_read_waiters_);
+    }
+
+    for (auto& entry: elems) {
+        ptr<read_index_elem>& ee = entry;
+        p_wn("cancelled bounded staleness read request %zu", ee->read_idx_);
+
+        uint64_t read_idx = ee->read_idx_;
+        ptr<std::exception> err =
+            cs_new<std::runtime_error>("Request cancelled.");
+        ee->result_->set_result_code(cmd_result_code::CANCELLED);
+        ee->result_->set_result(read_idx, err);
+    }
+}
+
+} // namespace nuraft;
@@ -25,9 +25,11 @@ limitations under the License.
 #include "event_awaiter.h"
 #include "peer.hxx"
 #include "snapshot.hxx"
+#include "snapshot_prefetcher.hxx"
 #include "snapshot_sync_ctx.hxx"
 #include "state_machine.hxx"
 #include "state_mgr.hxx"
+#include "term_index.hxx"
 #include "tracer.hxx"
 
 #include <cassert>
@@ -54,7 +56,7 @@ ptr<req_msg> raft_server::create_sync_snapshot_req(peer& p,
               sync_ctx.get(),
               sync_ctx->offset_,
               snp->get_last_log_idx(),
-              sync_ctx->get_user_snp_ctx() );
+              sync_ctx->user_snp_ctx_ );
         prev_sync_snp_log_idx = snp->get_last_log_idx();
 
         if (sync_ctx->get_timer().timeout()) {
@@ -117,47 +119,108 @@ ptr<req_msg> raft_server::create_sync_snapshot_req(peer& p,
             state_machine_->free_user_snp_ctx(user_ctx);
         }
         p.set_snapshot_in_sync(snp);
+
+        int32 num_streams = ctx_->get_params()->snapshot_sync_streams_;
+        if ( snp->get_type() == snapshot::logical_object &&
+             num_streams > 1 &&
+             &p != srv_to_join_.get() ) {
+            p.get_snapshot_sync_ctx()->init_streams(state_machine_, num_streams);
+        }
     }
 
     bool last_request = false;
     ptr<buffer> data = nullptr;
     ulong data_idx = 0;
+    ptr<snapshot_sync_ctx> cur_ctx = p.get_snapshot_sync_ctx();
+    // New member is synced by the response handler only,
+    // the block should be returned in this call.
+    bool wait_for_block = (&p == srv_to_join_.get());
+    bool prefetched = false;
+    int32 stream_id = 0;
     if (snp->get_type() == snapshot::raw_binary) {
         // LCOV_EXCL_START
         // Raw binary snapshot (original)
-        ulong offset = p.get_snapshot_sync_ctx()->get_offset();
-        int32 sz_left = (int32)(snp->size() - offset);
+        ulong offset = cur_ctx->get_offset();
         int32 blk_sz = get_snapshot_sync_block_size();
-        data = buffer::alloc((size_t)(std::min(blk_sz, sz_left)));
-        int32 sz_rd = state_machine_->read_snapshot_data(*snp, offset, *data);
-        if ((size_t)sz_rd < data->size()) {
-            // LCOV_EXCL_START
-            p_er( "only %d bytes could be read from snapshot while %d "
-                  "bytes are expected, must be something wrong, exit.",
-                  sz_rd, data->size() );
-            ctx_->state_mgr_->system_exit(raft_err::N18_partial_snapshot_block);
-            ::exit(-1);
-            return ptr<req_msg>();
-            // LCOV_EXCL_STOP
+        if (p.get_num_inflight() > 1) {
+            // Other blocks are in flight, send the next one. The last
+            // block is sent after all the others are acknowledged,
+            // as it makes the peer apply the snapshot.
+            offset = std::max(offset, cur_ctx->sent_offset_);
+            if (offset + (ulong)blk_sz >= snp->size()) return nullptr;
+        }
+        int32 sz_left = (int32)(snp->size() - offset);
+
+        bool not_ready = false;
+        prefetched = read_prefetched_snp_block( *cur_ctx, offset, wait_for_block,
+                                                data, last_request, not_ready );
+        if (not_ready) return nullptr;
+
+        if (!prefetched) {
+            data = buffer::alloc((size_t)(std::min(blk_sz, sz_left)));
+            int32 sz_rd = state_machine_->read_snapshot_data(*snp, offset, *data);
+            if ((size_t)sz_rd < data->size()) {
+                // LCOV_EXCL_START
+                p_er( "only %d bytes could be read from snapshot while %d "
+                      "bytes are expected, must be something wrong, exit.",
+                      sz_rd, data->size() );
+                ctx_->state_mgr_->system_exit(raft_err::N18_partial_snapshot_block);
+                ::exit(-1);
+                return ptr<req_msg>();
+                // LCOV_EXCL_STOP
+            }
+            last_request = (offset + (ulong)data->size()) >= snp->size();
         }
-        last_request = (offset + (ulong)data->size()) >= snp->size();
         data_idx = offset;
+        cur_ctx->sent_offset_ = offset + data->size();
         // LCOV_EXCL_STOP
 
+    } else if (cur_ctx->get_num_streams() > 1) {
+        // Logical object type snapshot, in multiple streams.
+        if (p.get_num_inflight() <= 1) {
+            // Nothing else is in flight, responses of in-flight
+            // streams (if any) have been lost.
+            cur_ctx->reset_in_flight_streams();
+        }
+        stream_id = cur_ctx->next_stream();
+        if (stream_id < 0) return nullptr;
+
+        snapshot_sync_ctx::stream& ss = cur_ctx->streams_[stream_id];
+        p_dv("peer: %d, stream %d, obj_idx: %ld, user_snp_ctx %p\n",
+             (int)p.get_id(), stream_id, ss.obj_idx_, ss.user_snp_ctx_);
+        state_machine_->read_logical_snp_obj_stream( *snp, ss.user_snp_ctx_,
+                                                     stream_id,
+                                                     cur_ctx->get_num_streams(),
+                                                     ss.obj_idx_,
+                                                     data, last_request );
+        if (data) data->pos(0);
+        ss.in_flight_ = true;
+        data_idx = ss.obj_idx_;
+
     } else {
         // Logical object type snapshot
-        ulong obj_idx = p.get_snapshot_sync_ctx()->get_offset();
-        void*& user_snp_ctx = p.get_snapshot_sync_ctx()->get_user_snp_ctx();
-        p_dv("peer: %d, obj_idx: %ld, user_snp_ctx %p\n",
-             (int)p.get_id(), obj_idx, user_snp_ctx);
-        state_machine_->read_logical_snp_obj( *snp, user_snp_ctx, obj_idx,
-                                              data, last_request );
-        if (data) data->pos(0);
+        ulong obj_idx = cur_ctx->get_offset();
+        bool not_ready = false;
+        prefetched = read_prefetched_snp_block( *cur_ctx, obj_idx, wait_for_block,
+                                                data, last_request, not_ready );
+        if (not_ready) return nullptr;
+
+        if (!prefetched) {
+            void*& user_snp_ctx = cur_ctx->get_user_snp_ctx();
+            p_dv("peer: %d, obj_idx: %ld, user_snp_ctx %p\n",
+                 (int)p.get_id(), obj_idx, user_snp_ctx);
+            state_machine_->read_logical_snp_obj( *snp, user_snp_ctx, obj_idx,
+                                                  data, last_request );
+            if (data) data->pos(0);
+        }
         data_idx = obj_idx;
     }
 
     std::unique_ptr<snapshot_sync_req> sync_req
         ( new snapshot_sync_req(snp, data_idx, data, last_request) );
+    if (cur_ctx->get_num_streams() > 1) {
+        sync_req->set_stream(stream_id, cur_ctx->get_num_streams());
+    }
     ptr<req_msg> req( cs_new<req_msg>
                       ( term,
                         msg_type::install_snapshot_request,
@@ -173,6 +236,93 @@ ptr<req_msg> raft_server::create_sync_snapshot_req(peer& p,
     return req;
 }
 
+bool raft_server::read_prefetched_snp_block(snapshot_sync_ctx& sync_ctx,
+                                            ulong offset,
+                                            bool wait,
+                                            ptr<buffer>& data_out,
+                                            bool& is_last_out,
+                                            bool& not_ready_out)
+{
+    not_ready_out = false;
+    ptr<raft_params> params = ctx_->get_params();
+    if (params->snapshot_prefetch_blocks_ <= 0) return false;
+
+    // Retry once with a new prefetcher if the requested block
+    // is not the one being prefetched.
+    for (size_t ii = 0; ii < 2; ++ii) {
+        if (!sync_ctx.prefetcher_) {
+            std::function<void()> when_ready;
+            if (!wait) {
+                // Send the block once it is ready.
+                when_ready = [this]() { bg_append_ea_->invoke(); };
+            }
+            sync_ctx.prefetcher_ = cs_new<snapshot_prefetcher>
+                                   ( state_machine_,
+                                     sync_ctx.get_snapshot(),
+                                     offset,
+                                     sync_ctx.user_snp_ctx_,
+                                     get_snapshot_sync_block_size(),
+                                     params->snapshot_prefetch_blocks_,
+                                     when_ready );
+            // Now the prefetcher owns the user context.
+            sync_ctx.user_snp_ctx_ = nullptr;
+        }
+
+        snapshot_prefetcher::result rr =
+            sync_ctx.prefetcher_->get(offset, data_out, is_last_out, wait);
+        switch (rr) {
+        case snapshot_prefetcher::READY:
+            return true;
+
+        case snapshot_prefetcher::NOT_READY:
+            not_ready_out = true;
+            return false;
+
+        case snapshot_prefetcher::FAILED:
+            // Read it again synchronously, to handle the error.
+            sync_ctx.stop_prefetch();
+            return false;
+
+        case snapshot_prefetcher::MISMATCH:
+        default:
+            p_db("snapshot prefetch mismatch at offset %zu, restart", offset);
+            sync_ctx.stop_prefetch();
+            break;
+        }
+    }
+    return false;
+}
+
+void raft_server::stop_snapshot_prefetchers() {
+    // Prefetchers invoke `bg_append_ea_` once a block is ready,
+    // they should be stopped before it is destroyed.
+    std::vector< ptr<peer> > pp_list;
+    for (auto& entry: peers_) pp_list.push_back(entry.second);
+    if (srv_to_join_) pp_list.push_back(srv_to_join_);
+
+    for (ptr<peer>& pp: pp_list) {
+        std::lock_guard<std::mutex> guard(pp->get_lock());
+        ptr<snapshot_sync_ctx> sync_ctx = pp->get_snapshot_sync_ctx();
+        if (sync_ctx) sync_ctx->stop_prefetch();
+    }
+}
+
+bool raft_server::has_more_snp_blocks_to_send(peer& p) {
+    std::lock_guard<std::mutex> guard(p.get_lock());
+    ptr<snapshot_sync_ctx> sync_ctx = p.get_snapshot_sync_ctx();
+    if (!sync_ctx) return false;
+
+    ptr<snapshot> snp = sync_ctx->get_snapshot();
+    if (sync_ctx->get_num_streams() > 1) {
+        return sync_ctx->has_stream_to_send();
+    }
+    if (snp->get_type() != snapshot::raw_binary) return false;
+
+    // Except for the last block.
+    ulong blk_sz = get_snapshot_sync_block_size();
+    return sync_ctx->sent_offset_ + blk_sz < snp->size();
+}
+
 ptr<resp_msg> raft_server::handle_install_snapshot_req(req_msg& req) {
     if (req.get_term() == state_->get_term() && !catching_up_) {
         if (role_ == srv_role::candidate) {
@@ -243,7 +393,18 @@ ptr<resp_msg> raft_server::handle_install_snapshot_req(req_msg& req) {
         } else {
             // Object type: add one (next object index).
             resp->accept(sync_req->get_offset());
-            if (sync_req->is_done()) {
+            if (sync_req->get_num_streams() > 1) {
+                // Let the leader know which stream it is,
+                // and whether all streams are done.
+                bool snp_done =
+                    sync_req->is_done() &&
+                    snp_streams_done_.size() >= (size_t)sync_req->get_num_streams();
+                resp->set_ctx( snapshot_sync_req::make_stream_ack
+                               ( sync_req->get_stream_id(),
+                                 sync_req->is_done(),
+                                 snp_done ) );
+
+            } else if (sync_req->is_done()) {
                 // TODO: check if there is missing object.
                 // Add a context buffer to inform installation is done.
                 ptr<buffer> done_ctx = buffer::alloc(1);
@@ -292,7 +453,37 @@ void raft_server::handle_install_snapshot_resp(resp_msg& resp) {
                  ( snp->get_type() == snapshot::logical_object &&
                    resp.get_ctx() );
 
-            if (snp_install_done) {
+            int32 stream_id = 0;
+            bool stream_done = false;
+            bool stream_ack =
+                sync_ctx->get_num_streams() > 1 &&
+                resp.get_ctx() &&
+                snapshot_sync_req::parse_stream_ack( *resp.get_ctx(),
+                                                     stream_id,
+                                                     stream_done,
+                                                     snp_install_done ) &&
+                stream_id >= 0 &&
+                stream_id < sync_ctx->get_num_streams();
+
+            if (stream_ack && !snp_install_done) {
+                snapshot_sync_ctx::stream& ss = sync_ctx->streams_[stream_id];
+                p_db("stream %d of snapshot continues at obj %zu%s",
+                     stream_id, resp.get_next_idx(),
+                     (stream_done) ? ", done" : "");
+                ss.in_flight_ = false;
+                ss.obj_idx_ = resp.get_next_idx();
+                ss.done_ = stream_done;
+                if (stream_done && ss.user_snp_ctx_) {
+                    state_machine_->free_user_snp_ctx(ss.user_snp_ctx_);
+                    ss.user_snp_ctx_ = nullptr;
+                }
+                if (stream_id == 0) {
+                    sync_ctx->set_offset(resp.get_next_idx());
+                } else {
+                    sync_ctx->get_timer().reset();
+                }
+
+            } else if (snp_install_done) {
                 p_db("snapshot sync is done (raw type)");
                 ptr<snapshot> nil_snp = nullptr;
                 p->set_next_log_idx(sync_ctx->get_snapshot()->get_last_log_idx() + 1);
@@ -305,6 +496,20 @@ void raft_server::handle_install_snapshot_resp(resp_msg& resp) {
                                   p->get_next_log_idx() < log_store_->next_slot();
                 p_in("snapshot done %zu, %zu, %d\n",
                      p->get_next_log_idx(), p->get_matched_idx(), need_to_catchup);
+            } else if ( snp->get_type() == snapshot::raw_binary &&
+                        ctx_->get_params()->snapshot_prefetch_blocks_ > 1 &&
+                        resp.get_next_idx() !=
+                            std::min( sync_ctx->get_offset() +
+                                          get_snapshot_sync_block_size(),
+                                      snp->size() ) ) {
+                // LCOV_EXCL_START
+                // Multiple blocks are in flight, and this is not the
+                // acknowledgement of the next block (the previous one
+                // may have been lost). Ignore it, the blocks after
+                // the acknowledged offset will be sent again.
+                p_db("ignore out of order snapshot ack %zu, acked offset %zu",
+                     resp.get_next_idx(), sync_ctx->get_offset());
+                // LCOV_EXCL_STOP
             } else {
                 p_db("continue to sync snapshot at offset %zu", resp.get_next_idx());
                 sync_ctx->set_offset(resp.get_next_idx());
@@ -443,6 +648,33 @@ bool raft_server::handle_snapshot_sync_req(snapshot_sync_req& req) {
                                            req.get_data());
         // LCOV_EXCL_STOP
 
+    } else if (req.get_num_streams() > 1) {
+        // Logical object type, in multiple streams.
+        int32 stream_id = req.get_stream_id();
+        if (stream_id == 0 && is_first_obj) {
+            // Beginning of a new snapshot.
+            snp_streams_done_.clear();
+        }
+
+        ulong obj_id = req.get_offset();
+        buffer& buf = req.get_data();
+        buf.pos(0);
+        state_machine_->save_logical_snp_obj_stream(req.get_snapshot(),
+                                                    stream_id,
+                                                    req.get_num_streams(),
+                                                    obj_id,
+                                                    buf,
+                                                    is_first_obj,
+                                                    is_last_obj);
+        req.set_offset(obj_id);
+
+        if (is_last_obj) {
+            snp_streams_done_.insert(stream_id);
+            // Install the snapshot once all streams are done.
+            is_last_obj = ( snp_streams_done_.size() >=
+                            (size_t)req.get_num_streams() );
+        }
+
     } else {
         // Logical object type.
         ulong obj_id = req.get_offset();
@@ -471,7 +703,11 @@ bool raft_server::handle_snapshot_sync_req(snapshot_sync_req& req) {
         p_in( "sucessfully receive a snapshot (idx %zu term %zu) from leader",
               req.get_snapshot().get_last_log_idx(),
               req.get_snapshot().get_last_log_term() );
+        // Background compaction (if any) should not race with
+        // the one below.
+        wait_for_log_compaction();
         if (log_store_->compact(req.get_snapshot().get_last_log_idx())) {
+            term_index_->compact(req.get_snapshot().get_last_log_idx());
             // The state machine will not be able to commit anything before the
             // snapshot is applied, so make this synchronously with election
             // timer stopped as usually applying a snapshot may take a very
@@ -496,6 +732,7 @@ bool raft_server::handle_snapshot_sync_req(snapshot_sync_req& req) {
 
             precommit_index_ = req.get_snapshot().get_last_log_idx();
             sm_commit_index_ = req.get_snapshot().get_last_log_idx();
+            sm_applied_index_ = req.get_snapshot().get_last_log_idx();
             quick_commit_index_ = req.get_snapshot().get_last_log_idx();
 
             ctx_->state_mgr_->save_state(*state_);
@@ -20,12 +20,16 @@ limitations under the License.
 
 #include "raft_server.hxx"
 
+#include "buffer_serializer.hxx"
 #include "cluster_config.hxx"
 #include "context.hxx"
+#include "handle_client_request.hxx"
 #include "rpc_cli_factory.hxx"
 #include "tracer.hxx"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <sstream>
 
 namespace nuraft {
@@ -79,6 +83,139 @@ ptr< cmd_result< ptr<buffer> > > raft_server::append_entries
     return send_msg_to_leader(req);
 }
 
+std::vector< ptr< cmd_result< ptr<buffer> > > >
+    raft_server::append_packed_entries(const std::vector< ptr<buffer> >& logs)
+{
+    std::vector< ptr< cmd_result< ptr<buffer> > > > rets;
+    if (logs.size() == 0) {
+        p_in("return empty list as log size is zero\n");
+        return rets;
+    }
+
+    ptr<req_msg> req = cs_new<req_msg>
+                       ( (ulong)0, msg_type::client_request, 0, 0,
+                         (ulong)0, (ulong)0, (ulong)0 ) ;
+    // `nullptr` payload is replicated as an empty one, as the state
+    // machine always gets a buffer for each payload.
+    std::vector< ptr<buffer> > payloads(logs);
+    for (ptr<buffer>& pp: payloads) {
+        if (!pp) pp = buffer::alloc(0);
+    }
+    req->log_entries().push_back
+        ( cs_new<log_entry>( 0, pack_app_logs(payloads),
+                             log_val_type::packed_app_log ) );
+
+    rets.reserve(logs.size());
+    for (size_t ii = 0; ii < logs.size(); ++ii) {
+        rets.push_back( cs_new< cmd_result< ptr<buffer> > >() );
+    }
+
+    // The result of the packed log is the packed results of payloads,
+    // deliver each of them to the corresponding `cmd_result`.
+    ptr< cmd_result< ptr<buffer> > > packed_ret = send_msg_to_leader(req);
+    for (auto& entry: rets) {
+        if (packed_ret->get_accepted()) entry->accept();
+        entry->set_result_code( packed_ret->get_result_code() );
+    }
+
+    packed_ret->when_ready
+    ( [rets]( cmd_result< ptr<buffer> >& res,
+              ptr<std::exception>& err )
+    {
+        std::vector< ptr<buffer> > results;
+        ptr<buffer> packed_results = res.get();
+        if (packed_results) {
+            packed_results->pos(0);
+            unpack_app_logs(*packed_results, results);
+        }
+        results.resize(rets.size());
+
+        ptr<std::exception> perr = err;
+        for (size_t ii = 0; ii < rets.size(); ++ii) {
+            ptr<buffer>& result = results[ii];
+            if (res.get_accepted()) rets[ii]->accept();
+            rets[ii]->set_result_code( res.get_result_code() );
+            rets[ii]->set_result(result, perr);
+        }
+    } );
+    return rets;
+}
+
+ptr<buffer> raft_server::pack_app_logs(const std::vector< ptr<buffer> >& payloads) {
+    //   << Format (version 0) >>
+    // version                      1 byte
+    // number of payloads (N)       4 bytes
+    // { payload length (X)         4 bytes
+    //   payload                    X bytes } * N
+    //
+    //   << Format (version 1) >>
+    // version                      1 byte
+    // number of payloads (N)       4 bytes
+    // { null flag                  1 byte
+    //   payload length (X)         4 bytes
+    //   payload                    X bytes } * N
+    //
+    // Version 1 is used only if there is a `nullptr` payload,
+    // so that it can be distinguished from an empty one.
+    const uint8_t VERSION_NO_NULL = 0x0;
+    const uint8_t VERSION_NULL_FLAG = 0x1;
+    uint8_t version = VERSION_NO_NULL;
+    size_t len = sizeof(uint8_t) + sizeof(uint32_t);
+    for (const ptr<buffer>& pp: payloads) {
+        len += sizeof(uint32_t) + (pp ? pp->size() : 0);
+        if (!pp) version = VERSION_NULL_FLAG;
+    }
+    if (version == VERSION_NULL_FLAG) {
+        len += sizeof(uint8_t) * payloads.size();
+    }
+
+    ptr<buffer> ret = buffer::alloc(len);
+    buffer_serializer bs(ret);
+    bs.put_u8(version);
+    bs.put_u32(payloads.size());
+    for (const ptr<buffer>& pp: payloads) {
+        if (version == VERSION_NULL_FLAG) {
+            bs.put_u8(pp ? 0 : 1);
+        }
+        if (pp) {
+            bs.put_bytes(pp->data_begin(), pp->size());
+        } else {
+            bs.put_u32(0);
+        }
+    }
+    ret->pos(0);
+    return ret;
+}
+
+bool raft_server::unpack_app_logs(buffer& buf,
+                                  std::vector< ptr<buffer> >& payloads_out)
+{
+    payloads_out.clear();
+   try {
+    buffer_serializer bs(buf);
+    uint8_t version = bs.get_u8();
+    if (version > 0x1) return false;
+    uint32_t num = bs.get_u32();
+    payloads_out.reserve(num);
+    for (uint32_t ii = 0; ii < num; ++ii) {
+        bool is_null = (version == 0x1) && bs.get_u8();
+        size_t len = 0;
+        void* data = bs.get_bytes(len);
+        if (is_null) {
+            payloads_out.push_back(nullptr);
+            continue;
+        }
+        ptr<buffer> pp = buffer::alloc(len);
+        if (len) memcpy(pp->data_begin(), data, len);
+        payloads_out.push_back(pp);
+    }
+   } catch (std::exception& ex) {
+    payloads_out.clear();
+    return false;
+   }
+    return true;
+}
+
 ptr< cmd_result< ptr<buffer> > > raft_server::send_msg_to_leader(ptr<req_msg>& req)
 {
     int32 leader_id = leader_;
@@ -139,6 +276,11 @@ ptr< cmd_result< ptr<buffer> > > raft_server::send_msg_to_leader(ptr<req_msg>& r
         return ret;
     }
 
+    if ( ctx_->get_params()->auto_forwarding_batch_size_ > 0 &&
+         req->get_type() == msg_type::client_request ) {
+        return enqueue_forward_req(leader_id, req);
+    }
+
 // LCOV_EXCL_START
     // Otherwise: re-direct request to the current leader
     //            (not recommended).
@@ -189,5 +331,238 @@ ptr< cmd_result< ptr<buffer> > > raft_server::send_msg_to_leader(ptr<req_msg>& r
 // LCOV_EXCL_STOP
 }
 
+ptr< cmd_result< ptr<buffer> > >
+    raft_server::enqueue_forward_req(int32 leader_id, ptr<req_msg>& req)
+{
+    ptr<forward_elem> elem = cs_new<forward_elem>(req);
+    ptr<forward_queue> fq;
+    {   auto_lock(rpc_clients_lock_);
+        auto entry = forward_queues_.find(leader_id);
+        if (entry == forward_queues_.end()) {
+            fq = cs_new<forward_queue>(leader_id);
+            forward_queues_.insert( std::make_pair(leader_id, fq) );
+        } else {
+            fq = entry->second;
+        }
+        fq->pending_.push_back(elem);
+    }
+    flush_forward_queue(fq);
+    return elem->result_;
+}
+
+void raft_server::flush_forward_queue(ptr<forward_queue> fq) {
+    static stat_elem& fwd_reqs = *stat_mgr::get_instance()->create_stat
+        (stat_elem::COUNTER, "auto_forwarding_requests");
+    static stat_elem& fwd_rpcs = *stat_mgr::get_instance()->create_stat
+        (stat_elem::COUNTER, "auto_forwarding_rpcs");
+
+    ptr<raft_params> params = ctx_->get_params();
+    size_t max_batch = std::max(1, params->auto_forwarding_batch_size_);
+    size_t max_clients = std::max(1, params->auto_forwarding_max_connections_);
+    ptr<srv_config> srv_conf = get_config()->get_server(fq->leader_id_);
+
+    // Requests are sent after releasing the lock, as the response
+    // handler may be invoked inline on a connection error.
+    std::list< std::pair< ptr<rpc_client>,
+                          std::vector< ptr<forward_elem> > > > to_send;
+    std::list< ptr<forward_elem> > to_drop;
+    {   auto_lock(rpc_clients_lock_);
+        while (!fq->pending_.empty()) {
+            ptr<rpc_client> rpc_cli;
+            if (stopping_) {
+                to_drop.splice(to_drop.end(), fq->pending_);
+                break;
+            }
+            if (!fq->idle_clients_.empty()) {
+                rpc_cli = fq->idle_clients_.front();
+                fq->idle_clients_.pop_front();
+            } else if (fq->num_clients_ < max_clients) {
+                if (srv_conf && ctx_->rpc_cli_factory_) {
+                    rpc_cli = ctx_->rpc_cli_factory_->create_client
+                              ( srv_conf->get_endpoint() );
+                }
+                if (!rpc_cli) {
+                    // Cannot reach the leader. If other connections
+                    // exist, requests will be sent once they respond.
+                    if (!fq->num_clients_) {
+                        to_drop.splice(to_drop.end(), fq->pending_);
+                    }
+                    break;
+                }
+                fq->num_clients_++;
+            } else {
+                // All connections are busy.
+                break;
+            }
+
+            std::vector< ptr<forward_elem> > elems;
+            while (!fq->pending_.empty() && elems.size() < max_batch) {
+                elems.push_back(fq->pending_.front());
+                fq->pending_.pop_front();
+            }
+            to_send.push_back( std::make_pair(rpc_cli, elems) );
+        }
+    }
+
+    for (ptr<forward_elem>& ee: to_drop) {
+        ptr<buffer> result;
+        ptr<std::exception> err =
+            cs_new<std::runtime_error>("Cannot forward request to leader.");
+        ee->result_->set_result_code(cmd_result_code::CANCELLED);
+        ee->result_->set_result(result, err);
+    }
+
+    for (auto& entry: to_send) {
+        ptr<rpc_client>& rpc_cli = entry.first;
+        std::vector< ptr<forward_elem> >& elems = entry.second;
+
+        //   << Format of the first log entry (header) >>
+        // version                      1 byte
+        // number of requests (N)       4 bytes
+        // number of logs of request    4 bytes * N
+        const uint8_t CURRENT_VERSION = 0x0;
+        ptr<buffer> hdr = buffer::alloc
+                          ( sizeof(uint8_t) +
+                            sizeof(uint32_t) * (elems.size() + 1) );
+        buffer_serializer bs(hdr);
+        bs.put_u8(CURRENT_VERSION);
+        bs.put_u32(elems.size());
+
+        ptr<req_msg> req = cs_new<req_msg>
+                           ( (ulong)0, msg_type::client_request_batch, 0, 0,
+                             (ulong)0, (ulong)0, (ulong)0 );
+        req->log_entries().push_back
+            ( cs_new<log_entry>(0, hdr, log_val_type::custom) );
+        for (ptr<forward_elem>& ee: elems) {
+            std::vector< ptr<log_entry> >& les = ee->req_->log_entries();
+            bs.put_u32(les.size());
+            req->log_entries().insert( req->log_entries().end(),
+                                       les.begin(), les.end() );
+        }
+        fwd_reqs += elems.size();
+        fwd_rpcs++;
+
+        rpc_handler handler = std::bind( &raft_server::handle_forward_resp,
+                                         this,
+                                         fq,
+                                         rpc_cli,
+                                         elems,
+                                         std::placeholders::_1,
+                                         std::placeholders::_2 );
+        rpc_cli->send(req, handler);
+    }
+}
+
+void raft_server::handle_forward_resp(ptr<forward_queue> fq,
+                                      ptr<rpc_client> rpc_cli,
+                                      std::vector< ptr<forward_elem> >& elems,
+                                      ptr<resp_msg>& resp,
+                                      ptr<rpc_exception>& err)
+{
+    // Result of each request, in the same order:
+    //   { accepted 1 byte, result code 4 bytes, ctx length + ctx } * N
+    ptr<std::exception> perr;
+    size_t num_done = 0;
+    if (err) {
+        p_wn("failed to forward %zu requests to leader %d: %s",
+             elems.size(), fq->leader_id_, err->what());
+        perr = err;
+    } else if (resp->get_accepted() && resp->get_ctx()) {
+       try {
+        ptr<buffer> resp_ctx = resp->get_ctx();
+        buffer_serializer bs(resp_ctx);
+        uint8_t version = bs.get_u8();
+        (void)version;
+        uint32_t num_results = bs.get_u32();
+        for (; num_done < elems.size() && num_done < num_results; ++num_done) {
+            ptr< cmd_result< ptr<buffer> > >& result = elems[num_done]->result_;
+            bool accepted = bs.get_u8();
+            cmd_result_code code = (cmd_result_code)bs.get_i32();
+            size_t ctx_len = 0;
+            void* ctx_ptr = bs.get_bytes(ctx_len);
+
+            ptr<buffer> ctx;
+            if (ctx_len) {
+                ctx = buffer::alloc(ctx_len);
+                memcpy(ctx->data_begin(), ctx_ptr, ctx_len);
+            }
+            if (accepted) result->accept();
+            result->set_result_code(code);
+            result->set_result(ctx, perr);
+        }
+       } catch (std::exception& ex) {
+        p_er("invalid forwarding response from leader %d: %s",
+             fq->leader_id_, ex.what());
+       }
+    }
+
+    // Requests without their results (e.g., the leader does not
+    // understand the batch).
+    for (size_t ii = num_done; ii < elems.size(); ++ii) {
+        ptr<buffer> result;
+        elems[ii]->result_->set_result_code
+            ( err ? cmd_result_code::FAILED : cmd_result_code::BAD_REQUEST );
+        elems[ii]->result_->set_result(result, perr);
+    }
+
+    {   auto_lock(rpc_clients_lock_);
+        if (err) {
+            // Discard the connection, a new one will be created.
+            fq->num_clients_--;
+        } else {
+            fq->idle_clients_.push_back(rpc_cli);
+        }
+    }
+    flush_forward_queue(fq);
+
+    if (fq->leader_id_ != leader_) {
+        // Leader has changed while the requests were in flight.
+        prune_forward_queues();
+    }
+}
+
+void raft_server::drop_all_forward_reqs() {
+    std::list< ptr<forward_elem> > elems;
+    {   auto_lock(rpc_clients_lock_);
+        for (auto& entry: forward_queues_) {
+            elems.splice(elems.end(), entry.second->pending_);
+        }
+    }
+
+    for (ptr<forward_elem>& ee: elems) {
+        p_wn("cancelled forwarding client request");
+        ptr<buffer> result;
+        ptr<std::exception> err =
+            cs_new<std::runtime_error>("Request cancelled.");
+        ee->result_->set_result_code(cmd_result_code::CANCELLED);
+        ee->result_->set_result(result, err);
+    }
+}
+
+size_t raft_server::get_num_forward_queues() {
+    auto_lock(rpc_clients_lock_);
+    return forward_queues_.size();
+}
+
+void raft_server::prune_forward_queues() {
+    int32 cur_leader = leader_;
+    auto_lock(rpc_clients_lock_);
+    auto entry = forward_queues_.begin();
+    while (entry != forward_queues_.end()) {
+        forward_queue& fq = *entry->second;
+        if ( fq.leader_id_ != cur_leader &&
+             fq.pending_.empty() &&
+             fq.idle_clients_.size() == fq.num_clients_ ) {
+            // No request is waiting or in flight, close all
+            // connections to the previous leader.
+            p_db("remove forwarding queue to previous leader %d",
+                 fq.leader_id_);
+            entry = forward_queues_.erase(entry);
+        } else {
+            entry++;
+        }
+    }
+}
+
 } // namespace nuraft;
 
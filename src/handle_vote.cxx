@@ -134,6 +134,8 @@ void raft_server::initiate_vote(bool ignore_priority) {
 void raft_server::request_vote(bool ignore_priority) {
     state_->set_voted_for(id_);
     ctx_->state_mgr_->save_state(*state_);
+    p_ev( TE_ELECTION_START, log_store_->next_slot() - 1,
+          -1, state_->get_term() );
     votes_granted_ += 1;
     votes_responded_ += 1;
     p_in("[VOTE INIT] my id %d, my role %s, term %ld, log idx %ld, "
@@ -205,6 +207,7 @@ ptr<resp_msg> raft_server::handle_vote_req(req_msg& req) {
           log_store_->next_slot() - 1 <= req.get_last_log_idx() );
 
     bool grant =
+        !im_learner_ &&
         req.get_term() == state_->get_term() &&
         log_okay &&
         ( state_->get_voted_for() == req.get_src() ||
@@ -266,6 +269,7 @@ void raft_server::handle_vote_resp(resp_msg& resp) {
 
     if (resp.get_accepted()) {
         votes_granted_ += 1;
+        p_ev(TE_VOTE_GRANTED, 0, resp.get_src(), resp.get_term());
     }
 
     if (votes_responded_ >= get_num_voting_members()) {
@@ -0,0 +1,91 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "log_entry.hxx"
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+namespace nuraft {
+
+namespace {
+
+// Allocator for `std::allocate_shared` which reserves `extra` bytes
+// right after the object (with the reference counter), and returns
+// the address of them through `extra_out`.
+template<typename T>
+struct compact_allocator {
+    using value_type = T;
+
+    compact_allocator(size_t extra, byte** extra_out)
+        : extra_(extra), extra_out_(extra_out) {}
+
+    template<typename U>
+    compact_allocator(const compact_allocator<U>& src)
+        : extra_(src.extra_), extra_out_(src.extra_out_) {}
+
+    T* allocate(size_t n) {
+        const size_t ALIGN = alignof(std::max_align_t);
+        size_t base = (n * sizeof(T) + ALIGN - 1) / ALIGN * ALIGN;
+        byte* mem = static_cast<byte*>( ::operator new(base + extra_) );
+        if (extra_out_) *extra_out_ = mem + base;
+        return reinterpret_cast<T*>(mem);
+    }
+
+    void deallocate(T* p, size_t) {
+        ::operator delete(p);
+    }
+
+    size_t extra_;
+    byte** extra_out_;
+};
+
+template<typename T, typename U>
+bool operator==(const compact_allocator<T>&, const compact_allocator<U>&) {
+    return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const compact_allocator<T>&, const compact_allocator<U>&) {
+    return false;
+}
+
+}
+
+ptr<log_entry> log_entry::make_compact(ulong term,
+                                       const byte* data,
+                                       size_t len,
+                                       log_val_type value_type)
+{
+    byte* buf_mem = nullptr;
+    compact_allocator<log_entry> alloc
+        ( buffer::view_meta_size(len) + len, &buf_mem );
+    ptr<log_entry> entry = std::allocate_shared<log_entry>
+                           ( alloc, term, ptr<buffer>(), value_type );
+
+    buffer* buf = buffer::make_in_place(buf_mem, len);
+    if (len) memcpy(buf->data_begin(), data, len);
+    buf->pos(0);
+
+    entry->inline_buf_ = buf;
+    entry->self_ = entry;
+    return entry;
+}
+
+}
+
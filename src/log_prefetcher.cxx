@@ -0,0 +1,130 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "log_prefetcher.hxx"
+
+#include "log_entry.hxx"
+#include "log_store.hxx"
+
+#include <algorithm>
+
+namespace nuraft {
+
+log_prefetcher::log_prefetcher(const ptr<log_store>& store,
+                               ulong start_idx,
+                               size_t batch_size,
+                               size_t max_batches)
+    : store_(store)
+    , batch_size_(batch_size ? batch_size : 1)
+    , max_batches_(max_batches ? max_batches : 1)
+    , next_idx_(start_idx)
+    , limit_idx_(start_idx - 1)
+    , failed_(false)
+    , stopping_(false)
+{
+    reader_ = std::thread(&log_prefetcher::read_loop, this);
+}
+
+log_prefetcher::~log_prefetcher() {
+    stop();
+}
+
+void log_prefetcher::stop() {
+    {   std::lock_guard<std::mutex> l(lock_);
+        stopping_ = true;
+        cv_.notify_all();
+    }
+    if (reader_.joinable()) reader_.join();
+}
+
+void log_prefetcher::set_limit(ulong last_idx) {
+    std::lock_guard<std::mutex> l(lock_);
+    if (last_idx <= limit_idx_) return;
+    limit_idx_ = last_idx;
+    cv_.notify_all();
+}
+
+void log_prefetcher::read_loop() {
+    std::string thread_name = "nuraft_log_rd";
+#ifdef __linux__
+    pthread_setname_np(pthread_self(), thread_name.c_str());
+#elif __APPLE__
+    pthread_setname_np(thread_name.c_str());
+#endif
+
+    std::unique_lock<std::mutex> l(lock_);
+    while (!stopping_) {
+        if ( failed_ ||
+             next_idx_ > limit_idx_ ||
+             batches_.size() >= max_batches_ ) {
+            cv_.wait(l);
+            continue;
+        }
+
+        ulong first_idx = next_idx_;
+        ulong last_idx = std::min(limit_idx_, first_idx + batch_size_ - 1);
+        l.unlock();
+        ptr< std::vector< ptr<log_entry> > > logs =
+            store_->log_entries(first_idx, last_idx + 1);
+        l.lock();
+
+        if (!logs || logs->size() != last_idx - first_idx + 1) {
+            failed_ = true;
+        } else {
+            batch bb;
+            bb.first_idx_ = first_idx;
+            bb.logs_ = logs;
+            batches_.push_back(bb);
+            next_idx_ = last_idx + 1;
+        }
+        cv_.notify_all();
+    }
+}
+
+ptr< std::vector< ptr<log_entry> > > log_prefetcher::get(ulong first_idx) {
+    std::unique_lock<std::mutex> l(lock_);
+    while (true) {
+        while (!batches_.empty() && batches_.front().first_idx_ < first_idx) {
+            batches_.pop_front();
+            cv_.notify_all();
+        }
+
+        if (!batches_.empty()) {
+            batch& bb = batches_.front();
+            if (bb.first_idx_ != first_idx) return nullptr;
+
+            ptr< std::vector< ptr<log_entry> > > ret = bb.logs_;
+            batches_.pop_front();
+            // Room for the next batch.
+            cv_.notify_all();
+            return ret;
+        }
+
+        if ( failed_ ||
+             stopping_ ||
+             next_idx_ != first_idx ||
+             first_idx > limit_idx_ ) {
+            return nullptr;
+        }
+
+        // The requested batch is being read.
+        cv_.wait(l);
+    }
+}
+
+}
+
@@ -0,0 +1,121 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include "basic_types.hxx"
+#include "pp_util.hxx"
+#include "ptr.hxx"
+
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nuraft {
+
+class log_entry;
+class log_store;
+
+/**
+ * Background reader of the logs to be committed.
+ *
+ * A dedicated thread reads committed logs from the log store in
+ * batches, by `log_store::log_entries`, and keeps up to `max_batches`
+ * of them in a bounded queue. So reading the next batches is
+ * overlapped with applying the current one to the state machine.
+ *
+ * Only the logs up to the limit given by `set_limit()` are read,
+ * so that logs not committed yet are never touched.
+ */
+class log_prefetcher {
+public:
+    /**
+     * @param store Log store to read the logs from.
+     * @param start_idx Index of the first log to read.
+     * @param batch_size Max number of logs in a batch.
+     * @param max_batches Max number of batches to read ahead.
+     */
+    log_prefetcher(const ptr<log_store>& store,
+                   ulong start_idx,
+                   size_t batch_size,
+                   size_t max_batches);
+
+    ~log_prefetcher();
+
+    __nocopy__(log_prefetcher);
+
+public:
+    /**
+     * Set the index of the last log that can be read.
+     *
+     * @param last_idx Log index.
+     */
+    void set_limit(ulong last_idx);
+
+    /**
+     * Get the batch starting at the given index, waiting for it if
+     * it is being read. Batches before the index are discarded.
+     *
+     * @param first_idx Index of the first log of the batch.
+     * @return Logs of the batch, `nullptr` if the log store failed
+     *         to read them, or the prefetcher is not reading from
+     *         the given index. In such a case, the caller should
+     *         restart the prefetcher from there.
+     */
+    ptr< std::vector< ptr<log_entry> > > get(ulong first_idx);
+
+    /**
+     * Stop the reader thread. Can be called multiple times.
+     */
+    void stop();
+
+private:
+    struct batch {
+        ulong first_idx_;
+        ptr< std::vector< ptr<log_entry> > > logs_;
+    };
+
+    void read_loop();
+
+    ptr<log_store> store_;
+    size_t batch_size_;
+    size_t max_batches_;
+
+    // Index of the first log of the next batch to be read.
+    ulong next_idx_;
+
+    // Index of the last log that can be read.
+    ulong limit_idx_;
+
+    // `true` if the log store failed to read a batch.
+    bool failed_;
+
+    bool stopping_;
+
+    std::list<batch> batches_;
+
+    std::mutex lock_;
+
+    std::condition_variable cv_;
+
+    std::thread reader_;
+};
+
+}
+
@@ -28,9 +28,9 @@ public:
 
 class mock_ssl_socket {
 public:
-    using lowest_layer_type = asio::ip::tcp::socket;
+    using lowest_layer_type = asio::generic::stream_protocol::socket;
 
-    mock_ssl_socket(asio::ip::tcp::socket& tcp_socket,
+    mock_ssl_socket(lowest_layer_type& tcp_socket,
                     mock_ssl_context& context)
         : socket_(tcp_socket)
         , context_(context)
@@ -44,7 +44,7 @@ public:
     template<typename A, typename B>
     void async_write_some(A a, B b) {}
 
-    asio::ip::tcp::socket& socket_;
+    lowest_layer_type& socket_;
     mock_ssl_context& context_;
 };
 
@@ -20,6 +20,7 @@ limitations under the License.
 
 #include "peer.hxx"
 
+#include "stat_mgr.hxx"
 #include "tracer.hxx"
 
 namespace nuraft {
@@ -41,6 +42,11 @@ void peer::send_req( ptr<peer> myself,
              msg_type_to_string( req->get_type() ).c_str() );
     }
 
+    uint64_t req_seq = 0;
+    if (req && req->get_type() == msg_type::append_entries_request) {
+        req_seq = append_req_seq_.fetch_add(1) + 1;
+    }
+
     ptr<rpc_result> pending = cs_new<rpc_result>(handler);
     ptr<rpc_client> rpc_local = nullptr;
     {   std::lock_guard<std::mutex> l(rpc_protector_);
@@ -52,6 +58,8 @@ void peer::send_req( ptr<peer> myself,
                       myself,
                       rpc_local,
                       req,
+                      req_seq,
+                      stat_now_us(),
                       pending,
                       std::placeholders::_1,
                       std::placeholders::_2 );
@@ -62,7 +70,7 @@ void peer::send_req( ptr<peer> myself,
         // Nothing has been sent, immediately free it
         // to serve next operation.
         p_tr("rpc local is null");
-        set_free();
+        release_busy();
     }
 }
 
@@ -75,10 +83,15 @@ void peer::send_req( ptr<peer> myself,
 void peer::handle_rpc_result( ptr<peer> myself,
                               ptr<rpc_client> my_rpc_client,
                               ptr<req_msg>& req,
+                              uint64_t req_seq,
+                              uint64_t sent_us,
                               ptr<rpc_result>& pending_result,
                               ptr<resp_msg>& resp,
                               ptr<rpc_exception>& err )
 {
+    static stat_elem& append_rpc_lat = *stat_mgr::get_instance()->create_stat
+        (stat_elem::HISTOGRAM, "repl_lat_append_rpc_us");
+
     if (req) {
         p_tr( "resp of req %d -> %d, type %s, %s",
               req->get_src(),
@@ -90,8 +103,24 @@ void peer::handle_rpc_result( ptr<peer> myself,
     if (err == nilptr) {
         // Succeeded.
         if ( req->get_type() == msg_type::append_entries_request ||
-             req->get_type() == msg_type::install_snapshot_request ) {
-            set_free();
+             req->get_type() == msg_type::install_snapshot_request ||
+             req->get_type() == msg_type::sync_log_request ) {
+            release_busy();
+        }
+        if ( req->get_type() == msg_type::append_entries_request &&
+             !req->log_entries().empty() ) {
+            // From sending logs to the ack of the follower.
+            append_rpc_lat += stat_now_us() - sent_us;
+        }
+
+        // Responses through the same connection arrive in order,
+        // but a new connection may deliver them earlier than the
+        // previous one.
+        uint64_t acked = acked_append_req_seq_;
+        while ( req_seq > acked &&
+                !acked_append_req_seq_.compare_exchange_weak(acked, req_seq) );
+        if (resp && req_seq && req_seq <= obsolete_append_req_seq_) {
+            resp->set_obsolete();
         }
 
         reset_active_timer();
@@ -118,7 +147,11 @@ void peer::handle_rpc_result( ptr<peer> myself,
             if (rpc_.get() == my_rpc_client.get()) {
                 rpc_.reset();
                 if ( req->get_type() == msg_type::append_entries_request ||
-                     req->get_type() == msg_type::install_snapshot_request ) {
+                     req->get_type() == msg_type::install_snapshot_request ||
+                     req->get_type() == msg_type::sync_log_request ) {
+                    // All other in-flight requests through this
+                    // connection will fail as well.
+                    set_pipeline_ready(false);
                     set_free();
                 }
 
@@ -20,6 +20,7 @@ limitations under the License.
 
 #include "raft_server.hxx"
 
+#include "batch_size_controller.hxx"
 #include "cluster_config.hxx"
 #include "context.hxx"
 #include "error_code.hxx"
@@ -27,9 +28,12 @@ limitations under the License.
 #include "peer.hxx"
 #include "snapshot.hxx"
 #include "state_machine.hxx"
+#include "stat_mgr.hxx"
 #include "state_mgr.hxx"
+#include "term_index.hxx"
 #include "tracer.hxx"
 
+#include <algorithm>
 #include <cassert>
 #include <random>
 #include <sstream>
@@ -40,7 +44,16 @@ namespace nuraft {
 const int raft_server::default_snapshot_sync_block_size = 4 * 1024;
 
 raft_server::raft_server(context* ctx, const init_options& opt)
-    : initialized_(false)
+    : append_senders_ready_(false)
+    , flush_start_(0)
+    , flush_end_(0)
+    , flush_running_(false)
+    , durable_idx_(0)
+    , flush_epoch_(0)
+    , compact_target_(0)
+    , compact_running_(false)
+    , compact_watermark_(0)
+    , initialized_(false)
     , leader_(-1)
     , id_(ctx->state_mgr_->server_id())
     , target_priority_(srv_config::INIT_PRIORITY)
@@ -49,6 +62,7 @@ raft_server::raft_server(context* ctx, const init_options& opt)
     , leader_commit_index_(0)
     , quick_commit_index_(ctx->state_machine_->last_commit_index())
     , sm_commit_index_(ctx->state_machine_->last_commit_index())
+    , sm_applied_index_(ctx->state_machine_->last_commit_index())
     , initial_commit_index_(ctx->state_machine_->last_commit_index())
     , hb_alive_(false)
     , election_completed_(true)
@@ -71,6 +85,7 @@ raft_server::raft_server(context* ctx, const init_options& opt)
     , role_(srv_role::follower)
     , state_(ctx->state_mgr_->read_state())
     , log_store_(ctx->state_mgr_->load_log_store())
+    , term_index_(cs_new<term_index>())
     , state_machine_(ctx->state_machine_)
     , receiving_snapshot_(false)
     , et_cnt_receiving_snapshot_(0)
@@ -80,6 +95,14 @@ raft_server::raft_server(context* ctx, const init_options& opt)
     , uncommitted_config_(nullptr)
     , srv_to_join_(nullptr)
     , conf_to_add_(nullptr)
+    , srv_to_join_start_idx_(0)
+    , commit_ret_notified_idx_(0)
+    , group_commit_head_(nullptr)
+    , group_commit_active_(false)
+    , repl_lat_tracker_(cs_new<repl_latency_tracker>())
+    , inflight_total_bytes_(0)
+    , leader_commit_received_(false)
+    , last_leader_commit_idx_(0)
     , resp_handler_( (rpc_handler)std::bind( &raft_server::handle_peer_resp,
                                              this,
                                              std::placeholders::_1,
@@ -101,6 +124,16 @@ raft_server::raft_server(context* ctx, const init_options& opt)
     log_current_params();
     update_rand_timeout();
     precommit_index_ = log_store_->next_slot() - 1;
+    term_index_->rebuild(*log_store_);
+
+    if (params->commit_ret_ring_size_ > 0) {
+        size_t ring_size = 1;
+        while (ring_size < (size_t)params->commit_ret_ring_size_) ring_size <<= 1;
+        commit_ret_ring_.resize(ring_size);
+        for (ptr<commit_ret_slot>& slot: commit_ret_ring_) {
+            slot = cs_new<commit_ret_slot>();
+        }
+    }
 
     if (!state_) {
         state_ = cs_new<srv_state>();
@@ -158,8 +191,7 @@ raft_server::raft_server(context* ctx, const init_options& opt)
                               log_store_->start_index() );
           i < log_store_->next_slot();
           ++i ) {
-        ptr<log_entry> entry(log_store_->entry_at(i));
-        if (entry->get_val_type() == log_val_type::conf) {
+        if (log_store_->val_type_at(i) == log_val_type::conf) {
             p_in( "detect a configuration change "
                   "that is not committed yet at index %llu", i );
             config_changing_ = true;
@@ -255,6 +287,8 @@ raft_server::raft_server(context* ctx, const init_options& opt)
 }
 
 raft_server::~raft_server() {
+    // Senders may be waiting for `lock_`, stop them first.
+    stop_append_senders();
     recur_lock(lock_);
     stopping_ = true;
     std::unique_lock<std::mutex> commit_lock(commit_cv_lock_);
@@ -264,6 +298,9 @@ raft_server::~raft_server() {
     commit_lock.release();
     ready_to_stop_cv_.wait_for(lock, std::chrono::milliseconds(10));
     cancel_schedulers();
+    stop_flush_thread();
+    stop_compaction_thread();
+    stop_snapshot_prefetchers();
     delete bg_append_ea_;
 }
 
@@ -308,7 +345,11 @@ void raft_server::log_current_params() {
           "reserved logs %d, client timeout %d, "
           "auto forwarding %s, API call type %s, "
           "custom commit quorum size %d, "
-          "custom election quorum size %d",
+          "custom election quorum size %d, "
+          "append pipeline window %d, "
+          "log sync snapshot threshold %d, "
+          "auto forwarding batch %d, connections %d, "
+          "parallel append senders %d",
           params->election_timeout_lower_bound_,
           params->election_timeout_upper_bound_,
           params->heart_beat_interval_,
@@ -322,7 +363,12 @@ void raft_server::log_current_params() {
           ( params->return_method_ == raft_params::blocking
             ? "BLOCKING" : "ASYNC" ),
           params->custom_commit_quorum_size_,
-          params->custom_election_quorum_size_ );
+          params->custom_election_quorum_size_,
+          params->append_pipeline_window_,
+          params->log_sync_snapshot_threshold_,
+          params->auto_forwarding_batch_size_,
+          params->auto_forwarding_max_connections_,
+          params->parallel_append_senders_ );
 }
 
 raft_params raft_server::get_current_params() const {
@@ -334,6 +380,9 @@ void raft_server::stop_server() {
 
     // Cancel all awaiting client requests.
     drop_all_pending_commit_elems();
+    drop_all_read_index_reqs();
+    drop_all_stale_read_reqs();
+    drop_all_forward_reqs();
 }
 
 void raft_server::shutdown() {
@@ -359,6 +408,9 @@ void raft_server::shutdown() {
         std::this_thread::yield();
     }
     drop_all_pending_commit_elems();
+    drop_all_read_index_reqs();
+    drop_all_stale_read_reqs();
+    drop_all_forward_reqs();
 
     // Clear shared_ptrs that the current server is holding.
     {   std::lock_guard<std::mutex> l(ctx_->ctx_lock_);
@@ -377,6 +429,13 @@ void raft_server::shutdown() {
         bg_append_ea_->invoke();
         bg_append_thread_.join();
     }
+
+    stop_append_senders();
+    stop_flush_thread();
+    stop_compaction_thread();
+    {   recur_lock(lock_);
+        stop_snapshot_prefetchers();
+    }
 }
 
 // Number of nodes that are able to vote, including leader itself.
@@ -414,6 +473,16 @@ int32 raft_server::get_quorum_for_commit() {
     return params->custom_commit_quorum_size_ - 1;
 }
 
+// Size of quorum EXCLUDING the leader, to confirm the leadership for
+// linearizable reads. It should be at least a majority, and should
+// intersect with any election quorum, even if the commit quorum is
+// customized to be smaller.
+int32 raft_server::get_quorum_for_read() {
+    int32 num_voting_members = get_num_voting_members();
+    return std::max( num_voting_members / 2,
+                     num_voting_members - get_quorum_for_election() - 1 );
+}
+
 int32 raft_server::get_leadership_expiry() {
     ptr<raft_params> params = ctx_->get_params();
     int expiry = params->leadership_expiry_;
@@ -479,6 +548,10 @@ ptr<resp_msg> raft_server::process_req(req_msg& req) {
         // Client request doesn't need to go through below process.
         return handle_cli_req_prelock(req);
     }
+    if ( req.get_type() == msg_type::client_request_batch ) {
+        // Client requests forwarded by a follower at once.
+        return handle_cli_req_fwd_batch(req);
+    }
 
     recur_lock(lock_);
     if ( req.get_type() == msg_type::append_entries_request ||
@@ -588,6 +661,23 @@ void raft_server::handle_peer_resp(ptr<resp_msg>& resp, ptr<rpc_exception>& err)
         if (pp) {
             pp->inc_rpc_errs();
             rpc_errs = pp->get_rpc_errs();
+
+            if ( ctx_->get_params()->append_pipeline_window_ > 1 &&
+                 err->req()->get_type() == msg_type::append_entries_request ) {
+                // Next log index may have been advanced optimistically
+                // by pipelined requests. Roll it back to the last
+                // index confirmed by the peer.
+                std::lock_guard<std::mutex> guard(pp->get_lock());
+                pp->set_pipeline_ready(false);
+                if (pp->get_batch_size_controller()) {
+                    pp->get_batch_size_controller()->reset();
+                }
+                if ( pp->get_matched_idx() &&
+                     pp->get_next_log_idx() > pp->get_matched_idx() + 1 ) {
+                    pp->set_next_log_idx(pp->get_matched_idx() + 1);
+                }
+                pp->discard_inflight_appends();
+            }
         }
 
         if (rpc_errs < peer::WARNINGS_LIMIT) {
@@ -757,17 +847,24 @@ void raft_server::reconnect_client(peer& p) {
 
 void raft_server::become_leader() {
     stop_election_timer();
+    p_ev( TE_BECOME_LEADER, log_store_->next_slot() - 1,
+          -1, state_->get_term() );
 
     {   auto_lock(commit_ret_elems_lock_);
         p_in("number of pending commit elements: %zu",
              commit_ret_elems_.size());
     }
 
-    {   auto_lock(cli_lock_);
+    {   std::unique_lock<rw_lock> rw_guard(cli_rw_lock_);
+        auto_lock(cli_lock_);
         role_ = srv_role::leader;
         leader_ = id_;
         srv_to_join_.reset();
         precommit_index_ = log_store_->next_slot() - 1;
+        {   std::lock_guard<std::mutex> l(inflight_lock_);
+            inflight_bytes_.clear();
+            inflight_total_bytes_ = 0;
+        }
         p_in("state machine commit index %zu, "
              "precommit index %zu, last log index %zu",
              sm_commit_index_.load(),
@@ -827,6 +924,11 @@ void raft_server::become_leader() {
     pre_vote_.quorum_reject_count_ = 0;
     data_fresh_ = true;
 
+    // Bounded staleness reads waiting for the leader's commit index
+    // can be served by this server now. As the commit index may be
+    // behind at the beginning of the term, the last log index is used.
+    on_leader_commit_index(log_store_->next_slot() - 1);
+
     request_append_entries();
 
     if (my_priority_ == 0) {
@@ -862,7 +964,8 @@ bool raft_server::check_leadership_validity() {
     return true;
 }
 
-void raft_server::yield_leadership(bool immediate_yield) {
+void raft_server::yield_leadership(bool immediate_yield,
+                                   int32 successor_id) {
     // Leader reelection is already happening.
     if (write_paused_) return;
 
@@ -880,25 +983,46 @@ void raft_server::yield_leadership(bool immediate_yield) {
         return;
     }
 
-    // Not immediate yield, find the highest priority node
-    // whose response time is not expired.
     int max_priority = 0;
     int candidate_id = -1;
     std::string candidate_endpoint;
     uint64_t last_resp_ms = 0;
-    size_t hb_interval_ms = ctx_->get_params()->heart_beat_interval_;
-    for (auto& entry: peers_) {
-        int32 srv_id = entry.first;
-        ptr<peer>& pp = entry.second;
-        uint64_t pp_last_resp_ms = pp->get_resp_timer_us() / 1000;
 
-        if ( srv_id != id_ &&
-             pp_last_resp_ms <= hb_interval_ms &&
-             pp->get_config().get_priority() > max_priority ) {
+    if (successor_id > -1) {
+        // Successor is given by the caller, it should be a voting member.
+        auto entry = peers_.find(successor_id);
+        if ( successor_id != id_ &&
+             entry != peers_.end() &&
+             !entry->second->is_learner() ) {
+            ptr<peer>& pp = entry->second;
             max_priority = pp->get_config().get_priority();
-            candidate_id = srv_id;
+            candidate_id = successor_id;
             candidate_endpoint = pp->get_config().get_endpoint();
-            last_resp_ms = pp_last_resp_ms;
+            last_resp_ms = pp->get_resp_timer_us() / 1000;
+        } else {
+            p_wn("given successor %d is not a valid voting member, "
+                 "will choose the next leader by priority",
+                 successor_id);
+        }
+    }
+
+    if (candidate_id < 0) {
+        // Not given, find the highest priority node
+        // whose response time is not expired.
+        size_t hb_interval_ms = ctx_->get_params()->heart_beat_interval_;
+        for (auto& entry: peers_) {
+            int32 srv_id = entry.first;
+            ptr<peer>& pp = entry.second;
+            uint64_t pp_last_resp_ms = pp->get_resp_timer_us() / 1000;
+
+            if ( srv_id != id_ &&
+                 pp_last_resp_ms <= hb_interval_ms &&
+                 pp->get_config().get_priority() > max_priority ) {
+                max_priority = pp->get_config().get_priority();
+                candidate_id = srv_id;
+                candidate_endpoint = pp->get_config().get_endpoint();
+                last_resp_ms = pp_last_resp_ms;
+            }
         }
     }
 
@@ -919,12 +1043,33 @@ void raft_server::yield_leadership(bool immediate_yield) {
     reelection_timer_.set_duration_ms
                       ( ctx_->get_params()->election_timeout_upper_bound_ );
     reelection_timer_.reset();
+
+    if (candidate_id < 0) return;
+    ptr<peer> pp = peers_[candidate_id];
+
+    ulong last_log_idx = log_store_->next_slot() - 1;
+    ulong p_matched_idx = pp->get_matched_idx();
+    if (p_matched_idx && p_matched_idx == last_log_idx) {
+        // Already caught up, hand over without waiting for response.
+        p_in("candidate %d already has the latest log %zu, resign now",
+             candidate_id, last_log_idx);
+        hand_over_leadership(pp);
+        return;
+    }
+
+    // Otherwise, start the catch-up now instead of waiting for
+    // the next heartbeat. The response handler will resign once
+    // the candidate reaches the latest log.
+    request_append_entries(pp);
 }
 
 void raft_server::become_follower() {
     // stop hb for all peers
     p_tr("  FOLLOWER\n");
-    {   std::lock_guard<std::mutex> ll(cli_lock_);
+    p_ev( TE_BECOME_FOLLOWER, log_store_->next_slot() - 1,
+          leader_, state_->get_term() );
+    {   std::unique_lock<rw_lock> rw_guard(cli_rw_lock_);
+        std::lock_guard<std::mutex> ll(cli_lock_);
         for (peer_itor it = peers_.begin(); it != peers_.end(); ++it) {
             it->second->enable_hb(false);
         }
@@ -944,6 +1089,7 @@ void raft_server::become_follower() {
         // Drain all pending callback functions.
         drop_all_pending_commit_elems();
     }
+    drop_all_read_index_reqs();
 
     restart_election_timer();
 }
@@ -1084,6 +1230,15 @@ void raft_server::handle_ext_resp_err(rpc_exception& err) {
 void raft_server::on_retryable_req_err(ptr<peer>& p, ptr<req_msg>& req) {
     p_db( "retry the request %s for %d",
           msg_type_to_string(req->get_type()).c_str(), p->get_id() );
+    if (req->get_type() == msg_type::sync_log_request) {
+        // Other log sync requests might have been in flight, and
+        // they failed as well. Instead of re-sending each of them,
+        // start over from the last index that the new server acked.
+        recur_lock(lock_);
+        if (p != srv_to_join_ || p->is_busy()) return;
+        sync_log_to_new_srv(p->get_next_log_idx());
+        return;
+    }
     p->send_req(p, req, ex_resp_handler_);
 }
 
@@ -1093,6 +1248,8 @@ ulong raft_server::term_for_log(ulong log_idx) {
     }
 
     if (log_idx >= log_store_->start_index()) {
+        ulong term = 0;
+        if (term_index_->find(log_idx, term)) return term;
         return log_store_->term_at(log_idx);
     }
 
@@ -1191,10 +1348,21 @@ void raft_server::set_last_snapshot(const ptr<snapshot>& new_snapshot) {
 
 ulong raft_server::store_log_entry(ptr<log_entry>& entry, ulong index) {
     ulong log_index = index;
-    if (index == 0) {
-        log_index = log_store_->append(entry);
-    } else {
-        log_store_->write_at(log_index, entry);
+    {   std::lock_guard<std::mutex> l(log_append_lock_);
+        if (index == 0) {
+            log_index = log_store_->append(entry);
+        } else {
+            log_store_->write_at(log_index, entry);
+        }
+        if (!log_index || log_store_->next_slot() != log_index + 1) {
+            // LCOV_EXCL_START
+            p_ft( "log store failed to append log %llu, next slot %llu",
+                  log_index, log_store_->next_slot() );
+            ctx_->state_mgr_->system_exit(N24_log_append_failed);
+            ::exit(-1);
+            // LCOV_EXCL_STOP
+        }
+        term_index_->append(log_index, entry->get_term());
     }
 
     if ( entry->get_val_type() == log_val_type::conf ) {
@@ -1219,5 +1387,57 @@ ulong raft_server::store_log_entry(ptr<log_entry>& entry, ulong index) {
     return log_index;
 }
 
+ulong raft_server::store_log_entries(std::vector< ptr<log_entry> >& entries,
+                                     ulong index)
+{
+    if (entries.empty()) return index;
+
+    ulong start_idx = index;
+    {   std::lock_guard<std::mutex> l(log_append_lock_);
+        if (index == 0) {
+            start_idx = log_store_->next_slot();
+            log_store_->append_batch(start_idx, entries);
+        } else {
+            log_store_->write_batch_at(start_idx, entries);
+        }
+        if (log_store_->next_slot() != start_idx + entries.size()) {
+            // LCOV_EXCL_START
+            p_ft( "log store failed to append logs %llu-%llu, next slot %llu",
+                  start_idx, start_idx + entries.size() - 1,
+                  log_store_->next_slot() );
+            ctx_->state_mgr_->system_exit(N24_log_append_failed);
+            ::exit(-1);
+            // LCOV_EXCL_STOP
+        }
+        for (size_t ii = 0; ii < entries.size(); ++ii) {
+            term_index_->append(start_idx + ii, entries[ii]->get_term());
+        }
+    }
+
+    // Same as `store_log_entry`, config logs should be durable.
+    ulong last_conf_idx = 0;
+    for (size_t ii = 0; ii < entries.size(); ++ii) {
+        if (entries[ii]->get_val_type() == log_val_type::conf) {
+            last_conf_idx = start_idx + ii;
+        }
+    }
+    if (last_conf_idx) {
+        if ( !log_store_->flush() ) {
+            // LCOV_EXCL_START
+            p_ft("log store flush failed");
+            ctx_->state_mgr_->system_exit(N21_log_flush_failed);
+            // LCOV_EXCL_STOP
+        }
+
+        if ( role_ == srv_role::leader ) {
+            if (precommit_index_ < last_conf_idx) {
+                precommit_index_ = last_conf_idx;
+            }
+        }
+    }
+
+    return start_idx;
+}
+
 } // namespace nuraft;
 
@@ -0,0 +1,783 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "segmented_log_store.hxx"
+
+#include "crc32.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nuraft {
+
+// Segment file:
+//   [file header] [record] [record] ...
+//
+// File header:
+//   magic (8), index of the first log entry (8).
+//
+// Record:
+//   payload length (4), CRC32C of the rest (4), log index (8),
+//   payload: term (8), value type (1), log data.
+//
+// The rest of the pre-allocated file is zero, and a zero payload
+// length marks the end of the segment.
+static const uint64_t SEG_MAGIC = 0x4e75526166534547; // "NuRafSEG"
+static const uint64_t META_MAGIC = 0x4e7552616653544d; // "NuRafSTM"
+static const size_t SEG_HDR_SIZE = 16;
+static const size_t REC_HDR_SIZE = 16;
+static const size_t PAYLOAD_HDR_SIZE = sizeof(ulong) + 1;
+static const char* SEG_SUFFIX = ".seg";
+static const char* META_FILE = "meta";
+
+static inline void put_u32(byte* ptr, uint32_t val) {
+    for (size_t ii = 0; ii < 4; ++ii) ptr[ii] = (val >> (ii * 8)) & 0xff;
+}
+
+static inline void put_u64(byte* ptr, uint64_t val) {
+    for (size_t ii = 0; ii < 8; ++ii) ptr[ii] = (val >> (ii * 8)) & 0xff;
+}
+
+static inline uint32_t get_u32(const byte* ptr) {
+    uint32_t val = 0;
+    for (size_t ii = 0; ii < 4; ++ii) val |= (uint32_t)ptr[ii] << (ii * 8);
+    return val;
+}
+
+static inline uint64_t get_u64(const byte* ptr) {
+    uint64_t val = 0;
+    for (size_t ii = 0; ii < 8; ++ii) val |= (uint64_t)ptr[ii] << (ii * 8);
+    return val;
+}
+
+static inline size_t rec_size(const byte* rec) {
+    return REC_HDR_SIZE + get_u32(rec);
+}
+
+// Return `true` if the record at `rec` is valid, and its index is `index`.
+static bool check_record(const byte* rec, size_t space, ulong index) {
+    if (space < REC_HDR_SIZE) return false;
+    uint32_t len = get_u32(rec);
+    if (len < PAYLOAD_HDR_SIZE || len > space - REC_HDR_SIZE) return false;
+    if (get_u64(rec + 8) != index) return false;
+    uint32_t crc = crc32c(rec + 8, len + 8, 0);
+    return (crc == get_u32(rec + 4));
+}
+
+static bool is_zero(const byte* ptr, size_t len) {
+    for (size_t ii = 0; ii < len; ++ii) {
+        if (ptr[ii]) return false;
+    }
+    return true;
+}
+
+static bool sync_dir(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    int rc = ::fsync(fd);
+    ::close(fd);
+    return (rc == 0);
+}
+
+struct segmented_log_store::segment {
+    segment()
+        : start_idx_(0)
+        , fd_(-1)
+        , map_(nullptr)
+        , capacity_(0)
+        , end_(SEG_HDR_SIZE)
+        , count_(0)
+        , sync_from_(SEG_HDR_SIZE)
+        , sync_to_(0)
+        {}
+
+    ~segment() {
+        if (map_) ::munmap(map_, capacity_);
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    ulong last_idx() const { return start_idx_ + count_ - 1; }
+
+    // Index of the first log entry.
+    ulong start_idx_;
+
+    std::string path_;
+
+    int fd_;
+
+    // Mapped file, of `capacity_` bytes.
+    byte* map_;
+
+    size_t capacity_;
+
+    // End of the last record.
+    size_t end_;
+
+    // Number of log entries.
+    ulong count_;
+
+    // Offset of every `index_interval_`-th record.
+    std::vector<size_t> sparse_;
+
+    // Range not synced yet: [sync_from_, max(end_, sync_to_)).
+    size_t sync_from_;
+    size_t sync_to_;
+};
+
+ptr<segmented_log_store> segmented_log_store::open(const std::string& path,
+                                                   const options& opt)
+{
+    ptr<segmented_log_store> ret = cs_new<segmented_log_store>(path, opt);
+    if (!ret->load()) return nullptr;
+    return ret;
+}
+
+segmented_log_store::segmented_log_store(const std::string& path,
+                                         const options& opt)
+    : path_(path)
+    , opt_(opt)
+    , dir_dirty_(false)
+    , start_idx_(1)
+    , next_idx_(1)
+{
+    if (!opt_.index_interval_) opt_.index_interval_ = 1;
+}
+
+segmented_log_store::~segmented_log_store() {
+    close();
+}
+
+bool segmented_log_store::load() {
+    std::lock_guard<std::mutex> l(lock_);
+
+    struct stat st;
+    if (::stat(path_.c_str(), &st) != 0) {
+        if (::mkdir(path_.c_str(), 0755) != 0) return false;
+    } else if (!S_ISDIR(st.st_mode)) {
+        return false;
+    }
+
+    DIR* dir = ::opendir(path_.c_str());
+    if (!dir) return false;
+
+    std::vector<ulong> seg_starts;
+    size_t suffix_len = strlen(SEG_SUFFIX);
+    struct dirent* ent;
+    while ( (ent = ::readdir(dir)) != nullptr ) {
+        std::string name(ent->d_name);
+        if ( name.size() <= suffix_len ||
+             name.compare(name.size() - suffix_len,
+                          suffix_len, SEG_SUFFIX) != 0 ) continue;
+        seg_starts.push_back( strtoull(name.c_str(), nullptr, 10) );
+    }
+    ::closedir(dir);
+    std::sort(seg_starts.begin(), seg_starts.end());
+
+    ulong meta_start = 1;
+    load_meta(meta_start);
+
+    // Segments should be contiguous. Once a segment is missing or
+    // broken, the following ones are orphans.
+    bool broken = false;
+    for (size_t ii = 0; ii < seg_starts.size(); ++ii) {
+        ptr<segment> seg;
+        if (!broken) {
+            seg = open_segment(seg_starts[ii], 0, false);
+            if (!seg) {
+                // Crashed while rolling over to the new segment, before
+                // its header became durable. It cannot have any durable
+                // log, treat it as an orphan.
+                if (ii + 1 < seg_starts.size()) return false;
+                broken = true;
+            }
+        }
+        if ( broken ||
+             ( !segments_.empty() &&
+               next_idx_ != seg->start_idx_ ) ) {
+            broken = true;
+            char name[64];
+            snprintf(name, 64, "/%020lu%s", (unsigned long)seg_starts[ii],
+                     SEG_SUFFIX);
+            ::unlink( (path_ + name).c_str() );
+            dir_dirty_ = true;
+            continue;
+        }
+
+        bool is_last = (ii + 1 == seg_starts.size());
+        if (segments_.empty()) next_idx_ = seg->start_idx_;
+        if (!load_segment(seg, is_last)) broken = true;
+        segments_[seg->start_idx_] = seg;
+    }
+
+    // Drop empty segments, except for the last one.
+    for (auto itr = segments_.begin(); itr != segments_.end(); ) {
+        auto next_itr = itr;
+        ++next_itr;
+        if (!itr->second->count_ && next_itr != segments_.end()) {
+            remove_segment(itr->second);
+            itr = segments_.erase(itr);
+        } else {
+            itr = next_itr;
+        }
+    }
+
+    if (segments_.empty()) {
+        start_idx_ = meta_start;
+        next_idx_ = meta_start;
+        terms_.clear();
+    } else {
+        ulong first = segments_.begin()->second->start_idx_;
+        start_idx_ = std::max(first, meta_start);
+        if (start_idx_ > next_idx_) {
+            // Everything has been compacted.
+            for (auto& entry: segments_) remove_segment(entry.second);
+            segments_.clear();
+            next_idx_ = start_idx_.load();
+            terms_.clear();
+        } else {
+            while (terms_.size() > next_idx_ - start_idx_) terms_.pop_front();
+        }
+    }
+    return sync_dirty();
+}
+
+bool segmented_log_store::load_segment(const ptr<segment>& seg, bool is_last) {
+    size_t pos = SEG_HDR_SIZE;
+    ulong idx = seg->start_idx_;
+    while (check_record(seg->map_ + pos, seg->capacity_ - pos, idx)) {
+        if ((idx - seg->start_idx_) % opt_.index_interval_ == 0) {
+            seg->sparse_.push_back(pos);
+        }
+        terms_.push_back( get_u64(seg->map_ + pos + REC_HDR_SIZE) );
+        pos += rec_size(seg->map_ + pos);
+        idx++;
+    }
+    seg->end_ = pos;
+    seg->count_ = idx - seg->start_idx_;
+    seg->sync_from_ = pos;
+    next_idx_ = idx;
+
+    size_t tail = std::min(REC_HDR_SIZE, seg->capacity_ - pos);
+    if (!is_zero(seg->map_ + pos, tail)) {
+        // Partially written record, discard it.
+        truncate_segment(seg, pos, seg->count_);
+        return is_last;
+    }
+    return true;
+}
+
+ptr<segmented_log_store::segment>
+    segmented_log_store::open_segment(ulong start_idx,
+                                      size_t min_size,
+                                      bool create)
+{
+    ptr<segment> seg = cs_new<segment>();
+    seg->start_idx_ = start_idx;
+    char name[64];
+    snprintf(name, 64, "/%020lu%s", (unsigned long)start_idx, SEG_SUFFIX);
+    seg->path_ = path_ + name;
+
+    int flags = O_RDWR | (create ? (O_CREAT | O_TRUNC) : 0);
+    seg->fd_ = ::open(seg->path_.c_str(), flags, 0644);
+    if (seg->fd_ < 0) return nullptr;
+
+    if (create) {
+        size_t size = std::max(opt_.segment_size_, SEG_HDR_SIZE + min_size);
+        // Allocate the blocks in advance, so that writing to the mapped
+        // file does not fail due to lack of space.
+#ifdef __linux__
+        int rc = ::posix_fallocate(seg->fd_, 0, size);
+        if (rc != 0) rc = ::ftruncate(seg->fd_, size);
+#else
+        int rc = ::ftruncate(seg->fd_, size);
+#endif
+        if (rc != 0) return nullptr;
+        seg->capacity_ = size;
+        dir_dirty_ = true;
+    } else {
+        struct stat st;
+        if (::fstat(seg->fd_, &st) != 0) return nullptr;
+        seg->capacity_ = st.st_size;
+        if (seg->capacity_ < SEG_HDR_SIZE) return nullptr;
+    }
+
+    void* addr = ::mmap( nullptr, seg->capacity_, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, seg->fd_, 0 );
+    if (addr == MAP_FAILED) return nullptr;
+    seg->map_ = static_cast<byte*>(addr);
+
+    if (create) {
+        put_u64(seg->map_, SEG_MAGIC);
+        put_u64(seg->map_ + 8, start_idx);
+        if (opt_.fsync_ && ::msync(seg->map_, SEG_HDR_SIZE, MS_SYNC) != 0) {
+            return nullptr;
+        }
+    } else if ( get_u64(seg->map_) != SEG_MAGIC ||
+                get_u64(seg->map_ + 8) != start_idx ) {
+        return nullptr;
+    }
+    return seg;
+}
+
+void segmented_log_store::remove_segment(const ptr<segment>& seg) {
+    ::munmap(seg->map_, seg->capacity_);
+    seg->map_ = nullptr;
+    ::close(seg->fd_);
+    seg->fd_ = -1;
+    ::unlink(seg->path_.c_str());
+    dir_dirty_ = true;
+
+    auto itr = std::find(dirty_.begin(), dirty_.end(), seg);
+    if (itr != dirty_.end()) dirty_.erase(itr);
+}
+
+void segmented_log_store::truncate_segment(const ptr<segment>& seg,
+                                           size_t offset,
+                                           ulong count)
+{
+    // Zero the discarded records, otherwise they may be recovered
+    // after a crash, right after a shorter record written at the
+    // same place. If the tail is garbage (at recovery), zero it
+    // up to the end of the file.
+    size_t end = (seg->end_ > offset) ? seg->end_ : seg->capacity_;
+    memset(seg->map_ + offset, 0x0, end - offset);
+
+    seg->end_ = offset;
+    seg->count_ = count;
+    seg->sparse_.resize( (count + opt_.index_interval_ - 1) /
+                         opt_.index_interval_ );
+    seg->sync_from_ = std::min(seg->sync_from_, offset);
+    seg->sync_to_ = std::max(seg->sync_to_, end);
+    if (std::find(dirty_.begin(), dirty_.end(), seg) == dirty_.end()) {
+        dirty_.push_back(seg);
+    }
+}
+
+void segmented_log_store::truncate_from(ulong index) {
+    if (index < start_idx_ || index > next_idx_) {
+        // Out of range, start over from the given index.
+        for (auto& entry: segments_) remove_segment(entry.second);
+        segments_.clear();
+        terms_.clear();
+        start_idx_ = index;
+        next_idx_ = index;
+        save_meta();
+        return;
+    }
+    if (index == next_idx_) return;
+
+    auto itr = segments_.lower_bound(index);
+    while (itr != segments_.end()) {
+        remove_segment(itr->second);
+        itr = segments_.erase(itr);
+    }
+
+    segment* seg = find_segment(index);
+    if (seg) {
+        size_t rec_len = 0;
+        const byte* rec = find_record(index, rec_len);
+        truncate_segment( segments_[seg->start_idx_],
+                          rec - seg->map_,
+                          index - seg->start_idx_ );
+    }
+    terms_.resize(index - start_idx_);
+    next_idx_ = index;
+}
+
+bool segmented_log_store::append_raw(ulong index,
+                                     const byte* rec,
+                                     size_t rec_len,
+                                     const byte* rec_rest,
+                                     size_t rec_rest_len,
+                                     ulong term)
+{
+    size_t total_len = rec_len + rec_rest_len;
+    ptr<segment> seg;
+    if (!segments_.empty()) seg = segments_.rbegin()->second;
+
+    if (!seg || seg->end_ + total_len > seg->capacity_) {
+        if (seg && !seg->count_) {
+            // Empty segment, replace it with the new one.
+            remove_segment(seg);
+            segments_.erase(seg->start_idx_);
+        }
+        seg = open_segment(index, total_len, true);
+        if (!seg) return false;
+        segments_[index] = seg;
+    }
+
+    memcpy(seg->map_ + seg->end_, rec, rec_len);
+    if (rec_rest_len) {
+        memcpy(seg->map_ + seg->end_ + rec_len, rec_rest, rec_rest_len);
+    }
+    if (seg->count_ % opt_.index_interval_ == 0) {
+        seg->sparse_.push_back(seg->end_);
+    }
+    seg->end_ += total_len;
+    seg->count_++;
+    if (dirty_.empty() || dirty_.back() != seg) dirty_.push_back(seg);
+
+    terms_.push_back(term);
+    next_idx_ = index + 1;
+    return true;
+}
+
+bool segmented_log_store::append_record(ulong index,
+                                        const byte* payload,
+                                        size_t payload_len,
+                                        ulong term)
+{
+    byte hdr[REC_HDR_SIZE];
+    put_u32(hdr, payload_len);
+    put_u64(hdr + 8, index);
+    uint32_t crc = crc32c(hdr + 8, 8, 0);
+    put_u32(hdr + 4, crc32c(payload, payload_len, crc));
+    return append_raw(index, hdr, REC_HDR_SIZE, payload, payload_len, term);
+}
+
+segmented_log_store::segment* segmented_log_store::find_segment(ulong index) const {
+    auto itr = segments_.upper_bound(index);
+    if (itr == segments_.begin()) return nullptr;
+    --itr;
+    segment* seg = itr->second.get();
+    if (index >= seg->start_idx_ + seg->count_) return nullptr;
+    return seg;
+}
+
+const byte* segmented_log_store::find_record(ulong index,
+                                             size_t& rec_len_out) const
+{
+    if (index < start_idx_ || index >= next_idx_) return nullptr;
+    segment* seg = find_segment(index);
+    if (!seg) return nullptr;
+
+    ulong rel = index - seg->start_idx_;
+    const byte* rec = seg->map_ + seg->sparse_[rel / opt_.index_interval_];
+    for (ulong ii = 0; ii < rel % opt_.index_interval_; ++ii) {
+        rec += rec_size(rec);
+    }
+    rec_len_out = rec_size(rec);
+    return rec;
+}
+
+ptr<log_entry> segmented_log_store::read_entry(ulong index) const {
+    size_t rec_len = 0;
+    const byte* rec = find_record(index, rec_len);
+    if (!rec) {
+        // Dummy entry, same as in-memory log store.
+        return cs_new<log_entry>(0, buffer::alloc(sz_ulong));
+    }
+
+    const byte* payload = rec + REC_HDR_SIZE;
+    size_t data_len = rec_len - REC_HDR_SIZE - PAYLOAD_HDR_SIZE;
+    return log_entry::make_compact( get_u64(payload),
+                                    payload + PAYLOAD_HDR_SIZE,
+                                    data_len,
+                                    static_cast<log_val_type>(payload[8]) );
+}
+
+ulong segmented_log_store::next_slot() const {
+    return next_idx_;
+}
+
+ulong segmented_log_store::start_index() const {
+    return start_idx_;
+}
+
+ptr<log_entry> segmented_log_store::last_entry() const {
+    std::lock_guard<std::mutex> l(lock_);
+    return read_entry(next_idx_ - 1);
+}
+
+ulong segmented_log_store::append(ptr<log_entry>& entry) {
+    ptr<buffer> payload = entry->serialize();
+
+    std::lock_guard<std::mutex> l(lock_);
+    ulong idx = next_idx_;
+    if ( !append_record( idx, payload->data_begin(), payload->size(),
+                         entry->get_term() ) ) {
+        return 0;
+    }
+    return idx;
+}
+
+void segmented_log_store::write_at(ulong index, ptr<log_entry>& entry) {
+    ptr<buffer> payload = entry->serialize();
+
+    // Discard all logs equal to or greater than `index`.
+    std::lock_guard<std::mutex> l(lock_);
+    truncate_from(index);
+    // If failed, `next_slot()` stays at `index`.
+    append_record( index, payload->data_begin(), payload->size(),
+                   entry->get_term() );
+}
+
+void segmented_log_store::append_batch(ulong start_idx,
+                                       std::vector< ptr<log_entry> >& entries)
+{
+    std::vector< ptr<buffer> > payloads;
+    payloads.reserve(entries.size());
+    for (ptr<log_entry>& le: entries) payloads.push_back(le->serialize());
+
+    // Stop at the first failure, `next_slot()` tells the caller
+    // how many logs have been written.
+    std::lock_guard<std::mutex> l(lock_);
+    ulong idx = next_idx_;
+    for (size_t ii = 0; ii < entries.size(); ++ii) {
+        if ( !append_record( idx++, payloads[ii]->data_begin(),
+                             payloads[ii]->size(),
+                             entries[ii]->get_term() ) ) break;
+    }
+}
+
+void segmented_log_store::write_batch_at(ulong start_idx,
+                                         std::vector< ptr<log_entry> >& entries)
+{
+    std::vector< ptr<buffer> > payloads;
+    payloads.reserve(entries.size());
+    for (ptr<log_entry>& le: entries) payloads.push_back(le->serialize());
+
+    // Discard all logs equal to or greater than `start_idx`.
+    std::lock_guard<std::mutex> l(lock_);
+    truncate_from(start_idx);
+    ulong idx = start_idx;
+    for (size_t ii = 0; ii < entries.size(); ++ii) {
+        // Same as `append_batch`.
+        if ( !append_record( idx++, payloads[ii]->data_begin(),
+                             payloads[ii]->size(),
+                             entries[ii]->get_term() ) ) break;
+    }
+}
+
+void segmented_log_store::end_of_append_batch(ulong start, ulong cnt) {
+    flush();
+}
+
+ptr<std::vector<ptr<log_entry>>>
+    segmented_log_store::log_entries(ulong start, ulong end)
+{
+    return log_entries_ext(start, end, 0);
+}
+
+ptr<std::vector<ptr<log_entry>>>
+    segmented_log_store::log_entries_ext(ulong start,
+                                         ulong end,
+                                         ulong batch_size_hint_in_bytes)
+{
+    ptr<std::vector<ptr<log_entry>>> ret =
+        cs_new<std::vector<ptr<log_entry>>>();
+
+    std::lock_guard<std::mutex> l(lock_);
+    if (start < start_idx_ || end > next_idx_) return nullptr;
+
+    ret->reserve(end - start);
+    size_t accum_size = 0;
+    for (ulong ii = start; ii < end; ++ii) {
+        ptr<log_entry> le = read_entry(ii);
+        accum_size += le->get_buf().size();
+        ret->push_back(le);
+        if ( batch_size_hint_in_bytes &&
+             accum_size >= batch_size_hint_in_bytes ) break;
+    }
+    return ret;
+}
+
+ptr<log_entry> segmented_log_store::entry_at(ulong index) {
+    std::lock_guard<std::mutex> l(lock_);
+    return read_entry(index);
+}
+
+ulong segmented_log_store::term_at(ulong index) {
+    std::lock_guard<std::mutex> l(lock_);
+    if (index < start_idx_ || index >= next_idx_) return 0;
+    return terms_[index - start_idx_];
+}
+
+log_val_type segmented_log_store::val_type_at(ulong index) {
+    std::lock_guard<std::mutex> l(lock_);
+    size_t rec_len = 0;
+    const byte* rec = find_record(index, rec_len);
+    if (!rec) return log_val_type::app_log;
+    // Only the record header is read from the mapped segment.
+    return static_cast<log_val_type>(rec[REC_HDR_SIZE + sizeof(ulong)]);
+}
+
+ptr<buffer> segmented_log_store::pack(ulong index, int32 cnt) {
+    std::lock_guard<std::mutex> l(lock_);
+    if (cnt < 0 || index < start_idx_ || index + cnt > next_idx_) {
+        return nullptr;
+    }
+
+    // Records in a segment are contiguous,
+    // copy them at once per segment.
+    std::vector< std::pair<const byte*, size_t> > runs;
+    size_t total = 0;
+    ulong ii = index;
+    while (ii < index + cnt) {
+        segment* seg = find_segment(ii);
+        size_t rec_len = 0;
+        const byte* begin = find_record(ii, rec_len);
+        const byte* rec = begin;
+        ulong seg_end = std::min(index + cnt, seg->start_idx_ + seg->count_);
+        for (; ii < seg_end; ++ii) rec += rec_size(rec);
+        runs.push_back( std::make_pair(begin, (size_t)(rec - begin)) );
+        total += rec - begin;
+    }
+
+    ptr<buffer> buf_out = buffer::alloc(sizeof(int32) + total);
+    buf_out->pos(0);
+    buf_out->put(cnt);
+    for (auto& entry: runs) buf_out->put_raw(entry.first, entry.second);
+    buf_out->pos(0);
+    return buf_out;
+}
+
+void segmented_log_store::apply_pack(ulong index, buffer& pack) {
+    pack.pos(0);
+    int32 num_logs = pack.get_int();
+    const byte* rec = pack.data();
+    size_t space = pack.size() - pack.pos();
+
+    std::lock_guard<std::mutex> l(lock_);
+    truncate_from(index);
+    for (int32 ii = 0; ii < num_logs; ++ii) {
+        ulong cur_idx = index + ii;
+        if (!check_record(rec, space, cur_idx)) {
+            assert(0);
+            break;
+        }
+        size_t rec_len = rec_size(rec);
+        if ( !append_raw( cur_idx, rec, rec_len, nullptr, 0,
+                          get_u64(rec + REC_HDR_SIZE) ) ) break;
+        rec += rec_len;
+        space -= rec_len;
+    }
+    sync_dirty();
+}
+
+bool segmented_log_store::compact(ulong last_log_index) {
+    std::lock_guard<std::mutex> l(lock_);
+    if (last_log_index < start_idx_) return true;
+
+    if (last_log_index >= next_idx_) {
+        for (auto& entry: segments_) remove_segment(entry.second);
+        segments_.clear();
+        terms_.clear();
+        next_idx_ = last_log_index + 1;
+
+    } else {
+        // Delete the segments entirely covered by the given index.
+        auto itr = segments_.begin();
+        while (itr != segments_.end()) {
+            if (itr->second->last_idx() > last_log_index) break;
+            remove_segment(itr->second);
+            itr = segments_.erase(itr);
+        }
+        for (ulong ii = start_idx_; ii <= last_log_index; ++ii) {
+            terms_.pop_front();
+        }
+    }
+
+    // WARNING:
+    //   Even though nothing has been erased,
+    //   we should set `start_idx_` to new index.
+    start_idx_ = last_log_index + 1;
+    return save_meta();
+}
+
+bool segmented_log_store::flush() {
+    std::lock_guard<std::mutex> l(lock_);
+    return sync_dirty();
+}
+
+bool segmented_log_store::sync_dirty() {
+    bool ok = true;
+    for (auto& seg: dirty_) {
+        size_t page = ::sysconf(_SC_PAGESIZE);
+        size_t from = seg->sync_from_ / page * page;
+        size_t to = std::max(seg->end_, seg->sync_to_);
+        if (opt_.fsync_ && to > from) {
+            if (::msync(seg->map_ + from, to - from, MS_SYNC) != 0) ok = false;
+        }
+        seg->sync_from_ = seg->end_;
+        seg->sync_to_ = 0;
+    }
+    dirty_.clear();
+
+    if (dir_dirty_) {
+        if (opt_.fsync_ && !sync_dir(path_)) ok = false;
+        dir_dirty_ = false;
+    }
+    return ok;
+}
+
+bool segmented_log_store::save_meta() {
+    byte buf[20];
+    put_u64(buf, META_MAGIC);
+    put_u64(buf + 8, start_idx_);
+    put_u32(buf + 16, crc32c(buf, 16, 0));
+
+    std::string tmp_path = path_ + "/" + META_FILE + ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool ok = (::write(fd, buf, sizeof(buf)) == (ssize_t)sizeof(buf));
+    if (ok && opt_.fsync_) ok = (::fsync(fd) == 0);
+    ::close(fd);
+    if (!ok) return false;
+
+    std::string meta_path = path_ + "/" + META_FILE;
+    if (::rename(tmp_path.c_str(), meta_path.c_str()) != 0) return false;
+    dir_dirty_ = true;
+    return sync_dirty();
+}
+
+void segmented_log_store::load_meta(ulong& start_idx_out) {
+    std::string meta_path = path_ + "/" + META_FILE;
+    int fd = ::open(meta_path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    byte buf[20];
+    bool ok = (::read(fd, buf, sizeof(buf)) == (ssize_t)sizeof(buf));
+    ::close(fd);
+    if ( !ok ||
+         get_u64(buf) != META_MAGIC ||
+         get_u32(buf + 16) != crc32c(buf, 16, 0) ) return;
+    start_idx_out = get_u64(buf + 8);
+}
+
+void segmented_log_store::close() {
+    std::lock_guard<std::mutex> l(lock_);
+    sync_dirty();
+    segments_.clear();
+}
+
+size_t segmented_log_store::get_num_segments() const {
+    std::lock_guard<std::mutex> l(lock_);
+    return segments_.size();
+}
+
+}
+
@@ -0,0 +1,173 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "snapshot_prefetcher.hxx"
+
+#include "snapshot.hxx"
+#include "state_machine.hxx"
+
+#include <algorithm>
+
+namespace nuraft {
+
+snapshot_prefetcher::snapshot_prefetcher(const ptr<state_machine>& sm,
+                                         const ptr<snapshot>& snp,
+                                         ulong start_offset,
+                                         void* user_snp_ctx,
+                                         size_t block_size,
+                                         size_t max_blocks,
+                                         const std::function<void()>& when_ready)
+    : sm_(sm)
+    , snp_(snp)
+    , user_snp_ctx_(user_snp_ctx)
+    , block_size_(block_size ? block_size : 1)
+    , max_blocks_(max_blocks ? max_blocks : 1)
+    , when_ready_(when_ready)
+    , next_offset_(start_offset)
+    , done_(false)
+    , failed_(false)
+    , waiting_(false)
+    , stopping_(false)
+{
+    reader_ = std::thread(&snapshot_prefetcher::read_loop, this);
+}
+
+snapshot_prefetcher::~snapshot_prefetcher() {
+    void* user_ctx = stop();
+    if (user_ctx) {
+        // Not taken back by the owner, return it to the state machine.
+        sm_->free_user_snp_ctx(user_ctx);
+    }
+}
+
+void* snapshot_prefetcher::stop() {
+    {   std::lock_guard<std::mutex> l(lock_);
+        stopping_ = true;
+        cv_.notify_all();
+    }
+    if (reader_.joinable()) reader_.join();
+
+    void* ret = user_snp_ctx_;
+    user_snp_ctx_ = nullptr;
+    return ret;
+}
+
+bool snapshot_prefetcher::read_block(ulong offset, block& blk_out) {
+    blk_out.offset_ = offset;
+    blk_out.is_last_ = false;
+
+    if (snp_->get_type() == snapshot::raw_binary) {
+        if (offset >= snp_->size()) return false;
+        size_t sz_left = snp_->size() - offset;
+        ptr<buffer> data = buffer::alloc( std::min(block_size_, sz_left) );
+        int32 sz_rd = sm_->read_snapshot_data(*snp_, offset, *data);
+        if (sz_rd < 0 || (size_t)sz_rd < data->size()) return false;
+        blk_out.data_ = data;
+        blk_out.is_last_ = (offset + data->size() >= snp_->size());
+
+    } else {
+        ptr<buffer> data;
+        sm_->read_logical_snp_obj( *snp_, user_snp_ctx_, offset,
+                                   data, blk_out.is_last_ );
+        if (data) data->pos(0);
+        blk_out.data_ = data;
+    }
+    return true;
+}
+
+void snapshot_prefetcher::read_loop() {
+    std::string thread_name = "nuraft_snp_rd";
+#ifdef __linux__
+    pthread_setname_np(pthread_self(), thread_name.c_str());
+#elif __APPLE__
+    pthread_setname_np(thread_name.c_str());
+#endif
+
+    std::unique_lock<std::mutex> l(lock_);
+    while (!stopping_) {
+        if (done_ || failed_ || blocks_.size() >= max_blocks_) {
+            cv_.wait(l);
+            continue;
+        }
+
+        ulong offset = next_offset_;
+        l.unlock();
+        block blk;
+        bool ok = read_block(offset, blk);
+        l.lock();
+
+        if (!ok) {
+            failed_ = true;
+        } else {
+            if (snp_->get_type() == snapshot::raw_binary) {
+                next_offset_ = offset + blk.data_->size();
+            } else {
+                next_offset_ = offset + 1;
+            }
+            done_ = blk.is_last_;
+            blocks_.push_back(blk);
+        }
+        cv_.notify_all();
+
+        if (waiting_ && when_ready_) {
+            waiting_ = false;
+            l.unlock();
+            when_ready_();
+            l.lock();
+        }
+    }
+}
+
+snapshot_prefetcher::result
+    snapshot_prefetcher::get(ulong offset,
+                             ptr<buffer>& data_out,
+                             bool& is_last_out,
+                             bool wait)
+{
+    std::unique_lock<std::mutex> l(lock_);
+    while (true) {
+        while (!blocks_.empty() && blocks_.front().offset_ < offset) {
+            blocks_.pop_front();
+            cv_.notify_all();
+        }
+
+        if (!blocks_.empty()) {
+            block& blk = blocks_.front();
+            if (blk.offset_ != offset) return MISMATCH;
+
+            data_out = blk.data_;
+            is_last_out = blk.is_last_;
+            blocks_.pop_front();
+            // Room for the next block.
+            cv_.notify_all();
+            return READY;
+        }
+
+        if (failed_) return FAILED;
+        if (done_ || stopping_ || next_offset_ != offset) return MISMATCH;
+
+        // The requested block is being read.
+        if (!wait) {
+            waiting_ = true;
+            return NOT_READY;
+        }
+        cv_.wait(l);
+    }
+}
+
+}
+
@@ -0,0 +1,155 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include "basic_types.hxx"
+#include "buffer.hxx"
+#include "pp_util.hxx"
+#include "ptr.hxx"
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+
+namespace nuraft {
+
+class snapshot;
+class state_machine;
+
+/**
+ * Background reader of a snapshot being sent to a peer.
+ *
+ * A dedicated thread reads the blocks (or objects) of the snapshot
+ * ahead of the replication path, and keeps up to `max_blocks` of
+ * them in a bounded queue. So reading the next block from the state
+ * machine is overlapped with sending the current one, and it does
+ * not block the Raft lock.
+ *
+ * For raw binary snapshot, the next offset is the end of the
+ * previous block. For logical object snapshot, the next object is
+ * assumed to be `current + 1`; if the follower asks for a different
+ * one, the caller should restart the prefetcher from there.
+ */
+class snapshot_prefetcher {
+public:
+    enum result {
+        // Requested block is returned.
+        READY,
+        // Requested block is being read,
+        // `when_ready` will be invoked once it is ready.
+        NOT_READY,
+        // Requested block is not the one being prefetched.
+        MISMATCH,
+        // State machine failed to read the block.
+        FAILED,
+    };
+
+    /**
+     * @param sm State machine to read the snapshot from.
+     * @param snp Snapshot to read.
+     * @param start_offset Offset (or object index) of the first block.
+     * @param user_snp_ctx User context of logical snapshot, will be
+     *                     owned by this prefetcher until `stop()`.
+     * @param block_size Block size of raw binary snapshot.
+     * @param max_blocks Max number of blocks to read ahead.
+     * @param when_ready Callback invoked when a block becomes ready
+     *                   after `get()` returned `NOT_READY`.
+     *                   Invoked by the reader thread.
+     */
+    snapshot_prefetcher(const ptr<state_machine>& sm,
+                        const ptr<snapshot>& snp,
+                        ulong start_offset,
+                        void* user_snp_ctx,
+                        size_t block_size,
+                        size_t max_blocks,
+                        const std::function<void()>& when_ready);
+
+    ~snapshot_prefetcher();
+
+    __nocopy__(snapshot_prefetcher);
+
+public:
+    /**
+     * Get the block at the given offset. Blocks before the offset
+     * are discarded.
+     *
+     * @param offset Offset (or object index) of the block.
+     * @param[out] data_out Data of the block.
+     * @param[out] is_last_out `true` if it is the last block.
+     * @param wait If `true`, wait until the block is read,
+     *             instead of returning `NOT_READY`.
+     * @return Result.
+     */
+    result get(ulong offset,
+               ptr<buffer>& data_out,
+               bool& is_last_out,
+               bool wait);
+
+    /**
+     * Stop the reader thread. Can be called multiple times.
+     *
+     * @return User context of logical snapshot, ownership is
+     *         transferred to the caller.
+     */
+    void* stop();
+
+private:
+    struct block {
+        ulong offset_;
+        ptr<buffer> data_;
+        bool is_last_;
+    };
+
+    void read_loop();
+
+    bool read_block(ulong offset, block& blk_out);
+
+    ptr<state_machine> sm_;
+    ptr<snapshot> snp_;
+    void* user_snp_ctx_;
+    size_t block_size_;
+    size_t max_blocks_;
+    std::function<void()> when_ready_;
+
+    // Offset of the next block to be read.
+    ulong next_offset_;
+
+    // `true` if the last block has been read.
+    bool done_;
+
+    // `true` if the state machine failed to read a block.
+    bool failed_;
+
+    // `true` if `get()` returned `NOT_READY`.
+    bool waiting_;
+
+    bool stopping_;
+
+    std::list<block> blocks_;
+
+    std::mutex lock_;
+
+    std::condition_variable cv_;
+
+    std::thread reader_;
+};
+
+}
+
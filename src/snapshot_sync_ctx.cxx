@@ -0,0 +1,79 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "snapshot_sync_ctx.hxx"
+
+#include "snapshot_prefetcher.hxx"
+#include "state_machine.hxx"
+
+namespace nuraft {
+
+snapshot_sync_ctx::~snapshot_sync_ctx() {
+    for (stream& ss: streams_) {
+        if (ss.user_snp_ctx_) sm_->free_user_snp_ctx(ss.user_snp_ctx_);
+    }
+}
+
+void snapshot_sync_ctx::stop_prefetch() {
+    if (!prefetcher_) return;
+    void* user_ctx = prefetcher_->stop();
+    if (user_ctx) user_snp_ctx_ = user_ctx;
+    prefetcher_.reset();
+}
+
+void snapshot_sync_ctx::init_streams(const ptr<state_machine>& sm,
+                                     int32 num_streams)
+{
+    sm_ = sm;
+    streams_.resize(num_streams);
+    next_stream_ = 0;
+}
+
+int32 snapshot_sync_ctx::find_stream() const {
+    if (streams_.empty()) return -1;
+
+    const stream& first = streams_[0];
+    if (first.obj_idx_ == 0 && !first.done_) {
+        // The first object should be saved before the others.
+        return first.in_flight_ ? -1 : 0;
+    }
+
+    for (size_t ii = 0; ii < streams_.size(); ++ii) {
+        size_t idx = (next_stream_ + ii) % streams_.size();
+        const stream& ss = streams_[idx];
+        if (ss.in_flight_ || ss.done_) continue;
+        return (int32)idx;
+    }
+    return -1;
+}
+
+int32 snapshot_sync_ctx::next_stream() {
+    int32 idx = find_stream();
+    if (idx >= 0) next_stream_ = idx + 1;
+    return idx;
+}
+
+bool snapshot_sync_ctx::has_stream_to_send() const {
+    return find_stream() >= 0;
+}
+
+void snapshot_sync_ctx::reset_in_flight_streams() {
+    for (stream& ss: streams_) ss.in_flight_ = false;
+}
+
+}
+
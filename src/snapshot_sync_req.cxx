@@ -24,6 +24,14 @@ limitations under the License.
 
 namespace nuraft {
 
+// Flags in the `done` byte.
+static const byte SNP_REQ_DONE = 0x1;
+static const byte SNP_REQ_STREAM = 0x2;
+
+// Flags of stream response context.
+static const byte SNP_ACK_STREAM_DONE = 0x1;
+static const byte SNP_ACK_SNP_DONE = 0x2;
+
 ptr<snapshot_sync_req> snapshot_sync_req::deserialize(buffer& buf) {
     buffer_serializer bs(buf);
     return deserialize(bs);
@@ -32,7 +40,14 @@ ptr<snapshot_sync_req> snapshot_sync_req::deserialize(buffer& buf) {
 ptr<snapshot_sync_req> snapshot_sync_req::deserialize(buffer_serializer& bs) {
     ptr<snapshot> snp(snapshot::deserialize(bs));
     ulong offset = bs.get_u64();
-    bool done = bs.get_u8() == 1;
+    byte flags = bs.get_u8();
+    bool done = (flags & SNP_REQ_DONE);
+    int32 stream_id = 0;
+    int32 num_streams = 1;
+    if (flags & SNP_REQ_STREAM) {
+        stream_id = bs.get_i32();
+        num_streams = bs.get_i32();
+    }
     byte* src = (byte*)bs.data();
     ptr<buffer> b;
     if (bs.pos() < bs.size()) {
@@ -44,18 +59,58 @@ ptr<snapshot_sync_req> snapshot_sync_req::deserialize(buffer_serializer& bs) {
         b = buffer::alloc(0);
     }
 
-    return cs_new<snapshot_sync_req>(snp, offset, b, done);
+    ptr<snapshot_sync_req> req = cs_new<snapshot_sync_req>(snp, offset, b, done);
+    req->set_stream(stream_id, num_streams);
+    return req;
 }
 
 ptr<buffer> snapshot_sync_req::serialize() {
     ptr<buffer> snp_buf = snapshot_->serialize();
-    ptr<buffer> buf = buffer::alloc(snp_buf->size() + sz_ulong + sz_byte + (data_->size() - data_->pos()));
+    bool stream = (num_streams_ > 1);
+    ptr<buffer> buf = buffer::alloc( snp_buf->size() + sz_ulong + sz_byte +
+                                     (stream ? sz_int * 2 : 0) +
+                                     (data_->size() - data_->pos()) );
     buf->put(*snp_buf);
     buf->put(offset_);
-    buf->put(done_ ? (byte)1 : (byte)0);
+    byte flags = done_ ? SNP_REQ_DONE : 0;
+    if (stream) flags |= SNP_REQ_STREAM;
+    buf->put(flags);
+    if (stream) {
+        buf->put(stream_id_);
+        buf->put(num_streams_);
+    }
     buf->put(*data_);
     buf->pos(0);
     return buf;
 }
 
+ptr<buffer> snapshot_sync_req::make_stream_ack(int32 stream_id,
+                                               bool stream_done,
+                                               bool snp_done)
+{
+    ptr<buffer> ctx = buffer::alloc(sz_int + sz_byte);
+    buffer_serializer bs(ctx);
+    bs.put_i32(stream_id);
+    byte flags = 0;
+    if (stream_done) flags |= SNP_ACK_STREAM_DONE;
+    if (snp_done) flags |= SNP_ACK_SNP_DONE;
+    bs.put_u8(flags);
+    return ctx;
+}
+
+bool snapshot_sync_req::parse_stream_ack(buffer& ctx,
+                                         int32& stream_id_out,
+                                         bool& stream_done_out,
+                                         bool& snp_done_out)
+{
+    // Context of non-stream response is a single byte.
+    if (ctx.size() < sz_int + sz_byte) return false;
+    buffer_serializer bs(ctx);
+    stream_id_out = bs.get_i32();
+    byte flags = bs.get_u8();
+    stream_done_out = (flags & SNP_ACK_STREAM_DONE);
+    snp_done_out = (flags & SNP_ACK_SNP_DONE);
+    return true;
+}
+
 } // namespace nuraft;
@@ -19,6 +19,8 @@ limitations under the License.
 
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
 
 namespace nuraft {
@@ -35,18 +37,49 @@ static auto_destroyer auto_destroyer_;
 
 // === stat_elem ==============================================================
 
+template<typename T>
+static T* new_aligned_array(size_t num, void*& mem_out) {
+    size_t size = sizeof(T) * num;
+    size_t space = size + alignof(T);
+    mem_out = ::operator new(space);
+    void* ptr = mem_out;
+    std::align(alignof(T), size, ptr, space);
+    T* arr = static_cast<T*>(ptr);
+    for (size_t ii = 0; ii < num; ++ii) new (arr + ii) T();
+    return arr;
+}
+
+template<typename T>
+static void delete_aligned_array(T* arr, size_t num, void* mem) {
+    if (!arr) return;
+    for (size_t ii = 0; ii < num; ++ii) arr[ii].~T();
+    ::operator delete(mem);
+}
+
 stat_elem::stat_elem(Type _type, const std::string& _name)
     : stat_type_(_type)
     , stat_name_(_name)
-    , counter_(0)
-    , gauge_(0)
-    , hist_( ( _type == HISTOGRAM )
-             ? ( new Histogram() )
-             : nullptr )
-    {}
+    , shards_mem_(nullptr)
+    , shards_( new_aligned_array<shard>(NUM_SHARDS, shards_mem_) )
+    , hist_shards_mem_(nullptr)
+    , hist_shards_(nullptr)
+{
+    if (_type == HISTOGRAM) {
+        hist_shards_ = new_aligned_array<hist_shard>(NUM_SHARDS,
+                                                     hist_shards_mem_);
+    }
+}
 
 stat_elem::~stat_elem() {
-    delete hist_;
+    delete_aligned_array(hist_shards_, NUM_SHARDS, hist_shards_mem_);
+    delete_aligned_array(shards_, NUM_SHARDS, shards_mem_);
+}
+
+void stat_elem::get_histogram(Histogram& histogram_out) const {
+    if (!hist_shards_) return;
+    for (size_t ii = 0; ii < NUM_SHARDS; ++ii) {
+        histogram_out += hist_shards_[ii].hist_;
+    }
 }
 
 
@@ -157,6 +190,138 @@ void stat_mgr::reset_all_stats() {
 }
 
 
+static std::string to_metric_name(const std::string& prefix,
+                                  const std::string& name)
+{
+    std::string ret = prefix + name;
+    for (char& cc: ret) {
+        if ( !( (cc >= 'a' && cc <= 'z') ||
+                (cc >= 'A' && cc <= 'Z') ||
+                (cc >= '0' && cc <= '9') ||
+                cc == '_' || cc == ':' ) ) {
+            cc = '_';
+        }
+    }
+    if (!ret.empty() && ret[0] >= '0' && ret[0] <= '9') ret = "_" + ret;
+    return ret;
+}
+
+void stat_mgr::dump_prometheus(const std::string& prefix,
+                               std::string& text_out)
+{
+    std::vector<stat_elem*> stats;
+    get_all_stats(stats);
+
+    std::stringstream ss;
+    for (stat_elem* elem: stats) {
+        std::string name = to_metric_name(prefix, elem->get_name());
+        switch (elem->get_type()) {
+        case stat_elem::COUNTER:
+            ss << "# TYPE " << name << " counter\n"
+               << name << " " << elem->get_counter() << "\n";
+            break;
+
+        case stat_elem::GAUGE:
+            ss << "# TYPE " << name << " gauge\n"
+               << name << " " << elem->get_gauge() << "\n";
+            break;
+
+        case stat_elem::HISTOGRAM: {
+            Histogram hist;
+            elem->get_histogram(hist);
+
+            // Buckets should be cumulative, in ascending order.
+            std::map<uint64_t, uint64_t> buckets;
+            for (HistItr& entry: hist) {
+                uint64_t cnt = entry.getCount();
+                if (cnt) buckets[entry.getUpperBound()] += cnt;
+            }
+
+            ss << "# TYPE " << name << " histogram\n";
+            uint64_t acc = 0;
+            for (auto& entry: buckets) {
+                if (entry.first == std::numeric_limits<uint64_t>::max()) {
+                    // Will be included in `+Inf`.
+                    continue;
+                }
+                acc += entry.second;
+                ss << name << "_bucket{le=\"" << entry.first << "\"} "
+                   << acc << "\n";
+            }
+            ss << name << "_bucket{le=\"+Inf\"} " << hist.getTotal() << "\n"
+               << name << "_sum " << hist.getSum() << "\n"
+               << name << "_count " << hist.getTotal() << "\n";
+            break; }
+
+        default: break;
+        }
+    }
+    text_out = ss.str();
+}
+
+
+// === repl_latency_tracker ===================================================
+
+repl_latency_tracker::repl_latency_tracker()
+    : quorum_commit_lat_( *stat_mgr::get_instance()->create_stat
+                          ( stat_elem::HISTOGRAM,
+                            "repl_lat_quorum_commit_us" ) )
+    , sm_commit_lat_( *stat_mgr::get_instance()->create_stat
+                      ( stat_elem::HISTOGRAM,
+                        "repl_lat_sm_commit_us" ) )
+    , num_committed_(0)
+    {}
+
+void repl_latency_tracker::on_appended(uint64_t last_idx) {
+#ifndef ENABLE_RAFT_STATS
+    return;
+#endif
+    std::lock_guard<std::mutex> l(lock_);
+    if ( elems_.size() >= MAX_ELEMS ||
+         ( !elems_.empty() && elems_.back().idx_ >= last_idx ) ) {
+        // Logs are overwritten (e.g., by a new leader), or
+        // not committed for a long time.
+        elems_.clear();
+        num_committed_ = 0;
+    }
+    elem ee;
+    ee.idx_ = last_idx;
+    ee.appended_us_ = stat_now_us();
+    ee.committed_us_ = 0;
+    elems_.push_back(ee);
+}
+
+void repl_latency_tracker::on_quorum_commit(uint64_t idx) {
+#ifndef ENABLE_RAFT_STATS
+    return;
+#endif
+    uint64_t now = stat_now_us();
+    std::lock_guard<std::mutex> l(lock_);
+    while ( num_committed_ < elems_.size() &&
+            elems_[num_committed_].idx_ <= idx ) {
+        elem& ee = elems_[num_committed_++];
+        ee.committed_us_ = now;
+        quorum_commit_lat_ += now - ee.appended_us_;
+    }
+}
+
+void repl_latency_tracker::on_sm_commit(uint64_t idx) {
+#ifndef ENABLE_RAFT_STATS
+    return;
+#endif
+    uint64_t now = stat_now_us();
+    std::lock_guard<std::mutex> l(lock_);
+    while (!elems_.empty() && elems_.front().idx_ <= idx) {
+        elem& ee = elems_.front();
+        if (num_committed_) {
+            sm_commit_lat_ += now - ee.committed_us_;
+            num_committed_--;
+        }
+        elems_.pop_front();
+    }
+}
+
+
 // === raft_server ============================================================
 
 uint64_t raft_server::get_stat_counter(const std::string& name) {
@@ -189,7 +354,9 @@ bool raft_server::get_stat_histogram(const std::string& name,
     if (!elem) return false;
     if (elem->get_type() != stat_elem::HISTOGRAM) return false;
 
-    for (HistItr& entry: *elem->get_histogram()) {
+    Histogram hist;
+    elem->get_histogram(hist);
+    for (HistItr& entry: hist) {
         uint64_t cnt = entry.getCount();
         if (cnt) {
             histogram_out.insert( std::make_pair(entry.getUpperBound(), cnt) );
@@ -202,6 +369,12 @@ void raft_server::reset_stat(const std::string& name) {
     stat_mgr::get_instance()->reset_stat(name);
 }
 
+std::string raft_server::get_all_stats_prometheus(const std::string& prefix) {
+    std::string text;
+    stat_mgr::get_instance()->dump_prometheus(prefix, text);
+    return text;
+}
+
 void raft_server::reset_all_stats() {
     stat_mgr::get_instance()->reset_all_stats();
 }
@@ -20,6 +20,8 @@ limitations under the License.
 
 #include <atomic>
 #include <cassert>
+#include <chrono>
+#include <deque>
 #include <map>
 #include <mutex>
 #include <string>
@@ -29,6 +31,15 @@ limitations under the License.
 namespace nuraft {
 
 // NOTE: Accessing a stat_elem instance using multiple threads is safe.
+//
+// Each stat is split into `NUM_SHARDS` shards on separate cache lines,
+// and each thread updates its own shard, so that updating the same stat
+// by multiple threads does not contend on the same cache line.
+// Shards are aggregated on read.
+//
+// `stat_mgr::create_stat` returns the handle (i.e., pointer) of the stat,
+// that should be kept by the caller (e.g., as a static reference) to avoid
+// the lookup by name in the hot path.
 class stat_elem {
 public:
     enum Type {
@@ -37,20 +48,21 @@ public:
         GAUGE = 2,
     };
 
+    static const size_t NUM_SHARDS = 16;
+
     stat_elem(Type _type, const std::string& _name);
 
     ~stat_elem();
 
+    stat_elem(const stat_elem&) = delete;
+    stat_elem& operator=(const stat_elem&) = delete;
+
     inline void inc(size_t amount = 1) {
 #ifndef ENABLE_RAFT_STATS
         return;
 #endif
         assert(stat_type_ != HISTOGRAM);
-        if (stat_type_ == COUNTER) {
-            counter_.fetch_add(amount, std::memory_order_relaxed);
-        } else {
-            gauge_.fetch_add(amount, std::memory_order_relaxed);
-        }
+        my_shard().value_.fetch_add(amount, std::memory_order_relaxed);
     }
 
     inline void dec(size_t amount = 1) {
@@ -58,11 +70,7 @@ public:
         return;
 #endif
         assert(stat_type_ != HISTOGRAM);
-        if (stat_type_ == COUNTER) {
-            counter_.fetch_sub(amount, std::memory_order_relaxed);
-        } else {
-            gauge_.fetch_sub(amount, std::memory_order_relaxed);
-        }
+        my_shard().value_.fetch_sub(amount, std::memory_order_relaxed);
     }
 
     inline void add_value(uint64_t val) {
@@ -70,19 +78,20 @@ public:
         return;
 #endif
         assert(stat_type_ == HISTOGRAM);
-        hist_->add(val);
+        hist_shards_[get_shard_idx()].hist_.add(val);
     }
 
+    // NOTE: Concurrent updates by other threads
+    //       during this call may be lost.
     inline void set(int64_t value) {
 #ifndef ENABLE_RAFT_STATS
         return;
 #endif
         assert(stat_type_ != HISTOGRAM);
-        if (stat_type_ == COUNTER) {
-            counter_.store(value, std::memory_order_relaxed);
-        } else {
-            gauge_.store(value, std::memory_order_relaxed);
+        for (size_t ii = 1; ii < NUM_SHARDS; ++ii) {
+            shards_[ii].value_.store(0, std::memory_order_relaxed);
         }
+        shards_[0].value_.store(value, std::memory_order_relaxed);
     }
 
     stat_elem& operator+=(size_t amount) {
@@ -132,11 +141,16 @@ public:
 
     Type get_type() const { return stat_type_; }
 
-    uint64_t get_counter() const { return counter_; }
+    uint64_t get_counter() const { return (uint64_t)sum_shards(); }
 
-    int64_t get_gauge() const { return gauge_; }
+    int64_t get_gauge() const { return sum_shards(); }
 
-    Histogram* get_histogram() const { return hist_; }
+    /**
+     * Get the histogram merged from all shards.
+     *
+     * @param[out] histogram_out Merged histogram.
+     */
+    void get_histogram(Histogram& histogram_out) const;
 
     void reset() {
         switch (stat_type_) {
@@ -146,18 +160,52 @@ public:
             break;
         case HISTOGRAM: {
             Histogram empty_histogram;
-            *hist_ = empty_histogram;
+            for (size_t ii = 0; ii < NUM_SHARDS; ++ii) {
+                hist_shards_[ii].hist_ = empty_histogram;
+            }
             break; }
         default: break;
         }
     }
 
 private:
+    // Aligned (and hence padded) to occupy its own cache line.
+    struct alignas(64) shard {
+        shard() : value_(0) {}
+        std::atomic<int64_t> value_;
+    };
+
+    struct alignas(64) hist_shard {
+        Histogram hist_;
+    };
+
+    // Shard index of the current thread, assigned in a round-robin manner.
+    static size_t get_shard_idx() {
+        static std::atomic<size_t> next_idx(0);
+        static thread_local size_t my_idx =
+            next_idx.fetch_add(1, std::memory_order_relaxed) % NUM_SHARDS;
+        return my_idx;
+    }
+
+    shard& my_shard() { return shards_[get_shard_idx()]; }
+
+    int64_t sum_shards() const {
+        int64_t sum = 0;
+        for (size_t ii = 0; ii < NUM_SHARDS; ++ii) {
+            sum += shards_[ii].value_.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
     Type stat_type_;
     std::string stat_name_;
-    std::atomic<uint64_t> counter_;
-    std::atomic<int64_t> gauge_;
-    Histogram* hist_;
+
+    // `new` does not guarantee the alignment of the shards (before
+    // C++17), they are placed in the aligned part of the raw memory.
+    void* shards_mem_;
+    shard* shards_;
+    void* hist_shards_mem_;
+    hist_shard* hist_shards_;
 };
 
 // Singleton class
@@ -179,6 +227,16 @@ public:
 
     void reset_all_stats();
 
+    /**
+     * Dump all stats in Prometheus text exposition format.
+     * Stat names are prefixed by the given prefix, and characters
+     * not allowed in metric names are replaced with `_`.
+     *
+     * @param prefix Prefix of metric names.
+     * @param[out] text_out Dumped text.
+     */
+    void dump_prometheus(const std::string& prefix, std::string& text_out);
+
 private:
     static std::mutex instance_lock_;
     static std::atomic<stat_mgr*> instance_;
@@ -190,5 +248,52 @@ private:
     std::map<std::string, stat_elem*> stat_map_;
 };
 
+// Current time in microseconds since an arbitrary point,
+// for measuring latency of stats. Returns 0 without reading the clock
+// if stats are not enabled, so only for stats.
+inline uint64_t stat_now_us() {
+#ifndef ENABLE_RAFT_STATS
+    return 0;
+#endif
+    return std::chrono::duration_cast<std::chrono::microseconds>
+           ( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+// Latency of each phase after logs are appended by the leader:
+//   appended -> quorum commit -> state machine commit.
+// Does nothing if stats are not enabled.
+class repl_latency_tracker {
+public:
+    repl_latency_tracker();
+
+    // Logs up to `last_idx` are appended.
+    void on_appended(uint64_t last_idx);
+
+    // Logs up to `idx` are committed by quorum.
+    void on_quorum_commit(uint64_t idx);
+
+    // Logs up to `idx` are committed to the state machine.
+    void on_sm_commit(uint64_t idx);
+
+private:
+    struct elem {
+        uint64_t idx_;
+        uint64_t appended_us_;
+        uint64_t committed_us_;
+    };
+
+    // Not to grow indefinitely if logs are never committed.
+    static const size_t MAX_ELEMS = 65536;
+
+    stat_elem& quorum_commit_lat_;
+    stat_elem& sm_commit_lat_;
+
+    std::mutex lock_;
+    // In index order, the first `num_committed_` elems
+    // are committed by quorum.
+    std::deque<elem> elems_;
+    size_t num_committed_;
+};
+
 } // namespace nuraft
 
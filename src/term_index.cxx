@@ -0,0 +1,123 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "term_index.hxx"
+
+#include "log_store.hxx"
+
+#include <algorithm>
+
+namespace nuraft {
+
+term_index::term_index()
+    : start_idx_(0)
+    , last_idx_(0)
+    {}
+
+void term_index::rebuild(log_store& store) {
+    std::lock_guard<std::mutex> l(lock_);
+    clear_nolock();
+
+    ulong start = store.start_index();
+    ulong last = store.next_slot() - 1;
+    ulong cur = start;
+    while (cur <= last) {
+        ulong term = store.term_at(cur);
+        runs_.push_back( std::make_pair(cur, term) );
+
+        // Find the last log of this term.
+        ulong lo = cur, hi = last;
+        while (lo < hi) {
+            ulong mid = lo + (hi - lo + 1) / 2;
+            if (store.term_at(mid) == term) {
+                lo = mid;
+            } else {
+                hi = mid - 1;
+            }
+        }
+        cur = lo + 1;
+    }
+    if (!runs_.empty()) {
+        start_idx_ = start;
+        last_idx_ = last;
+    }
+}
+
+void term_index::append(ulong idx, ulong term) {
+    std::lock_guard<std::mutex> l(lock_);
+    if (!runs_.empty()) {
+        if (idx <= start_idx_ || idx > last_idx_ + 1) {
+            // Overwriting everything, or not contiguous.
+            clear_nolock();
+        } else if (idx <= last_idx_) {
+            // Overwrite, drop runs starting at `idx` or later.
+            while (runs_.back().first >= idx) runs_.pop_back();
+            last_idx_ = idx - 1;
+        }
+    }
+
+    if (runs_.empty()) {
+        start_idx_ = idx;
+    }
+    if (runs_.empty() || runs_.back().second != term) {
+        runs_.push_back( std::make_pair(idx, term) );
+    }
+    last_idx_ = idx;
+}
+
+void term_index::compact(ulong upto) {
+    std::lock_guard<std::mutex> l(lock_);
+    if (runs_.empty() || upto < start_idx_) return;
+    if (upto >= last_idx_) {
+        clear_nolock();
+        return;
+    }
+
+    start_idx_ = upto + 1;
+    while (runs_.size() > 1 && runs_[1].first <= start_idx_) {
+        runs_.pop_front();
+    }
+    runs_.front().first = start_idx_;
+}
+
+void term_index::clear() {
+    std::lock_guard<std::mutex> l(lock_);
+    clear_nolock();
+}
+
+bool term_index::find(ulong idx, ulong& term_out) {
+    std::lock_guard<std::mutex> l(lock_);
+    if (runs_.empty() || idx < start_idx_ || idx > last_idx_) return false;
+
+    // The last run starting at or before `idx`.
+    auto entry = std::upper_bound
+                 ( runs_.begin(), runs_.end(), idx,
+                   []( ulong ii, const std::pair<ulong, ulong>& rr ) {
+                       return ii < rr.first;
+                   } );
+    --entry;
+    term_out = entry->second;
+    return true;
+}
+
+void term_index::clear_nolock() {
+    runs_.clear();
+    start_idx_ = last_idx_ = 0;
+}
+
+}
+
@@ -0,0 +1,94 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include "basic_types.hxx"
+#include "pp_util.hxx"
+
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace nuraft {
+
+class log_store;
+
+/**
+ * Run-length index of the term of each log in the log store,
+ * so that the term of a log can be found without reading
+ * the log store.
+ *
+ * It covers a contiguous range of log indexes, and keeps one
+ * (start index, term) pair for each run of logs with the same term.
+ * If a log is not covered (e.g., written in a way the index is not
+ * aware of), the caller should read the log store instead.
+ */
+class term_index {
+public:
+    term_index();
+
+    __nocopy__(term_index);
+
+public:
+    /**
+     * Rebuild the index from the given log store. As terms never
+     * decrease, it finds the boundaries of terms by binary search.
+     */
+    void rebuild(log_store& store);
+
+    /**
+     * Called when a log is appended at `idx`. If `idx` is in the
+     * middle of the range, the logs from `idx` are overwritten.
+     */
+    void append(ulong idx, ulong term);
+
+    /**
+     * Called when logs up to `upto` (inclusive) are compacted.
+     */
+    void compact(ulong upto);
+
+    /**
+     * Forget everything.
+     */
+    void clear();
+
+    /**
+     * Find the term of the log at `idx`.
+     *
+     * @param idx Log index.
+     * @param[out] term_out Term of the log.
+     * @return `false` if the log is not covered by the index.
+     */
+    bool find(ulong idx, ulong& term_out);
+
+private:
+    void clear_nolock();
+
+    std::mutex lock_;
+
+    // <start index of a run, term>, in ascending order of index.
+    std::deque< std::pair<ulong, ulong> > runs_;
+
+    // Covered range: [start_idx_, last_idx_].
+    // Empty if `runs_` is empty.
+    ulong start_idx_;
+    ulong last_idx_;
+};
+
+}
+
@@ -0,0 +1,187 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "timer_wheel.hxx"
+
+#include <cassert>
+
+namespace nuraft {
+
+// 4 levels of 64 slots, 2^24 ticks in total.
+static const size_t LEVEL_BITS = 6;
+static const size_t SLOTS = (size_t)1 << LEVEL_BITS;
+static const size_t SLOT_MASK = SLOTS - 1;
+static const size_t LEVELS = 4;
+static const uint64_t MAX_TICKS = (uint64_t)1 << (LEVEL_BITS * LEVELS);
+
+// Node of the doubly linked list in each slot,
+// attached to `delayed_task` as its impl context.
+struct timer_wheel::entry {
+    entry() : prev_(this), next_(this), expiry_(0) {}
+
+    bool linked() const { return next_ != this; }
+
+    entry* prev_;
+    entry* next_;
+    uint64_t expiry_;
+    // Hold the task while it is in the wheel.
+    ptr<delayed_task> task_;
+};
+
+timer_wheel::timer_wheel(size_t tick_ms)
+    : tick_ms_(tick_ms ? tick_ms : 1)
+    , cur_tick_(0)
+    , num_tasks_(0)
+{
+    slots_.resize(LEVELS * SLOTS);
+    for (entry*& ee: slots_) ee = new entry();
+}
+
+timer_wheel::~timer_wheel() {
+    std::vector< ptr<delayed_task> > tasks;
+    {   std::lock_guard<std::mutex> l(lock_);
+        for (entry* head: slots_) {
+            while (head->linked()) {
+                entry* ee = head->next_;
+                tasks.push_back(ee->task_);
+                ee->task_.reset();
+                unlink(ee);
+            }
+            delete head;
+        }
+        slots_.clear();
+    }
+    // Tasks (and their entries) can be freed here, outside the lock.
+}
+
+void timer_wheel::free_entry(void* ptr) {
+    entry* ee = static_cast<entry*>(ptr);
+    assert(!ee->linked());
+    delete ee;
+}
+
+void timer_wheel::schedule(ptr<delayed_task>& task, int32 milliseconds) {
+    uint64_t ticks = milliseconds > 0
+                     ? ( (uint64_t)milliseconds + tick_ms_ - 1 ) / tick_ms_
+                     : 0;
+    // Next `advance()` can happen at any moment in the current tick,
+    // so add one more tick not to expire earlier than the given time.
+    ticks++;
+    if (ticks >= MAX_TICKS) ticks = MAX_TICKS - 1;
+
+    std::lock_guard<std::mutex> l(lock_);
+    entry* ee = static_cast<entry*>(task->get_impl_context());
+    if (!ee) {
+        ee = new entry();
+        task->set_impl_context(ee, &timer_wheel::free_entry);
+    }
+    // ensure it's not in cancelled state
+    task->reset();
+
+    if (ee->linked()) {
+        unlink(ee);
+    } else {
+        ee->task_ = task;
+        num_tasks_++;
+    }
+    ee->expiry_ = cur_tick_ + ticks - 1;
+    link(ee);
+}
+
+void timer_wheel::cancel(ptr<delayed_task>& task) {
+    std::lock_guard<std::mutex> l(lock_);
+    entry* ee = static_cast<entry*>(task->get_impl_context());
+    if (!ee || !ee->linked()) return;
+
+    unlink(ee);
+    // `task` is still referenced by the caller.
+    ee->task_.reset();
+    num_tasks_--;
+}
+
+void timer_wheel::advance(std::vector< ptr<delayed_task> >& expired_out) {
+    std::lock_guard<std::mutex> l(lock_);
+    size_t idx = cur_tick_ & SLOT_MASK;
+    if (idx == 0) {
+        // Bring tasks in the upper level down, as long as
+        // the lower level wraps around.
+        for (size_t lv = 1; lv < LEVELS; ++lv) {
+            size_t lv_idx = (cur_tick_ >> (LEVEL_BITS * lv)) & SLOT_MASK;
+            cascade(lv, lv_idx);
+            if (lv_idx) break;
+        }
+    }
+
+    entry* head = slots_[idx];
+    while (head->linked()) {
+        entry* ee = head->next_;
+        assert(ee->expiry_ == cur_tick_);
+        unlink(ee);
+        expired_out.push_back(ee->task_);
+        ee->task_.reset();
+        num_tasks_--;
+    }
+    cur_tick_++;
+}
+
+size_t timer_wheel::get_num_tasks() {
+    std::lock_guard<std::mutex> l(lock_);
+    return num_tasks_;
+}
+
+void timer_wheel::link(entry* ee) {
+    uint64_t delta = ee->expiry_ - cur_tick_;
+    size_t lv = 0;
+    while ( lv < LEVELS - 1 &&
+            delta >= ( (uint64_t)1 << (LEVEL_BITS * (lv + 1)) ) ) {
+        lv++;
+    }
+    size_t idx = (ee->expiry_ >> (LEVEL_BITS * lv)) & SLOT_MASK;
+
+    entry* head = slots_[lv * SLOTS + idx];
+    ee->prev_ = head->prev_;
+    ee->next_ = head;
+    head->prev_->next_ = ee;
+    head->prev_ = ee;
+}
+
+void timer_wheel::unlink(entry* ee) {
+    ee->prev_->next_ = ee->next_;
+    ee->next_->prev_ = ee->prev_;
+    ee->prev_ = ee->next_ = ee;
+}
+
+void timer_wheel::cascade(size_t level, size_t slot) {
+    entry* head = slots_[level * SLOTS + slot];
+    // Detach the whole list first, as re-linking may put
+    // an entry back to the same slot.
+    entry list;
+    if (!head->linked()) return;
+    list.next_ = head->next_;
+    list.prev_ = head->prev_;
+    list.next_->prev_ = &list;
+    list.prev_->next_ = &list;
+    head->prev_ = head->next_ = head;
+
+    while (list.linked()) {
+        entry* ee = list.next_;
+        unlink(ee);
+        link(ee);
+    }
+}
+
+}
@@ -0,0 +1,103 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include "delayed_task.hxx"
+#include "ptr.hxx"
+
+#include <mutex>
+#include <vector>
+
+namespace nuraft {
+
+/**
+ * Hierarchical timer wheel for `delayed_task`.
+ *
+ * Both scheduling and cancelling a task are O(1), and the per-task
+ * entry is allocated only once (as the impl context of the task),
+ * so that re-scheduling the same task does not allocate memory.
+ *
+ * The wheel does not have its own clock: `advance()` should be
+ * called every `tick_ms` by the caller. Tasks whose timeout is
+ * longer than the range of the wheel (2^24 ticks) are clamped.
+ */
+class timer_wheel {
+public:
+    timer_wheel(size_t tick_ms);
+
+    ~timer_wheel();
+
+    __nocopy__(timer_wheel);
+
+public:
+    /**
+     * Schedule the given task, or re-schedule it if it is already
+     * scheduled. It will expire after at least the given time.
+     *
+     * @param task Task to schedule.
+     * @param milliseconds Timeout in milliseconds.
+     */
+    void schedule(ptr<delayed_task>& task, int32 milliseconds);
+
+    /**
+     * Remove the given task from the wheel, if it is scheduled.
+     *
+     * @param task Task to cancel.
+     */
+    void cancel(ptr<delayed_task>& task);
+
+    /**
+     * Advance the wheel by one tick.
+     *
+     * @param[out] expired_out Tasks expired at this tick.
+     *                         Caller is responsible for executing them.
+     */
+    void advance(std::vector< ptr<delayed_task> >& expired_out);
+
+    /**
+     * Get the number of tasks currently scheduled.
+     */
+    size_t get_num_tasks();
+
+    size_t get_tick_ms() const { return tick_ms_; }
+
+private:
+    struct entry;
+
+    static void free_entry(void* ptr);
+
+    void link(entry* e);
+
+    void unlink(entry* e);
+
+    void cascade(size_t level, size_t slot);
+
+    size_t tick_ms_;
+
+    // Next tick to be processed by `advance()`.
+    uint64_t cur_tick_;
+
+    size_t num_tasks_;
+
+    // Sentinels of each slot, `LEVELS * SLOTS`.
+    std::vector<entry*> slots_;
+
+    std::mutex lock_;
+};
+
+}
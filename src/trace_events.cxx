@@ -0,0 +1,267 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "trace_events.hxx"
+
+#include "ptr.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+namespace nuraft {
+
+std::atomic<bool> trace_events::enabled_(false);
+
+// Events recorded before this time are discarded by `clear()`.
+static std::atomic<uint64_t> cleared_ns(0);
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>
+           ( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+// Magic number of the binary file: "NRTRACE1".
+static const uint64_t TRACE_FILE_MAGIC = 0x314543415254524e;
+
+// Ring of a thread, written only by the owner thread.
+struct trace_ring {
+    trace_ring(uint32_t thread_id)
+        : thread_id_(thread_id)
+        , num_written_(0)
+        , events_(trace_events::RING_SIZE)
+        {}
+
+    uint32_t thread_id_;
+    // Total number of events written so far,
+    // the next slot is `num_written_ % RING_SIZE`.
+    std::atomic<uint64_t> num_written_;
+    std::vector<trace_event> events_;
+};
+
+struct trace_ring_registry {
+    trace_ring_registry() : next_thread_id_(0) {}
+
+    std::mutex lock_;
+    // Rings of the running threads.
+    std::vector< ptr<trace_ring> > rings_;
+    // Latest `RING_SIZE` events of the exited threads, so that they
+    // are available without keeping the rings of those threads.
+    std::deque<trace_event> retired_;
+    uint32_t next_thread_id_;
+};
+
+static trace_ring_registry& get_registry() {
+    static trace_ring_registry* registry = new trace_ring_registry();
+    return *registry;
+}
+
+// Unregisters the ring of the thread when it exits. The ring is freed
+// once `dump` is not reading it.
+struct trace_ring_holder {
+    trace_ring_holder() : ring_(nullptr) {}
+
+    ~trace_ring_holder() {
+        if (!ring_) return;
+        trace_ring_registry& reg = get_registry();
+        std::lock_guard<std::mutex> l(reg.lock_);
+        auto itr = std::find_if( reg.rings_.begin(),
+                                 reg.rings_.end(),
+                                 [this](const ptr<trace_ring>& rr) {
+                                     return rr.get() == ring_;
+                                 } );
+        if (itr == reg.rings_.end()) return;
+
+        // No one else writes to the ring, all events are valid.
+        const size_t RING_SIZE = trace_events::RING_SIZE;
+        uint64_t end = ring_->num_written_.load(std::memory_order_relaxed);
+        uint64_t begin = (end > RING_SIZE) ? (end - RING_SIZE) : 0;
+        for (uint64_t ii = begin; ii < end; ++ii) {
+            reg.retired_.push_back( ring_->events_[ii % RING_SIZE] );
+        }
+        while (reg.retired_.size() > RING_SIZE) reg.retired_.pop_front();
+        reg.rings_.erase(itr);
+    }
+
+    trace_ring* ring_;
+};
+
+static trace_ring* get_my_ring() {
+    static thread_local trace_ring_holder holder;
+    if (!holder.ring_) {
+        trace_ring_registry& reg = get_registry();
+        std::lock_guard<std::mutex> l(reg.lock_);
+        ptr<trace_ring> ring = cs_new<trace_ring>(reg.next_thread_id_++);
+        reg.rings_.push_back(ring);
+        holder.ring_ = ring.get();
+    }
+    return holder.ring_;
+}
+
+void trace_events::record(uint16_t event_id,
+                          int32 srv_id,
+                          uint64_t log_idx,
+                          int32 peer_id,
+                          uint64_t term)
+{
+    trace_ring* ring = get_my_ring();
+    uint64_t seq = ring->num_written_.load(std::memory_order_relaxed);
+    trace_event& ee = ring->events_[seq % RING_SIZE];
+    ee.ts_ns_ = now_ns();
+    ee.log_idx_ = log_idx;
+    ee.term_ = term;
+    ee.srv_id_ = srv_id;
+    ee.peer_id_ = peer_id;
+    ee.thread_id_ = ring->thread_id_;
+    ee.event_id_ = event_id;
+    ee.reserved_ = 0;
+    ring->num_written_.store(seq + 1, std::memory_order_release);
+}
+
+void trace_events::dump(std::vector<trace_event>& events_out,
+                        uint64_t since_ns)
+{
+    std::vector< ptr<trace_ring> > rings;
+    events_out.clear();
+    {   trace_ring_registry& reg = get_registry();
+        std::lock_guard<std::mutex> l(reg.lock_);
+        rings = reg.rings_;
+        events_out.assign(reg.retired_.begin(), reg.retired_.end());
+    }
+
+    for (ptr<trace_ring>& ring: rings) {
+        uint64_t end = ring->num_written_.load(std::memory_order_acquire);
+        uint64_t begin = (end > RING_SIZE) ? (end - RING_SIZE) : 0;
+        size_t num_prev = events_out.size();
+        for (uint64_t ii = begin; ii < end; ++ii) {
+            events_out.push_back( ring->events_[ii % RING_SIZE] );
+        }
+
+        // The owner thread may have overwritten the oldest events
+        // (or be overwriting the next one) while copying them,
+        // discard them.
+        uint64_t new_end = ring->num_written_.load(std::memory_order_acquire);
+        if (new_end + 1 > begin + RING_SIZE) {
+            size_t num_dirty = std::min<uint64_t>
+                               ( new_end + 1 - begin - RING_SIZE,
+                                 end - begin );
+            events_out.erase( events_out.begin() + num_prev,
+                              events_out.begin() + num_prev + num_dirty );
+        }
+    }
+
+    since_ns = std::max(since_ns, cleared_ns.load());
+    events_out.erase( std::remove_if( events_out.begin(),
+                                      events_out.end(),
+                                      [since_ns](const trace_event& ee) {
+                                          return ee.ts_ns_ <= since_ns;
+                                      } ),
+                      events_out.end() );
+    std::stable_sort( events_out.begin(),
+                      events_out.end(),
+                      [](const trace_event& ll, const trace_event& rr) {
+                          return ll.ts_ns_ < rr.ts_ns_;
+                      } );
+}
+
+void trace_events::clear() {
+    cleared_ns.store( now_ns() );
+}
+
+bool trace_events::save(const std::string& path,
+                        const std::vector<trace_event>& events)
+{
+    std::ofstream fs(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!fs.good()) return false;
+
+    uint64_t header[2] = { TRACE_FILE_MAGIC, (uint64_t)events.size() };
+    fs.write(reinterpret_cast<const char*>(header), sizeof(header));
+    if (!events.empty()) {
+        fs.write( reinterpret_cast<const char*>(events.data()),
+                  sizeof(trace_event) * events.size() );
+    }
+    return fs.good();
+}
+
+bool trace_events::load(const std::string& path,
+                        std::vector<trace_event>& events_out)
+{
+    std::ifstream fs(path, std::ios::in | std::ios::binary);
+    if (!fs.good()) return false;
+
+    uint64_t header[2] = {0, 0};
+    fs.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!fs.good() || header[0] != TRACE_FILE_MAGIC) return false;
+
+    events_out.resize(header[1]);
+    if (!events_out.empty()) {
+        fs.read( reinterpret_cast<char*>(events_out.data()),
+                 sizeof(trace_event) * events_out.size() );
+    }
+    return fs.good();
+}
+
+std::string trace_events::to_chrome_trace
+            (const std::vector<trace_event>& events)
+{
+    std::stringstream ss;
+    ss << "{\"traceEvents\":[";
+    bool first = true;
+    for (const trace_event& ee: events) {
+        if (!first) ss << ",";
+        first = false;
+
+        char ts_buf[32];
+        snprintf( ts_buf, sizeof(ts_buf), "%llu.%03llu",
+                  (unsigned long long)(ee.ts_ns_ / 1000),
+                  (unsigned long long)(ee.ts_ns_ % 1000) );
+        ss << "\n{\"name\":\"" << event_name(ee.event_id_) << "\""
+           << ",\"ph\":\"i\",\"s\":\"t\""
+           << ",\"ts\":" << ts_buf
+           << ",\"pid\":" << ee.srv_id_
+           << ",\"tid\":" << ee.thread_id_
+           << ",\"args\":{\"log_idx\":" << ee.log_idx_
+           << ",\"term\":" << ee.term_
+           << ",\"peer\":" << ee.peer_id_ << "}}";
+    }
+    ss << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    return ss.str();
+}
+
+const char* trace_events::event_name(uint16_t event_id) {
+    switch (event_id) {
+    case TE_APPEND_REQ_SEND:    return "append_req_send";
+    case TE_APPEND_RESP_RECV:   return "append_resp_recv";
+    case TE_APPEND_REQ_RECV:    return "append_req_recv";
+    case TE_LOG_APPEND:         return "log_append";
+    case TE_COMMIT_QUORUM:      return "commit_quorum";
+    case TE_COMMIT_SM:          return "commit_sm";
+    case TE_ELECTION_START:     return "election_start";
+    case TE_VOTE_GRANTED:       return "vote_granted";
+    case TE_BECOME_LEADER:      return "become_leader";
+    case TE_BECOME_FOLLOWER:    return "become_follower";
+    default:                    return "unknown";
+    }
+}
+
+}
+
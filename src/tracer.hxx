@@ -18,6 +18,7 @@ limitations under the License.
 #pragma once
 
 #include "logger.hxx"
+#include "trace_events.hxx"
 
 #include <string>
 
@@ -91,3 +92,11 @@ static inline std::string msg_if_given
     if (l_ && l_->get_level() >= 1) \
         l_->put_details(1, __FILE__, __func__, __LINE__, msg_if_given(__VA_ARGS__))
 
+// binary trace event, recorded by server `id_`.
+#ifdef NO_RAFT_TRACE_EVENTS
+#define p_ev(event_id, log_idx, peer_id, term)
+#else
+#define p_ev(event_id, log_idx, peer_id, term) \
+    if (nuraft::trace_events::is_enabled()) \
+        nuraft::trace_events::record((event_id), id_, (log_idx), (peer_id), (term))
+#endif
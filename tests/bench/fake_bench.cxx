@@ -0,0 +1,734 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "fake_network.hxx"
+#include "raft_package_fake.hxx"
+
+#include "test_common.h"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <thread>
+
+#include <stdio.h>
+
+using namespace nuraft;
+using namespace raft_functional_common;
+
+namespace fake_bench {
+
+using raft_result = cmd_result< ptr<buffer> >;
+
+struct bench_config {
+    bench_config()
+        : num_servers_(3)
+        , payload_size_(256)
+        , batch_size_(1)
+        , num_rounds_(1000)
+        , num_ops_(20)
+        , snapshot_logs_(100)
+        , log_level_(2)
+        , output_("./fake_bench_results.jsonl")
+        , rtt_profile_("all")
+        , inflight_(16)
+        , loss_rate_(0)
+        {}
+
+    // Number of servers in the cluster.
+    size_t num_servers_;
+    // Size of each log payload.
+    size_t payload_size_;
+    // Number of logs in an `append_entries` call.
+    size_t batch_size_;
+    // Number of `append_entries` calls in append benchmark.
+    size_t num_rounds_;
+    // Number of elections, snapshot installs, or config changes
+    // in each benchmark.
+    size_t num_ops_;
+    // Number of logs to be included in the snapshot
+    // of snapshot benchmark.
+    size_t snapshot_logs_;
+    // Log level of Raft servers.
+    int log_level_;
+    // Result file, each line is a JSON object.
+    std::string output_;
+    // Link profile of WAN benchmark: `lan`, `az`, `region`, or `all`.
+    std::string rtt_profile_;
+    // Max number of uncommitted `append_entries` calls
+    // in WAN benchmark.
+    size_t inflight_;
+    // Request loss rate of links in WAN benchmark.
+    double loss_rate_;
+};
+
+// Maximum time to wait for a condition in `pump`.
+static const size_t MAX_WAIT_MS = 10000;
+
+// Invoke heartbeat timer of leaders every this number of loops in `pump`.
+static const size_t HB_LOOPS = 16;
+
+// Heartbeat interval and election timeout on the virtual clock,
+// the same as the default `raft_params`.
+static const uint64_t VIRTUAL_HB_US = 125 * 1000;
+static const uint64_t VIRTUAL_ELECTION_TIMEOUT_US = 250 * 1000;
+
+// Number of idle loops in `pump_virtual` to wait for
+// background threads before moving the virtual clock.
+static const size_t IDLE_LOOPS = 64;
+
+static int next_srv_id = 1;
+
+static raft_params get_bench_params(bool snapshot) {
+    raft_params params;
+    params.with_election_timeout_lower(0);
+    params.with_election_timeout_upper(10000);
+    params.with_hb_interval(5000);
+    params.with_client_req_timeout(1000000);
+    params.with_reserved_log_items(0);
+    params.with_snapshot_enabled(snapshot ? 5 : 0);
+    params.with_log_sync_stopping_gap(1);
+    params.return_method_ = raft_params::async_handler;
+    return params;
+}
+
+class cluster {
+public:
+    cluster(const bench_config& config, bool snapshot)
+        : config_(config)
+        , params_( get_bench_params(snapshot) )
+        , f_base_( cs_new<FakeNetworkBase>() )
+        , last_hb_us_(0)
+    {
+        f_base_->getLogger()->setLogLevel(config_.log_level_);
+    }
+
+    ~cluster() {
+        for (RaftPkg* pp: members_) pp->raftServer->shutdown();
+        f_base_->destroy();
+    }
+
+    // Launch a new server, not joined the cluster yet.
+    RaftPkg* launch() {
+        int srv_id = next_srv_id++;
+        std::unique_ptr<RaftPkg> pkg
+            ( new RaftPkg(f_base_, srv_id, "S" + std::to_string(srv_id)) );
+        RaftPkg* pp = pkg.get();
+        launch_servers({pp}, &params_);
+        pp->myLogWrapper->set_level(config_.log_level_);
+        pkgs_.push_back(std::move(pkg));
+        return pp;
+    }
+
+    // Deliver messages sent by the given servers (all members
+    // if not given) until `cond` becomes true.
+    bool pump(const std::function<bool()>& cond,
+              bool send_hb = true,
+              const std::vector<RaftPkg*>* senders = nullptr)
+    {
+        if (!senders) senders = &members_;
+        TestSuite::Timer timer(MAX_WAIT_MS);
+        size_t num_loops = 0;
+        while (!cond()) {
+            if (timer.timeout()) return false;
+            for (RaftPkg* pp: *senders) pp->fNet->execReqResp();
+            if (send_hb && ++num_loops % HB_LOOPS == 0) {
+                for (RaftPkg* pp: *senders) {
+                    if (!pp->raftServer->is_leader()) continue;
+                    pp->fTimer->invoke( timer_task_type::heartbeat_timer );
+                }
+            }
+            // Commit is done by the background thread.
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    // Same as `pump`, but messages are delivered when they arrive
+    // on the virtual clock, and the clock jumps to the next arrival
+    // (or heartbeat) if there is nothing to do.
+    bool pump_virtual(const std::function<bool()>& cond,
+                      const std::vector<RaftPkg*>* senders = nullptr)
+    {
+        if (!senders) senders = &members_;
+        TestSuite::Timer timer(MAX_WAIT_MS);
+        size_t idle_loops = 0;
+        while (!cond()) {
+            if (timer.timeout()) return false;
+            bool processed = false;
+            for (RaftPkg* pp: *senders) {
+                if (pp->fNet->execDue()) processed = true;
+            }
+            if (processed) {
+                idle_loops = 0;
+                continue;
+            }
+
+            uint64_t next_us = std::numeric_limits<uint64_t>::max();
+            for (RaftPkg* pp: *senders) {
+                next_us = std::min(next_us, pp->fNet->getNextEventUs());
+            }
+            if ( next_us == std::numeric_limits<uint64_t>::max() &&
+                 ++idle_loops < IDLE_LOOPS ) {
+                // Commit may be in progress in the background thread.
+                std::this_thread::yield();
+                continue;
+            }
+
+            uint64_t hb_us = last_hb_us_ + VIRTUAL_HB_US;
+            if (next_us <= hb_us) {
+                f_base_->advanceClockTo(next_us);
+                continue;
+            }
+            f_base_->advanceClockTo(hb_us);
+            last_hb_us_ = std::max(hb_us, f_base_->getClockUs());
+            for (RaftPkg* pp: *senders) {
+                if (!pp->raftServer->is_leader()) continue;
+                pp->fTimer->invoke( timer_task_type::heartbeat_timer );
+            }
+            idle_loops = 0;
+        }
+        return true;
+    }
+
+    RaftPkg* leader() const {
+        for (RaftPkg* pp: members_) {
+            if (pp->raftServer->is_leader()) return pp;
+        }
+        return nullptr;
+    }
+
+    // All members committed all logs of the leader.
+    bool synced() const {
+        RaftPkg* ll = leader();
+        if (!ll) return false;
+        ulong last_idx = ll->raftServer->get_last_log_idx();
+        for (RaftPkg* pp: members_) {
+            if (pp->raftServer->get_committed_log_idx() != last_idx) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int add(RaftPkg* pp) {
+        if (members_.empty()) {
+            // The first server is the leader of itself.
+            members_.push_back(pp);
+            CHK_TRUE( pump( [pp]() { return pp->raftServer->is_leader(); } ) );
+            return 0;
+        }
+
+        RaftPkg* ll = leader();
+        CHK_NONNULL( ll );
+        ptr<srv_config> conf = pp->getTestMgr()->get_srv_config();
+        // Previous config change may not be done yet, retry.
+        CHK_TRUE( pump( [ll, conf]() {
+            return ll->raftServer->add_srv(*conf)->get_accepted();
+        } ) );
+
+        members_.push_back(pp);
+        int srv_id = pp->myId;
+        CHK_TRUE( pump( [this, ll, srv_id]() {
+            return ll->raftServer->get_srv_config(srv_id) && synced();
+        } ) );
+        return 0;
+    }
+
+    int remove(RaftPkg* pp) {
+        RaftPkg* ll = leader();
+        CHK_NONNULL( ll );
+        int srv_id = pp->myId;
+        CHK_TRUE( pump( [ll, srv_id]() {
+            return ll->raftServer->remove_srv(srv_id)->get_accepted();
+        } ) );
+        // Removed server may not see the commit of its removal.
+        members_.erase( std::find(members_.begin(), members_.end(), pp) );
+        CHK_TRUE( pump( [this, ll, srv_id]() {
+            return !ll->raftServer->get_srv_config(srv_id) && synced();
+        } ) );
+
+        pp->raftServer->shutdown();
+        pp->free();
+        return 0;
+    }
+
+    int form(size_t num_servers) {
+        for (size_t ii = 0; ii < num_servers; ++ii) {
+            CHK_Z( add( launch() ) );
+        }
+        return 0;
+    }
+
+    const std::vector<RaftPkg*>& members() const { return members_; }
+
+    FakeNetworkBase* base() const { return f_base_.get(); }
+
+private:
+    const bench_config& config_;
+    raft_params params_;
+    ptr<FakeNetworkBase> f_base_;
+    std::vector< std::unique_ptr<RaftPkg> > pkgs_;
+    std::vector<RaftPkg*> members_;
+    uint64_t last_hb_us_;
+};
+
+static uint64_t get_percentile(const std::vector<uint64_t>& sorted_lat,
+                               double percentile)
+{
+    if (sorted_lat.empty()) return 0;
+    size_t idx = (size_t)(sorted_lat.size() * percentile / 100);
+    if (idx >= sorted_lat.size()) idx = sorted_lat.size() - 1;
+    return sorted_lat[idx];
+}
+
+// Print the result, and append it to the result file as a JSON line.
+// If `elapsed_us` is given, it is used as the total time
+// instead of the sum of latencies (i.e., rounds were overlapped).
+static void report(const bench_config& config,
+                   const std::string& name,
+                   size_t ops_per_round,
+                   std::vector<uint64_t> lat,
+                   uint64_t elapsed_us = 0)
+{
+    std::sort(lat.begin(), lat.end());
+    uint64_t total_us = 0;
+    for (uint64_t ll: lat) total_us += ll;
+    if (elapsed_us) total_us = elapsed_us;
+    uint64_t num_ops = lat.size() * ops_per_round;
+    uint64_t ops_per_sec = total_us ? num_ops * 1000000 / total_us : 0;
+
+    TestSuite::_msg("%15s%10zu%12s%10s%10s%10s%10s\n",
+                    name.c_str(), (size_t)num_ops,
+                    TestSuite::countToString(ops_per_sec).c_str(),
+                    TestSuite::usToString( get_percentile(lat, 50) ).c_str(),
+                    TestSuite::usToString( get_percentile(lat, 99) ).c_str(),
+                    TestSuite::usToString( get_percentile(lat, 99.9) ).c_str(),
+                    TestSuite::usToString( lat.empty() ? 0 : lat.back() )
+                        .c_str() );
+
+    std::stringstream ss;
+    ss << "{\"bench\":\"" << name << "\""
+       << ",\"servers\":" << config.num_servers_
+       << ",\"payload\":" << config.payload_size_
+       << ",\"batch\":" << config.batch_size_
+       << ",\"rounds\":" << lat.size()
+       << ",\"ops\":" << num_ops
+       << ",\"total_us\":" << total_us
+       << ",\"ops_per_sec\":" << ops_per_sec
+       << ",\"p50_us\":" << get_percentile(lat, 50)
+       << ",\"p99_us\":" << get_percentile(lat, 99)
+       << ",\"p999_us\":" << get_percentile(lat, 99.9)
+       << ",\"max_us\":" << (lat.empty() ? 0 : lat.back())
+       << "}";
+
+    std::ofstream fs;
+    fs.open(config.output_, std::ofstream::out | std::ofstream::app);
+    if (!fs.good()) return;
+    fs << ss.str() << std::endl;
+    fs.close();
+}
+
+static void print_header() {
+    TestSuite::_msg("%15s%10s%12s%10s%10s%10s%10s\n",
+                    "BENCH", "ops", "ops/s", "p50", "p99", "p99.9", "max");
+}
+
+static std::vector< ptr<buffer> > make_batch(const bench_config& config) {
+    std::vector< ptr<buffer> > logs(config.batch_size_);
+    for (ptr<buffer>& bb: logs) {
+        bb = buffer::alloc(config.payload_size_);
+        memset(bb->data_begin(), 'x', config.payload_size_);
+    }
+    return logs;
+}
+
+int append_bench(const bench_config& config) {
+    reset_log_files();
+    cluster cc(config, false);
+    CHK_Z( cc.form(config.num_servers_) );
+    RaftPkg* ll = cc.leader();
+    CHK_NONNULL( ll );
+
+    std::vector<uint64_t> append_lat;
+    std::vector<uint64_t> commit_lat;
+    append_lat.reserve(config.num_rounds_);
+    commit_lat.reserve(config.num_rounds_);
+    for (size_t ii = 0; ii < config.num_rounds_; ++ii) {
+        std::vector< ptr<buffer> > logs = make_batch(config);
+
+        TestSuite::Timer timer;
+        ptr<raft_result> ret = ll->raftServer->append_entries(logs);
+        append_lat.push_back( timer.getTimeUs() );
+        CHK_TRUE( ret->get_accepted() );
+
+        ulong target_idx = ll->raftServer->get_last_log_idx();
+        CHK_TRUE( cc.pump( [ll, target_idx]() {
+            return ll->raftServer->get_committed_log_idx() >= target_idx;
+        }, false ) );
+        commit_lat.push_back( timer.getTimeUs() );
+    }
+    CHK_TRUE( cc.pump( [&cc]() { return cc.synced(); } ) );
+
+    print_header();
+    report(config, "append", config.batch_size_, append_lat);
+    report(config, "commit", config.batch_size_, commit_lat);
+    return 0;
+}
+
+int election_bench(const bench_config& config) {
+    if (config.num_servers_ < 3) {
+        _msg("election benchmark needs at least 3 servers\n");
+        return 0;
+    }
+
+    reset_log_files();
+    cluster cc(config, false);
+    CHK_Z( cc.form(config.num_servers_) );
+
+    std::vector<uint64_t> elect_lat;
+    std::vector<uint64_t> sync_lat;
+    const std::vector<RaftPkg*>& members = cc.members();
+    for (size_t ii = 0; ii < config.num_ops_; ++ii) {
+        RaftPkg* ll = cc.leader();
+        CHK_NONNULL( ll );
+        size_t ll_pos = std::find(members.begin(), members.end(), ll)
+                        - members.begin();
+        RaftPkg* cand = members[(ll_pos + 1) % members.size()];
+
+        // Other followers lose the leader first, so that they accept
+        // the pre-vote of the candidate. Their own pre-votes are held
+        // until the new leader is established, otherwise one of them
+        // may win the election when there are 5 or more servers.
+        // Failing them instead is not an option, as it makes the
+        // connection to be re-established with backoff.
+        std::vector<RaftPkg*> others;
+        for (RaftPkg* pp: members) {
+            if (pp == ll || pp == cand) continue;
+            pp->fTimer->invoke( timer_task_type::election_timer );
+            others.push_back(pp);
+        }
+
+        TestSuite::Timer timer;
+        cand->fTimer->invoke( timer_task_type::election_timer );
+        std::vector<RaftPkg*> senders = {cand};
+        CHK_TRUE( cc.pump( [cand]() {
+            return cand->raftServer->is_leader();
+        }, false, &senders ) );
+        elect_lat.push_back( timer.getTimeUs() );
+
+        // Until the new leader's first log is committed everywhere.
+        CHK_TRUE( cc.pump( [&cc]() { return cc.synced(); }, true, &senders ) );
+        sync_lat.push_back( timer.getTimeUs() );
+
+        // Now held pre-votes will be rejected.
+        for (RaftPkg* pp: others) pp->fNet->execReqResp();
+        CHK_TRUE( cc.pump( [&cc]() { return cc.synced(); } ) );
+    }
+
+    print_header();
+    report(config, "election", 1, elect_lat);
+    report(config, "election_sync", 1, sync_lat);
+    return 0;
+}
+
+static int join_bench(const bench_config& config, bool snapshot) {
+    reset_log_files();
+    cluster cc(config, snapshot);
+    CHK_Z( cc.form(config.num_servers_) );
+
+    if (snapshot) {
+        // Make logs compacted, so that a new server should
+        // receive the snapshot.
+        RaftPkg* ll = cc.leader();
+        CHK_NONNULL( ll );
+        bench_config one_log = config;
+        one_log.batch_size_ = 1;
+        for (size_t ii = 0; ii < config.snapshot_logs_; ++ii) {
+            ll->raftServer->append_entries( make_batch(one_log) );
+            for (RaftPkg* pp: cc.members()) pp->fNet->execReqResp();
+        }
+        CHK_TRUE( cc.pump( [&cc]() { return cc.synced(); } ) );
+    }
+
+    std::vector<uint64_t> add_lat;
+    std::vector<uint64_t> remove_lat;
+    for (size_t ii = 0; ii < config.num_ops_; ++ii) {
+        RaftPkg* pp = cc.launch();
+
+        TestSuite::Timer timer;
+        CHK_Z( cc.add(pp) );
+        add_lat.push_back( timer.getTimeUs() );
+
+        timer.reset();
+        CHK_Z( cc.remove(pp) );
+        remove_lat.push_back( timer.getTimeUs() );
+    }
+
+    print_header();
+    if (snapshot) {
+        report(config, "snapshot_join", 1, add_lat);
+    } else {
+        report(config, "add_server", 1, add_lat);
+        report(config, "remove_server", 1, remove_lat);
+    }
+    return 0;
+}
+
+int snapshot_bench(const bench_config& config) {
+    return join_bench(config, true);
+}
+
+int config_change_bench(const bench_config& config) {
+    return join_bench(config, false);
+}
+
+static std::vector< std::pair<std::string, LinkProfile> >
+    get_profiles(const bench_config& config)
+{
+    std::vector< std::pair<std::string, LinkProfile> > ret;
+    const std::string& pp = config.rtt_profile_;
+    if (pp == "lan" || pp == "all") {
+        ret.push_back( std::make_pair("lan", LinkProfile::lan()) );
+    }
+    if (pp == "az" || pp == "all") {
+        ret.push_back( std::make_pair("az", LinkProfile::crossAz()) );
+    }
+    if (pp == "region" || pp == "all") {
+        ret.push_back( std::make_pair("region", LinkProfile::crossRegion()) );
+    }
+    for (auto& entry: ret) entry.second.lossRate = config.loss_rate_;
+    return ret;
+}
+
+static int wan_commit(const bench_config& config,
+                      cluster& cc,
+                      const std::string& profile_name)
+{
+    RaftPkg* ll = cc.leader();
+    CHK_NONNULL( ll );
+    FakeNetworkBase* base = cc.base();
+
+    // <target log index, virtual time of append>
+    std::map<ulong, uint64_t> pending;
+    std::vector<uint64_t> commit_lat;
+    commit_lat.reserve(config.num_rounds_);
+    uint64_t start_us = base->getClockUs();
+    size_t num_issued = 0;
+    while (commit_lat.size() < config.num_rounds_) {
+        while ( num_issued < config.num_rounds_ &&
+                pending.size() < config.inflight_ ) {
+            ptr<raft_result> ret =
+                ll->raftServer->append_entries( make_batch(config) );
+            CHK_TRUE( ret->get_accepted() );
+            pending[ll->raftServer->get_last_log_idx()] = base->getClockUs();
+            num_issued++;
+        }
+
+        ulong target_idx = pending.begin()->first;
+        CHK_TRUE( cc.pump_virtual( [ll, target_idx]() {
+            return ll->raftServer->get_target_committed_log_idx() >= target_idx;
+        } ) );
+        ulong committed_idx = ll->raftServer->get_target_committed_log_idx();
+        while (!pending.empty() && pending.begin()->first <= committed_idx) {
+            commit_lat.push_back( base->getClockUs() - pending.begin()->second );
+            pending.erase(pending.begin());
+        }
+    }
+
+    report( config, "commit@" + profile_name, config.batch_size_,
+            commit_lat, base->getClockUs() - start_us );
+    return 0;
+}
+
+static int wan_failover(const bench_config& config,
+                        cluster& cc,
+                        const std::string& profile_name)
+{
+    FakeNetworkBase* base = cc.base();
+    std::vector<uint64_t> failover_lat;
+    const std::vector<RaftPkg*>& members = cc.members();
+    for (size_t ii = 0; ii < config.num_ops_; ++ii) {
+        RaftPkg* ll = cc.leader();
+        CHK_NONNULL( ll );
+
+        // With lossy links, followers may have different logs.
+        // Choose the most up-to-date one, as others cannot win.
+        RaftPkg* cand = nullptr;
+        for (RaftPkg* pp: members) {
+            if (pp == ll) continue;
+            if ( !cand ||
+                 pp->raftServer->get_last_log_idx() >
+                     cand->raftServer->get_last_log_idx() ) {
+                cand = pp;
+            }
+        }
+
+        // The leader is gone from now on (not pumped), and followers
+        // notice it after the election timeout. The same as
+        // `election_bench`, other followers lose the leader first.
+        uint64_t start_us = base->getClockUs();
+        base->advanceClock(VIRTUAL_ELECTION_TIMEOUT_US);
+        std::vector<RaftPkg*> others;
+        for (RaftPkg* pp: members) {
+            if (pp == ll || pp == cand) continue;
+            pp->fTimer->invoke( timer_task_type::election_timer );
+            others.push_back(pp);
+        }
+        cand->fTimer->invoke( timer_task_type::election_timer );
+
+        // Until the new leader commits its first log.
+        auto done = [cand]() {
+            return cand->raftServer->is_leader() &&
+                   cand->raftServer->get_target_committed_log_idx() >=
+                       cand->raftServer->get_last_log_idx();
+        };
+        std::vector<RaftPkg*> senders = {cand};
+        while (true) {
+            uint64_t vote_us = base->getClockUs();
+            CHK_TRUE( cc.pump_virtual( [&]() {
+                return done() ||
+                       base->getClockUs() >= vote_us + VIRTUAL_ELECTION_TIMEOUT_US;
+            }, &senders ) );
+            if (done()) break;
+            // Vote requests may be lost, retry after the election timeout.
+            if (!cand->raftServer->is_leader()) {
+                cand->fTimer->invoke( timer_task_type::election_timer );
+            }
+        }
+        failover_lat.push_back( base->getClockUs() - start_us );
+
+        for (RaftPkg* pp: others) pp->fNet->execReqResp();
+        CHK_TRUE( cc.pump( [&cc]() { return cc.synced(); } ) );
+    }
+
+    report(config, "failover@" + profile_name, 1, failover_lat);
+    return 0;
+}
+
+int wan_bench(const bench_config& config) {
+    // All numbers are based on the virtual clock of the fake network.
+    print_header();
+    for (auto& entry: get_profiles(config)) {
+        reset_log_files();
+        cluster cc(config, false);
+        CHK_Z( cc.form(config.num_servers_) );
+        cc.base()->setLinkProfile(entry.second);
+
+        CHK_Z( wan_commit(config, cc, entry.first) );
+        if (config.num_servers_ >= 3) {
+            CHK_Z( wan_failover(config, cc, entry.first) );
+        }
+    }
+    return 0;
+}
+
+void usage(int argc, char** argv) {
+    std::stringstream ss;
+    ss <<
+    "Usage: \n" <<
+    "    fake_bench [--servers <# servers>] [--payload <payload size>]\n"
+    "               [--batch <# logs per append>] [--rounds <# appends>]\n"
+    "               [--ops <# elections, snapshots, config changes>]\n"
+    "               [--snapshot-logs <# logs in snapshot>]\n"
+    "               [--rtt-profile <lan | az | region | all>]\n"
+    "               [--inflight <# appends in flight>] [--loss <rate>]\n"
+    "               [--log-level <level>] [--output <result file>]\n"
+    "               [-f <benchmark name>]\n" <<
+    std::endl;
+
+    std::cout << ss.str();
+    exit(0);
+}
+
+bench_config parse_config(int argc, char** argv) {
+    bench_config ret;
+    for (int ii = 1; ii < argc; ++ii) {
+        std::string arg = argv[ii];
+        if (arg == "-h" || arg == "--help") usage(argc, argv);
+        if (ii + 1 >= argc) continue;
+
+        if (arg == "--servers") {
+            ret.num_servers_ = atoi( argv[++ii] );
+        } else if (arg == "--payload") {
+            ret.payload_size_ = atoi( argv[++ii] );
+        } else if (arg == "--batch") {
+            ret.batch_size_ = atoi( argv[++ii] );
+        } else if (arg == "--rounds") {
+            ret.num_rounds_ = atoi( argv[++ii] );
+        } else if (arg == "--ops") {
+            ret.num_ops_ = atoi( argv[++ii] );
+        } else if (arg == "--snapshot-logs") {
+            ret.snapshot_logs_ = atoi( argv[++ii] );
+        } else if (arg == "--log-level") {
+            ret.log_level_ = atoi( argv[++ii] );
+        } else if (arg == "--output") {
+            ret.output_ = argv[++ii];
+        } else if (arg == "--rtt-profile") {
+            ret.rtt_profile_ = argv[++ii];
+        } else if (arg == "--inflight") {
+            ret.inflight_ = atoi( argv[++ii] );
+        } else if (arg == "--loss") {
+            ret.loss_rate_ = atof( argv[++ii] );
+        }
+    }
+
+    if (ret.num_servers_ < 1 || ret.num_servers_ > 9) {
+        std::cout << "valid server number range: 1 - 9." << std::endl;
+        exit(0);
+    }
+    if (ret.payload_size_ < 1 || ret.payload_size_ > 16*1024*1024) {
+        std::cout << "valid payload size range: 1 byte - 16 MB." << std::endl;
+        exit(0);
+    }
+    if (ret.batch_size_ < 1) {
+        std::cout << "batch size should be greater than zero." << std::endl;
+        exit(0);
+    }
+    if (ret.inflight_ < 1) {
+        std::cout << "inflight should be greater than zero." << std::endl;
+        exit(0);
+    }
+    if ( ret.rtt_profile_ != "lan" && ret.rtt_profile_ != "az" &&
+         ret.rtt_profile_ != "region" && ret.rtt_profile_ != "all" ) {
+        std::cout << "valid RTT profiles: lan, az, region, all." << std::endl;
+        exit(0);
+    }
+    return ret;
+}
+
+}; // namespace fake_bench;
+using namespace fake_bench;
+
+int main(int argc, char** argv) {
+    TestSuite ts(argc, argv);
+
+    bench_config config = parse_config(argc, argv);
+
+    ts.options.printTestMessage = true;
+
+    ts.doTest("append bench", append_bench, config);
+    ts.doTest("election bench", election_bench, config);
+    ts.doTest("snapshot bench", snapshot_bench, config);
+    ts.doTest("config change bench", config_change_bench, config);
+    ts.doTest("wan bench", wan_bench, config);
+
+    return 0;
+}
@@ -17,12 +17,18 @@ limitations under the License.
 
 #include "raft_package_asio.hxx"
 
+#include "crc32.hxx"
 #include "event_awaiter.h"
+#include "stat_mgr.hxx"
 #include "test_common.h"
 
 #include <unordered_map>
 
+#include <arpa/inet.h>
+#include <netinet/in.h>
 #include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 using namespace nuraft;
 using namespace raft_functional_common;
@@ -200,6 +206,128 @@ int ssl_test() {
     return 0;
 }
 
+int ssl_session_resumption_test() {
+    reset_log_files();
+
+    std::string s1_addr = "localhost:20010";
+    std::string s2_addr = "localhost:20020";
+    std::string s3_addr = "localhost:20030";
+
+    RaftAsioPkg s1(1, s1_addr);
+    RaftAsioPkg s2(2, s2_addr);
+    RaftAsioPkg s3(3, s3_addr);
+    std::vector<RaftAsioPkg*> pkgs = {&s1, &s2, &s3};
+    for (RaftAsioPkg* pp: pkgs) pp->sslSessionResumption = true;
+
+    _msg("launching asio-raft servers with SSL\n");
+    CHK_Z( launch_servers(pkgs, true) );
+
+    _msg("organizing raft group\n");
+    CHK_Z( make_group(pkgs) );
+    CHK_TRUE( s1.raftServer->is_leader() );
+
+#ifdef ENABLE_RAFT_STATS
+    stat_elem* num_resumed =
+        stat_mgr::get_instance()->get_stat("asio_ssl_resumed_handshakes");
+    uint64_t resumed_before = num_resumed ? num_resumed->get_counter() : 0;
+#endif
+
+    // New connections to the same endpoint should resume the session
+    // established by the Raft traffic.
+    for (size_t ii = 0; ii < 3; ++ii) {
+        ptr<rpc_client> cli = s1.asioSvc->create_client(s2_addr);
+        CHK_NONNULL( cli.get() );
+
+        ptr<req_msg> req = cs_new<req_msg>
+                           ( 0, msg_type::append_entries_request,
+                             1, 2, 0, 0, 0 );
+        EventAwaiter ea;
+        bool got_resp = false;
+        rpc_handler handler = [&](ptr<resp_msg>& resp,
+                                  ptr<rpc_exception>& err) {
+            got_resp = (resp != nullptr);
+            ea.invoke();
+        };
+        cli->send(req, handler);
+        ea.wait_ms(3000);
+        CHK_TRUE( got_resp );
+    }
+#ifdef ENABLE_RAFT_STATS
+    num_resumed =
+        stat_mgr::get_instance()->get_stat("asio_ssl_resumed_handshakes");
+    CHK_NONNULL( num_resumed );
+    CHK_EQ( resumed_before + 3, num_resumed->get_counter() );
+#endif
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+    TestSuite::sleep_sec(1, "shutting down");
+
+    s1.stopAsio();
+    s2.stopAsio();
+    s3.stopAsio();
+
+    SimpleLogger::shutdown();
+    return 0;
+}
+
+int unix_socket_test(bool enable_ssl) {
+    reset_log_files();
+
+    std::string s1_addr = "unix://./nuraft_test_s1.sock";
+    std::string s2_addr = "unix://./nuraft_test_s2.sock";
+    std::string s3_addr = "unix://./nuraft_test_s3.sock";
+
+    RaftAsioPkg s1(1, s1_addr);
+    RaftAsioPkg s2(2, s2_addr);
+    RaftAsioPkg s3(3, s3_addr);
+    std::vector<RaftAsioPkg*> pkgs = {&s1, &s2, &s3};
+
+    _msg("launching asio-raft servers over Unix domain socket\n");
+    CHK_Z( launch_servers(pkgs, enable_ssl) );
+
+    _msg("organizing raft group\n");
+    CHK_Z( make_group(pkgs) );
+    CHK_TRUE( s1.raftServer->is_leader() );
+    CHK_EQ(1, s2.raftServer->get_leader());
+    CHK_EQ(1, s3.raftServer->get_leader());
+
+    for (size_t ii=0; ii<10; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        ptr< cmd_result< ptr<buffer> > > ret =
+            s1.raftServer->append_entries( {msg} );
+        CHK_TRUE( ret->get_accepted() );
+        CHK_EQ( cmd_result_code::OK, ret->get_result_code() );
+    }
+    TestSuite::sleep_ms(500, "replication");
+
+    uint64_t committed_idx = s1.raftServer->get_committed_log_idx();
+    CHK_EQ( committed_idx, s2.raftServer->get_committed_log_idx() );
+    CHK_EQ( committed_idx, s3.raftServer->get_committed_log_idx() );
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+    CHK_OK( s3.getTestSm()->isSame( *s1.getTestSm() ) );
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+    TestSuite::sleep_sec(1, "shutting down");
+
+    s1.stopAsio();
+    s2.stopAsio();
+    s3.stopAsio();
+
+    for (size_t ii = 1; ii <= 3; ++ii) {
+        std::string path = "./nuraft_test_s" + std::to_string(ii) + ".sock";
+        remove(path.c_str());
+    }
+
+    SimpleLogger::shutdown();
+    return 0;
+}
+
 static bool dbg_print_ctx = false;
 static std::unordered_map<std::string, std::string> req_map;
 static std::unordered_map<std::string, std::string> resp_map;
@@ -689,7 +817,8 @@ static void async_handler(std::list<ulong>* idx_list,
     }
 }
 
-int async_append_handler_test() {
+// 0: default, 1: zero copy receive, 2: compact log entries.
+int async_append_handler_test(size_t receive_mode) {
     reset_log_files();
 
     std::string s1_addr = "tcp://127.0.0.1:20010";
@@ -700,6 +829,10 @@ int async_append_handler_test() {
     RaftAsioPkg s2(2, s2_addr);
     RaftAsioPkg s3(3, s3_addr);
     std::vector<RaftAsioPkg*> pkgs = {&s1, &s2, &s3};
+    for (RaftAsioPkg* pp: pkgs) {
+        pp->zeroCopyReceive = (receive_mode == 1);
+        pp->compactLogEntries = (receive_mode == 2);
+    }
 
     _msg("launching asio-raft servers\n");
     CHK_Z( launch_servers(pkgs, false) );
@@ -752,41 +885,772 @@ int async_append_handler_test() {
     return 0;
 }
 
-}  // namespace asio_service_test;
-using namespace asio_service_test;
+int follower_bg_flush_test() {
+    reset_log_files();
 
-int main(int argc, char** argv) {
-    TestSuite ts(argc, argv);
+    std::string s1_addr = "tcp://127.0.0.1:20010";
+    std::string s2_addr = "tcp://127.0.0.1:20020";
+    std::string s3_addr = "tcp://127.0.0.1:20030";
 
-    ts.options.printTestMessage = true;
+    RaftAsioPkg s1(1, s1_addr);
+    RaftAsioPkg s2(2, s2_addr);
+    RaftAsioPkg s3(3, s3_addr);
+    std::vector<RaftAsioPkg*> pkgs = {&s1, &s2, &s3};
 
-    ts.doTest( "make group test",
-               make_group_test );
+    _msg("launching asio-raft servers\n");
+    CHK_Z( launch_servers(pkgs, false) );
 
-    ts.doTest( "leader election test",
-               leader_election_test );
+    _msg("organizing raft group\n");
+    CHK_Z( make_group(pkgs) );
 
-#if defined(__linux__) || defined(__APPLE__)
-    ts.doTest( "ssl test",
-               ssl_test );
-#endif
+    // Followers respond after the background flush.
+    for (auto& entry: pkgs) {
+        RaftAsioPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        param.with_bg_thread_for_follower_flush(true);
+        pp->raftServer->update_params(param);
+    }
 
-    ts.doTest( "message meta test",
-               message_meta_test );
+    const size_t NUM = 100;
+    std::list< ptr< cmd_result< ptr<buffer> > > > handlers;
+    for (size_t ii=0; ii<NUM; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        ptr< cmd_result< ptr<buffer> > > ret =
+            s1.raftServer->append_entries( {msg} );
+        CHK_TRUE( ret->get_accepted() );
+        handlers.push_back(ret);
+    }
+    TestSuite::sleep_sec(1, "replication");
 
-    ts.doTest( "empty meta test",
-               empty_meta_test,
-               TestRange<bool>( {false, true} ) );
+    for (size_t ii=0; ii<NUM; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        CHK_GT( s1.getTestSm()->isCommitted(test_msg), 0 );
+    }
 
-    ts.doTest( "message meta random denial test",
-               message_meta_random_denial_test );
+    // State machine should be identical.
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+    CHK_OK( s3.getTestSm()->isSame( *s1.getTestSm() ) );
 
-    ts.doTest( "response hint test",
-               response_hint_test,
-               TestRange<bool>( {false, true} ) );
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+    TestSuite::sleep_sec(1, "shutting down");
 
-    ts.doTest( "async append handler test",
-               async_append_handler_test );
+    SimpleLogger::shutdown();
+    return 0;
+}
+
+int parallel_append_senders_test() {
+    reset_log_files();
+
+    RaftAsioPkg s1(1, "tcp://127.0.0.1:20010");
+    RaftAsioPkg s2(2, "tcp://127.0.0.1:20020");
+    RaftAsioPkg s3(3, "tcp://127.0.0.1:20030");
+    RaftAsioPkg s4(4, "tcp://127.0.0.1:20040");
+    RaftAsioPkg s5(5, "tcp://127.0.0.1:20050");
+    std::vector<RaftAsioPkg*> pkgs = {&s1, &s2, &s3, &s4, &s5};
+
+    _msg("launching asio-raft servers\n");
+    CHK_Z( launch_servers(pkgs, false) );
+
+    _msg("organizing raft group\n");
+    CHK_Z( make_group(pkgs) );
+
+    // Requests to 4 followers are created by 2 threads.
+    for (auto& entry: pkgs) {
+        RaftAsioPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        param.with_parallel_append_senders(2);
+        pp->raftServer->update_params(param);
+    }
+
+    const size_t NUM = 100;
+    std::list< ptr< cmd_result< ptr<buffer> > > > handlers;
+    for (size_t ii=0; ii<NUM; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        ptr< cmd_result< ptr<buffer> > > ret =
+            s1.raftServer->append_entries( {msg} );
+        CHK_TRUE( ret->get_accepted() );
+        handlers.push_back(ret);
+    }
+    TestSuite::sleep_sec(1, "replication");
+
+    for (size_t ii=0; ii<NUM; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        CHK_GT( s1.getTestSm()->isCommitted(test_msg), 0 );
+    }
+
+    // State machine should be identical.
+    for (RaftAsioPkg* pp: pkgs) {
+        if (pp == &s1) continue;
+        CHK_OK( pp->getTestSm()->isSame( *s1.getTestSm() ) );
+    }
+
+    for (RaftAsioPkg* pp: pkgs) pp->raftServer->shutdown();
+    TestSuite::sleep_sec(1, "shutting down");
+
+    SimpleLogger::shutdown();
+    return 0;
+}
+
+int parallel_append_senders_leader_change_test() {
+    reset_log_files();
+
+    RaftAsioPkg s1(1, "tcp://127.0.0.1:20010");
+    RaftAsioPkg s2(2, "tcp://127.0.0.1:20020");
+    RaftAsioPkg s3(3, "tcp://127.0.0.1:20030");
+    std::vector<RaftAsioPkg*> pkgs = {&s1, &s2, &s3};
+
+    _msg("launching asio-raft servers\n");
+    CHK_Z( launch_servers(pkgs, false) );
+
+    _msg("organizing raft group\n");
+    CHK_Z( make_group(pkgs) );
+
+    for (auto& entry: pkgs) {
+        RaftAsioPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        param.with_parallel_append_senders(2);
+        pp->raftServer->update_params(param);
+    }
+
+    // Leadership moves to S2 while S1's senders are replicating.
+    const size_t NUM = 100;
+    for (size_t ii=0; ii<NUM; ++ii) {
+        if (ii == NUM / 2) {
+            s1.raftServer->yield_leadership(false, 2);
+        }
+        std::string test_msg = "test" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        s1.raftServer->append_entries( {msg} );
+    }
+    TestSuite::sleep_sec(2, "leader election");
+
+    for (RaftAsioPkg* pp: pkgs) {
+        CHK_EQ( 2, pp->raftServer->get_leader() );
+    }
+
+    // The new leader's senders should replicate logs as usual.
+    for (size_t ii=0; ii<NUM; ++ii) {
+        std::string test_msg = "new" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        ptr< cmd_result< ptr<buffer> > > ret =
+            s2.raftServer->append_entries( {msg} );
+        CHK_TRUE( ret->get_accepted() );
+    }
+    TestSuite::sleep_sec(1, "replication");
+
+    for (size_t ii=0; ii<NUM; ++ii) {
+        std::string test_msg = "new" + std::to_string(ii);
+        CHK_GT( s2.getTestSm()->isCommitted(test_msg), 0 );
+    }
+
+    // State machine should be identical.
+    CHK_OK( s1.getTestSm()->isSame( *s2.getTestSm() ) );
+    CHK_OK( s3.getTestSm()->isSame( *s2.getTestSm() ) );
+
+    for (RaftAsioPkg* pp: pkgs) pp->raftServer->shutdown();
+    TestSuite::sleep_sec(1, "shutting down");
+
+    SimpleLogger::shutdown();
+    return 0;
+}
+
+int crc32c_header_test() {
+    reset_log_files();
+
+    std::string s1_addr = "tcp://127.0.0.1:20010";
+    std::string s2_addr = "tcp://127.0.0.1:20020";
+    std::string s3_addr = "tcp://127.0.0.1:20030";
+
+    RaftAsioPkg s1(1, s1_addr);
+    RaftAsioPkg s2(2, s2_addr);
+    RaftAsioPkg s3(3, s3_addr);
+    std::vector<RaftAsioPkg*> pkgs = {&s1, &s2, &s3};
+
+    // S3 does not use CRC32C for its requests, but it should be
+    // able to handle requests and responses with CRC32C.
+    s1.crc32cHeader = true;
+    s2.crc32cHeader = true;
+
+    _msg("launching asio-raft servers\n");
+    CHK_Z( launch_servers(pkgs, false) );
+
+    _msg("organizing raft group\n");
+    CHK_Z( make_group(pkgs) );
+
+    for (size_t ii=0; ii<10; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        ptr< cmd_result< ptr<buffer> > > ret =
+            s1.raftServer->append_entries( {msg} );
+        CHK_TRUE( ret->get_accepted() );
+    }
+    TestSuite::sleep_sec(1, "replication");
+
+    // State machine should be identical.
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+    CHK_OK( s3.getTestSm()->isSame( *s1.getTestSm() ) );
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+    TestSuite::sleep_sec(1, "shutting down");
+
+    SimpleLogger::shutdown();
+    return 0;
+}
+
+int log_entry_crc_test(bool leader_crc) {
+    reset_log_files();
+
+    std::string s1_addr = "tcp://127.0.0.1:20010";
+    std::string s2_addr = "tcp://127.0.0.1:20020";
+    std::string s3_addr = "tcp://127.0.0.1:20030";
+
+    RaftAsioPkg s1(1, s1_addr);
+    RaftAsioPkg s2(2, s2_addr);
+    RaftAsioPkg s3(3, s3_addr);
+    std::vector<RaftAsioPkg*> pkgs = {&s1, &s2, &s3};
+    for (RaftAsioPkg* pp: pkgs) pp->logEntryCrc = true;
+
+    _msg("launching asio-raft servers\n");
+    CHK_Z( launch_servers(pkgs, false) );
+
+    _msg("organizing raft group\n");
+    CHK_Z( make_group(pkgs) );
+
+    if (leader_crc) {
+        raft_params param = s1.raftServer->get_current_params();
+        param.with_log_entry_crc(true);
+        s1.raftServer->update_params(param);
+    }
+
+    for (size_t ii=0; ii<10; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        ptr< cmd_result< ptr<buffer> > > ret =
+            s1.raftServer->append_entries( {msg} );
+        CHK_TRUE( ret->get_accepted() );
+    }
+    TestSuite::sleep_sec(1, "replication");
+
+    // State machine should be identical.
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+    CHK_OK( s3.getTestSm()->isSame( *s1.getTestSm() ) );
+
+    // Followers should have CRC of received logs.
+    uint64_t last_idx = s1.raftServer->get_last_log_idx();
+    for (RaftAsioPkg* pp: pkgs) {
+        ptr<log_store> ls = pp->raftServer->get_log_store();
+        ptr<log_entry> le = ls->entry_at(last_idx);
+        CHK_EQ( log_val_type::app_log, le->get_val_type() );
+        if (pp == &s1 && !leader_crc) {
+            CHK_FALSE( le->has_crc32() );
+            continue;
+        }
+        CHK_TRUE( le->has_crc32() );
+        CHK_EQ( crc32c( le->get_buf().data_begin(), le->get_buf().size(), 0 ),
+                le->get_crc32() );
+    }
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+    TestSuite::sleep_sec(1, "shutting down");
+
+    SimpleLogger::shutdown();
+    return 0;
+}
+
+int compression_test(int codec) {
+    reset_log_files();
+
+    std::string s1_addr = "tcp://127.0.0.1:20010";
+    std::string s2_addr = "tcp://127.0.0.1:20020";
+    std::string s3_addr = "tcp://127.0.0.1:20030";
+
+    RaftAsioPkg s1(1, s1_addr);
+    RaftAsioPkg s2(2, s2_addr);
+    RaftAsioPkg s3(3, s3_addr);
+    std::vector<RaftAsioPkg*> pkgs = {&s1, &s2, &s3};
+    // S3 doesn't compress, but it can still receive compressed requests.
+    s1.compressionType = (asio_service_options::compression_type)codec;
+    s2.compressionType = (asio_service_options::compression_type)codec;
+
+    _msg("launching asio-raft servers\n");
+    CHK_Z( launch_servers(pkgs, false) );
+
+    _msg("organizing raft group\n");
+    CHK_Z( make_group(pkgs) );
+
+    // Big and compressible payloads, and small ones.
+    for (size_t ii=0; ii<20; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        if (ii % 2 == 0) {
+            for (size_t jj=0; jj<1000; ++jj) {
+                test_msg += "{\"key\": \"value\"}";
+            }
+        }
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        ptr< cmd_result< ptr<buffer> > > ret =
+            s1.raftServer->append_entries( {msg} );
+        CHK_TRUE( ret->get_accepted() );
+    }
+    TestSuite::sleep_sec(1, "replication");
+
+    // State machine should be identical.
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+    CHK_OK( s3.getTestSm()->isSame( *s1.getTestSm() ) );
+
+#ifdef ENABLE_RAFT_STATS
+    uint64_t raw_bytes =
+        raft_server::get_stat_counter("asio_compress_raw_bytes");
+    uint64_t out_bytes =
+        raft_server::get_stat_counter("asio_compress_out_bytes");
+    _msg("compressed %zu -> %zu bytes\n", raw_bytes, out_bytes);
+    if (codec == asio_service_options::zlib) {
+        CHK_GT( raw_bytes, out_bytes );
+    }
+#endif
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+    TestSuite::sleep_sec(1, "shutting down");
+
+    SimpleLogger::shutdown();
+    return 0;
+}
+
+int io_context_per_worker_test(bool pin_threads) {
+    reset_log_files();
+
+    std::string s1_addr = "tcp://127.0.0.1:20010";
+    std::string s2_addr = "tcp://127.0.0.1:20020";
+    std::string s3_addr = "tcp://127.0.0.1:20030";
+
+    RaftAsioPkg s1(1, s1_addr);
+    RaftAsioPkg s2(2, s2_addr);
+    RaftAsioPkg s3(3, s3_addr);
+    std::vector<RaftAsioPkg*> pkgs = {&s1, &s2, &s3};
+    for (RaftAsioPkg* pp: pkgs) {
+        pp->ioContextPerWorker = true;
+        pp->pinWorkerThreads = pin_threads;
+    }
+
+    _msg("launching asio-raft servers\n");
+    CHK_Z( launch_servers(pkgs, false) );
+
+    _msg("organizing raft group\n");
+    CHK_Z( make_group(pkgs) );
+    CHK_TRUE( s1.raftServer->is_leader() );
+
+    std::list< ptr< cmd_result< ptr<buffer> > > > rets;
+    for (size_t ii=0; ii<100; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        ptr< cmd_result< ptr<buffer> > > ret =
+            s1.raftServer->append_entries( {msg} );
+        CHK_TRUE( ret->get_accepted() );
+        rets.push_back(ret);
+    }
+    TestSuite::sleep_sec(1, "replication");
+
+    for (auto& entry: rets) {
+        CHK_EQ( cmd_result_code::OK, entry->get_result_code() );
+    }
+
+    // State machine should be identical.
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+    CHK_OK( s3.getTestSm()->isSame( *s1.getTestSm() ) );
+
+    for (RaftAsioPkg* pp: pkgs) {
+        pp->raftServer->shutdown();
+        pp->stopAsio();
+        CHK_Z( pp->asioSvc->get_active_workers() );
+    }
+    TestSuite::sleep_sec(1, "shutting down");
+
+    SimpleLogger::shutdown();
+    return 0;
+}
+
+int multi_connection_test(size_t num_conns) {
+    reset_log_files();
+
+    std::string s1_addr = "tcp://127.0.0.1:20010";
+    std::string s2_addr = "tcp://127.0.0.1:20020";
+    std::string s3_addr = "tcp://127.0.0.1:20030";
+
+    RaftAsioPkg s1(1, s1_addr);
+    RaftAsioPkg s2(2, s2_addr);
+    RaftAsioPkg s3(3, s3_addr);
+    std::vector<RaftAsioPkg*> pkgs = {&s1, &s2, &s3};
+    for (RaftAsioPkg* pp: pkgs) {
+        pp->connectionsPerPeer = num_conns;
+    }
+
+    _msg("launching asio-raft servers\n");
+    CHK_Z( launch_servers(pkgs, false) );
+
+    // S3 will join later.
+    _msg("organizing raft group\n");
+    CHK_Z( make_group( {&s1, &s2} ) );
+    CHK_TRUE( s1.raftServer->is_leader() );
+
+    std::list< ptr< cmd_result< ptr<buffer> > > > rets;
+    for (size_t ii=0; ii<100; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        ptr< cmd_result< ptr<buffer> > > ret =
+            s1.raftServer->append_entries( {msg} );
+        CHK_TRUE( ret->get_accepted() );
+        rets.push_back(ret);
+    }
+    TestSuite::sleep_sec(1, "replication");
+
+    for (auto& entry: rets) {
+        CHK_EQ( cmd_result_code::OK, entry->get_result_code() );
+    }
+
+    // Logs are compacted, S3 should receive a snapshot.
+    s1.raftServer->add_srv( *(s3.getTestMgr()->get_srv_config()) );
+    TestSuite::sleep_sec(2, "adding S3");
+    CHK_EQ(1, s3.raftServer->get_leader());
+
+    // State machine should be identical.
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+    CHK_OK( s3.getTestSm()->isSame( *s1.getTestSm() ) );
+
+    for (RaftAsioPkg* pp: pkgs) {
+        pp->raftServer->shutdown();
+    }
+    TestSuite::sleep_sec(1, "shutting down");
+
+    SimpleLogger::shutdown();
+    return 0;
+}
+
+// Send a HTTP GET request to the local port and return the response.
+static std::string http_get(uint16_t port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return std::string();
+
+    struct sockaddr_in addr;
+    memset(&addr, 0x0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        ::close(fd);
+        return std::string();
+    }
+
+    std::string req = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    if (::write(fd, req.data(), req.size()) != (ssize_t)req.size()) {
+        ::close(fd);
+        return std::string();
+    }
+
+    // Server closes the connection after the response.
+    std::string resp;
+    char buf[4096];
+    ssize_t len = 0;
+    while ( (len = ::read(fd, buf, sizeof(buf))) > 0 ) {
+        resp.append(buf, len);
+    }
+    ::close(fd);
+    return resp;
+}
+
+int metrics_endpoint_test() {
+    reset_log_files();
+
+    std::string s1_addr = "tcp://127.0.0.1:20010";
+    std::string s2_addr = "tcp://127.0.0.1:20020";
+    std::string s3_addr = "tcp://127.0.0.1:20030";
+
+    RaftAsioPkg s1(1, s1_addr);
+    RaftAsioPkg s2(2, s2_addr);
+    RaftAsioPkg s3(3, s3_addr);
+    std::vector<RaftAsioPkg*> pkgs = {&s1, &s2, &s3};
+    const uint16_t METRICS_PORT = 20100;
+    s1.metricsHttpPort = METRICS_PORT;
+
+    _msg("launching asio-raft servers\n");
+    CHK_Z( launch_servers(pkgs, false) );
+
+    _msg("organizing raft group\n");
+    CHK_Z( make_group(pkgs) );
+    CHK_TRUE( s1.raftServer->is_leader() );
+
+    for (size_t ii=0; ii<10; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        ptr< cmd_result< ptr<buffer> > > ret =
+            s1.raftServer->append_entries( {msg} );
+        CHK_TRUE( ret->get_accepted() );
+        CHK_EQ( cmd_result_code::OK, ret->get_result_code() );
+    }
+    TestSuite::sleep_ms(500, "replication");
+
+    std::string resp = http_get(METRICS_PORT);
+    CHK_EQ( 0, resp.find("HTTP/1.1 200 OK\r\n") );
+    size_t body_pos = resp.find("\r\n\r\n");
+    CHK_NEQ( std::string::npos, body_pos );
+    std::string body = resp.substr(body_pos + 4);
+    CHK_EQ( raft_server::get_all_stats_prometheus().size(), body.size() );
+
+#ifdef ENABLE_RAFT_STATS
+    // Latency of each phase should be exported.
+    for (std::string name: { "repl_lat_client_wait_us",
+                             "repl_lat_store_log_us",
+                             "repl_lat_end_of_append_batch_us",
+                             "repl_lat_append_rpc_us",
+                             "repl_lat_quorum_commit_us",
+                             "repl_lat_sm_commit_us" }) {
+        CHK_NEQ( std::string::npos,
+                 body.find("# TYPE nuraft_" + name + " histogram") );
+        CHK_NEQ( std::string::npos,
+                 body.find("nuraft_" + name + "_bucket{le=\"+Inf\"}") );
+    }
+#endif
+
+    for (RaftAsioPkg* pp: pkgs) {
+        pp->raftServer->shutdown();
+    }
+    TestSuite::sleep_sec(1, "shutting down");
+
+    SimpleLogger::shutdown();
+    return 0;
+}
+
+int multi_raft_test(bool coalesce_hb) {
+    reset_log_files();
+
+    const size_t NUM_NODES = 3;
+    const int32 NUM_GROUPS = 4;
+
+    // One Asio service and listener per node, shared by all groups.
+    std::vector< ptr<asio_service> > svcs;
+    std::vector< ptr<rpc_listener> > listeners;
+    std::vector< ptr<raft_group_dispatcher> > dispatchers;
+    for (size_t ii = 0; ii < NUM_NODES; ++ii) {
+        int srv_id = ii + 1;
+        ptr<logger> no_log;
+        asio_service::options asio_opt;
+        asio_opt.thread_pool_size_ = 4;
+        if (coalesce_hb) {
+            // Along with the timer wheel, for a large number of groups.
+            asio_opt.heartbeat_coalesce_window_ms_ =
+                RaftAsioPkg::HEARTBEAT_MS / 5;
+            asio_opt.timer_wheel_tick_ms_ = 10;
+        }
+        ptr<asio_service> svc = cs_new<asio_service>(asio_opt, no_log);
+        ptr<rpc_listener> listener =
+            svc->create_rpc_listener(20000 + srv_id * 10, no_log);
+        CHK_NONNULL( listener );
+
+        ptr<raft_group_dispatcher> dispatcher =
+            cs_new<raft_group_dispatcher>();
+        listener->listen_groups(dispatcher);
+
+        svcs.push_back(svc);
+        listeners.push_back(listener);
+        dispatchers.push_back(dispatcher);
+    }
+
+    // groups[group_id][node].
+    std::vector< std::vector< ptr<RaftAsioPkg> > > groups(NUM_GROUPS);
+    for (int32 gg = 0; gg < NUM_GROUPS; ++gg) {
+        for (size_t ii = 0; ii < NUM_NODES; ++ii) {
+            int srv_id = ii + 1;
+            std::string addr = "tcp://127.0.0.1:" +
+                               std::to_string(20000 + srv_id * 10);
+            ptr<RaftAsioPkg> pkg = cs_new<RaftAsioPkg>(srv_id, addr);
+            pkg->initGroupServer(svcs[ii], dispatchers[ii], gg);
+            groups[gg].push_back(pkg);
+        }
+    }
+    for (size_t ii = 0; ii < NUM_NODES; ++ii) {
+        CHK_EQ( (size_t)NUM_GROUPS, dispatchers[ii]->get_num_groups() );
+    }
+    TestSuite::sleep_sec(1, "launching servers");
+
+    _msg("organizing raft groups\n");
+    for (int32 gg = 0; gg < NUM_GROUPS; ++gg) {
+        std::vector<RaftAsioPkg*> pkgs;
+        for (ptr<RaftAsioPkg>& pp: groups[gg]) pkgs.push_back(pp.get());
+        CHK_Z( make_group(pkgs) );
+        CHK_TRUE( pkgs[0]->raftServer->is_leader() );
+    }
+
+    // Append different number of logs to each group.
+    for (int32 gg = 0; gg < NUM_GROUPS; ++gg) {
+        ptr<raft_server> leader = groups[gg][0]->raftServer;
+        for (int32 ii = 0; ii < 5 * (gg + 1); ++ii) {
+            std::string test_msg = "group" + std::to_string(gg) +
+                                   "_" + std::to_string(ii);
+            ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+            msg->put(test_msg);
+            ptr< cmd_result< ptr<buffer> > > ret =
+                leader->append_entries( {msg} );
+            CHK_TRUE( ret->get_accepted() );
+        }
+    }
+    TestSuite::sleep_sec(1, "replication");
+
+    // Each group should have its own logs only.
+    uint64_t last_idx[NUM_GROUPS];
+    for (int32 gg = 0; gg < NUM_GROUPS; ++gg) {
+        RaftAsioPkg* leader = groups[gg][0].get();
+        last_idx[gg] = leader->raftServer->get_last_log_idx();
+        for (ptr<RaftAsioPkg>& pp: groups[gg]) {
+            CHK_EQ( last_idx[gg], pp->raftServer->get_committed_log_idx() );
+            CHK_EQ( 1, pp->raftServer->get_leader() );
+            if (pp.get() == leader) continue;
+            CHK_OK( pp->getTestSm()->isSame( *leader->getTestSm() ) );
+        }
+    }
+    CHK_EQ( last_idx[0] + 5, last_idx[1] );
+
+    // Leaders should be kept by heartbeats, with or without coalescing.
+    TestSuite::sleep_sec(1, "heartbeats");
+    for (int32 gg = 0; gg < NUM_GROUPS; ++gg) {
+        for (ptr<RaftAsioPkg>& pp: groups[gg]) {
+            CHK_EQ( 1, pp->raftServer->get_leader() );
+            CHK_EQ( last_idx[gg], pp->raftServer->get_committed_log_idx() );
+        }
+    }
+
+#ifdef ENABLE_RAFT_STATS
+    stat_elem* num_coalesced =
+        stat_mgr::get_instance()->get_stat("num_coalesced_heartbeats");
+    if (coalesce_hb) {
+        CHK_NONNULL( num_coalesced );
+        CHK_GT( num_coalesced->get_counter(), 0 );
+    }
+#endif
+
+    for (int32 gg = 0; gg < NUM_GROUPS; ++gg) {
+        for (size_t ii = 0; ii < NUM_NODES; ++ii) {
+            groups[gg][ii]->raftServer->shutdown();
+            dispatchers[ii]->deregister_group(gg);
+        }
+    }
+    for (size_t ii = 0; ii < NUM_NODES; ++ii) {
+        listeners[ii]->stop();
+        listeners[ii]->shutdown();
+        svcs[ii]->stop();
+        size_t count = 0;
+        while (svcs[ii]->get_active_workers() && count < 500) {
+            // 10ms per tick.
+            timer_helper::sleep_ms(10);
+            count++;
+        }
+    }
+    TestSuite::sleep_sec(1, "shutting down");
+
+    SimpleLogger::shutdown();
+    return 0;
+}
+
+}  // namespace asio_service_test;
+using namespace asio_service_test;
+
+int main(int argc, char** argv) {
+    TestSuite ts(argc, argv);
+
+    ts.options.printTestMessage = true;
+
+    ts.doTest( "make group test",
+               make_group_test );
+
+    ts.doTest( "leader election test",
+               leader_election_test );
+
+#if defined(__linux__) || defined(__APPLE__)
+    ts.doTest( "ssl test",
+               ssl_test );
+
+    ts.doTest( "ssl session resumption test",
+               ssl_session_resumption_test );
+
+    ts.doTest( "unix domain socket test",
+               unix_socket_test,
+               TestRange<bool>( {false, true} ) );
+#endif
+
+    ts.doTest( "message meta test",
+               message_meta_test );
+
+    ts.doTest( "empty meta test",
+               empty_meta_test,
+               TestRange<bool>( {false, true} ) );
+
+    ts.doTest( "message meta random denial test",
+               message_meta_random_denial_test );
+
+    ts.doTest( "response hint test",
+               response_hint_test,
+               TestRange<bool>( {false, true} ) );
+
+    ts.doTest( "async append handler test",
+               async_append_handler_test,
+               TestRange<size_t>( {0, 1, 2} ) );
+
+    ts.doTest( "follower bg flush test",
+               follower_bg_flush_test );
+
+    ts.doTest( "parallel append senders test",
+               parallel_append_senders_test );
+
+    ts.doTest( "parallel append senders leader change test",
+               parallel_append_senders_leader_change_test );
+
+    ts.doTest( "crc32c header test",
+               crc32c_header_test );
+
+    ts.doTest( "log entry crc test",
+               log_entry_crc_test,
+               TestRange<bool>( {false, true} ) );
+
+    ts.doTest( "compression test",
+               compression_test,
+               TestRange<int>( { asio_service_options::lz4,
+                                 asio_service_options::zstd,
+                                 asio_service_options::zlib } ) );
+
+    ts.doTest( "io context per worker test",
+               io_context_per_worker_test,
+               TestRange<bool>( {false, true} ) );
+
+    ts.doTest( "multi connection test",
+               multi_connection_test,
+               TestRange<size_t>( {1, 2, 4} ) );
+
+    ts.doTest( "metrics endpoint test",
+               metrics_endpoint_test );
+
+    ts.doTest( "multi raft test",
+               multi_raft_test,
+               TestRange<bool>( {false, true} ) );
 
 #ifdef ENABLE_RAFT_STATS
     _msg("raft stats: ENABLED\n");
@@ -0,0 +1,271 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "async_logger.hxx"
+
+#include "test_common.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace nuraft;
+
+namespace async_logger_test {
+
+class capture_logger : public logger {
+public:
+    capture_logger()
+        : level_(6)
+        , blocked_(false)
+        {}
+
+    void set_level(int l) { level_ = l; }
+
+    int get_level() { return level_; }
+
+    void put_details(int level,
+                     const char* source_file,
+                     const char* func_name,
+                     size_t line_number,
+                     const std::string& log_line)
+    {
+        std::unique_lock<std::mutex> l(lock_);
+        while (blocked_) cv_.wait(l);
+        levels_.push_back(level);
+        lines_.push_back(log_line);
+        callers_.push_back(std::this_thread::get_id());
+    }
+
+    void block(bool to) {
+        std::lock_guard<std::mutex> l(lock_);
+        blocked_ = to;
+        cv_.notify_all();
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> l(lock_);
+        return lines_.size();
+    }
+
+    int level_;
+    bool blocked_;
+    std::mutex lock_;
+    std::condition_variable cv_;
+    std::vector<int> levels_;
+    std::vector<std::string> lines_;
+    std::vector<std::thread::id> callers_;
+};
+
+int order_test(size_t num_threads) {
+    const size_t NUM_LOGS = 10000;
+    ptr<capture_logger> backend = cs_new<capture_logger>();
+
+    async_logger::options opt;
+    opt.queue_size_ = num_threads * NUM_LOGS;
+    ptr<async_logger> al = cs_new<async_logger>(backend, opt);
+
+    std::vector<std::thread> threads;
+    for (size_t ii = 0; ii < num_threads; ++ii) {
+        threads.push_back( std::thread( [ii, al]() {
+            for (size_t jj = 0; jj < NUM_LOGS; ++jj) {
+                al->put_details( 4, __FILE__, __func__, __LINE__,
+                                 std::to_string(ii) + " " +
+                                 std::to_string(jj) );
+            }
+        } ) );
+    }
+    for (auto& entry: threads) entry.join();
+    al->flush();
+
+    CHK_EQ( 0, al->get_num_dropped() );
+    CHK_EQ( num_threads * NUM_LOGS, backend->size() );
+
+    // Logs from the same thread should keep their order,
+    // and should be written by the background thread.
+    std::vector<size_t> next_idx(num_threads, 0);
+    for (size_t ii = 0; ii < backend->lines_.size(); ++ii) {
+        size_t t_idx = 0, l_idx = 0;
+        sscanf(backend->lines_[ii].c_str(), "%zu %zu", &t_idx, &l_idx);
+        CHK_GT( num_threads, t_idx );
+        CHK_EQ( next_idx[t_idx], l_idx );
+        next_idx[t_idx]++;
+        CHK_FALSE( backend->callers_[ii] == std::this_thread::get_id() );
+    }
+
+    return 0;
+}
+
+int level_test() {
+    ptr<capture_logger> backend = cs_new<capture_logger>();
+    backend->set_level(5);
+    ptr<async_logger> al = cs_new<async_logger>(backend);
+
+    // Should inherit the level of the backend.
+    CHK_EQ( 5, al->get_level() );
+
+    al->set_level(3);
+    CHK_EQ( 3, al->get_level() );
+    CHK_EQ( 3, backend->get_level() );
+
+    al->put_details(4, __FILE__, __func__, __LINE__, "info");
+    al->put_details(3, __FILE__, __func__, __LINE__, "warn");
+    al->put_details(2, __FILE__, __func__, __LINE__, "error");
+    al->flush();
+
+    CHK_EQ( 2, backend->size() );
+    CHK_EQ( std::string("warn"), backend->lines_[0] );
+    CHK_EQ( std::string("error"), backend->lines_[1] );
+    CHK_EQ( 0, al->get_num_dropped() );
+
+    return 0;
+}
+
+int drop_test() {
+    const size_t NUM_LOGS = 100;
+    ptr<capture_logger> backend = cs_new<capture_logger>();
+
+    async_logger::options opt;
+    opt.queue_size_ = 4;
+    ptr<async_logger> al = cs_new<async_logger>(backend, opt);
+
+    // Backend is stuck, the queue will be full soon,
+    // but the caller should not be blocked.
+    backend->block(true);
+    for (size_t ii = 0; ii < NUM_LOGS; ++ii) {
+        al->put_details(4, __FILE__, __func__, __LINE__, std::to_string(ii));
+    }
+    CHK_GTEQ( al->get_num_dropped(), NUM_LOGS - 5 );
+
+    backend->block(false);
+    al->flush();
+    CHK_EQ( NUM_LOGS, backend->size() + al->get_num_dropped() );
+
+    // Fatal log should not be dropped.
+    backend->block(true);
+    for (size_t ii = 0; ii < 10; ++ii) {
+        al->put_details(4, __FILE__, __func__, __LINE__, "info");
+    }
+    std::thread releaser( [backend]() {
+        TestSuite::sleep_ms(100);
+        backend->block(false);
+    } );
+    al->put_details(1, __FILE__, __func__, __LINE__, "fatal");
+    releaser.join();
+    al->flush();
+
+    CHK_EQ( std::string("fatal"), backend->lines_.back() );
+    CHK_EQ( 1, backend->levels_.back() );
+
+    return 0;
+}
+
+int fatal_sync_test() {
+    ptr<capture_logger> backend = cs_new<capture_logger>();
+    ptr<async_logger> al = cs_new<async_logger>(backend);
+
+    for (size_t ii = 0; ii < 100; ++ii) {
+        al->put_details(4, __FILE__, __func__, __LINE__, std::to_string(ii));
+    }
+    // Fatal log should be written by the caller before returning,
+    // after all the previous logs.
+    al->put_details(1, __FILE__, __func__, __LINE__, "fatal");
+    CHK_EQ( 101, backend->size() );
+    CHK_EQ( std::string("99"), backend->lines_[99] );
+    CHK_EQ( std::string("fatal"), backend->lines_.back() );
+    CHK_EQ( 1, backend->levels_.back() );
+    CHK_TRUE( backend->callers_.back() == std::this_thread::get_id() );
+
+    return 0;
+}
+
+int stop_test() {
+    ptr<capture_logger> backend = cs_new<capture_logger>();
+    ptr<async_logger> al = cs_new<async_logger>(backend);
+
+    for (size_t ii = 0; ii < 100; ++ii) {
+        al->put_details(4, __FILE__, __func__, __LINE__, std::to_string(ii));
+    }
+    // Queued logs should be written on stop.
+    al->stop();
+    CHK_EQ( 100, backend->size() );
+
+    // After stop, logs are written directly.
+    al->put_details(4, __FILE__, __func__, __LINE__, "direct");
+    CHK_EQ( 101, backend->size() );
+    CHK_TRUE( backend->callers_.back() == std::this_thread::get_id() );
+
+    return 0;
+}
+
+int stop_race_test() {
+    const size_t NUM_THREADS = 4;
+    const size_t NUM_LOGS = 10000;
+    ptr<capture_logger> backend = cs_new<capture_logger>();
+    ptr<async_logger> al = cs_new<async_logger>(backend);
+
+    std::vector<std::thread> threads;
+    for (size_t ii = 0; ii < NUM_THREADS; ++ii) {
+        threads.push_back( std::thread( [al]() {
+            for (size_t jj = 0; jj < NUM_LOGS; ++jj) {
+                al->put_details( 4, __FILE__, __func__, __LINE__,
+                                 std::to_string(jj) );
+            }
+        } ) );
+    }
+    // Stop while the logs are being put.
+    TestSuite::sleep_ms(1);
+    al->stop();
+    for (auto& entry: threads) entry.join();
+
+    // Each log should be either written or counted as dropped.
+    CHK_EQ( NUM_THREADS * NUM_LOGS,
+            backend->size() + al->get_num_dropped() );
+
+    return 0;
+}
+
+}  // namespace async_logger_test;
+using namespace async_logger_test;
+
+int main(int argc, char** argv) {
+    TestSuite ts(argc, argv);
+
+    ts.options.printTestMessage = false;
+
+    ts.doTest( "order test",
+               order_test,
+               TestRange<size_t>( {1, 4} ) );
+
+    ts.doTest( "level test",
+               level_test );
+
+    ts.doTest( "drop test",
+               drop_test );
+
+    ts.doTest( "fatal sync test",
+               fatal_sync_test );
+
+    ts.doTest( "stop test",
+               stop_test );
+
+    ts.doTest( "stop race test",
+               stop_race_test );
+
+    return 0;
+}
@@ -25,6 +25,7 @@ limitations under the License.
 #include <cstring>
 #include <random>
 #include <string>
+#include <thread>
 
 using namespace nuraft;
 
@@ -244,6 +245,102 @@ int buffer_serializer_test(bool little_endian) {
     return 0;
 }
 
+int buffer_view_test(size_t data_size) {
+    // Mimic received log context: [meta (4 bytes)] [size (4 bytes)] [data]
+    ptr<buffer> src = buffer::alloc(sz_int + sz_int + data_size);
+    src->put((int32)0);
+    src->put((int32)data_size);
+    size_t offset = src->pos();
+    for (size_t ii = 0; ii < data_size; ++ii) {
+        src->put( (byte)(ii & 0xff) );
+    }
+
+    size_t meta_size = buffer::view_meta_size(data_size);
+    // Not enough room for the meta section.
+    CHK_NULL( buffer::view_in_place(src, meta_size - 1, data_size).get() );
+    // Out of bound.
+    CHK_NULL( buffer::view_in_place(src, offset, data_size + 1).get() );
+
+    ptr<buffer> view = buffer::view_in_place(src, offset, data_size);
+    CHK_NONNULL( view.get() );
+    CHK_EQ( data_size, view->size() );
+    CHK_Z( view->pos() );
+    CHK_EQ( src->data_begin() + offset, view->data_begin() );
+    for (size_t ii = 0; ii < data_size; ++ii) {
+        CHK_EQ( (byte)(ii & 0xff), view->get_byte() );
+    }
+
+    // View should keep the source buffer alive.
+    std::weak_ptr<buffer> src_weak = src;
+    src.reset();
+    CHK_FALSE( src_weak.expired() );
+    view.reset();
+    CHK_TRUE( src_weak.expired() );
+
+    // Meta section at an unaligned address.
+    src = buffer::alloc(sz_int + sz_int + data_size);
+    src->put((int32)0);
+    src->put((int32)data_size);
+    for (size_t ii = 0; ii < data_size; ++ii) {
+        src->put( (byte)(ii & 0xff) );
+    }
+    view = buffer::view_in_place(src, offset + 1, data_size - 1);
+    CHK_NONNULL( view.get() );
+    CHK_EQ( data_size - 1, view->size() );
+    CHK_EQ( src->data_begin() + offset + 1, view->data_begin() );
+    for (size_t ii = 1; ii < data_size; ++ii) {
+        CHK_EQ( (byte)(ii & 0xff), view->get_byte() );
+    }
+    view->pos(1);
+    CHK_EQ( 1, view->pos() );
+    CHK_EQ( (byte)2, view->get_byte() );
+
+    return 0;
+}
+
+int buffer_pool_test(size_t data_size) {
+    buffer::set_allocator( cs_new<buffer_pool>() );
+
+    ptr<buffer> buf = buffer::alloc(data_size);
+    CHK_EQ( data_size, buf->size() );
+    for (size_t ii = 0; ii < data_size; ++ii) {
+        buf->put( (byte)(ii & 0xff) );
+    }
+    byte* addr = buf->data_begin();
+    buf.reset();
+
+    // Freed block should be reused, with a clean meta section.
+    buf = buffer::alloc(data_size);
+    CHK_EQ( addr, buf->data_begin() );
+    CHK_EQ( data_size, buf->size() );
+    CHK_Z( buf->pos() );
+    buf->put( (byte)0xab );
+    buf->pos(0);
+    CHK_EQ( (byte)0xab, buf->get_byte() );
+
+    // Free the buffer in another thread, where it is cached
+    // and then released when the thread exits.
+    std::thread tt( [&buf]() { buf.reset(); } );
+    tt.join();
+    CHK_NULL( buf.get() );
+
+    // Too big to be pooled.
+    ptr<buffer> big = buffer::alloc(buffer_pool::MAX_BLOCK_SIZE);
+    CHK_EQ( buffer_pool::MAX_BLOCK_SIZE, big->size() );
+
+    // Back to the default allocator, a buffer allocated by the pool
+    // should be freed by the pool.
+    buffer::set_allocator(nullptr);
+    big.reset();
+    buffer_pool::release_thread_cache();
+
+#ifdef ENABLE_RAFT_STATS
+    CHK_GT( raft_server::get_stat_counter("buffer_pool_hits"), 0 );
+    CHK_GT( raft_server::get_stat_counter("buffer_pool_misses"), 0 );
+#endif
+    return 0;
+}
+
 }  // namespace buffer_test;
 using namespace buffer_test;
 
@@ -260,6 +357,14 @@ int main(int argc, char** argv) {
                buffer_serializer_test,
                TestRange<bool>( {true, false} ) );
 
+    ts.doTest( "buffer view test",
+               buffer_view_test,
+               TestRange<size_t>( {16, 0x8000, 0x10000} ) );
+
+    ts.doTest( "buffer pool test",
+               buffer_pool_test,
+               TestRange<size_t>( {16, 1024, 0x8000} ) );
+
     return 0;
 }
 
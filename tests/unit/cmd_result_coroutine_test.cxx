@@ -0,0 +1,159 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "async.hxx"
+#include "buffer.hxx"
+#include "buffer_serializer.hxx"
+
+#include "test_common.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+#ifndef NURAFT_COROUTINE_SUPPORT
+#error "This test requires C++20 coroutine support."
+#endif
+
+using namespace nuraft;
+
+namespace cmd_result_coroutine_test {
+
+using result_type = cmd_result< ptr<buffer> >;
+
+// Minimal coroutine type, started right away and
+// destroyed automatically once it finishes.
+struct task {
+    struct promise_type {
+        task get_return_object() { return task(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+struct await_ctx {
+    await_ctx()
+        : done_(false)
+        , value_(0)
+        , has_value_(false)
+        {}
+
+    std::atomic<bool> done_;
+    uint64_t value_;
+    bool has_value_;
+    std::thread::id resumed_thread_;
+};
+
+task await_result(ptr<result_type> res, await_ctx& ctx) {
+    ptr<buffer> value = co_await *res;
+    ctx.resumed_thread_ = std::this_thread::get_id();
+    ctx.has_value_ = (value != nullptr);
+    if (value) {
+        buffer_serializer bs(value);
+        ctx.value_ = bs.get_u64();
+    }
+    ctx.done_ = true;
+}
+
+ptr<buffer> make_value(uint64_t value) {
+    ptr<buffer> ret = buffer::alloc(sizeof(uint64_t));
+    buffer_serializer bs(ret);
+    bs.put_u64(value);
+    ret->pos(0);
+    return ret;
+}
+
+int ready_test() {
+    // Result is already set, should not suspend.
+    ptr<buffer> value = make_value(1234);
+    ptr<result_type> res = cs_new<result_type>(value);
+
+    await_ctx ctx;
+    await_result(res, ctx);
+    CHK_TRUE( ctx.done_.load() );
+    CHK_TRUE( ctx.has_value_ );
+    CHK_EQ( 1234, ctx.value_ );
+    CHK_TRUE( std::this_thread::get_id() == ctx.resumed_thread_ );
+
+    return 0;
+}
+
+int async_test() {
+    ptr<result_type> res = cs_new<result_type>();
+
+    // Should be suspended until the result is set.
+    await_ctx ctx;
+    await_result(res, ctx);
+    CHK_FALSE( ctx.done_.load() );
+
+    std::thread::id setter_thread;
+    std::thread tt( [&]() {
+        setter_thread = std::this_thread::get_id();
+        ptr<buffer> value = make_value(5678);
+        ptr<std::exception> err;
+        res->set_result(value, err);
+    } );
+    tt.join();
+
+    // Should be resumed by the thread setting the result.
+    CHK_TRUE( ctx.done_.load() );
+    CHK_TRUE( ctx.has_value_ );
+    CHK_EQ( 5678, ctx.value_ );
+    CHK_TRUE( setter_thread == ctx.resumed_thread_ );
+
+    return 0;
+}
+
+int error_test() {
+    ptr<result_type> res = cs_new<result_type>();
+
+    await_ctx ctx;
+    await_result(res, ctx);
+    CHK_FALSE( ctx.done_.load() );
+
+    // With an error, empty result should be returned, the same as `get()`.
+    ptr<buffer> value = make_value(1);
+    ptr<std::exception> err = cs_new<std::runtime_error>("test error");
+    res->set_result(value, err);
+    CHK_TRUE( ctx.done_.load() );
+    CHK_FALSE( ctx.has_value_ );
+
+    return 0;
+}
+
+}  // namespace cmd_result_coroutine_test;
+using namespace cmd_result_coroutine_test;
+
+int main(int argc, char** argv) {
+    TestSuite ts(argc, argv);
+
+    ts.options.printTestMessage = false;
+
+    ts.doTest( "ready test",
+               ready_test );
+
+    ts.doTest( "async test",
+               async_test );
+
+    ts.doTest( "error test",
+               error_test );
+
+    return 0;
+}
+
@@ -0,0 +1,122 @@
+/************************************************************************
+Modifications Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Original Copyright:
+See URL: https://github.com/datatechnology/cornerstone
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "crc32.hxx"
+#include "nuraft.hxx"
+
+#include "test_common.h"
+
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+
+using namespace nuraft;
+
+namespace crc32_test {
+
+int crc32_known_value_test() {
+    const std::string str = "123456789";
+
+    CHK_EQ( (uint32_t)0xCBF43926, crc32_8(str.data(), str.size(), 0) );
+    CHK_EQ( (uint32_t)0xCBF43926, crc32_1(str.data(), str.size(), 0) );
+
+    CHK_EQ( (uint32_t)0xE3069283, crc32c_sw(str.data(), str.size(), 0) );
+    CHK_EQ( (uint32_t)0xE3069283, crc32c(str.data(), str.size(), 0) );
+
+    TestSuite::_msg( "hardware CRC32C: %s\n",
+                     crc32c_hw_available() ? "available" : "not available" );
+    return 0;
+}
+
+int crc32c_sw_hw_test() {
+    const size_t MAX_LEN = 300;
+    std::vector<uint8_t> data(MAX_LEN + 8);
+    for (uint8_t& cc: data) cc = (uint8_t)rand();
+
+    // Various lengths and (unaligned) offsets.
+    for (size_t offset = 0; offset < 8; ++offset) {
+        for (size_t len = 0; len <= MAX_LEN; ++len) {
+            const uint8_t* ptr = data.data() + offset;
+            CHK_EQ( crc32c_sw(ptr, len, 0), crc32c(ptr, len, 0) );
+        }
+    }
+
+    // Continued calculation should be the same as the one-shot.
+    uint32_t whole = crc32c(data.data(), MAX_LEN, 0);
+    for (size_t split = 0; split <= MAX_LEN; split += 7) {
+        uint32_t first = crc32c(data.data(), split, 0);
+        CHK_EQ( whole, crc32c(data.data() + split, MAX_LEN - split, first) );
+        first = crc32c_sw(data.data(), split, 0);
+        CHK_EQ( whole, crc32c_sw(data.data() + split, MAX_LEN - split, first) );
+    }
+    return 0;
+}
+
+typedef uint32_t (*crc_func)(const void*, size_t, uint32_t);
+
+int crc32_throughput_test() {
+    const size_t BUF_SIZE = 64 * 1024;
+    const size_t TOTAL_SIZE = (size_t)256 * 1024 * 1024;
+    std::vector<uint8_t> data(BUF_SIZE);
+    for (uint8_t& cc: data) cc = (uint8_t)rand();
+
+    struct impl {
+        const char* name;
+        crc_func func;
+    } impls[] = { {"crc32_1", crc32_1},
+                  {"crc32_8", crc32_8},
+                  {"crc32c_sw", crc32c_sw},
+                  {"crc32c", crc32c} };
+
+    for (impl& ii: impls) {
+        uint32_t crc = 0;
+        TestSuite::Timer tt;
+        for (size_t done = 0; done < TOTAL_SIZE; done += BUF_SIZE) {
+            crc = ii.func(data.data(), BUF_SIZE, crc);
+        }
+        uint64_t us = tt.getTimeUs();
+        TestSuite::_msg( "%-10s %8.2f GB/s (%x)\n",
+                         ii.name,
+                         (double)TOTAL_SIZE / 1000.0 / (us ? us : 1),
+                         crc );
+    }
+    return 0;
+}
+
+}  // namespace crc32_test;
+using namespace crc32_test;
+
+int main(int argc, char** argv) {
+    TestSuite ts(argc, argv);
+
+    ts.options.printTestMessage = true;
+
+    ts.doTest( "crc32 known value test",
+               crc32_known_value_test );
+
+    ts.doTest( "crc32c software and hardware test",
+               crc32c_sw_hw_test );
+
+    ts.doTest( "crc32 throughput test",
+               crc32_throughput_test );
+
+    return 0;
+}
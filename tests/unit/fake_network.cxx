@@ -20,13 +20,37 @@ limitations under the License.
 
 #include "logger.h"
 
+#include <algorithm>
 #include <cassert>
+#include <limits>
 
 namespace nuraft {
 
+// Rough size of a message on the wire, used for bandwidth simulation.
+static const size_t MSG_HEADER_SIZE = 64;
+static const size_t LOG_HEADER_SIZE = 24;
+
+static size_t getReqSize(req_msg& req) {
+    size_t ret = MSG_HEADER_SIZE;
+    for (ptr<log_entry>& le: req.log_entries()) {
+        ret += LOG_HEADER_SIZE;
+        if (!le->is_buf_null()) ret += le->get_buf().size();
+    }
+    return ret;
+}
+
+static size_t getRespSize(resp_msg& resp) {
+    size_t ret = MSG_HEADER_SIZE;
+    if (resp.get_ctx()) ret += resp.get_ctx()->size();
+    return ret;
+}
+
 // === FakeNetworkBase
 
-FakeNetworkBase::FakeNetworkBase() {
+FakeNetworkBase::FakeNetworkBase()
+    : clockUs(0)
+    , rng(0)
+{
     myLog = new SimpleLogger("./base.log", 1024, 32*1024*1024, 10);
     myLog->setLogLevel(6);
     myLog->setDispLevel(-1);
@@ -61,6 +85,69 @@ FakeNetwork* FakeNetworkBase::findNetwork(const std::string& endpoint) {
     return (entry->second).get();
 }
 
+void FakeNetworkBase::advanceClockTo(uint64_t us) {
+    uint64_t cur = clockUs.load();
+    while (cur < us && !clockUs.compare_exchange_weak(cur, us));
+}
+
+void FakeNetworkBase::setLinkProfile(const LinkProfile& profile) {
+    std::lock_guard<std::mutex> l(linksLock);
+    defaultProfile = profile;
+    for (auto& entry: links) entry.second.profile = profile;
+}
+
+void FakeNetworkBase::setLinkProfile(const std::string& src,
+                                     const std::string& dst,
+                                     const LinkProfile& profile)
+{
+    std::lock_guard<std::mutex> l(linksLock);
+    links[std::make_pair(src, dst)].profile = profile;
+}
+
+void FakeNetworkBase::setSeed(uint32_t seed) {
+    std::lock_guard<std::mutex> l(linksLock);
+    rng.seed(seed);
+}
+
+uint64_t FakeNetworkBase::scheduleArrival(const std::string& src,
+                                          const std::string& dst,
+                                          size_t num_bytes,
+                                          bool& lost)
+{
+    std::lock_guard<std::mutex> l(linksLock);
+    auto key = std::make_pair(src, dst);
+    auto entry = links.find(key);
+    if (entry == links.end()) {
+        entry = links.insert( std::make_pair(key, LinkState()) ).first;
+        entry->second.profile = defaultProfile;
+    }
+    LinkState& link = entry->second;
+    const LinkProfile& pp = link.profile;
+
+    // Messages on the same link are serialized by bandwidth.
+    uint64_t now = clockUs;
+    uint64_t start_us = std::max(now, link.busyUntilUs);
+    uint64_t tx_us = pp.bandwidthBps
+                     ? num_bytes * 1000000 / pp.bandwidthBps
+                     : 0;
+    link.busyUntilUs = start_us + tx_us;
+
+    uint64_t jitter_us = 0;
+    if (pp.jitterUs) {
+        jitter_us = std::uniform_int_distribution<uint64_t>(0, pp.jitterUs)(rng);
+    }
+    lost = false;
+    if (pp.lossRate > 0) {
+        lost = std::uniform_real_distribution<double>(0, 1)(rng) < pp.lossRate;
+    }
+
+    // Jitter should not reorder messages, as TCP does.
+    uint64_t arrival_us = link.busyUntilUs + pp.latencyUs + jitter_us;
+    arrival_us = std::max(arrival_us, link.lastArrivalUs);
+    link.lastArrivalUs = arrival_us;
+    return arrival_us;
+}
+
 
 // === FakeNetwork
 
@@ -171,7 +258,21 @@ bool FakeNetwork::delieverReqTo(const std::string& endpoint,
               myEndpoint.c_str(), endpoint.c_str(),
               msg_type_to_string( pkg.req->get_type() ).c_str() );
 
-    conn->pendingResps.push_back( FakeNetwork::RespPkg(resp, pkg.whenDone) );
+    FakeNetwork::RespPkg resp_pkg(resp, pkg.whenDone);
+    if (resp && resp->is_deferred()) {
+        ptr< std::atomic<int> > state = resp_pkg.state;
+        *state = RespPkg::WAITING;
+        resp_pkg.req = pkg.req;
+        resp->when_ready( [state](bool ok) {
+            *state = ok ? RespPkg::READY : RespPkg::FAILED;
+        } );
+    }
+    if (resp) {
+        bool lost = false;
+        resp_pkg.arrivalUs = base->scheduleArrival( endpoint, myEndpoint,
+                                                    getRespSize(*resp), lost );
+    }
+    conn->pendingResps.push_back(resp_pkg);
     conn->pendingReqs.erase(pkg_entry);
     return true;
 }
@@ -232,12 +333,24 @@ bool FakeNetwork::handleRespFrom(const std::string& endpoint,
     // Copy shared pointer for the case of reconnection,
     // as it drops all resps.
     RespPkg pkg = *pkg_entry;
+
+    // Deferred response that is not ready yet,
+    // the following ones should wait for it as well.
+    if (*pkg.state == RespPkg::WAITING) return false;
+
     _log_info(ll, "[BEGIN] deliver response %s -> %s, %s",
               endpoint.c_str(), myEndpoint.c_str(),
               msg_type_to_string( pkg.resp->get_type() ).c_str() );
 
     ptr<rpc_exception> exp;
-    pkg.whenDone( pkg.resp, exp );
+    if (*pkg.state == RespPkg::FAILED) {
+        ptr<resp_msg> rsp; // empty.
+        exp = cs_new<rpc_exception>
+              ( "failed to complete deferred response", pkg.req );
+        pkg.whenDone( rsp, exp );
+    } else {
+        pkg.whenDone( pkg.resp, exp );
+    }
 
     _log_info(ll, "[END] deliver response %s -> %s, %s",
               endpoint.c_str(), myEndpoint.c_str(),
@@ -260,6 +373,60 @@ void FakeNetwork::handleAllFrom(const std::string& endpoint) {
     while (handleRespFrom(endpoint));
 }
 
+bool FakeNetwork::execDue() {
+    // Same as `execReqResp`, keep the reference of clients.
+    std::unordered_map< std::string, ptr<FakeClient> > clients_clone;
+    {   std::lock_guard<std::mutex> ll(clientsLock);
+        clients_clone = clients;
+    }
+
+    // NOTE:
+    //   Failure of a request may replace the client, while functions
+    //   below always work on the current one. Hence we should find
+    //   the client again every time.
+    bool processed = false;
+    for (auto& entry: clients_clone) {
+        const std::string& cur_endpoint = entry.first;
+        while (true) {
+            ptr<FakeClient> conn = findClient(cur_endpoint);
+            if (!conn || conn->pendingReqs.empty()) break;
+            ReqPkg& pkg = conn->pendingReqs.front();
+            if (pkg.arrivalUs > base->getClockUs()) break;
+            if (pkg.lost) makeReqFail(cur_endpoint);
+            else delieverReqTo(cur_endpoint);
+            processed = true;
+        }
+        while (true) {
+            ptr<FakeClient> conn = findClient(cur_endpoint);
+            if (!conn || conn->pendingResps.empty()) break;
+            RespPkg& pkg = conn->pendingResps.front();
+            if (pkg.arrivalUs > base->getClockUs()) break;
+            if (!handleRespFrom(cur_endpoint)) break;
+            processed = true;
+        }
+    }
+    return processed;
+}
+
+uint64_t FakeNetwork::getNextEventUs() {
+    std::unordered_map< std::string, ptr<FakeClient> > clients_clone;
+    {   std::lock_guard<std::mutex> ll(clientsLock);
+        clients_clone = clients;
+    }
+
+    uint64_t ret = std::numeric_limits<uint64_t>::max();
+    for (auto& entry: clients_clone) {
+        ptr<FakeClient>& conn = entry.second;
+        if (!conn->pendingReqs.empty()) {
+            ret = std::min(ret, conn->pendingReqs.front().arrivalUs);
+        }
+        if (!conn->pendingResps.empty()) {
+            ret = std::min(ret, conn->pendingResps.front().arrivalUs);
+        }
+    }
+    return ret;
+}
+
 size_t FakeNetwork::getNumPendingReqs(const std::string& endpoint) {
     ptr<FakeClient> conn = findClient(endpoint);
     if (!conn) return 0;
@@ -302,7 +469,11 @@ void FakeClient::send(ptr<req_msg>& req, rpc_handler& when_done) {
               motherNet->getEndpoint().c_str(),
               dstNet->getEndpoint().c_str(),
               msg_type_to_string( req->get_type() ).c_str() );
-    pendingReqs.push_back( FakeNetwork::ReqPkg(req, when_done) );
+    FakeNetwork::ReqPkg pkg(req, when_done);
+    pkg.arrivalUs = motherNet->getBase()->scheduleArrival
+                    ( motherNet->getEndpoint(), dstNet->getEndpoint(),
+                      getReqSize(*req), pkg.lost );
+    pendingReqs.push_back(pkg);
 }
 
 void FakeClient::dropPackets() {
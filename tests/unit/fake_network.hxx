@@ -19,7 +19,9 @@ limitations under the License.
 
 #include "nuraft.hxx"
 
+#include <atomic>
 #include <map>
+#include <random>
 #include <unordered_map>
 
 class SimpleLogger;
@@ -39,18 +41,34 @@ public:
 
     struct ReqPkg {
         ReqPkg(ptr<req_msg>& _req, rpc_handler& _when_done)
-            : req(_req), whenDone(_when_done)
+            : req(_req), whenDone(_when_done), arrivalUs(0), lost(false)
             {}
         ptr<req_msg> req;
         rpc_handler whenDone;
+        // Virtual time when this request arrives at the destination.
+        uint64_t arrivalUs;
+        // If `true`, this request will fail on arrival.
+        bool lost;
     };
 
     struct RespPkg {
+        enum ReadyState {
+            READY = 0,
+            WAITING = 1,
+            FAILED = 2,
+        };
         RespPkg(ptr<resp_msg>& _resp, rpc_handler& _when_done)
-            : resp(_resp), whenDone(_when_done)
+            : resp(_resp), whenDone(_when_done), arrivalUs(0)
+            , state( cs_new< std::atomic<int> >(READY) )
             {}
         ptr<resp_msg> resp;
         rpc_handler whenDone;
+        // Virtual time when this response arrives at the source.
+        uint64_t arrivalUs;
+        // Deferred response is not sent until it becomes ready.
+        ptr< std::atomic<int> > state;
+        // Request of a deferred response, to make it fail.
+        ptr<req_msg> req;
     };
 
     FakeNetworkBase* getBase() const { return base.get(); }
@@ -82,6 +100,20 @@ public:
 
     void handleAllFrom(const std::string& endpoint);
 
+    /**
+     * Deliver requests and handle responses whose arrival time
+     * has passed on the virtual clock, to and from all endpoints.
+     *
+     * @return `true` if any message has been processed.
+     */
+    bool execDue();
+
+    /**
+     * Earliest arrival time of pending requests and responses
+     * of this network, or `UINT64_MAX` if nothing is pending.
+     */
+    uint64_t getNextEventUs();
+
     size_t getNumPendingReqs(const std::string& endpoint);
 
     size_t getNumPendingResps(const std::string& endpoint);
@@ -106,6 +138,41 @@ private:
     bool online;
 };
 
+/**
+ * Characteristics of a one-way link, used to compute the arrival time
+ * of each message on the virtual clock of `FakeNetworkBase`.
+ * Default (all zero) means instant delivery without loss.
+ */
+struct LinkProfile {
+    LinkProfile(uint64_t latency_us = 0,
+                uint64_t jitter_us = 0,
+                uint64_t bandwidth_bps = 0,
+                double loss_rate = 0.0)
+        : latencyUs(latency_us)
+        , jitterUs(jitter_us)
+        , bandwidthBps(bandwidth_bps)
+        , lossRate(loss_rate)
+        {}
+
+    // Within a data center, 0.2 ms RTT.
+    static LinkProfile lan() { return LinkProfile(100, 20, 10000000000ULL / 8); }
+
+    // Across availability zones, 2 ms RTT.
+    static LinkProfile crossAz() { return LinkProfile(1000, 200, 5000000000ULL / 8); }
+
+    // Across regions, 80 ms RTT.
+    static LinkProfile crossRegion() { return LinkProfile(40000, 2000, 1000000000ULL / 8); }
+
+    // One-way latency.
+    uint64_t latencyUs;
+    // Random delay added to the latency, uniform in [0, jitterUs].
+    uint64_t jitterUs;
+    // Bytes per second, 0 means unlimited.
+    uint64_t bandwidthBps;
+    // Probability that a request is lost.
+    double lossRate;
+};
+
 class FakeNetworkBase {
 public:
     FakeNetworkBase();
@@ -122,10 +189,68 @@ public:
 
     SimpleLogger* getLogger() const { return myLog; }
 
+    uint64_t getClockUs() const { return clockUs; }
+
+    /**
+     * Move the virtual clock forward. It never goes backward.
+     */
+    void advanceClockTo(uint64_t us);
+
+    void advanceClock(uint64_t us) { advanceClockTo(clockUs + us); }
+
+    /**
+     * Set the profile of all links, including the ones
+     * that have their own profile.
+     */
+    void setLinkProfile(const LinkProfile& profile);
+
+    /**
+     * Set the profile of the link from `src` to `dst`.
+     */
+    void setLinkProfile(const std::string& src,
+                        const std::string& dst,
+                        const LinkProfile& profile);
+
+    void setSeed(uint32_t seed);
+
+    /**
+     * Compute the arrival time of a message of the given size,
+     * sent from `src` to `dst` at the current virtual time.
+     *
+     * @param[out] lost `true` if the message is lost.
+     * @return Arrival time.
+     */
+    uint64_t scheduleArrival(const std::string& src,
+                             const std::string& dst,
+                             size_t num_bytes,
+                             bool& lost);
+
 private:
+    struct LinkState {
+        LinkState() : busyUntilUs(0), lastArrivalUs(0) {}
+        LinkProfile profile;
+        // The link is sending the previous message until this time.
+        uint64_t busyUntilUs;
+        // To keep the order of messages on the same link.
+        uint64_t lastArrivalUs;
+    };
+
     // <endpoint, network instance>
     std::map<std::string, ptr<FakeNetwork>> nets;
 
+    // Current virtual time.
+    std::atomic<uint64_t> clockUs;
+
+    // Profile of links that have no specific profile.
+    LinkProfile defaultProfile;
+
+    // <{src, dst}, link state>
+    std::map< std::pair<std::string, std::string>, LinkState > links;
+
+    std::mt19937 rng;
+
+    std::mutex linksLock;
+
     SimpleLogger* myLog;
 };
 
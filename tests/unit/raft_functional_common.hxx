@@ -24,6 +24,7 @@ limitations under the License.
 #include "test_common.h"
 
 #include <cassert>
+#include <functional>
 #include <list>
 #include <map>
 #include <sstream>
@@ -41,6 +42,9 @@ class TestSm : public state_machine {
 public:
     TestSm(SimpleLogger* logger = nullptr)
         : customBatchSize(0)
+        , streamObjs(0)
+        , numCommitBatches(0)
+        , maxCommitBatchSize(0)
         , myLog(logger)
     {
         (void)myLog;
@@ -49,6 +53,12 @@ public:
     ~TestSm() {}
 
     ptr<buffer> commit(const ulong log_idx, buffer& data) {
+        std::function<void(ulong)> hook;
+        {   std::lock_guard<std::mutex> ll(commitHookLock);
+            hook = commitHook;
+        }
+        if (hook) hook(log_idx);
+
         std::lock_guard<std::mutex> ll(dataLock);
         commits[log_idx] = buffer::copy(data);
 
@@ -58,6 +68,44 @@ public:
         return ret;
     }
 
+    void commit_batch(const std::vector<ext_op_params>& params,
+                      std::vector< ptr<buffer> >& results_out)
+    {
+        numCommitBatches++;
+        if (maxCommitBatchSize < params.size()) {
+            maxCommitBatchSize = params.size();
+        }
+        state_machine::commit_batch(params, results_out);
+    }
+
+    void commit_packed(const std::vector<ext_op_params>& params,
+                       std::vector< ptr<buffer> >& results_out)
+    {
+        std::lock_guard<std::mutex> ll(dataLock);
+        results_out.resize(params.size());
+        if (params.empty()) return;
+
+        ulong log_idx = params[0].log_idx;
+        std::vector< ptr<buffer> >& payloads = packedCommits[log_idx];
+        payloads.clear();
+        for (size_t ii = 0; ii < params.size(); ++ii) {
+            payloads.push_back( buffer::copy(*params[ii].data) );
+
+            // Log index and the position in the pack.
+            ptr<buffer> ret = buffer::alloc(sizeof(ulong) + sizeof(uint32_t));
+            buffer_serializer bs(ret);
+            bs.put_u64(log_idx);
+            bs.put_u32(ii);
+            results_out[ii] = ret;
+        }
+
+        std::string marker = "packed";
+        ptr<buffer> marker_buf = buffer::alloc(marker.size() + 1);
+        marker_buf->put(marker);
+        marker_buf->pos(0);
+        commits[log_idx] = marker_buf;
+    }
+
     ptr<buffer> pre_commit(const ulong log_idx, buffer& data) {
         std::lock_guard<std::mutex> ll(dataLock);
         preCommits[log_idx] = buffer::copy(data);
@@ -179,6 +227,82 @@ public:
         return 0;
     }
 
+    // Stream `stream_id` sends the logs whose index modulo
+    // `num_streams` is `stream_id`, while metadata (object 0) is
+    // sent by stream 0.
+    int read_logical_snp_obj_stream(snapshot& s,
+                                    void*& user_snp_ctx,
+                                    int32 stream_id,
+                                    int32 num_streams,
+                                    ulong obj_id,
+                                    ptr<buffer>& data_out,
+                                    bool& is_last_obj)
+    {
+        if (stream_id == 0 && obj_id == 0) {
+            return read_logical_snp_obj(s, user_snp_ctx, obj_id,
+                                        data_out, is_last_obj);
+        }
+
+        if (obj_id == 0) {
+            // First object of other streams.
+            auto entry = commits.begin();
+            ulong first_idx = (entry != commits.end()) ? entry->first : 0;
+            obj_id = first_stream_idx(first_idx, stream_id, num_streams);
+        }
+        if (!obj_id || obj_id > s.get_last_log_idx()) {
+            // Nothing to send in this stream.
+            data_out = buffer::alloc(0);
+            is_last_obj = true;
+            return 0;
+        }
+
+        bool dummy = false;
+        read_logical_snp_obj(s, user_snp_ctx, obj_id, data_out, dummy);
+        is_last_obj = (obj_id + num_streams > s.get_last_log_idx());
+        return 0;
+    }
+
+    void save_logical_snp_obj_stream(snapshot& s,
+                                     int32 stream_id,
+                                     int32 num_streams,
+                                     ulong& obj_id,
+                                     buffer& data,
+                                     bool is_first_obj,
+                                     bool is_last_obj)
+    {
+        if (stream_id == 0 && obj_id == 0) {
+            // Metadata: start from the first log of stream 0.
+            buffer_serializer bs(data);
+            ulong first_idx = bs.get_u64();
+            obj_id = first_stream_idx(first_idx, 0, num_streams);
+            return;
+        }
+        if (data.size() == 0) return;
+
+        buffer_serializer bs(data);
+        ulong log_idx = bs.get_u64();
+        streamObjs++;
+        if (data.size() > sizeof(ulong)) {
+            int32 data_size = bs.get_i32();
+            ptr<buffer> data_commit = buffer::alloc(data_size);
+            bs.get_buffer( data_commit );
+            commits[log_idx] = data_commit;
+            preCommits[log_idx] = buffer::copy(*data_commit);
+        }
+        obj_id = log_idx + num_streams;
+    }
+
+    static ulong first_stream_idx(ulong first_idx,
+                                  int32 stream_id,
+                                  int32 num_streams)
+    {
+        if (!first_idx) return 0;
+        ulong rem = first_idx % num_streams;
+        return first_idx + ( (stream_id + num_streams - rem) % num_streams );
+    }
+
+    size_t getNumStreamObjs() const { return streamObjs; }
+
     void free_user_snp_ctx(void*& user_snp_ctx) {
         if (!user_snp_ctx) return;
 
@@ -296,6 +420,23 @@ public:
         return entry->first;
     }
 
+    uint64_t getNumCommitBatches() const { return numCommitBatches; }
+
+    uint64_t getMaxCommitBatchSize() const { return maxCommitBatchSize; }
+
+    // Called at the beginning of each `commit` call.
+    void setCommitHook(const std::function<void(ulong)>& hook) {
+        std::lock_guard<std::mutex> ll(commitHookLock);
+        commitHook = hook;
+    }
+
+    std::vector< ptr<buffer> > getPackedData(ulong log_idx) const {
+        std::lock_guard<std::mutex> ll(dataLock);
+        auto entry = packedCommits.find(log_idx);
+        if (entry == packedCommits.end()) return {};
+        return entry->second;
+    }
+
     ptr<buffer> getData(ulong log_idx) const {
         std::lock_guard<std::mutex> ll(dataLock);
         auto entry = commits.find(log_idx);
@@ -306,24 +447,35 @@ public:
 private:
     std::map<uint64_t, ptr<buffer>> preCommits;
     std::map<uint64_t, ptr<buffer>> commits;
+    std::map<uint64_t, std::vector< ptr<buffer> >> packedCommits;
     std::list<uint64_t> rollbacks;
     mutable std::mutex dataLock;
 
     ptr<snapshot> lastSnapshot;
     mutable std::mutex lastSnapshotLock;
 
+    std::function<void(ulong)> commitHook;
+    std::mutex commitHookLock;
+
     std::atomic<uint64_t> customBatchSize;
 
+    // Number of objects saved by `save_logical_snp_obj_stream`.
+    std::atomic<size_t> streamObjs;
+
+    std::atomic<uint64_t> numCommitBatches;
+    std::atomic<uint64_t> maxCommitBatchSize;
+
     SimpleLogger* myLog;
 };
 
 class TestMgr : public state_mgr {
 public:
     TestMgr(int srv_id,
-            const std::string& endpoint)
+            const std::string& endpoint,
+            ptr<inmem_log_store> log_store = nullptr)
         : myId(srv_id)
         , myEndpoint(endpoint)
-        , curLogStore( cs_new<inmem_log_store>() )
+        , curLogStore( log_store ? log_store : cs_new<inmem_log_store>() )
     {
         mySrvConfig = cs_new<srv_config>
                       ( srv_id,
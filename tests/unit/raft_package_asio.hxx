@@ -51,6 +51,16 @@ public:
         , readReqMeta(nullptr)
         , writeReqMeta(nullptr)
         , alwaysInvokeCb(true)
+        , zeroCopyReceive(false)
+        , compactLogEntries(false)
+        , crc32cHeader(false)
+        , logEntryCrc(false)
+        , compressionType(asio_service_options::none)
+        , ioContextPerWorker(false)
+        , pinWorkerThreads(false)
+        , connectionsPerPeer(1)
+        , metricsHttpPort(0)
+        , sslSessionResumption(false)
         , myLogWrapper(nullptr)
         , myLog(nullptr)
         {}
@@ -95,6 +105,7 @@ public:
             asio_opt.server_cert_file_  = "./cert.pem";
             asio_opt.root_cert_file_    = "./cert.pem"; // self-signed.
             asio_opt.server_key_file_   = "./key.pem";
+            asio_opt.ssl_session_resumption_ = sslSessionResumption;
         }
 
         if (readReqMeta) asio_opt.read_req_meta_ = readReqMeta;
@@ -105,12 +116,25 @@ public:
 
         asio_opt.invoke_req_cb_on_empty_meta_ = alwaysInvokeCb;
         asio_opt.invoke_resp_cb_on_empty_meta_ = alwaysInvokeCb;
+        asio_opt.zero_copy_log_receive_ = zeroCopyReceive;
+        asio_opt.compact_log_entries_ = compactLogEntries;
+        asio_opt.crc32c_header_ = crc32cHeader;
+        asio_opt.log_entry_crc_ = logEntryCrc;
+        asio_opt.compression_type_ = compressionType;
+        asio_opt.io_context_per_worker_ = ioContextPerWorker;
+        asio_opt.pin_worker_threads_ = pinWorkerThreads;
+        asio_opt.connections_per_peer_ = connectionsPerPeer;
+        asio_opt.metrics_http_port_ = metricsHttpPort;
 
         asioSvc = cs_new<asio_service>(asio_opt, myLog);
 
         int raft_port = 20000 + myId * 10;
-        ptr<rpc_listener> listener
-                          ( asioSvc->create_rpc_listener(raft_port, myLog) );
+        ptr<rpc_listener> listener;
+        if (myEndpoint.find("unix://") == 0) {
+            listener = asioSvc->create_rpc_listener(myEndpoint, myLog);
+        } else {
+            listener = asioSvc->create_rpc_listener(raft_port, myLog);
+        }
         ptr<delayed_task_scheduler> scheduler = asioSvc;
         ptr<rpc_client_factory> rpc_cli_factory = asioSvc;
 
@@ -130,6 +154,38 @@ public:
         asioListener->listen(raftServer);
     }
 
+    // Launch a Raft server of the given group, on the Asio service
+    // and the listener shared by the other groups (Multi-Raft).
+    void initGroupServer(ptr<asio_service>& svc,
+                         ptr<raft_group_dispatcher>& dispatcher,
+                         int32 group_id)
+    {
+        std::string log_file_name = "./srv" + std::to_string(myId) +
+                                    "_g" + std::to_string(group_id) + ".log";
+        myLogWrapper = cs_new<logger_wrapper>(log_file_name);
+        myLog = myLogWrapper;
+
+        sMgr = cs_new<TestMgr>(myId, myEndpoint);
+        sm = cs_new<TestSm>( myLogWrapper->getLogger() );
+
+        ptr<rpc_listener> listener;
+        ptr<delayed_task_scheduler> scheduler = svc;
+        ptr<rpc_client_factory> rpc_cli_factory =
+            svc->create_group_client_factory(group_id);
+
+        raft_params params;
+        params.with_hb_interval(HEARTBEAT_MS);
+        params.with_election_timeout_lower(HEARTBEAT_MS * 2);
+        params.with_election_timeout_upper(HEARTBEAT_MS * 4);
+        params.with_reserved_log_items(10);
+        params.with_snapshot_enabled(5);
+        params.with_client_req_timeout(10000);
+        context* ctx( new context( sMgr, sm, listener, myLog,
+                                   rpc_cli_factory, scheduler, params ) );
+        raftServer = cs_new<raft_server>(ctx);
+        dispatcher->register_group(group_id, raftServer);
+    }
+
     void stopAsio() {
         if (asioListener) {
             asioListener->stop();
@@ -179,6 +235,36 @@ public:
 
     bool alwaysInvokeCb;
 
+    // If `true`, received log entries refer to the receive buffer.
+    bool zeroCopyReceive;
+
+    // If `true`, received log entries are created in the compact layout.
+    bool compactLogEntries;
+
+    // If `true`, use CRC32C for request headers.
+    bool crc32cHeader;
+
+    // If `true`, send CRC32C of each log entry.
+    bool logEntryCrc;
+
+    // Codec for compressing requests.
+    asio_service_options::compression_type compressionType;
+
+    // If `true`, each Asio worker runs its own io_service.
+    bool ioContextPerWorker;
+
+    // If `true`, pin Asio workers to CPU cores.
+    bool pinWorkerThreads;
+
+    // Number of connections to each peer.
+    size_t connectionsPerPeer;
+
+    // If non-zero, port of the HTTP metrics endpoint.
+    uint16_t metricsHttpPort;
+
+    // If `true`, resume TLS sessions when reconnecting.
+    bool sslSessionResumption;
+
     ptr<logger_wrapper> myLogWrapper;
     ptr<logger> myLog;
 };
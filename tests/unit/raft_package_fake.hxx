@@ -41,6 +41,7 @@ public:
         , scheduler(nullptr)
         , ctx(nullptr)
         , raftServer(nullptr)
+        , logStore(nullptr)
         {}
 
     ~RaftPkg() {
@@ -57,7 +58,7 @@ public:
         fBase->addNetwork(fNet);
 
         fTimer = cs_new<FakeTimer>( myEndpoint, fBase->getLogger() );
-        sMgr = cs_new<TestMgr>(myId, myEndpoint);
+        sMgr = cs_new<TestMgr>(myId, myEndpoint, logStore);
         sm = cs_new<TestSm>( fBase->getLogger() );
 
         std::string log_file_name = "./srv" + std::to_string(myId) + ".log";
@@ -125,6 +126,9 @@ public:
     raft_params params;
     context* ctx;
     ptr<raft_server> raftServer;
+
+    // If set before `initServer`, used instead of the default log store.
+    ptr<inmem_log_store> logStore;
 };
 
 static INT_UNUSED launch_servers(const std::vector<RaftPkg*>& pkgs,
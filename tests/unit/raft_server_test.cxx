@@ -21,6 +21,9 @@ limitations under the License.
 #include "event_awaiter.h"
 #include "test_common.h"
 
+#include <mutex>
+#include <thread>
+
 #include <stdio.h>
 
 using namespace nuraft;
@@ -1229,6 +1232,107 @@ int leadership_takeover_offline_candidate_test() {
     return 0;
 }
 
+int leadership_takeover_successor_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        pp->raftServer->update_params(param);
+    }
+
+    // Set the priority of S2 to 100.
+    s1.raftServer->set_priority(2, 100);
+    // Send priority change reqs.
+    s1.fNet->execReqResp();
+    // Send reqs again for commit.
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+    // Append a message, and replicate it to S2 only,
+    // so that S3 is behind the leader.
+    std::string test_msg = "test";
+    ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+    msg->put(test_msg);
+    CHK_TRUE( s1.raftServer->append_entries( {msg} )->get_accepted() );
+    s1.fNet->execReqResp(s2_addr);
+    s1.fNet->execReqResp(s2_addr);
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+    // Yield leadership to S3, even though S2 has higher priority.
+    s1.dbgLog(" --- yield leadership to S3 ---");
+    s1.raftServer->yield_leadership(false, 3);
+
+    // Write should be paused.
+    msg = buffer::alloc(test_msg.size() + 1);
+    msg->put(test_msg);
+    CHK_FALSE( s1.raftServer->append_entries( {msg} )->get_accepted() );
+
+    // Catch-up of S3 should have started without heartbeat,
+    // S1 will resign once S3 gets the latest log.
+    s1.fNet->execReqResp(s3_addr);
+    CHK_FALSE( s1.raftServer->is_leader() );
+
+    // Now S3 should have received takeover request.
+    s1.fNet->execReqResp(s3_addr);
+    // Send vote requests, S3 will not use pre-vote.
+    s3.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+    // Send new config as a new leader.
+    s3.fNet->execReqResp();
+    // Follow-up: commit.
+    s3.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+    CHK_FALSE( s1.raftServer->is_leader() );
+    CHK_FALSE( s2.raftServer->is_leader() );
+    CHK_TRUE( s3.raftServer->is_leader() );
+
+    // Yield to S1 which is already caught up,
+    // S3 should resign right away.
+    s3.dbgLog(" --- yield leadership to S1 ---");
+    s3.raftServer->yield_leadership(false, 1);
+    CHK_FALSE( s3.raftServer->is_leader() );
+
+    // Takeover request, and then vote requests.
+    s3.fNet->execReqResp(s1_addr);
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+    CHK_TRUE( s1.raftServer->is_leader() );
+    CHK_FALSE( s2.raftServer->is_leader() );
+    CHK_FALSE( s3.raftServer->is_leader() );
+
+    print_stats(pkgs);
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
 int temporary_leader_test() {
     reset_log_files();
     ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
@@ -1622,6 +1726,237 @@ int snapshot_basic_test() {
     return 0;
 }
 
+int snapshot_prefetch_test() {
+    const int32 prefetch_blocks[] = {1, 4};
+    for (int32 num_blocks: prefetch_blocks) {
+        reset_log_files();
+        ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+        std::string s1_addr = "S1";
+        std::string s2_addr = "S2";
+        std::string s3_addr = "S3";
+
+        RaftPkg s1(f_base, 1, s1_addr);
+        RaftPkg s2(f_base, 2, s2_addr);
+        RaftPkg s3(f_base, 3, s3_addr);
+        std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+        CHK_Z( launch_servers( pkgs ) );
+        CHK_Z( make_group( pkgs ) );
+
+        raft_params param = s1.raftServer->get_current_params();
+        param.with_snapshot_prefetch_blocks(num_blocks);
+        s1.raftServer->update_params(param);
+
+        // Append a message using separate thread.
+        ExecArgs exec_args(&s1);
+        TestSuite::ThreadHolder hh(&exec_args, fake_executer, fake_executer_killer);
+
+        for (size_t ii=0; ii<10; ++ii) {
+            std::string test_msg = "test" + std::to_string(ii);
+            ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+            msg->put(test_msg);
+            exec_args.setMsg(msg);
+            exec_args.eaExecuter.invoke();
+
+            // Wait for executer thread.
+            TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+            CHK_NULL( exec_args.getMsg().get() );
+
+            // NOTE: Send it to S2 only, S3 will be lagging behind.
+            s1.fNet->execReqResp("S2"); // replication.
+            s1.fNet->execReqResp("S2"); // commit.
+            TestSuite::sleep_ms(COMMIT_TIME_MS); // commit execution.
+        }
+        // Make req to S3 failed.
+        s1.fNet->makeReqFail("S3");
+
+        // Trigger heartbeat to S3, it will initiate snapshot transmission.
+        s1.fTimer->invoke(timer_task_type::heartbeat_timer);
+
+        // Blocks are sent by the background thread once they are
+        // read, keep delivering them until S3 catches up.
+        for (size_t ii = 0; ii < 1000; ++ii) {
+            s1.fNet->execReqResp();
+            if ( !s3.raftServer->is_receiving_snapshot() &&
+                 s3.getTestSm()->isSame( *s1.getTestSm() ) ) {
+                break;
+            }
+            TestSuite::sleep_ms(1);
+        }
+
+        // State machine should be identical.
+        CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+        CHK_OK( s3.getTestSm()->isSame( *s1.getTestSm() ) );
+
+        print_stats(pkgs);
+
+        s1.raftServer->shutdown();
+        s2.raftServer->shutdown();
+        s3.raftServer->shutdown();
+
+        fake_executer_killer(&exec_args);
+        hh.join();
+        CHK_Z( hh.getResult() );
+
+        f_base->destroy();
+    }
+    return 0;
+}
+
+int snapshot_prefetch_shutdown_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    raft_params param = s1.raftServer->get_current_params();
+    param.with_snapshot_prefetch_blocks(4);
+    s1.raftServer->update_params(param);
+
+    // Append a message using separate thread.
+    ExecArgs exec_args(&s1);
+    TestSuite::ThreadHolder hh(&exec_args, fake_executer, fake_executer_killer);
+
+    for (size_t ii=0; ii<10; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        exec_args.setMsg(msg);
+        exec_args.eaExecuter.invoke();
+
+        // Wait for executer thread.
+        TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+        CHK_NULL( exec_args.getMsg().get() );
+
+        // NOTE: Send it to S2 only, S3 will be lagging behind.
+        s1.fNet->execReqResp("S2"); // replication.
+        s1.fNet->execReqResp("S2"); // commit.
+        TestSuite::sleep_ms(COMMIT_TIME_MS); // commit execution.
+    }
+    // Make req to S3 failed.
+    s1.fNet->makeReqFail("S3");
+
+    // Trigger heartbeat to S3, it will initiate snapshot transmission.
+    s1.fTimer->invoke(timer_task_type::heartbeat_timer);
+
+    // Deliver only a part of the snapshot, and then stop the leader
+    // while blocks are being prefetched.
+    for (size_t ii = 0; ii < 1000; ++ii) {
+        s1.fNet->execReqResp();
+        if (s3.raftServer->is_receiving_snapshot()) break;
+        TestSuite::sleep_ms(1);
+    }
+    CHK_TRUE( s3.raftServer->is_receiving_snapshot() );
+
+    fake_executer_killer(&exec_args);
+    hh.join();
+    CHK_Z( hh.getResult() );
+
+    // Prefetcher should not touch the leader after it is destroyed.
+    s1.raftServer->shutdown();
+    s1.raftServer.reset();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+    return 0;
+}
+
+int snapshot_streams_test() {
+    const int32 streams[] = {2, 3};
+    for (int32 num_streams: streams) {
+        reset_log_files();
+        ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+        std::string s1_addr = "S1";
+        std::string s2_addr = "S2";
+        std::string s3_addr = "S3";
+
+        RaftPkg s1(f_base, 1, s1_addr);
+        RaftPkg s2(f_base, 2, s2_addr);
+        RaftPkg s3(f_base, 3, s3_addr);
+        std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+        CHK_Z( launch_servers( pkgs ) );
+        CHK_Z( make_group( pkgs ) );
+
+        raft_params param = s1.raftServer->get_current_params();
+        param.with_snapshot_sync_streams(num_streams);
+        s1.raftServer->update_params(param);
+
+        // Append a message using separate thread.
+        ExecArgs exec_args(&s1);
+        TestSuite::ThreadHolder hh(&exec_args, fake_executer, fake_executer_killer);
+
+        for (size_t ii=0; ii<10; ++ii) {
+            std::string test_msg = "test" + std::to_string(ii);
+            ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+            msg->put(test_msg);
+            exec_args.setMsg(msg);
+            exec_args.eaExecuter.invoke();
+
+            // Wait for executer thread.
+            TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+            CHK_NULL( exec_args.getMsg().get() );
+
+            // NOTE: Send it to S2 only, S3 will be lagging behind.
+            s1.fNet->execReqResp("S2"); // replication.
+            s1.fNet->execReqResp("S2"); // commit.
+            TestSuite::sleep_ms(COMMIT_TIME_MS); // commit execution.
+        }
+        // Make req to S3 failed.
+        s1.fNet->makeReqFail("S3");
+
+        // Trigger heartbeat to S3, it will initiate snapshot transmission.
+        s1.fTimer->invoke(timer_task_type::heartbeat_timer);
+
+        // Objects of all streams are sent in parallel,
+        // keep delivering them until S3 catches up.
+        for (size_t ii = 0; ii < 1000; ++ii) {
+            s1.fNet->execReqResp();
+            if ( !s3.raftServer->is_receiving_snapshot() &&
+                 s3.getTestSm()->isSame( *s1.getTestSm() ) ) {
+                break;
+            }
+            TestSuite::sleep_ms(1);
+        }
+
+        // State machine should be identical.
+        CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+        CHK_OK( s3.getTestSm()->isSame( *s1.getTestSm() ) );
+        CHK_GT( s3.getTestSm()->getNumStreamObjs(), 0 );
+
+        print_stats(pkgs);
+
+        s1.raftServer->shutdown();
+        s2.raftServer->shutdown();
+        s3.raftServer->shutdown();
+
+        fake_executer_killer(&exec_args);
+        hh.join();
+        CHK_Z( hh.getResult() );
+
+        f_base->destroy();
+    }
+    return 0;
+}
+
 int join_empty_node_test() {
     reset_log_files();
     ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
@@ -1709,6 +2044,113 @@ int join_empty_node_test() {
     return 0;
 }
 
+int new_member_log_sync_test(bool use_snapshot) {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    raft_params custom_params;
+    custom_params.with_election_timeout_lower(0);
+    custom_params.with_election_timeout_upper(10000);
+    custom_params.with_hb_interval(5000);
+    custom_params.with_client_req_timeout(1000000);
+    custom_params.with_log_sync_stopping_gap(1);
+    custom_params.with_log_sync_batch_size(5);
+    custom_params.with_append_pipeline_window(4);
+    if (use_snapshot) {
+        // Keep all logs, but a snapshot covering
+        // more than 10 logs will be used.
+        custom_params.with_snapshot_enabled(30);
+        custom_params.with_reserved_log_items(1000);
+        custom_params.with_log_sync_snapshot_threshold(10);
+    }
+    custom_params.return_method_ = raft_params::async_handler;
+    CHK_Z( launch_servers( pkgs, &custom_params ) );
+
+    // Organize group by using S1 and S2 only.
+    CHK_Z( make_group( {&s1, &s2} ) );
+
+    const size_t NUM = 50;
+    for (size_t ii = 0; ii < NUM; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        CHK_TRUE( s1.raftServer->append_entries( {msg} )->get_accepted() );
+        s1.fNet->execReqResp(s2_addr); // replication.
+        s1.fNet->execReqResp(s2_addr); // commit.
+    }
+    TestSuite::sleep_ms(COMMIT_TIME_MS); // commit execution.
+    CHK_GT( s1.raftServer->get_committed_log_idx(), NUM );
+
+    // Now add S3 to leader.
+    s1.raftServer->add_srv( *(s3.getTestMgr()->get_srv_config()) );
+    s1.fNet->execReqResp(s3_addr); // join req/resp.
+
+    if (use_snapshot) {
+        // Snapshot should be sent first, even though
+        // the leader has all logs.
+        CHK_EQ( 1, s1.raftServer->get_log_store()->start_index() );
+        do {
+            s1.fNet->execReqResp(s3_addr);
+        } while (s3.raftServer->is_receiving_snapshot());
+        CHK_GT( s3.raftServer->get_log_store()->start_index(), 1 );
+    }
+
+    // The first request should be sent alone,
+    // and then the window will be filled up.
+    CHK_EQ( 1, s1.fNet->getNumPendingReqs(s3_addr) );
+    s1.fNet->execReqResp(s3_addr);
+    CHK_EQ( 4, s1.fNet->getNumPendingReqs(s3_addr) );
+
+    // Sync the rest of logs.
+    while (s1.fNet->getNumPendingReqs(s3_addr)) {
+        s1.fNet->execReqResp(s3_addr);
+    }
+    TestSuite::sleep_ms(COMMIT_TIME_MS); // S1 & S3: commit logs.
+
+    s1.fNet->execReqResp(); // new config.
+    s1.fNet->execReqResp(); // commit.
+    TestSuite::sleep_ms(COMMIT_TIME_MS); // commit execution.
+
+    CHK_NONNULL( s1.raftServer->get_srv_config(3) );
+
+    s1.fTimer->invoke(timer_task_type::heartbeat_timer);
+    s1.fNet->execReqResp(); // replication.
+    s1.fNet->execReqResp(); // commit.
+    TestSuite::sleep_ms(COMMIT_TIME_MS); // commit execution.
+    print_stats(pkgs);
+
+    // State machine should be identical.
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+    CHK_OK( s3.getTestSm()->isSame( *s1.getTestSm() ) );
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+int pipelined_log_sync_test() {
+    CHK_Z( new_member_log_sync_test(false) );
+    return 0;
+}
+
+int snapshot_log_sync_test() {
+    CHK_Z( new_member_log_sync_test(true) );
+    return 0;
+}
+
 static int async_handler(std::list<ulong>* idx_list,
                          ptr< cmd_result< ptr<buffer> > >& cmd_result,
                          cmd_result_code expected_code,
@@ -1913,7 +2355,7 @@ int async_append_handler_cancel_test() {
     return 0;
 }
 
-int apply_config_test() {
+int pipelined_append_test() {
     reset_log_files();
     ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
 
@@ -1926,12 +2368,1797 @@ int apply_config_test() {
     RaftPkg s3(f_base, 3, s3_addr);
     std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
 
-    raft_params custom_params;
-    custom_params.election_timeout_lower_bound_ = 0;
-    custom_params.election_timeout_upper_bound_ = 1000;
-    custom_params.heart_beat_interval_ = 500;
-    custom_params.snapshot_distance_ = 100;
-    CHK_Z( launch_servers( pkgs, &custom_params ) );
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    const int32 WINDOW = 4;
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        param.with_append_pipeline_window(WINDOW);
+        pp->raftServer->update_params(param);
+    }
+
+    // First append to confirm the followers' log position,
+    // pipelining starts after that.
+    {
+        std::string test_msg = "first";
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        s1.raftServer->append_entries( {msg} );
+        s1.fNet->execReqResp();
+        s1.fNet->execReqResp();
+        TestSuite::sleep_ms(COMMIT_TIME_MS);
+    }
+
+    const size_t NUM = 10;
+    std::list< ptr< cmd_result< ptr<buffer> > > > handlers;
+    for (size_t ii=0; ii<NUM; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        ptr< cmd_result< ptr<buffer> > > ret =
+            s1.raftServer->append_entries( {msg} );
+
+        CHK_TRUE( ret->get_accepted() );
+        CHK_EQ( cmd_result_code::OK, ret->get_result_code() );
+
+        handlers.push_back(ret);
+    }
+
+    // Multiple requests should be in flight, bounded by the window.
+    CHK_GT( s1.fNet->getNumPendingReqs(s2_addr), 1 );
+    CHK_SM( s1.fNet->getNumPendingReqs(s2_addr), (size_t)WINDOW + 1 );
+    CHK_GT( s1.fNet->getNumPendingReqs(s3_addr), 1 );
+
+    // Process all requests and the following commits.
+    for (size_t ii=0; ii<NUM; ++ii) {
+        s1.fNet->execReqResp();
+    }
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+    // Check if all messages are committed.
+    for (size_t ii=0; ii<NUM; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        uint64_t idx = s1.getTestSm()->isCommitted(test_msg);
+        CHK_GT(idx, 0);
+    }
+
+    // State machine should be identical.
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+    CHK_OK( s3.getTestSm()->isSame( *s1.getTestSm() ) );
+
+    print_stats(pkgs);
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+int pipelined_append_reject_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    const int32 WINDOW = 4;
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        param.with_append_pipeline_window(WINDOW);
+        pp->raftServer->update_params(param);
+    }
+
+    auto append_msg = [&](const std::string& test_msg) {
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        return s1.raftServer->append_entries( {msg} );
+    };
+
+    // Start pipelining.
+    append_msg("first");
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+    const size_t NUM = 10;
+    for (size_t ii = 0; ii < NUM; ++ii) {
+        CHK_TRUE( append_msg("test" + std::to_string(ii))->get_accepted() );
+    }
+    CHK_GT( s1.fNet->getNumPendingReqs(s2_addr), 1 );
+
+    // S2 appends the logs in the first request, and then loses them.
+    // All the other pipelined requests will be rejected.
+    ptr<log_store> s2_store = s2.getTestMgr()->load_log_store();
+    ulong s2_last_idx = s2_store->next_slot() - 1;
+    CHK_TRUE( s1.fNet->delieverReqTo(s2_addr) );
+    CHK_GT( s2_store->next_slot() - 1, s2_last_idx );
+    ptr<log_entry> le = s2_store->entry_at(s2_last_idx);
+    s2_store->write_at(s2_last_idx, le);
+    CHK_EQ( s2_last_idx + 1, s2_store->next_slot() );
+
+    // Leader should restart from the lost logs, ignoring the
+    // rejections of the other requests in flight. It may need to
+    // send a snapshot, as the leader's log can be compacted.
+    ptr<log_store> s1_store = s1.getTestMgr()->load_log_store();
+    for (size_t ii = 0; ii < 100; ++ii) {
+        s1.fNet->execReqResp();
+        if ( s2_store->next_slot() == s1_store->next_slot() &&
+             s2.raftServer->get_committed_log_idx() ==
+                 s1.raftServer->get_committed_log_idx() ) {
+            break;
+        }
+        TestSuite::sleep_ms(1);
+    }
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    CHK_EQ( s1_store->next_slot(), s2_store->next_slot() );
+    for (size_t ii = 0; ii < NUM; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        CHK_GT( s1.getTestSm()->isCommitted(test_msg), 0 );
+    }
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+    CHK_OK( s3.getTestSm()->isSame( *s1.getTestSm() ) );
+
+    print_stats(pkgs);
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+class DeferredLogStore : public inmem_log_store {
+public:
+    DeferredLogStore() : holding(false), durableIdx(0) {}
+
+    ulong last_durable_index() {
+        if (!holding) return next_slot() - 1;
+        return durableIdx;
+    }
+
+    // If `true`, logs after `durableIdx` are not durable yet.
+    std::atomic<bool> holding;
+    std::atomic<ulong> durableIdx;
+};
+
+int parallel_log_appending_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2};
+
+    ptr<DeferredLogStore> s1_store = cs_new<DeferredLogStore>();
+    s1.logStore = s1_store;
+
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        param.with_parallel_log_appending(true);
+        pp->raftServer->update_params(param);
+    }
+
+    // Leader's log store stops making logs durable.
+    s1_store->durableIdx = s1_store->next_slot() - 1;
+    s1_store->holding = true;
+
+    std::string test_msg = "test";
+    ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+    msg->put(test_msg);
+    ptr< cmd_result< ptr<buffer> > > ret =
+        s1.raftServer->append_entries( {msg} );
+    CHK_TRUE( ret->get_accepted() );
+
+    // Should be replicated right away.
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    CHK_EQ( s1_store->next_slot(),
+            s2.getTestMgr()->load_log_store()->next_slot() );
+
+    // But not committed, as the leader's log is not durable
+    // and two members are needed for the quorum.
+    CHK_Z( s1.getTestSm()->isCommitted(test_msg) );
+
+    // Now durable, should be committed.
+    s1_store->durableIdx = s1_store->next_slot() - 1;
+    s1.raftServer->notify_log_append_completion(true);
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    CHK_GT( s1.getTestSm()->isCommitted(test_msg), 0 );
+
+    // Commit index to the follower.
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+int parallel_log_appending_follower_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    ptr<DeferredLogStore> s2_store = cs_new<DeferredLogStore>();
+    ptr<DeferredLogStore> s3_store = cs_new<DeferredLogStore>();
+    s2.logStore = s2_store;
+    s3.logStore = s3_store;
+
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        param.with_parallel_log_appending(true);
+        pp->raftServer->update_params(param);
+    }
+
+    // Followers' log stores stop making logs durable.
+    for (ptr<DeferredLogStore> ss: {s2_store, s3_store}) {
+        ss->durableIdx = ss->next_slot() - 1;
+        ss->holding = true;
+    }
+
+    std::string test_msg = "test";
+    ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+    msg->put(test_msg);
+    ptr< cmd_result< ptr<buffer> > > ret =
+        s1.raftServer->append_entries( {msg} );
+    CHK_TRUE( ret->get_accepted() );
+
+    // Replicated to followers, but they should not respond
+    // until the logs are durable.
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    CHK_EQ( s1.getTestMgr()->load_log_store()->next_slot(),
+            s2_store->next_slot() );
+    CHK_EQ( 1, s1.fNet->getNumPendingResps(s2_addr) );
+    CHK_EQ( 1, s1.fNet->getNumPendingResps(s3_addr) );
+
+    // Leader should not commit, even though its own log is durable.
+    CHK_FALSE( s1.fNet->handleRespFrom(s2_addr) );
+    CHK_FALSE( s1.fNet->handleRespFrom(s3_addr) );
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    CHK_Z( s1.getTestSm()->isCommitted(test_msg) );
+
+    // S2's log becomes durable, it completes the quorum.
+    s2_store->durableIdx = s2_store->next_slot() - 1;
+    s2.raftServer->notify_log_append_completion(true);
+    CHK_TRUE( s1.fNet->handleRespFrom(s2_addr) );
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    CHK_GT( s1.getTestSm()->isCommitted(test_msg), 0 );
+
+    // S3's response is still pending.
+    CHK_EQ( 1, s1.fNet->getNumPendingResps(s3_addr) );
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+class FlushTrackingLogStore : public inmem_log_store {
+public:
+    FlushTrackingLogStore() : flushedIdx(0), numFlushes(0) {}
+
+    void end_of_append_batch(ulong start, ulong cnt) {
+        // Slow flush.
+        TestSuite::sleep_ms(10);
+        flushThread = std::this_thread::get_id();
+        ulong last_idx = start + cnt - 1;
+        if (last_idx > flushedIdx) flushedIdx = last_idx;
+        numFlushes++;
+    }
+
+    std::atomic<ulong> flushedIdx;
+    std::atomic<size_t> numFlushes;
+    std::thread::id flushThread;
+};
+
+int follower_bg_flush_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    ptr<FlushTrackingLogStore> s2_store = cs_new<FlushTrackingLogStore>();
+    ptr<FlushTrackingLogStore> s3_store = cs_new<FlushTrackingLogStore>();
+    s2.logStore = s2_store;
+    s3.logStore = s3_store;
+
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        param.with_bg_thread_for_follower_flush(true);
+        pp->raftServer->update_params(param);
+    }
+
+    const size_t NUM = 10;
+    for (size_t ii=0; ii<NUM; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        ptr< cmd_result< ptr<buffer> > > ret =
+            s1.raftServer->append_entries( {msg} );
+        CHK_TRUE( ret->get_accepted() );
+
+        // Responses are held until the logs are flushed, without
+        // blocking the thread handling the requests.
+        s1.fNet->delieverReqTo(s2_addr);
+        s1.fNet->delieverReqTo(s3_addr);
+        for (const std::string& addr: {s2_addr, s3_addr}) {
+            size_t waited_ms = 0;
+            while ( !s1.fNet->handleRespFrom(addr) && waited_ms < 1000 ) {
+                TestSuite::sleep_ms(1);
+                waited_ms++;
+            }
+        }
+        CHK_EQ( s2_store->next_slot() - 1, s2_store->flushedIdx.load() );
+        CHK_EQ( s3_store->next_slot() - 1, s3_store->flushedIdx.load() );
+        CHK_Z( s1.fNet->getNumPendingResps(s2_addr) );
+        CHK_Z( s1.fNet->getNumPendingResps(s3_addr) );
+    }
+    // Commit index to the followers, waiting for the flushes.
+    for (size_t ii = 0; ii < 3; ++ii) {
+        s1.fNet->execReqResp();
+        TestSuite::sleep_ms(COMMIT_TIME_MS);
+    }
+
+    for (size_t ii=0; ii<NUM; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        CHK_GT( s1.getTestSm()->isCommitted(test_msg), 0 );
+    }
+
+    // Flushes should have been done by another thread.
+    CHK_GT( s2_store->numFlushes.load(), 0 );
+    CHK_FALSE( s2_store->flushThread == std::this_thread::get_id() );
+    CHK_FALSE( s3_store->flushThread == std::this_thread::get_id() );
+
+    // State machine should be identical.
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+    CHK_OK( s3.getTestSm()->isSame( *s1.getTestSm() ) );
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+int flow_control_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2};
+
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    const size_t MAX_ENTRIES = 3;
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        param.with_max_uncommitted_entries(MAX_ENTRIES);
+        pp->raftServer->update_params(param);
+    }
+
+    auto append_msg = [&](const std::string& test_msg)
+                      -> ptr< cmd_result< ptr<buffer> > > {
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        return s1.raftServer->append_entries( {msg} );
+    };
+
+    // Up to the limit, without replication.
+    for (size_t ii=0; ii<MAX_ENTRIES; ++ii) {
+        ptr< cmd_result< ptr<buffer> > > ret =
+            append_msg("test" + std::to_string(ii));
+        CHK_TRUE( ret->get_accepted() );
+    }
+
+    // Should be rejected.
+    ptr< cmd_result< ptr<buffer> > > ret = append_msg("busy");
+    CHK_FALSE( ret->get_accepted() );
+    CHK_EQ( cmd_result_code::SERVER_IS_BUSY, ret->get_result_code() );
+
+    // Replicate and commit, then it should be accepted again.
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    ret = append_msg("test_again");
+    CHK_TRUE( ret->get_accepted() );
+
+    // Limit by the size of logs.
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.with_max_uncommitted_entries(0);
+        param.with_max_uncommitted_bytes(16);
+        pp->raftServer->update_params(param);
+    }
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+    ret = append_msg( std::string(32, 'x') );
+    CHK_TRUE( ret->get_accepted() );
+    ret = append_msg("small");
+    CHK_FALSE( ret->get_accepted() );
+    CHK_EQ( cmd_result_code::SERVER_IS_BUSY, ret->get_result_code() );
+
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    ret = append_msg("small");
+    CHK_TRUE( ret->get_accepted() );
+
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    // Commit index to the follower.
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+int adaptive_batch_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2};
+
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        param.max_append_size_ = 100;
+        param.with_adaptive_batch_target_latency_us(1000);
+        pp->raftServer->update_params(param);
+    }
+
+    const size_t NUM = 50;
+    const size_t MSG_SIZE = 1024;
+    auto append_msgs = [&]() {
+        for (size_t ii=0; ii<NUM; ++ii) {
+            ptr<buffer> msg = buffer::alloc(MSG_SIZE);
+            s1.raftServer->append_entries( {msg} );
+        }
+    };
+    ptr<log_store> s2_store = s2.getTestMgr()->load_log_store();
+
+    // Responses take longer than the target, batches should shrink
+    // to the minimum size (4 KB).
+    append_msgs();
+    size_t max_batch = 0;
+    ulong last_idx = s1.getTestMgr()->load_log_store()->next_slot() - 1;
+    for (size_t ii=0; ii<100; ++ii) {
+        ulong prev_idx = s2_store->next_slot() - 1;
+        if (prev_idx >= last_idx) break;
+        TestSuite::sleep_ms(20);
+        s1.fNet->execReqResp();
+        ulong cur_idx = s2_store->next_slot() - 1;
+        // Skip the first two rounds, before the first response.
+        if (ii >= 2) max_batch = std::max(max_batch, (size_t)(cur_idx - prev_idx));
+    }
+    CHK_EQ( last_idx, s2_store->next_slot() - 1 );
+    CHK_GT( max_batch, 0 );
+    CHK_SM( max_batch, 5 );
+
+    // Disable it, then the remaining logs should be sent at once.
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.with_adaptive_batch_target_latency_us(0);
+        pp->raftServer->update_params(param);
+    }
+    s1.fNet->execReqResp();
+    append_msgs();
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    CHK_EQ( s1.getTestMgr()->load_log_store()->next_slot(),
+            s2_store->next_slot() );
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+int learner_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    CHK_Z( launch_servers( pkgs ) );
+
+    // S3 joins as a learner.
+    s3.getTestMgr()->get_srv_config()->set_learner(true);
+    CHK_Z( make_group( pkgs ) );
+    CHK_TRUE( s1.raftServer->get_config()->get_server(3)->is_learner() );
+
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        pp->raftServer->update_params(param);
+    }
+
+    auto append_msg = [&](const std::string& test_msg) {
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        return s1.raftServer->append_entries( {msg} );
+    };
+
+    // Only the learner acknowledges the log, should not be committed.
+    CHK_TRUE( append_msg("learner_only")->get_accepted() );
+    s1.fNet->execReqResp(s3_addr);
+    s1.fNet->execReqResp(s3_addr);
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    CHK_EQ( s1.getTestMgr()->load_log_store()->next_slot(),
+            s3.getTestMgr()->load_log_store()->next_slot() );
+    CHK_Z( s1.getTestSm()->isCommitted("learner_only") );
+
+    // Now S2 also acknowledges it.
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    CHK_GT( s1.getTestSm()->isCommitted("learner_only"), 0 );
+
+    // Only leader can promote a learner, and only learners.
+    ptr< cmd_result< ptr<buffer> > > ret = s2.raftServer->promote_learner(3);
+    CHK_FALSE( ret->get_accepted() );
+    CHK_EQ( cmd_result_code::NOT_LEADER, ret->get_result_code() );
+    ret = s1.raftServer->promote_learner(2);
+    CHK_FALSE( ret->get_accepted() );
+    CHK_EQ( cmd_result_code::BAD_REQUEST, ret->get_result_code() );
+
+    // Promote S3.
+    ret = s1.raftServer->promote_learner(3);
+    CHK_TRUE( ret->get_accepted() );
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    CHK_FALSE( s1.raftServer->get_config()->get_server(3)->is_learner() );
+    CHK_FALSE( s3.raftServer->get_config()->get_server(3)->is_learner() );
+
+    // S3 is a voting member now, its ack completes the quorum.
+    CHK_TRUE( append_msg("voter")->get_accepted() );
+    s1.fNet->execReqResp(s3_addr);
+    s1.fNet->execReqResp(s3_addr);
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    CHK_GT( s1.getTestSm()->isCommitted("voter"), 0 );
+
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+    CHK_OK( s3.getTestSm()->isSame( *s1.getTestSm() ) );
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+class BlockingCompactLogStore : public inmem_log_store {
+public:
+    BlockingCompactLogStore() : released(false), numCompactions(0) {}
+
+    bool compact(ulong last_log_index) {
+        {   std::unique_lock<std::mutex> l(lock);
+            compactThread = std::this_thread::get_id();
+            numCompactions++;
+            // Slow compaction, until it is released.
+            while (!released) cv.wait(l);
+        }
+        return inmem_log_store::compact(last_log_index);
+    }
+
+    void release() {
+        std::lock_guard<std::mutex> l(lock);
+        released = true;
+        cv.notify_all();
+    }
+
+    std::mutex lock;
+    std::condition_variable cv;
+    bool released;
+    std::atomic<size_t> numCompactions;
+    std::thread::id compactThread;
+};
+
+int bg_log_compaction_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    ptr<BlockingCompactLogStore> s1_store = cs_new<BlockingCompactLogStore>();
+    s1.logStore = s1_store;
+
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        param.with_bg_thread_for_log_compaction(true);
+        pp->raftServer->update_params(param);
+    }
+
+    auto append_msg = [&](const std::string& test_msg) {
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        return s1.raftServer->append_entries( {msg} );
+    };
+
+    // Until the first snapshot is created.
+    size_t ii = 0;
+    for (; ii < 10 && !s1_store->numCompactions; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        CHK_TRUE( append_msg(test_msg)->get_accepted() );
+
+        // NOTE: Send it to S2 only, S3 will be lagging behind.
+        s1.fNet->execReqResp(s2_addr); // replication.
+        s1.fNet->execReqResp(s2_addr); // commit.
+        TestSuite::sleep_ms(COMMIT_TIME_MS); // commit execution.
+    }
+    CHK_GT( s1_store->numCompactions.load(), 0 );
+    CHK_FALSE( s1_store->compactThread == std::this_thread::get_id() );
+
+    // Compaction is still in progress, but the leader is not blocked.
+    for (size_t jj = 0; jj < 5; ++jj, ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        CHK_TRUE( append_msg(test_msg)->get_accepted() );
+        s1.fNet->execReqResp(s2_addr);
+        s1.fNet->execReqResp(s2_addr);
+        TestSuite::sleep_ms(COMMIT_TIME_MS);
+        CHK_GT( s1.getTestSm()->isCommitted(test_msg), 0 );
+    }
+    CHK_EQ( 1, s1_store->start_index() );
+
+    // Make req to S3 failed.
+    s1.fNet->makeReqFail(s3_addr);
+
+    // Trigger heartbeat to S3. Logs being compacted are regarded as gone,
+    // so that it will initiate snapshot transmission.
+    s1.fTimer->invoke(timer_task_type::heartbeat_timer);
+    do {
+        s1.fNet->execReqResp();
+    } while (s3.raftServer->is_receiving_snapshot());
+    CHK_GT( s3.getTestMgr()->load_log_store()->start_index(), 1 );
+
+    s1.fNet->execReqResp(); // commit.
+    TestSuite::sleep_ms(COMMIT_TIME_MS); // commit execution.
+
+    // Let the compaction finish.
+    s1_store->release();
+    for (size_t jj = 0; jj < 100 && s1_store->start_index() == 1; ++jj) {
+        TestSuite::sleep_ms(10);
+    }
+    CHK_GT( s1_store->start_index(), 1 );
+
+    // State machine should be identical.
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+    CHK_OK( s3.getTestSm()->isSame( *s1.getTestSm() ) );
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+int read_index_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        pp->raftServer->update_params(param);
+    }
+
+    // Append a message and commit it.
+    std::string test_msg = "test";
+    ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+    msg->put(test_msg);
+    s1.raftServer->append_entries( {msg} );
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    uint64_t committed_idx = s1.getTestSm()->isCommitted(test_msg);
+    CHK_GT( committed_idx, 0 );
+
+    // Follower should not accept read request.
+    ptr< cmd_result<uint64_t> > f_ret = s2.raftServer->read_index();
+    CHK_FALSE( f_ret->get_accepted() );
+    CHK_EQ( cmd_result_code::NOT_LEADER, f_ret->get_result_code() );
+
+    // Concurrent read requests.
+    const size_t NUM = 3;
+    std::atomic<size_t> num_done(0);
+    std::list< ptr< cmd_result<uint64_t> > > handlers;
+    for (size_t ii=0; ii<NUM; ++ii) {
+        ptr< cmd_result<uint64_t> > ret = s1.raftServer->read_index();
+        CHK_TRUE( ret->get_accepted() );
+        ret->when_ready
+            ( [&num_done, committed_idx]
+              ( uint64_t& read_idx, ptr<std::exception>& err ) {
+                  if (!err && read_idx >= committed_idx) num_done++;
+              } );
+        handlers.push_back(ret);
+    }
+
+    // Leadership is not confirmed yet.
+    CHK_Z( num_done.load() );
+    CHK_EQ( 1, s1.fNet->getNumPendingReqs(s2_addr) );
+    CHK_EQ( 1, s1.fNet->getNumPendingReqs(s3_addr) );
+
+    // The first request is done, and the others arrived
+    // during the first round should share the next round.
+    s1.fNet->execReqResp();
+    CHK_EQ( 1, num_done.load() );
+    CHK_EQ( 1, s1.fNet->getNumPendingReqs(s2_addr) );
+    CHK_EQ( 1, s1.fNet->getNumPendingReqs(s3_addr) );
+
+    s1.fNet->execReqResp();
+    CHK_EQ( NUM, num_done.load() );
+    for (auto& entry: handlers) {
+        CHK_EQ( cmd_result_code::OK, entry->get_result_code() );
+    }
+
+    // Enable lease, and then read again:
+    // it should be done without heartbeat.
+    {
+        raft_params param = s1.raftServer->get_current_params();
+        param.with_election_timeout_lower(10000);
+        param.with_lease_read(true);
+        s1.raftServer->update_params(param);
+    }
+    num_done = 0;
+    ptr< cmd_result<uint64_t> > ret = s1.raftServer->read_index();
+    CHK_TRUE( ret->get_accepted() );
+    ret->when_ready
+        ( [&num_done, committed_idx]
+          ( uint64_t& read_idx, ptr<std::exception>& err ) {
+              if (!err && read_idx >= committed_idx) num_done++;
+          } );
+    CHK_EQ( 1, num_done.load() );
+    CHK_Z( s1.fNet->getNumPendingReqs(s2_addr) );
+    CHK_Z( s1.fNet->getNumPendingReqs(s3_addr) );
+
+    // Pending read request should be cancelled on leadership change.
+    {
+        raft_params param = s1.raftServer->get_current_params();
+        param.with_lease_read(false);
+        s1.raftServer->update_params(param);
+    }
+    ret = s1.raftServer->read_index();
+    CHK_TRUE( ret->get_accepted() );
+    s1.raftServer->yield_leadership(true);
+    CHK_EQ( cmd_result_code::CANCELLED, ret->get_result_code() );
+
+    print_stats(pkgs);
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+int read_index_applied_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        pp->raftServer->update_params(param);
+    }
+    {
+        raft_params param = s1.raftServer->get_current_params();
+        param.with_election_timeout_lower(10000);
+        param.with_lease_read(true);
+        s1.raftServer->update_params(param);
+    }
+
+    // Block the state machine of the leader in the middle of commit.
+    std::atomic<bool> hook_entered(false);
+    std::atomic<bool> hook_released(false);
+    s1.getTestSm()->setCommitHook( [&](ulong log_idx) {
+        hook_entered = true;
+        while (!hook_released) TestSuite::sleep_ms(1);
+    } );
+
+    std::string test_msg = "test";
+    ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+    msg->put(test_msg);
+    s1.raftServer->append_entries( {msg} );
+    s1.fNet->execReqResp();
+    for (size_t ii = 0; ii < 1000 && !hook_entered; ++ii) {
+        TestSuite::sleep_ms(1);
+    }
+    CHK_TRUE( hook_entered.load() );
+
+    // Lease is valid, but the log is not applied yet.
+    std::atomic<size_t> num_done(0);
+    ptr< cmd_result<uint64_t> > ret = s1.raftServer->read_index();
+    CHK_TRUE( ret->get_accepted() );
+    ret->when_ready
+        ( [&num_done]
+          ( uint64_t& read_idx, ptr<std::exception>& err ) {
+              if (!err) num_done++;
+          } );
+    CHK_Z( num_done.load() );
+
+    // Once the state machine returns, the read should be done.
+    hook_released = true;
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    CHK_EQ( 1, num_done.load() );
+    CHK_GTEQ( s1.getTestSm()->getLastCommittedIdx(), ret->get() );
+    s1.getTestSm()->setCommitHook(nullptr);
+
+    s1.fNet->execReqResp();
+
+    print_stats(pkgs);
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+int read_index_custom_quorum_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        pp->raftServer->update_params(param);
+    }
+
+    // Leader alone can commit.
+    {
+        raft_params param = s1.raftServer->get_current_params();
+        param.custom_commit_quorum_size_ = 1;
+        s1.raftServer->update_params(param);
+    }
+
+    std::atomic<size_t> num_done(0);
+    ptr< cmd_result<uint64_t> > ret = s1.raftServer->read_index();
+    CHK_TRUE( ret->get_accepted() );
+    ret->when_ready
+        ( [&num_done]
+          ( uint64_t& read_idx, ptr<std::exception>& err ) {
+              if (!err) num_done++;
+          } );
+
+    // Even with the custom commit quorum, the leadership should be
+    // confirmed by a majority.
+    CHK_Z( num_done.load() );
+    s1.fNet->execReqResp(s2_addr);
+    CHK_EQ( 1, num_done.load() );
+    CHK_EQ( cmd_result_code::OK, ret->get_result_code() );
+
+    s1.fNet->execReqResp();
+
+    print_stats(pkgs);
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+int bounded_stale_read_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        pp->raftServer->update_params(param);
+    }
+
+    auto append_msg = [&](const std::string& test_msg) {
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        return s1.raftServer->append_entries( {msg} );
+    };
+
+    // Append a message and commit it on all servers.
+    CHK_TRUE( append_msg("test")->get_accepted() );
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    uint64_t committed_idx = s1.getTestSm()->isCommitted("test");
+    CHK_GT( committed_idx, 0 );
+    CHK_GT( s2.getTestSm()->isCommitted("test"), 0 );
+
+    auto stale_read = [&]( RaftPkg& pkg,
+                           ulong min_idx,
+                           int32 staleness_ms,
+                           std::atomic<uint64_t>& read_idx_out ) {
+        ptr< cmd_result<uint64_t> > ret =
+            pkg.raftServer->bounded_stale_read(min_idx, staleness_ms);
+        ret->when_ready
+            ( [&read_idx_out]
+              ( uint64_t& read_idx, ptr<std::exception>& err ) {
+                  if (!err) read_idx_out = read_idx;
+              } );
+        return ret;
+    };
+
+    // Already applied on the follower.
+    std::atomic<uint64_t> r_min(0);
+    ptr< cmd_result<uint64_t> > ret =
+        stale_read(s2, committed_idx, -1, r_min);
+    CHK_TRUE( ret->get_accepted() );
+    CHK_EQ( cmd_result_code::OK, ret->get_result_code() );
+    CHK_EQ( committed_idx, r_min.load() );
+
+    // Commit index from the leader was received recently.
+    std::atomic<uint64_t> r_recent(0);
+    stale_read(s2, 0, 10000, r_recent);
+    CHK_EQ( committed_idx, r_recent.load() );
+
+    // Next log is not applied yet.
+    std::atomic<uint64_t> r_next(0);
+    stale_read(s2, committed_idx + 1, -1, r_next);
+    CHK_Z( r_next.load() );
+
+    // Commit index from the leader is too old,
+    // should wait for the next request from the leader.
+    TestSuite::sleep_ms(10);
+    std::atomic<uint64_t> r_fresh(0);
+    stale_read(s2, 0, 0, r_fresh);
+    CHK_Z( r_fresh.load() );
+
+    // Quorum responded to the leader recently,
+    // it can serve it right away.
+    std::atomic<uint64_t> r_leader(0);
+    stale_read(s1, 0, 10000, r_leader);
+    CHK_EQ( committed_idx, r_leader.load() );
+
+    // The next request from the leader carries the commit index.
+    CHK_TRUE( append_msg("test2")->get_accepted() );
+    s1.fNet->execReqResp();
+    CHK_EQ( committed_idx, r_fresh.load() );
+    CHK_Z( r_next.load() );
+
+    // Once the next log is committed and applied.
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    CHK_EQ( committed_idx + 1, r_next.load() );
+
+    // No quorum responded to the leader within the bound,
+    // it should confirm its leadership first.
+    TestSuite::sleep_ms(10);
+    std::atomic<uint64_t> r_leader_old(0);
+    stale_read(s1, 0, 1, r_leader_old);
+    CHK_Z( r_leader_old.load() );
+    s1.fNet->execReqResp();
+    CHK_EQ( committed_idx + 1, r_leader_old.load() );
+
+    // Pending request should be cancelled on shutdown.
+    ret = stale_read(s3, committed_idx + 100, -1, r_min);
+    CHK_TRUE( ret->get_accepted() );
+
+    print_stats(pkgs);
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+    CHK_EQ( cmd_result_code::CANCELLED, ret->get_result_code() );
+
+    f_base->destroy();
+
+    return 0;
+}
+
+int concurrent_append_test(raft_params::locking_method_type lock_type,
+                           bool group_commit)
+{
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        param.locking_method_type_ = lock_type;
+        if (group_commit) {
+            param.with_group_commit_max_bytes(1024 * 1024);
+            param.with_group_commit_max_delay_us(2000);
+        }
+        pp->raftServer->update_params(param);
+    }
+
+    // Append messages from multiple threads at the same time.
+    const size_t NUM_THREADS = 4;
+    const size_t NUM_PER_THREAD = 10;
+    std::atomic<size_t> num_accepted(0);
+    std::list< ptr< cmd_result< ptr<buffer> > > > handlers;
+    std::mutex handlers_lock;
+    std::vector<std::thread> threads;
+    for (size_t ii = 0; ii < NUM_THREADS; ++ii) {
+        threads.push_back( std::thread( [&, ii]() {
+            for (size_t jj = 0; jj < NUM_PER_THREAD; ++jj) {
+                std::string test_msg = "test" + std::to_string(ii) +
+                                       "_" + std::to_string(jj);
+                ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+                msg->put(test_msg);
+                ptr< cmd_result< ptr<buffer> > > ret =
+                    s1.raftServer->append_entries( {msg} );
+                if (ret->get_accepted()) num_accepted++;
+                std::lock_guard<std::mutex> l(handlers_lock);
+                handlers.push_back(ret);
+            }
+        } ) );
+    }
+    for (std::thread& tt: threads) tt.join();
+    CHK_EQ( NUM_THREADS * NUM_PER_THREAD, num_accepted.load() );
+
+    // Replication of grouped logs.
+    for (size_t ii = 0; ii < NUM_THREADS * NUM_PER_THREAD; ++ii) {
+        if ( !s1.fNet->getNumPendingReqs(s2_addr) &&
+             !s1.fNet->getNumPendingReqs(s3_addr) ) break;
+        s1.fNet->execReqResp();
+    }
+    // Deliver the updated commit index.
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+    for (auto& entry: handlers) {
+        CHK_EQ( cmd_result_code::OK, entry->get_result_code() );
+    }
+    for (size_t ii = 0; ii < NUM_THREADS; ++ii) {
+        for (size_t jj = 0; jj < NUM_PER_THREAD; ++jj) {
+            std::string test_msg = "test" + std::to_string(ii) +
+                                   "_" + std::to_string(jj);
+            CHK_GT( s1.getTestSm()->isCommitted(test_msg), 0 );
+        }
+    }
+
+    // State machine should be identical.
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+    CHK_OK( s3.getTestSm()->isSame( *s1.getTestSm() ) );
+
+    print_stats(pkgs);
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+int group_commit_test() {
+    CHK_Z( concurrent_append_test(raft_params::dual_mutex, true) );
+    CHK_Z( concurrent_append_test(raft_params::dual_rw_lock, true) );
+    return 0;
+}
+
+int rw_lock_append_test() {
+    CHK_Z( concurrent_append_test(raft_params::dual_rw_lock, false) );
+    return 0;
+}
+
+int auto_forwarding_batch_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        param.with_auto_forwarding(true);
+        param.with_auto_forwarding_batch_size(8);
+        param.with_auto_forwarding_max_connections(1);
+        pp->raftServer->update_params(param);
+    }
+
+    std::atomic<size_t> num_done(0);
+    auto append_to_s2 = [&](const std::string& test_msg)
+                        -> ptr< cmd_result< ptr<buffer> > >
+    {
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        ptr< cmd_result< ptr<buffer> > > ret =
+            s2.raftServer->append_entries( {msg} );
+        ret->when_ready( [&num_done]( cmd_result< ptr<buffer> >& res,
+                                      ptr<std::exception>& err ) {
+            num_done++;
+        } );
+        return ret;
+    };
+
+    // The first request goes out right away, and the others
+    // wait for the connection.
+    const size_t NUM = 5;
+    std::vector< ptr< cmd_result< ptr<buffer> > > > results;
+    for (size_t ii = 0; ii < NUM; ++ii) {
+        results.push_back( append_to_s2( "test" + std::to_string(ii) ) );
+    }
+    CHK_EQ( 1, s2.fNet->getNumPendingReqs(s1_addr) );
+    CHK_Z( num_done.load() );
+
+    // Once the first one is done, all the others are sent at once.
+    s2.fNet->execReqResp(s1_addr);
+    CHK_EQ( 1, num_done.load() );
+    CHK_EQ( 1, s2.fNet->getNumPendingReqs(s1_addr) );
+
+    s2.fNet->execReqResp(s1_addr);
+    CHK_EQ( NUM, num_done.load() );
+    for (auto& entry: results) {
+        CHK_TRUE( entry->get_accepted() );
+        CHK_EQ( cmd_result_code::OK, entry->get_result_code() );
+    }
+
+    // Replicate and commit.
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    // Deliver the updated commit index to followers.
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+    // All logs should be committed in the order of requests.
+    uint64_t prev_idx = 0;
+    for (size_t ii = 0; ii < NUM; ++ii) {
+        uint64_t log_idx =
+            s2.getTestSm()->isCommitted( "test" + std::to_string(ii) );
+        CHK_GT( log_idx, prev_idx );
+        prev_idx = log_idx;
+    }
+
+    // Requests in a failed RPC should fail, and the queued
+    // ones should be sent through a new connection.
+    num_done = 0;
+    results.clear();
+    for (size_t ii = 0; ii < NUM; ++ii) {
+        results.push_back( append_to_s2( "fail" + std::to_string(ii) ) );
+    }
+    s2.fNet->makeReqFail(s1_addr);
+    CHK_EQ( 1, num_done.load() );
+    CHK_FALSE( results[0]->get_accepted() );
+    CHK_EQ( cmd_result_code::FAILED, results[0]->get_result_code() );
+
+    CHK_EQ( 1, s2.fNet->getNumPendingReqs(s1_addr) );
+    s2.fNet->execReqResp(s1_addr);
+    CHK_EQ( NUM, num_done.load() );
+    for (size_t ii = 1; ii < NUM; ++ii) {
+        CHK_TRUE( results[ii]->get_accepted() );
+    }
+
+    // Leader rejects the requests if writes are paused,
+    // the result code should be delivered.
+    s1.raftServer->yield_leadership(false, 3);
+    num_done = 0;
+    results.clear();
+    results.push_back( append_to_s2( "rejected" ) );
+    s2.fNet->execReqResp(s1_addr);
+    CHK_EQ( 1, num_done.load() );
+    CHK_FALSE( results[0]->get_accepted() );
+    CHK_EQ( cmd_result_code::NOT_LEADER, results[0]->get_result_code() );
+    CHK_EQ( 1, s2.raftServer->get_num_forward_queues() );
+
+    // S1 resigns once S3 gets the latest log.
+    s1.fNet->execReqResp(s3_addr);
+    // Deliver the commit index, and then takeover request to S3.
+    s1.fNet->execReqResp(s3_addr);
+    s1.fNet->execReqResp(s3_addr);
+    // Send vote requests, S3 will not use pre-vote.
+    s3.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+    // Send new config as a new leader.
+    s3.fNet->execReqResp();
+    // Follow-up: commit.
+    s3.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+    CHK_TRUE( s3.raftServer->is_leader() );
+
+    // S2 needs a snapshot, as the logs of S3 have been compacted.
+    // Once S2 accepts logs from S3, it recognizes the new leader.
+    for (size_t ii = 0; ii < 100; ++ii) {
+        s3.fNet->execReqResp();
+        if (s2.raftServer->get_leader() == 3) break;
+    }
+    CHK_EQ( 3, s2.raftServer->get_leader() );
+
+    // The drained queue to the previous leader should be removed.
+    CHK_Z( s2.raftServer->get_num_forward_queues() );
+
+    num_done = 0;
+    results.clear();
+    results.push_back( append_to_s2( "new_leader" ) );
+    CHK_EQ( 1, s2.raftServer->get_num_forward_queues() );
+    s2.fNet->execReqResp(s3_addr);
+    CHK_EQ( 1, num_done.load() );
+    CHK_TRUE( results[0]->get_accepted() );
+
+    print_stats(pkgs);
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+int commit_batch_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    const int32 MAX_BATCH = 4;
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        param.with_max_commit_batch_size(MAX_BATCH);
+        // S2 reads a few batches ahead.
+        param.with_commit_prefetch(pp == &s2);
+        param.with_commit_prefetch_batches(3);
+        pp->raftServer->update_params(param);
+    }
+
+    // Append messages, and commit them at once.
+    const size_t NUM = 20;
+    std::list< ptr< cmd_result< ptr<buffer> > > > handlers;
+    for (size_t ii = 0; ii < NUM; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        handlers.push_back( s1.raftServer->append_entries( {msg} ) );
+    }
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    // Deliver the updated commit index to followers.
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+    // Each request should get its own result (its log index).
+    size_t idx = 0;
+    for (auto& entry: handlers) {
+        CHK_EQ( cmd_result_code::OK, entry->get_result_code() );
+        ptr<buffer> result = entry->get();
+        CHK_NONNULL( result );
+        buffer_serializer bs(result);
+        uint64_t log_idx = bs.get_u64();
+        CHK_EQ( s1.getTestSm()->isCommitted( "test" + std::to_string(idx++) ),
+                log_idx );
+    }
+
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        CHK_GT( pp->getTestSm()->getNumCommitBatches(), 0 );
+        CHK_GT( pp->getTestSm()->getMaxCommitBatchSize(), 1 );
+        CHK_SMEQ( (uint64_t)MAX_BATCH, pp->getTestSm()->getMaxCommitBatchSize() );
+    }
+
+    // State machine should be identical.
+    CHK_OK( s2.getTestSm()->isSame( *s1.getTestSm() ) );
+    CHK_OK( s3.getTestSm()->isSame( *s1.getTestSm() ) );
+
+    print_stats(pkgs);
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+int packed_append_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    CHK_Z( launch_servers( pkgs ) );
+    CHK_Z( make_group( pkgs ) );
+
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        // S2 commits logs in batches.
+        if (pp == &s2) param.with_max_commit_batch_size(4);
+        pp->raftServer->update_params(param);
+    }
+
+    // Packed payloads, followed by a normal log.
+    const size_t NUM = 10;
+    std::vector< ptr<buffer> > msgs;
+    for (size_t ii = 0; ii < NUM; ++ii) {
+        std::string test_msg = "packed" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        msgs.push_back(msg);
+    }
+    uint64_t last_idx = s1.raftServer->get_last_log_idx();
+    std::vector< ptr< cmd_result< ptr<buffer> > > > results =
+        s1.raftServer->append_packed_entries(msgs);
+    CHK_EQ( NUM, results.size() );
+    for (auto& entry: results) {
+        CHK_TRUE( entry->get_accepted() );
+    }
+    // All payloads should be in a single log.
+    CHK_EQ( last_idx + 1, s1.raftServer->get_last_log_idx() );
+
+    std::string test_msg = "test";
+    ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+    msg->put(test_msg);
+    CHK_TRUE( s1.raftServer->append_entries( {msg} )->get_accepted() );
+
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    // Deliver the updated commit index to followers.
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+    // Each payload should get its own result.
+    for (size_t ii = 0; ii < NUM; ++ii) {
+        CHK_EQ( cmd_result_code::OK, results[ii]->get_result_code() );
+        ptr<buffer> result = results[ii]->get();
+        CHK_NONNULL( result );
+        buffer_serializer bs(result);
+        CHK_EQ( last_idx + 1, bs.get_u64() );
+        CHK_EQ( ii, bs.get_u32() );
+    }
+
+    // All members should have applied the payloads in order.
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        std::vector< ptr<buffer> > payloads =
+            pp->getTestSm()->getPackedData(last_idx + 1);
+        CHK_EQ( NUM, payloads.size() );
+        for (size_t ii = 0; ii < NUM; ++ii) {
+            payloads[ii]->pos(0);
+            CHK_EQ( "packed" + std::to_string(ii),
+                    std::string( payloads[ii]->get_str() ) );
+        }
+        CHK_EQ( last_idx + 2, pp->getTestSm()->isCommitted("test") );
+    }
+
+    print_stats(pkgs);
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+int pack_app_logs_test() {
+    std::string test_msg = "payload";
+    ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+    msg->put(test_msg);
+    msg->pos(0);
+
+    // Without `nullptr`, version 0 format should be used.
+    std::vector< ptr<buffer> > payloads = { msg, buffer::alloc(0) };
+    ptr<buffer> packed = raft_server::pack_app_logs(payloads);
+    CHK_EQ( 0x0, packed->data_begin()[0] );
+
+    std::vector< ptr<buffer> > unpacked;
+    CHK_TRUE( raft_server::unpack_app_logs(*packed, unpacked) );
+    CHK_EQ( 2, unpacked.size() );
+    CHK_EQ( test_msg, std::string( unpacked[0]->get_str() ) );
+    CHK_NONNULL( unpacked[1] );
+    CHK_Z( unpacked[1]->size() );
+
+    // `nullptr` should be distinguished from an empty buffer.
+    payloads = { msg, nullptr, buffer::alloc(0) };
+    packed = raft_server::pack_app_logs(payloads);
+    CHK_EQ( 0x1, packed->data_begin()[0] );
+
+    CHK_TRUE( raft_server::unpack_app_logs(*packed, unpacked) );
+    CHK_EQ( 3, unpacked.size() );
+    CHK_EQ( test_msg, std::string( unpacked[0]->get_str() ) );
+    CHK_NULL( unpacked[1].get() );
+    CHK_NONNULL( unpacked[2] );
+    CHK_Z( unpacked[2]->size() );
+
+    // Truncated buffer.
+    ptr<buffer> truncated = buffer::alloc(packed->size() - 1);
+    memcpy(truncated->data_begin(), packed->data_begin(), truncated->size());
+    CHK_FALSE( raft_server::unpack_app_logs(*truncated, unpacked) );
+    CHK_Z( unpacked.size() );
+
+    // Unknown version.
+    packed->data_begin()[0] = 0xff;
+    CHK_FALSE( raft_server::unpack_app_logs(*packed, unpacked) );
+
+    return 0;
+}
+
+int commit_ret_ring_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    // Smaller than the number of logs in flight,
+    // to test the overflow to the map.
+    raft_params custom_params;
+    custom_params.with_election_timeout_lower(0);
+    custom_params.with_election_timeout_upper(10000);
+    custom_params.with_hb_interval(5000);
+    custom_params.with_client_req_timeout(1000000);
+    custom_params.with_reserved_log_items(0);
+    custom_params.with_snapshot_enabled(5);
+    custom_params.with_log_sync_stopping_gap(1);
+    custom_params.with_commit_ret_ring_size(3);
+    custom_params.return_method_ = raft_params::async_handler;
+    CHK_Z( launch_servers( pkgs, &custom_params ) );
+    CHK_Z( make_group( pkgs ) );
+
+    const size_t NUM = 10;
+    std::list< ptr< cmd_result< ptr<buffer> > > > handlers;
+    for (size_t ii = 0; ii < NUM; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        handlers.push_back( s1.raftServer->append_entries( {msg} ) );
+    }
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+    // Each request should get its own result (its log index).
+    size_t idx = 0;
+    for (auto& entry: handlers) {
+        CHK_EQ( cmd_result_code::OK, entry->get_result_code() );
+        ptr<buffer> result = entry->get();
+        CHK_NONNULL( result );
+        buffer_serializer bs(result);
+        uint64_t log_idx = bs.get_u64();
+        CHK_EQ( s1.getTestSm()->isCommitted( "test" + std::to_string(idx++) ),
+                log_idx );
+    }
+
+    // Pending requests should be cancelled on leadership change.
+    handlers.clear();
+    for (size_t ii = 0; ii < NUM; ++ii) {
+        std::string test_msg = "cancel" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        handlers.push_back( s1.raftServer->append_entries( {msg} ) );
+    }
+    s1.raftServer->yield_leadership(true);
+    for (auto& entry: handlers) {
+        CHK_EQ( cmd_result_code::CANCELLED, entry->get_result_code() );
+    }
+
+    print_stats(pkgs);
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+int commit_ret_ring_multi_entry_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    raft_params custom_params;
+    custom_params.with_election_timeout_lower(0);
+    custom_params.with_election_timeout_upper(10000);
+    custom_params.with_hb_interval(5000);
+    custom_params.with_client_req_timeout(1000000);
+    custom_params.with_reserved_log_items(0);
+    custom_params.with_snapshot_enabled(5);
+    custom_params.with_log_sync_stopping_gap(1);
+    custom_params.with_commit_ret_ring_size(4);
+    custom_params.return_method_ = raft_params::async_handler;
+    CHK_Z( launch_servers( pkgs, &custom_params ) );
+    CHK_Z( make_group( pkgs ) );
+
+    // Only the last log of each request has a waiter, the results
+    // of the others should not pile up in the map.
+    const size_t NUM_ROUNDS = 10;
+    const size_t NUM_REQS = 4;
+    const size_t NUM_LOGS = 3;
+    for (size_t ii = 0; ii < NUM_ROUNDS; ++ii) {
+        std::list< ptr< cmd_result< ptr<buffer> > > > handlers;
+        for (size_t jj = 0; jj < NUM_REQS; ++jj) {
+            std::vector< ptr<buffer> > logs;
+            for (size_t kk = 0; kk < NUM_LOGS; ++kk) {
+                std::string test_msg = "test" + std::to_string(ii) + "_" +
+                                       std::to_string(jj) + "_" +
+                                       std::to_string(kk);
+                ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+                msg->put(test_msg);
+                logs.push_back(msg);
+            }
+            handlers.push_back( s1.raftServer->append_entries(logs) );
+        }
+        s1.fNet->execReqResp();
+        s1.fNet->execReqResp();
+        TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+        for (auto& entry: handlers) {
+            CHK_EQ( cmd_result_code::OK, entry->get_result_code() );
+        }
+        CHK_Z( s1.raftServer->get_num_pending_commit_rets() );
+    }
+    CHK_Z( s2.raftServer->get_num_pending_commit_rets() );
+    CHK_Z( s3.raftServer->get_num_pending_commit_rets() );
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
+int apply_config_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    raft_params custom_params;
+    custom_params.election_timeout_lower_bound_ = 0;
+    custom_params.election_timeout_upper_bound_ = 1000;
+    custom_params.heart_beat_interval_ = 500;
+    custom_params.snapshot_distance_ = 100;
+    CHK_Z( launch_servers( pkgs, &custom_params ) );
     CHK_Z( make_group( pkgs ) );
 
     for (auto& entry: pkgs) {
@@ -2078,6 +4305,91 @@ int apply_config_test() {
     return 0;
 }
 
+int trace_events_test() {
+    reset_log_files();
+    ptr<FakeNetworkBase> f_base = cs_new<FakeNetworkBase>();
+
+    std::string s1_addr = "S1";
+    std::string s2_addr = "S2";
+    std::string s3_addr = "S3";
+
+    RaftPkg s1(f_base, 1, s1_addr);
+    RaftPkg s2(f_base, 2, s2_addr);
+    RaftPkg s3(f_base, 3, s3_addr);
+    std::vector<RaftPkg*> pkgs = {&s1, &s2, &s3};
+
+    trace_events::clear();
+    trace_events::enable(true);
+
+    CHK_Z( launch_servers( pkgs ) );
+    for (auto& entry: pkgs) {
+        RaftPkg* pp = entry;
+        raft_params param = pp->raftServer->get_current_params();
+        param.return_method_ = raft_params::async_handler;
+        pp->raftServer->update_params(param);
+    }
+    CHK_Z( make_group( pkgs ) );
+
+    const size_t NUM = 5;
+    for (size_t ii=0; ii<NUM; ++ii) {
+        std::string test_msg = "test" + std::to_string(ii);
+        ptr<buffer> msg = buffer::alloc(test_msg.size() + 1);
+        msg->put(test_msg);
+        s1.raftServer->append_entries( {msg} );
+    }
+    s1.fNet->execReqResp();
+    s1.fNet->execReqResp();
+    TestSuite::sleep_ms(COMMIT_TIME_MS);
+
+    trace_events::enable(false);
+
+    std::vector<trace_event> events;
+    trace_events::dump(events);
+
+    // Count events of S1 (leader) and S2 (follower).
+    std::map<uint16_t, size_t> s1_events;
+    std::map<uint16_t, size_t> s2_events;
+    uint64_t last_ts = 0;
+    uint64_t last_commit_idx = 0;
+    for (trace_event& ee: events) {
+        // Should be sorted.
+        CHK_GTEQ( ee.ts_ns_, last_ts );
+        last_ts = ee.ts_ns_;
+        if (ee.srv_id_ == 1) {
+            s1_events[ee.event_id_]++;
+            if (ee.event_id_ == TE_COMMIT_SM) last_commit_idx = ee.log_idx_;
+        } else if (ee.srv_id_ == 2) {
+            s2_events[ee.event_id_]++;
+        }
+    }
+    CHK_EQ( 1, s1_events[TE_BECOME_LEADER] );
+    CHK_GT( s1_events[TE_APPEND_REQ_SEND], 0 );
+    CHK_GT( s1_events[TE_APPEND_RESP_RECV], 0 );
+    CHK_GTEQ( s1_events[TE_LOG_APPEND], NUM );
+    CHK_GT( s1_events[TE_COMMIT_QUORUM], 0 );
+    CHK_EQ( s1.raftServer->get_committed_log_idx(), last_commit_idx );
+    CHK_GT( s2_events[TE_APPEND_REQ_RECV], 0 );
+
+    // Nothing should be recorded while disabled.
+    std::vector<trace_event> new_events;
+    s1.fNet->execReqResp();
+    trace_events::dump(new_events, last_ts);
+    CHK_Z( new_events.size() );
+
+    std::string json = trace_events::to_chrome_trace(events);
+    CHK_NEQ( std::string::npos, json.find("\"name\":\"become_leader\"") );
+
+    print_stats(pkgs);
+
+    s1.raftServer->shutdown();
+    s2.raftServer->shutdown();
+    s3.raftServer->shutdown();
+
+    f_base->destroy();
+
+    return 0;
+}
+
 }  // namespace raft_server_test;
 using namespace raft_server_test;
 
@@ -2125,6 +4437,9 @@ int main(int argc, char** argv) {
     ts.doTest( "leadership takeover with offline candidate test",
                leadership_takeover_offline_candidate_test );
 
+    ts.doTest( "leadership takeover with given successor test",
+               leadership_takeover_successor_test );
+
     ts.doTest( "temporary leader test",
                temporary_leader_test );
 
@@ -2140,9 +4455,24 @@ int main(int argc, char** argv) {
     ts.doTest( "snapshot basic test",
                snapshot_basic_test );
 
+    ts.doTest( "snapshot prefetch test",
+               snapshot_prefetch_test );
+
+    ts.doTest( "snapshot prefetch shutdown test",
+               snapshot_prefetch_shutdown_test );
+
+    ts.doTest( "snapshot streams test",
+               snapshot_streams_test );
+
     ts.doTest( "join empty node test",
                join_empty_node_test );
 
+    ts.doTest( "pipelined log sync test",
+               pipelined_log_sync_test );
+
+    ts.doTest( "snapshot log sync test",
+               snapshot_log_sync_test );
+
     ts.doTest( "async append handler test",
                async_append_handler_test );
 
@@ -2152,6 +4482,72 @@ int main(int argc, char** argv) {
     ts.doTest( "apply config log entry test",
                apply_config_test );
 
+    ts.doTest( "pipelined append test",
+               pipelined_append_test );
+
+    ts.doTest( "pipelined append reject test",
+               pipelined_append_reject_test );
+
+    ts.doTest( "parallel log appending test",
+               parallel_log_appending_test );
+
+    ts.doTest( "parallel log appending follower test",
+               parallel_log_appending_follower_test );
+
+    ts.doTest( "follower bg flush test",
+               follower_bg_flush_test );
+
+    ts.doTest( "flow control test",
+               flow_control_test );
+
+    ts.doTest( "adaptive batch test",
+               adaptive_batch_test );
+
+    ts.doTest( "learner test",
+               learner_test );
+
+    ts.doTest( "background log compaction test",
+               bg_log_compaction_test );
+
+    ts.doTest( "read index test",
+               read_index_test );
+
+    ts.doTest( "read index applied test",
+               read_index_applied_test );
+
+    ts.doTest( "read index custom quorum test",
+               read_index_custom_quorum_test );
+
+    ts.doTest( "bounded staleness read test",
+               bounded_stale_read_test );
+
+    ts.doTest( "group commit test",
+               group_commit_test );
+
+    ts.doTest( "rw lock append test",
+               rw_lock_append_test );
+
+    ts.doTest( "auto forwarding batch test",
+               auto_forwarding_batch_test );
+
+    ts.doTest( "commit batch test",
+               commit_batch_test );
+
+    ts.doTest( "packed append test",
+               packed_append_test );
+
+    ts.doTest( "pack app logs test",
+               pack_app_logs_test );
+
+    ts.doTest( "commit ret ring test",
+               commit_ret_ring_test );
+
+    ts.doTest( "commit ret ring multi entry test",
+               commit_ret_ring_multi_entry_test );
+
+    ts.doTest( "trace events test",
+               trace_events_test );
+
 #ifdef ENABLE_RAFT_STATS
     _msg("raft stats: ENABLED\n");
 #else
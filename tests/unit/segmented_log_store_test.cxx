@@ -0,0 +1,500 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "nuraft.hxx"
+#include "segmented_log_store.hxx"
+
+#include "test_common.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace nuraft;
+
+namespace segmented_log_store_test {
+
+static ptr<log_entry> make_entry(ulong term, size_t idx, size_t size = 0) {
+    std::string str = "log_" + std::to_string(idx) + "_";
+    while (str.size() < size) str += "x";
+    ptr<buffer> buf = buffer::alloc(str.size() + 1 + sizeof(int32));
+    buf->put(str);
+    buf->pos(0);
+    return cs_new<log_entry>(term, buf);
+}
+
+static bool check_entry(const ptr<log_entry>& le, ulong term, size_t idx) {
+    if (!le || le->get_term() != term) return false;
+    le->get_buf().pos(0);
+    std::string str = le->get_buf().get_str();
+    std::string expected = "log_" + std::to_string(idx) + "_";
+    return str.substr(0, expected.size()) == expected;
+}
+
+static segmented_log_store::options small_opt() {
+    segmented_log_store::options opt;
+    // Make a few entries roll over to the next segment.
+    opt.segment_size_ = 4096;
+    opt.index_interval_ = 4;
+    opt.fsync_ = false;
+    return opt;
+}
+
+int append_read_test() {
+    std::string path;
+    TEST_SUITE_PREPARE_PATH(path);
+
+    const size_t NUM = 300;
+    {   ptr<segmented_log_store> ls =
+            segmented_log_store::open(path, small_opt());
+        CHK_NONNULL(ls);
+        CHK_EQ(1, ls->start_index());
+        CHK_EQ(1, ls->next_slot());
+        CHK_EQ(0, ls->last_entry()->get_term());
+
+        for (size_t ii = 1; ii <= NUM; ++ii) {
+            ptr<log_entry> le = make_entry(ii / 10 + 1, ii, ii % 7 * 20);
+            CHK_EQ(ii, ls->append(le));
+        }
+        ls->end_of_append_batch(1, NUM);
+        CHK_GT(ls->get_num_segments(), 1);
+        CHK_EQ(NUM + 1, ls->next_slot());
+
+        for (size_t ii = 1; ii <= NUM; ++ii) {
+            CHK_TRUE( check_entry(ls->entry_at(ii), ii / 10 + 1, ii) );
+            CHK_EQ(ii / 10 + 1, ls->term_at(ii));
+        }
+        CHK_TRUE( check_entry(ls->last_entry(), NUM / 10 + 1, NUM) );
+
+        ptr<std::vector<ptr<log_entry>>> entries = ls->log_entries(11, 111);
+        CHK_NONNULL(entries);
+        CHK_EQ(100, entries->size());
+        for (size_t ii = 0; ii < entries->size(); ++ii) {
+            CHK_TRUE( check_entry((*entries)[ii], (ii + 11) / 10 + 1, ii + 11) );
+        }
+
+        entries = ls->log_entries_ext(1, NUM + 1, 100);
+        CHK_NONNULL(entries);
+        CHK_GT(entries->size(), 0);
+        CHK_SM(entries->size(), NUM);
+    }
+
+    // Reopen, all logs should be recovered.
+    {   ptr<segmented_log_store> ls =
+            segmented_log_store::open(path, small_opt());
+        CHK_NONNULL(ls);
+        CHK_EQ(1, ls->start_index());
+        CHK_EQ(NUM + 1, ls->next_slot());
+        for (size_t ii = 1; ii <= NUM; ++ii) {
+            CHK_TRUE( check_entry(ls->entry_at(ii), ii / 10 + 1, ii) );
+            CHK_EQ(ii / 10 + 1, ls->term_at(ii));
+        }
+
+        // Append more.
+        ptr<log_entry> le = make_entry(100, NUM + 1);
+        CHK_EQ(NUM + 1, ls->append(le));
+        CHK_TRUE( check_entry(ls->entry_at(NUM + 1), 100, NUM + 1) );
+    }
+
+    TEST_SUITE_CLEANUP_PATH();
+    return 0;
+}
+
+int write_at_test() {
+    std::string path;
+    TEST_SUITE_PREPARE_PATH(path);
+
+    const size_t NUM = 200;
+    {   ptr<segmented_log_store> ls =
+            segmented_log_store::open(path, small_opt());
+        CHK_NONNULL(ls);
+        for (size_t ii = 1; ii <= NUM; ++ii) {
+            ptr<log_entry> le = make_entry(1, ii, 50);
+            ls->append(le);
+        }
+        size_t num_segs = ls->get_num_segments();
+
+        // Overwrite in the middle, the rest should be truncated.
+        ptr<log_entry> le = make_entry(2, 1000);
+        ls->write_at(50, le);
+        CHK_EQ(51, ls->next_slot());
+        CHK_TRUE( check_entry(ls->entry_at(50), 2, 1000) );
+        CHK_EQ(2, ls->term_at(50));
+        CHK_EQ(0, ls->term_at(51));
+        CHK_TRUE( check_entry(ls->entry_at(49), 1, 49) );
+        CHK_SM(ls->get_num_segments(), num_segs);
+
+        le = make_entry(2, 51);
+        CHK_EQ(51, ls->append(le));
+        ls->flush();
+    }
+
+    // Truncated logs should not come back.
+    {   ptr<segmented_log_store> ls =
+            segmented_log_store::open(path, small_opt());
+        CHK_NONNULL(ls);
+        CHK_EQ(52, ls->next_slot());
+        CHK_TRUE( check_entry(ls->entry_at(50), 2, 1000) );
+        CHK_TRUE( check_entry(ls->entry_at(51), 2, 51) );
+        CHK_EQ(0, ls->term_at(52));
+    }
+
+    TEST_SUITE_CLEANUP_PATH();
+    return 0;
+}
+
+int batch_test() {
+    std::string path;
+    TEST_SUITE_PREPARE_PATH(path);
+
+    const size_t NUM = 100;
+    {   ptr<segmented_log_store> ls =
+            segmented_log_store::open(path, small_opt());
+        CHK_NONNULL(ls);
+
+        std::vector< ptr<log_entry> > entries;
+        for (size_t ii = 1; ii <= NUM; ++ii) {
+            entries.push_back( make_entry(1, ii, 50) );
+        }
+        ls->append_batch(1, entries);
+        CHK_EQ(NUM + 1, ls->next_slot());
+        CHK_GT(ls->get_num_segments(), 1);
+        for (size_t ii = 1; ii <= NUM; ++ii) {
+            CHK_TRUE( check_entry(ls->entry_at(ii), 1, ii) );
+        }
+
+        // Overwrite from the middle, the rest should be truncated.
+        entries.clear();
+        for (size_t ii = 0; ii < 10; ++ii) {
+            entries.push_back( make_entry(2, 1000 + ii) );
+        }
+        ls->write_batch_at(50, entries);
+        CHK_EQ(60, ls->next_slot());
+        CHK_TRUE( check_entry(ls->entry_at(49), 1, 49) );
+        for (size_t ii = 0; ii < 10; ++ii) {
+            CHK_TRUE( check_entry(ls->entry_at(50 + ii), 2, 1000 + ii) );
+        }
+        CHK_EQ(0, ls->term_at(60));
+        ls->flush();
+    }
+
+    {   ptr<segmented_log_store> ls =
+            segmented_log_store::open(path, small_opt());
+        CHK_NONNULL(ls);
+        CHK_EQ(60, ls->next_slot());
+        CHK_TRUE( check_entry(ls->entry_at(59), 2, 1009) );
+    }
+
+    TEST_SUITE_CLEANUP_PATH();
+    return 0;
+}
+
+int compact_test() {
+    std::string path;
+    TEST_SUITE_PREPARE_PATH(path);
+
+    const size_t NUM = 300;
+    {   ptr<segmented_log_store> ls =
+            segmented_log_store::open(path, small_opt());
+        CHK_NONNULL(ls);
+        for (size_t ii = 1; ii <= NUM; ++ii) {
+            ptr<log_entry> le = make_entry(ii, ii, 30);
+            ls->append(le);
+        }
+        size_t num_segs = ls->get_num_segments();
+
+        CHK_TRUE( ls->compact(150) );
+        CHK_EQ(151, ls->start_index());
+        CHK_EQ(NUM + 1, ls->next_slot());
+        CHK_SM(ls->get_num_segments(), num_segs);
+        CHK_EQ(0, ls->term_at(150));
+        CHK_EQ(151, ls->term_at(151));
+        CHK_TRUE( check_entry(ls->entry_at(151), 151, 151) );
+        CHK_NULL( ls->log_entries(100, 200).get() );
+    }
+
+    {   ptr<segmented_log_store> ls =
+            segmented_log_store::open(path, small_opt());
+        CHK_NONNULL(ls);
+        CHK_EQ(151, ls->start_index());
+        CHK_EQ(NUM + 1, ls->next_slot());
+        CHK_EQ(0, ls->term_at(150));
+        CHK_TRUE( check_entry(ls->entry_at(151), 151, 151) );
+
+        // Compact beyond the last log.
+        CHK_TRUE( ls->compact(NUM + 100) );
+        CHK_EQ(NUM + 101, ls->start_index());
+        CHK_EQ(NUM + 101, ls->next_slot());
+        CHK_EQ(0, ls->get_num_segments());
+    }
+
+    {   ptr<segmented_log_store> ls =
+            segmented_log_store::open(path, small_opt());
+        CHK_NONNULL(ls);
+        CHK_EQ(NUM + 101, ls->start_index());
+        CHK_EQ(NUM + 101, ls->next_slot());
+
+        ptr<log_entry> le = make_entry(1000, NUM + 101);
+        CHK_EQ(NUM + 101, ls->append(le));
+        CHK_TRUE( check_entry(ls->entry_at(NUM + 101), 1000, NUM + 101) );
+    }
+
+    TEST_SUITE_CLEANUP_PATH();
+    return 0;
+}
+
+int pack_test() {
+    std::string path;
+    TEST_SUITE_PREPARE_PATH(path);
+    std::string path_src = path + "_src";
+    std::string path_dst = path + "_dst";
+
+    const size_t NUM = 200;
+    ptr<segmented_log_store> src =
+        segmented_log_store::open(path_src, small_opt());
+    CHK_NONNULL(src);
+    for (size_t ii = 1; ii <= NUM; ++ii) {
+        ptr<log_entry> le = make_entry(ii, ii, 40);
+        src->append(le);
+    }
+
+    ptr<segmented_log_store> dst =
+        segmented_log_store::open(path_dst, small_opt());
+    CHK_NONNULL(dst);
+
+    // Pack across segments.
+    ptr<buffer> pack = src->pack(1, 100);
+    CHK_NONNULL(pack);
+    dst->apply_pack(1, *pack);
+    pack = src->pack(101, NUM - 100);
+    CHK_NONNULL(pack);
+    dst->apply_pack(101, *pack);
+
+    CHK_EQ(1, dst->start_index());
+    CHK_EQ(NUM + 1, dst->next_slot());
+    for (size_t ii = 1; ii <= NUM; ++ii) {
+        CHK_TRUE( check_entry(dst->entry_at(ii), ii, ii) );
+        CHK_EQ(ii, dst->term_at(ii));
+    }
+
+    // Apply at an index beyond the current logs: start over.
+    pack = src->pack(150, 10);
+    ptr<segmented_log_store> dst2 =
+        segmented_log_store::open(path_dst + "2", small_opt());
+    dst2->apply_pack(150, *pack);
+    CHK_EQ(150, dst2->start_index());
+    CHK_EQ(160, dst2->next_slot());
+    CHK_TRUE( check_entry(dst2->entry_at(155), 155, 155) );
+
+    TEST_SUITE_CLEANUP_PATH();
+    return 0;
+}
+
+int recovery_test() {
+    std::string path;
+    TEST_SUITE_PREPARE_PATH(path);
+
+    const size_t NUM = 10;
+    segmented_log_store::options opt = small_opt();
+    // Single segment.
+    opt.segment_size_ = 64 * 1024;
+    opt.fsync_ = true;
+    {   ptr<segmented_log_store> ls = segmented_log_store::open(path, opt);
+        CHK_NONNULL(ls);
+        for (size_t ii = 1; ii <= NUM; ++ii) {
+            ptr<log_entry> le = make_entry(1, ii, 100);
+            ls->append(le);
+        }
+        CHK_EQ(1, ls->get_num_segments());
+    }
+
+    // Corrupt the last record, as if it was partially written.
+    std::string seg_file = path + "/00000000000000000001.seg";
+    int fd = ::open(seg_file.c_str(), O_RDWR);
+    CHK_GTEQ(fd, 0);
+    off_t size = lseek(fd, 0, SEEK_END);
+    std::vector<char> data(size);
+    CHK_EQ(size, pread(fd, data.data(), size, 0));
+    off_t last_byte = size - 1;
+    while (last_byte > 0 && data[last_byte] == 0) last_byte--;
+    char junk = ~data[last_byte];
+    CHK_EQ(1, pwrite(fd, &junk, 1, last_byte));
+    ::close(fd);
+
+    {   ptr<segmented_log_store> ls = segmented_log_store::open(path, opt);
+        CHK_NONNULL(ls);
+        CHK_EQ(NUM, ls->next_slot());
+        CHK_TRUE( check_entry(ls->entry_at(NUM - 1), 1, NUM - 1) );
+
+        ptr<log_entry> le = make_entry(2, NUM);
+        CHK_EQ(NUM, ls->append(le));
+    }
+
+    {   ptr<segmented_log_store> ls = segmented_log_store::open(path, opt);
+        CHK_NONNULL(ls);
+        CHK_EQ(NUM + 1, ls->next_slot());
+        CHK_TRUE( check_entry(ls->entry_at(NUM), 2, NUM) );
+    }
+
+    TEST_SUITE_CLEANUP_PATH();
+    return 0;
+}
+
+int large_entry_test() {
+    std::string path;
+    TEST_SUITE_PREPARE_PATH(path);
+
+    ptr<segmented_log_store> ls = segmented_log_store::open(path, small_opt());
+    CHK_NONNULL(ls);
+
+    // Bigger than the segment size.
+    ptr<log_entry> le = make_entry(1, 1, 10);
+    ls->append(le);
+    le = make_entry(1, 2, 10000);
+    ls->append(le);
+    le = make_entry(1, 3, 10);
+    ls->append(le);
+    CHK_EQ(3, ls->get_num_segments());
+    CHK_TRUE( check_entry(ls->entry_at(2), 1, 2) );
+    CHK_GT(ls->entry_at(2)->get_buf().size(), 10000);
+    CHK_TRUE( check_entry(ls->entry_at(3), 1, 3) );
+
+    TEST_SUITE_CLEANUP_PATH();
+    return 0;
+}
+
+int roll_crash_test() {
+    std::string path;
+    TEST_SUITE_PREPARE_PATH(path);
+
+    const size_t NUM = 10;
+    {   ptr<segmented_log_store> ls =
+            segmented_log_store::open(path, small_opt());
+        CHK_NONNULL(ls);
+        for (size_t ii = 1; ii <= NUM; ++ii) {
+            ptr<log_entry> le = make_entry(1, ii, 100);
+            ls->append(le);
+        }
+        ls->flush();
+    }
+
+    // Crashed while rolling over to the next segment: the file exists,
+    // but its header was not written.
+    std::string seg_file = path + "/00000000000000000011.seg";
+    int fd = ::open(seg_file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CHK_GTEQ(fd, 0);
+    CHK_Z( ::ftruncate(fd, 4096) );
+    ::close(fd);
+
+    {   ptr<segmented_log_store> ls =
+            segmented_log_store::open(path, small_opt());
+        CHK_NONNULL(ls);
+        CHK_EQ(NUM + 1, ls->next_slot());
+        CHK_TRUE( check_entry(ls->entry_at(NUM), 1, NUM) );
+        CHK_NEQ( 0, ::access(seg_file.c_str(), F_OK) );
+
+        ptr<log_entry> le = make_entry(2, NUM + 1);
+        CHK_EQ(NUM + 1, ls->append(le));
+        ls->flush();
+    }
+
+    {   ptr<segmented_log_store> ls =
+            segmented_log_store::open(path, small_opt());
+        CHK_NONNULL(ls);
+        CHK_EQ(NUM + 2, ls->next_slot());
+        CHK_TRUE( check_entry(ls->entry_at(NUM + 1), 2, NUM + 1) );
+    }
+
+    TEST_SUITE_CLEANUP_PATH();
+    return 0;
+}
+
+}  // namespace segmented_log_store_test;
+using namespace segmented_log_store_test;
+
+int val_type_test() {
+    std::string path;
+    TEST_SUITE_PREPARE_PATH(path);
+
+    // Every 7th log is a config.
+    const size_t NUM = 50;
+    auto type_of = [](size_t idx) -> log_val_type {
+        return (idx % 7 == 0) ? log_val_type::conf : log_val_type::app_log;
+    };
+
+    {   ptr<segmented_log_store> ls =
+            segmented_log_store::open(path, small_opt());
+        CHK_NONNULL(ls);
+        for (size_t ii = 1; ii <= NUM; ++ii) {
+            ptr<log_entry> le = make_entry(1, ii, 100);
+            ptr<log_entry> typed =
+                cs_new<log_entry>(1, le->get_buf_ptr(), type_of(ii));
+            ls->append(typed);
+        }
+        CHK_GT(ls->get_num_segments(), 1);
+        ls->flush();
+    }
+
+    {   ptr<segmented_log_store> ls =
+            segmented_log_store::open(path, small_opt());
+        CHK_NONNULL(ls);
+        for (size_t ii = 1; ii <= NUM; ++ii) {
+            CHK_EQ( (int)type_of(ii), (int)ls->val_type_at(ii) );
+            CHK_EQ( (int)type_of(ii), (int)ls->entry_at(ii)->get_val_type() );
+        }
+        // Out of range.
+        CHK_EQ( (int)log_val_type::app_log, (int)ls->val_type_at(NUM + 1) );
+    }
+
+    TEST_SUITE_CLEANUP_PATH();
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    TestSuite ts(argc, argv);
+
+    ts.options.printTestMessage = true;
+
+    ts.doTest( "append and read test",
+               append_read_test );
+
+    ts.doTest( "write at test",
+               write_at_test );
+
+    ts.doTest( "batch append test",
+               batch_test );
+
+    ts.doTest( "compact test",
+               compact_test );
+
+    ts.doTest( "pack and apply pack test",
+               pack_test );
+
+    ts.doTest( "recovery test",
+               recovery_test );
+
+    ts.doTest( "large entry test",
+               large_entry_test );
+
+    ts.doTest( "roll crash test",
+               roll_crash_test );
+
+    ts.doTest( "val type test",
+               val_type_test );
+
+    return 0;
+}
+
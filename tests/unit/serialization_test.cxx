@@ -196,6 +196,49 @@ int snapshot_sync_req_zero_buffer_test(bool done) {
     return 0;
 }
 
+int snapshot_sync_req_stream_test(bool done) {
+    ptr<buffer> rnd_buf(buffer::alloc(rnd() % 100 + 1));
+    for (size_t i = 0; i < rnd_buf->size(); ++i) {
+        rnd_buf->put((byte)(rnd()));
+    }
+    rnd_buf->pos(0);
+
+    ptr<snapshot> snp = generate_random_snapshot();
+    ptr<snapshot_sync_req> sync_req
+                           ( cs_new<snapshot_sync_req>
+                             ( snp, long_val(rnd()), rnd_buf, done ) );
+    sync_req->set_stream(2, 4);
+    ptr<buffer> sync_req_buf( sync_req->serialize() );
+
+    ptr<snapshot_sync_req> sync_req1
+                           ( snapshot_sync_req::deserialize( *sync_req_buf ) );
+    CHK_EQ( sync_req->get_offset(), sync_req1->get_offset() );
+    CHK_EQ( done, sync_req1->is_done() );
+    CHK_EQ( 2, sync_req1->get_stream_id() );
+    CHK_EQ( 4, sync_req1->get_num_streams() );
+
+    buffer& buf1 = sync_req1->get_data();
+    CHK_EQ( rnd_buf->size(), buf1.size() );
+    CHK_Z( memcmp( rnd_buf->data(), buf1.data(), buf1.size() ) );
+
+    // Response context.
+    ptr<buffer> ack = snapshot_sync_req::make_stream_ack(3, done, !done);
+    int32 stream_id = 0;
+    bool stream_done = false, snp_done = false;
+    CHK_TRUE( snapshot_sync_req::parse_stream_ack
+              ( *ack, stream_id, stream_done, snp_done ) );
+    CHK_EQ( 3, stream_id );
+    CHK_EQ( done, stream_done );
+    CHK_EQ( !done, snp_done );
+
+    // Context of non-stream response.
+    ptr<buffer> done_ctx = buffer::alloc(1);
+    CHK_FALSE( snapshot_sync_req::parse_stream_ack
+               ( *done_ctx, stream_id, stream_done, snp_done ) );
+
+    return 0;
+}
+
 int log_entry_test() {
     ptr<buffer> data = buffer::alloc(24 + rnd() % 100);
     for (size_t i = 0; i < data->size(); ++i) {
@@ -221,6 +264,38 @@ int log_entry_test() {
     return 0;
 }
 
+int log_entry_compact_test(size_t len) {
+    std::string payload(len, 'x');
+    for (size_t ii = 0; ii < len; ++ii) payload[ii] = 'a' + rnd() % 26;
+
+    ptr<log_entry> entry = log_entry::make_compact
+                           ( 123, (const byte*)payload.data(), len,
+                             log_val_type::conf );
+    CHK_EQ( 123, entry->get_term() );
+    CHK_EQ( log_val_type::conf, entry->get_val_type() );
+    CHK_FALSE( entry->is_buf_null() );
+    CHK_EQ( len, entry->get_buf().size() );
+    CHK_EQ( 0, entry->get_buf().pos() );
+    CHK_Z( memcmp( entry->get_buf().data_begin(), payload.data(), len ) );
+
+    // Serialize and deserialize.
+    ptr<buffer> enc = entry->serialize();
+    ptr<log_entry> entry2 = log_entry::deserialize(*enc);
+    CHK_EQ( entry->get_term(), entry2->get_term() );
+    CHK_EQ( entry->get_val_type(), entry2->get_val_type() );
+    CHK_EQ( len, entry2->get_buf().size() );
+    CHK_Z( memcmp( entry2->get_buf().data_begin(), payload.data(), len ) );
+
+    // The buffer should be valid after the log entry is released.
+    ptr<buffer> buf = entry->get_buf_ptr();
+    CHK_EQ( &entry->get_buf(), buf.get() );
+    entry.reset();
+    CHK_EQ( len, buf->size() );
+    CHK_Z( memcmp( buf->data_begin(), payload.data(), len ) );
+
+    return 0;
+}
+
 int custom_notification_msg_test(bool empty_context) {
     custom_notification_msg orig_msg;
     orig_msg.type_ = custom_notification_msg::out_of_log_range_warning;
@@ -279,7 +354,13 @@ int main(int argc, char** argv) {
     ts.doTest( "snapshot_sync_req zero buffer test",
                snapshot_sync_req_zero_buffer_test,
                TestRange<bool>( {true, false} ) );
+    ts.doTest( "snapshot_sync_req stream test",
+               snapshot_sync_req_stream_test,
+               TestRange<bool>( {true, false} ) );
     ts.doTest( "log_entry test", log_entry_test );
+    ts.doTest( "log_entry compact test",
+               log_entry_compact_test,
+               TestRange<size_t>( {0, 64, 0x8000 + 10} ) );
     ts.doTest( "custom_notification_msg test",
                custom_notification_msg_test,
                TestRange<bool>( {true, false} ) );
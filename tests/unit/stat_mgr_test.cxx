@@ -23,6 +23,8 @@ limitations under the License.
 #include <cstring>
 #include <random>
 #include <string>
+#include <thread>
+#include <vector>
 
 using namespace nuraft;
 
@@ -80,6 +82,90 @@ int stat_mgr_basic_test() {
     return 0;
 }
 
+int stat_mgr_multi_thread_test(size_t num_threads) {
+    stat_elem& counter = *stat_mgr::get_instance()->create_stat
+        (stat_elem::COUNTER, "mt_counter");
+
+    stat_elem& histogram = *stat_mgr::get_instance()->create_stat
+        (stat_elem::HISTOGRAM, "mt_histogram");
+    raft_server::reset_stat("mt_counter");
+    raft_server::reset_stat("mt_histogram");
+
+    // Should return the same handle.
+    CHK_EQ( &counter, stat_mgr::get_instance()->create_stat
+                      (stat_elem::COUNTER, "mt_counter") );
+
+    const size_t NUM = 100000;
+    std::vector<std::thread> threads;
+    for (size_t ii = 0; ii < num_threads; ++ii) {
+        threads.push_back( std::thread( [&counter, &histogram, NUM]() {
+            for (size_t jj = 0; jj < NUM; ++jj) {
+                counter++;
+                histogram += jj;
+            }
+        } ) );
+    }
+    for (std::thread& tt: threads) tt.join();
+
+    // Shards should be aggregated.
+    CHK_EQ(NUM * num_threads, raft_server::get_stat_counter("mt_counter"));
+
+    std::map<double, uint64_t> hist_dump;
+    raft_server::get_stat_histogram("mt_histogram", hist_dump);
+    size_t hist_sum = 0;
+    for (auto& entry: hist_dump) hist_sum += entry.second;
+    CHK_EQ(NUM * num_threads, hist_sum);
+
+    // Set should override all shards.
+    counter = 10;
+    CHK_EQ(10, raft_server::get_stat_counter("mt_counter"));
+
+    return 0;
+}
+
+int stat_mgr_prometheus_test() {
+    stat_elem& counter = *stat_mgr::get_instance()->create_stat
+        (stat_elem::COUNTER, "prom.counter");
+    stat_elem& gauge = *stat_mgr::get_instance()->create_stat
+        (stat_elem::GAUGE, "prom_gauge");
+    stat_elem& histogram = *stat_mgr::get_instance()->create_stat
+        (stat_elem::HISTOGRAM, "prom_histogram");
+    raft_server::reset_all_stats();
+
+    counter += 3;
+    gauge = 7;
+    histogram += 1;
+    histogram += 100;
+    histogram += 100;
+
+    std::string text = raft_server::get_all_stats_prometheus("test_");
+    TestSuite::_msg("%s", text.c_str());
+
+    // Invalid character should be replaced.
+    CHK_NEQ( std::string::npos,
+             text.find("# TYPE test_prom_counter counter\n"
+                       "test_prom_counter 3\n") );
+    CHK_NEQ( std::string::npos,
+             text.find("# TYPE test_prom_gauge gauge\n"
+                       "test_prom_gauge 7\n") );
+
+    // Buckets should be cumulative.
+    CHK_NEQ( std::string::npos,
+             text.find("# TYPE test_prom_histogram histogram\n") );
+    CHK_NEQ( std::string::npos,
+             text.find("test_prom_histogram_bucket{le=\"2\"} 1\n") );
+    CHK_NEQ( std::string::npos,
+             text.find("test_prom_histogram_bucket{le=\"128\"} 3\n") );
+    CHK_NEQ( std::string::npos,
+             text.find("test_prom_histogram_bucket{le=\"+Inf\"} 3\n") );
+    CHK_NEQ( std::string::npos,
+             text.find("test_prom_histogram_sum 201\n") );
+    CHK_NEQ( std::string::npos,
+             text.find("test_prom_histogram_count 3\n") );
+
+    return 0;
+}
+
 }  // namespace stat_mgr_test;
 using namespace stat_mgr_test;
 
@@ -91,6 +177,13 @@ int main(int argc, char** argv) {
 #ifdef ENABLE_RAFT_STATS
     ts.doTest( "stat mgr basic test",
                stat_mgr_basic_test );
+
+    ts.doTest( "stat mgr multi thread test",
+               stat_mgr_multi_thread_test,
+               TestRange<size_t>( {1, 4, 32} ) );
+
+    ts.doTest( "stat mgr prometheus test",
+               stat_mgr_prometheus_test );
 #endif
 
     return 0;
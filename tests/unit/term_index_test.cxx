@@ -0,0 +1,158 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "nuraft.hxx"
+
+#include "in_memory_log_store.hxx"
+#include "term_index.hxx"
+
+#include "test_common.h"
+
+#include <vector>
+
+using namespace nuraft;
+
+namespace term_index_test {
+
+static void append_logs(inmem_log_store& store,
+                        const std::vector<ulong>& terms)
+{
+    for (ulong term: terms) {
+        ptr<buffer> buf = buffer::alloc(sizeof(ulong));
+        buf->put(term);
+        ptr<log_entry> le = cs_new<log_entry>(term, buf);
+        store.append(le);
+    }
+}
+
+static int check_terms(term_index& ti, log_store& store) {
+    for (ulong ii = store.start_index(); ii < store.next_slot(); ++ii) {
+        ulong term = 0;
+        CHK_TRUE( ti.find(ii, term) );
+        CHK_EQ( store.term_at(ii), term );
+    }
+    return 0;
+}
+
+int rebuild_test() {
+    inmem_log_store store;
+    term_index ti;
+
+    // Empty log store.
+    ti.rebuild(store);
+    ulong term = 0;
+    CHK_FALSE( ti.find(1, term) );
+
+    append_logs(store, {1, 1, 1, 2, 3, 3, 5, 5, 5, 5, 8});
+    ti.rebuild(store);
+    CHK_Z( check_terms(ti, store) );
+    CHK_FALSE( ti.find(0, term) );
+    CHK_FALSE( ti.find(store.next_slot(), term) );
+
+    // After compaction.
+    store.compact(5);
+    ti.rebuild(store);
+    CHK_Z( check_terms(ti, store) );
+    CHK_FALSE( ti.find(5, term) );
+
+    return 0;
+}
+
+int append_overwrite_test() {
+    term_index ti;
+    ulong term = 0;
+
+    for (ulong ii = 1; ii <= 10; ++ii) {
+        ti.append(ii, (ii + 2) / 3);
+    }
+    for (ulong ii = 1; ii <= 10; ++ii) {
+        CHK_TRUE( ti.find(ii, term) );
+        CHK_EQ( (ii + 2) / 3, term );
+    }
+
+    // Overwrite from the middle of a run: the rest should be dropped.
+    ti.append(5, 7);
+    CHK_TRUE( ti.find(4, term) );
+    CHK_EQ( 2, term );
+    CHK_TRUE( ti.find(5, term) );
+    CHK_EQ( 7, term );
+    CHK_FALSE( ti.find(6, term) );
+
+    // Gap: only the new log is covered.
+    ti.append(10, 8);
+    CHK_FALSE( ti.find(5, term) );
+    CHK_TRUE( ti.find(10, term) );
+    CHK_EQ( 8, term );
+
+    // Overwrite the first log.
+    ti.append(10, 9);
+    CHK_TRUE( ti.find(10, term) );
+    CHK_EQ( 9, term );
+    CHK_FALSE( ti.find(11, term) );
+
+    return 0;
+}
+
+int compact_test() {
+    term_index ti;
+    ulong term = 0;
+
+    for (ulong ii = 1; ii <= 20; ++ii) {
+        ti.append(ii, (ii + 4) / 5);
+    }
+
+    ti.compact(7);
+    CHK_FALSE( ti.find(7, term) );
+    for (ulong ii = 8; ii <= 20; ++ii) {
+        CHK_TRUE( ti.find(ii, term) );
+        CHK_EQ( (ii + 4) / 5, term );
+    }
+
+    // Compaction below the start does nothing.
+    ti.compact(3);
+    CHK_TRUE( ti.find(8, term) );
+
+    // Compaction beyond the last log clears everything,
+    // and then appending can start from any index.
+    ti.compact(25);
+    CHK_FALSE( ti.find(20, term) );
+    ti.append(26, 10);
+    CHK_TRUE( ti.find(26, term) );
+    CHK_EQ( 10, term );
+
+    return 0;
+}
+
+}  // namespace term_index_test;
+using namespace term_index_test;
+
+int main(int argc, char** argv) {
+    TestSuite ts(argc, argv);
+
+    ts.options.printTestMessage = false;
+
+    ts.doTest( "rebuild test",
+               rebuild_test );
+
+    ts.doTest( "append overwrite test",
+               append_overwrite_test );
+
+    ts.doTest( "compact test",
+               compact_test );
+
+    return 0;
+}
+
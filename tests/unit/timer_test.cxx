@@ -19,10 +19,12 @@ limitations under the License.
 **************************************************************************/
 
 #include "nuraft.hxx"
+#include "timer_wheel.hxx"
 
 #include "test_common.h"
 
 #include <atomic>
+#include <vector>
 
 using namespace nuraft;
 
@@ -32,8 +34,14 @@ void timer_invoke_handler(std::atomic<size_t>* counter) {
     if (counter) (*counter)++;
 }
 
-int timer_basic_test() {
-    asio_service svc;
+static asio_service::options get_options(bool timer_wheel) {
+    asio_service::options opt;
+    if (timer_wheel) opt.timer_wheel_tick_ms_ = 10;
+    return opt;
+}
+
+int timer_basic_test(bool timer_wheel) {
+    asio_service svc( get_options(timer_wheel) );
     std::atomic<size_t> counter(0);
     timer_task<void>::executor handler = std::bind( timer_invoke_handler,
                                                     &counter );
@@ -57,8 +65,8 @@ int timer_basic_test() {
     return 0;
 }
 
-int timer_cancel_test() {
-    asio_service svc;
+int timer_cancel_test(bool timer_wheel) {
+    asio_service svc( get_options(timer_wheel) );
     std::atomic<size_t> counter(0);
     timer_task<void>::executor handler = std::bind( timer_invoke_handler,
                                                     &counter );
@@ -91,6 +99,87 @@ int timer_cancel_test() {
     return 0;
 }
 
+int timer_wheel_expiry_test() {
+    const size_t TICK_MS = 10;
+    timer_wheel tw(TICK_MS);
+
+    // Timeouts across all levels of the wheel.
+    std::vector<int32> timeouts_ms =
+        { 0, 5, 10, 11, 630, 640, 650, 40950, 40960, 41000, 2621440 };
+    std::vector<size_t> counters(timeouts_ms.size(), 0);
+    std::vector< ptr<delayed_task> > tasks;
+    for (size_t ii = 0; ii < timeouts_ms.size(); ++ii) {
+        timer_task<void>::executor handler =
+            std::bind( timer_invoke_handler, nullptr );
+        ptr<delayed_task> task = cs_new< timer_task<void> >( handler );
+        tasks.push_back(task);
+        tw.schedule(task, timeouts_ms[ii]);
+    }
+    CHK_EQ( timeouts_ms.size(), tw.get_num_tasks() );
+
+    // Each task should expire at the first tick after its timeout.
+    size_t max_ticks = timeouts_ms.back() / TICK_MS + 2;
+    for (size_t tick = 0; tick < max_ticks; ++tick) {
+        std::vector< ptr<delayed_task> > expired;
+        tw.advance(expired);
+        for (ptr<delayed_task>& ee: expired) {
+            for (size_t ii = 0; ii < tasks.size(); ++ii) {
+                if (tasks[ii] != ee) continue;
+                counters[ii]++;
+                size_t exp_tick = (timeouts_ms[ii] + TICK_MS - 1) / TICK_MS;
+                CHK_EQ( exp_tick, tick );
+            }
+        }
+    }
+    for (size_t& cc: counters) CHK_EQ(1, cc);
+    CHK_Z( tw.get_num_tasks() );
+    return 0;
+}
+
+int timer_wheel_reschedule_test() {
+    const size_t TICK_MS = 10;
+    timer_wheel tw(TICK_MS);
+
+    timer_task<void>::executor handler = std::bind( timer_invoke_handler,
+                                                    nullptr );
+    ptr<delayed_task> task = cs_new< timer_task<void> >( handler );
+
+    // Re-schedule it repeatedly, like heartbeat and election timers.
+    // It should be delayed every time.
+    for (size_t ii = 0; ii < 1000; ++ii) {
+        tw.schedule(task, 100);
+        CHK_EQ(1, tw.get_num_tasks());
+        std::vector< ptr<delayed_task> > expired;
+        tw.advance(expired);
+        CHK_Z( expired.size() );
+    }
+
+    // Cancel and re-schedule.
+    tw.cancel(task);
+    CHK_Z( tw.get_num_tasks() );
+    for (size_t ii = 0; ii < 100; ++ii) {
+        std::vector< ptr<delayed_task> > expired;
+        tw.advance(expired);
+        CHK_Z( expired.size() );
+    }
+
+    tw.schedule(task, 100);
+    size_t num_ticks = 0;
+    while (true) {
+        std::vector< ptr<delayed_task> > expired;
+        tw.advance(expired);
+        if (!expired.empty()) {
+            CHK_EQ(1, expired.size());
+            CHK_EQ(task.get(), expired[0].get());
+            break;
+        }
+        num_ticks++;
+        CHK_SM(num_ticks, 100);
+    }
+    CHK_EQ(10, num_ticks);
+    return 0;
+}
+
 }  // namespace timer_test;
 using namespace timer_test;
 
@@ -100,10 +189,18 @@ int main(int argc, char** argv) {
     ts.options.printTestMessage = false;
 
     ts.doTest( "timer basic test",
-               timer_basic_test );
+               timer_basic_test,
+               TestRange<bool>( {false, true} ) );
 
     ts.doTest( "timer cancel test",
-               timer_cancel_test );
+               timer_cancel_test,
+               TestRange<bool>( {false, true} ) );
+
+    ts.doTest( "timer wheel expiry test",
+               timer_wheel_expiry_test );
+
+    ts.doTest( "timer wheel reschedule test",
+               timer_wheel_reschedule_test );
 
     return 0;
 }
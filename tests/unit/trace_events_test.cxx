@@ -0,0 +1,186 @@
+/************************************************************************
+Copyright 2017-2019 eBay Inc.
+Author/Developer(s): Jung-Sang Ahn
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+**************************************************************************/
+
+#include "nuraft.hxx"
+
+#include "test_common.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace nuraft;
+
+namespace trace_events_test {
+
+int trace_events_ring_test(size_t num_events) {
+    trace_events::clear();
+
+    for (size_t ii = 0; ii < num_events; ++ii) {
+        trace_events::record(TE_LOG_APPEND, 1, ii, 2, 3);
+    }
+
+    std::vector<trace_event> events;
+    trace_events::dump(events);
+
+    // Only the latest events should remain, except for the oldest
+    // slot that is the next one to be overwritten.
+    size_t exp_num = (num_events < trace_events::RING_SIZE)
+                     ? num_events : trace_events::RING_SIZE - 1;
+    CHK_EQ( exp_num, events.size() );
+    for (size_t ii = 0; ii < exp_num; ++ii) {
+        trace_event& ee = events[ii];
+        CHK_EQ( TE_LOG_APPEND, ee.event_id_ );
+        CHK_EQ( num_events - exp_num + ii, ee.log_idx_ );
+        CHK_EQ( 1, ee.srv_id_ );
+        CHK_EQ( 2, ee.peer_id_ );
+        CHK_EQ( 3, ee.term_ );
+    }
+
+    // Streaming: only new events after the last one.
+    uint64_t last_ts = events.back().ts_ns_;
+    trace_events::record(TE_COMMIT_SM, 1, num_events, -1, 3);
+    trace_events::dump(events, last_ts);
+    CHK_EQ( 1, events.size() );
+    CHK_EQ( TE_COMMIT_SM, events[0].event_id_ );
+
+    return 0;
+}
+
+int trace_events_multi_thread_test() {
+    trace_events::clear();
+
+    const size_t NUM_THREADS = 4;
+    const size_t NUM = 1000;
+    std::vector<std::thread> threads;
+    for (size_t ii = 0; ii < NUM_THREADS; ++ii) {
+        threads.push_back( std::thread( [ii, NUM]() {
+            for (size_t jj = 0; jj < NUM; ++jj) {
+                trace_events::record(TE_APPEND_REQ_SEND, ii, jj, -1, 1);
+            }
+        } ) );
+    }
+    for (std::thread& tt: threads) tt.join();
+
+    // Events of exited threads should be available, in time order.
+    std::vector<trace_event> events;
+    trace_events::dump(events);
+    CHK_EQ( NUM_THREADS * NUM, events.size() );
+
+    std::vector<uint64_t> next_idx(NUM_THREADS, 0);
+    for (size_t ii = 0; ii < events.size(); ++ii) {
+        trace_event& ee = events[ii];
+        if (ii) CHK_GTEQ( ee.ts_ns_, events[ii - 1].ts_ns_ );
+        CHK_EQ( next_idx[ee.srv_id_]++, ee.log_idx_ );
+    }
+    return 0;
+}
+
+int trace_events_thread_exit_test() {
+    trace_events::clear();
+
+    // Each thread fills a half of its ring, and then exits.
+    const size_t NUM_THREADS = 4;
+    const size_t NUM = trace_events::RING_SIZE / 2;
+    for (size_t ii = 0; ii < NUM_THREADS; ++ii) {
+        std::thread tt( [ii, NUM]() {
+            for (size_t jj = 0; jj < NUM; ++jj) {
+                trace_events::record(TE_APPEND_REQ_SEND, ii, jj, -1, 1);
+            }
+        } );
+        tt.join();
+    }
+
+    // Rings of the exited threads are freed, only the latest
+    // `RING_SIZE` events of them are kept.
+    std::vector<trace_event> events;
+    trace_events::dump(events);
+    CHK_EQ( trace_events::RING_SIZE, events.size() );
+    for (size_t ii = 0; ii < events.size(); ++ii) {
+        trace_event& ee = events[ii];
+        CHK_EQ( NUM_THREADS - 2 + ii / NUM, (size_t)ee.srv_id_ );
+        CHK_EQ( ii % NUM, ee.log_idx_ );
+    }
+    return 0;
+}
+
+int trace_events_file_test() {
+    trace_events::clear();
+    trace_events::record(TE_ELECTION_START, 1, 10, -1, 5);
+    trace_events::record(TE_VOTE_GRANTED, 1, 0, 2, 5);
+    trace_events::record(TE_BECOME_LEADER, 1, 10, -1, 5);
+
+    std::vector<trace_event> events;
+    trace_events::dump(events);
+    CHK_EQ( 3, events.size() );
+
+    std::string path = "./trace_events_test.bin";
+    CHK_TRUE( trace_events::save(path, events) );
+
+    std::vector<trace_event> loaded;
+    CHK_TRUE( trace_events::load(path, loaded) );
+    CHK_EQ( events.size(), loaded.size() );
+    for (size_t ii = 0; ii < events.size(); ++ii) {
+        CHK_Z( memcmp(&events[ii], &loaded[ii], sizeof(trace_event)) );
+    }
+
+    std::string json = trace_events::to_chrome_trace(loaded);
+    TestSuite::_msg("%s", json.c_str());
+    CHK_EQ( 0, json.find("{\"traceEvents\":[") );
+    CHK_NEQ( std::string::npos, json.find("\"name\":\"election_start\"") );
+    CHK_NEQ( std::string::npos, json.find("\"name\":\"vote_granted\"") );
+    CHK_NEQ( std::string::npos, json.find("\"args\":{\"log_idx\":0,"
+                                          "\"term\":5,\"peer\":2}") );
+
+    // Not a trace file.
+    std::string bad_path = "./trace_events_test.bad";
+    CHK_TRUE( trace_events::save(bad_path, std::vector<trace_event>()) );
+    {   FILE* fp = fopen(bad_path.c_str(), "wb");
+        fputs("not a trace file", fp);
+        fclose(fp);
+    }
+    CHK_FALSE( trace_events::load(bad_path, loaded) );
+
+    remove(path.c_str());
+    remove(bad_path.c_str());
+    return 0;
+}
+
+}  // namespace trace_events_test;
+using namespace trace_events_test;
+
+int main(int argc, char** argv) {
+    TestSuite ts(argc, argv);
+
+    ts.options.printTestMessage = false;
+
+    ts.doTest( "trace events ring test",
+               trace_events_ring_test,
+               TestRange<size_t>( {10, trace_events::RING_SIZE,
+                                   trace_events::RING_SIZE * 3 + 1} ) );
+
+    ts.doTest( "trace events multi thread test",
+               trace_events_multi_thread_test );
+
+    ts.doTest( "trace events thread exit test",
+               trace_events_thread_exit_test );
+
+    ts.doTest( "trace events file test",
+               trace_events_file_test );
+
+    return 0;
+}